@@ -67,6 +67,76 @@ bool OBNsim::Utils::isValidNodeName(const std::string &name) {
     return (name.find("//") == std::string::npos) && (name.find("/_") == std::string::npos);
 }
 
+void OBNsim::Utils::encodeUpdateList(const UpdateList& updates, std::string& bytes) {
+    bytes.resize(updates.size() * 16);
+    auto p = bytes.begin();
+    for (const auto& update: updates) {
+        uint64_t v[2] = {static_cast<uint64_t>(update.first), update.second};
+        for (auto x: v) {
+            for (int k = 0; k < 8; ++k, x >>= 8) {
+                *(p++) = static_cast<char>(x & 0xFF);
+            }
+        }
+    }
+}
+
+bool OBNsim::Utils::decodeUpdateList(const std::string& bytes, UpdateList& updates) {
+    updates.clear();
+    if (bytes.size() % 16 != 0) {
+        return false;
+    }
+    updates.reserve(bytes.size() / 16);
+    for (auto p = bytes.begin(); p != bytes.end(); ) {
+        uint64_t v[2] = {0, 0};
+        for (auto& x: v) {
+            for (int k = 0; k < 8; ++k) {
+                x |= static_cast<uint64_t>(static_cast<unsigned char>(*(p++))) << (8*k);
+            }
+        }
+        updates.emplace_back(static_cast<simtime_t>(v[0]), v[1]);
+    }
+    return true;
+}
+
+void OBNsim::Utils::encodeIntStringList(const IntStringList& list, std::string& bytes) {
+    std::size_t size = 0;
+    for (const auto& item: list) {
+        size += 16 + item.second.size();
+    }
+    bytes.clear();
+    bytes.reserve(size);
+    for (const auto& item: list) {
+        uint64_t v[2] = {static_cast<uint64_t>(item.first), item.second.size()};
+        for (auto x: v) {
+            for (int k = 0; k < 8; ++k, x >>= 8) {
+                bytes.push_back(static_cast<char>(x & 0xFF));
+            }
+        }
+        bytes.append(item.second);
+    }
+}
+
+bool OBNsim::Utils::decodeIntStringList(const std::string& bytes, IntStringList& list) {
+    list.clear();
+    for (std::size_t p = 0; p < bytes.size(); ) {
+        if (bytes.size() - p < 16) {
+            return false;
+        }
+        uint64_t v[2] = {0, 0};
+        for (auto& x: v) {
+            for (int k = 0; k < 8; ++k) {
+                x |= static_cast<uint64_t>(static_cast<unsigned char>(bytes[p++])) << (8*k);
+            }
+        }
+        if (v[1] > bytes.size() - p) {
+            return false;
+        }
+        list.emplace_back(static_cast<int64_t>(v[0]), bytes.substr(p, v[1]));
+        p += v[1];
+    }
+    return true;
+}
+
 void OBNsim::ResizableBuffer::allocateData(std::size_t newsize) {
     m_data_size = newsize;
     
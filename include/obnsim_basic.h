@@ -14,6 +14,8 @@
 #include <cstdint>
 #include <string>
 #include <chrono>
+#include <vector>
+#include <utility>
 
 namespace OBNsim {
     // Some constants
@@ -26,6 +28,11 @@ namespace OBNsim {
     typedef uint64_t updatemask_t;  ///< Update mask type: each bit corresponds to one update, so the width of the type is the maximum number of updates.
     const int MAX_UPDATE_INDEX = 63;    ///< The maximum index of update type allowed = number of bits in updatemast_t - 1
     
+    const int64_t YACK_NO_UPDATE_X = 0x1;   ///< Flag in Data.I of SIM_Y_ACK: the node does not need UPDATE_X in the current iteration
+    
+    typedef std::vector< std::pair<simtime_t, updatemask_t> > UpdateList;  ///< A list of updates (time, mask), e.g. the updates of a lookahead window (SIM_YW)
+    typedef std::vector< std::pair<int64_t, std::string> > IntStringList;  ///< A list of (integer, string) pairs, e.g. the connections and their results of a SYS_PORT_CONNECT_BATCH
+    
     
     namespace Utils {
         
@@ -57,6 +64,34 @@ namespace OBNsim {
          \return true if name is a valid node name.
          */
         bool isValidNodeName(const std::string &name);
+        
+        /** \brief Encode a list of updates as a string of bytes, e.g. for the data of a SIM_YW message.
+         Each update is encoded as its time then its mask, both as 64-bit little-endian integers.
+         \param updates The list of updates.
+         \param bytes The string to receive the encoded bytes (its content is replaced).
+         */
+        void encodeUpdateList(const UpdateList& updates, std::string& bytes);
+        
+        /** \brief Decode a list of updates encoded by encodeUpdateList().
+         \param bytes The encoded bytes.
+         \param updates The list to receive the updates (its content is replaced).
+         \return false if the bytes are not a valid encoding.
+         */
+        bool decodeUpdateList(const std::string& bytes, UpdateList& updates);
+        
+        /** \brief Encode a list of (integer, string) pairs as a string of bytes, e.g. for the data of a SYS_PORT_CONNECT_BATCH message.
+         Each pair is encoded as the integer, the length of the string, both as 64-bit little-endian integers, then the string.
+         \param list The list of pairs.
+         \param bytes The string to receive the encoded bytes (its content is replaced).
+         */
+        void encodeIntStringList(const IntStringList& list, std::string& bytes);
+        
+        /** \brief Decode a list of (integer, string) pairs encoded by encodeIntStringList().
+         \param bytes The encoded bytes.
+         \param list The list to receive the pairs (its content is replaced).
+         \return false if the bytes are not a valid encoding.
+         */
+        bool decodeIntStringList(const std::string& bytes, IntStringList& list);
     }
     
     /** A resizable buffer, used to store data for messages. */
@@ -0,0 +1,303 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Implement the ring buffers in shared memory.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <cstring>
+#include <cerrno>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <obnsim_shm.h>
+
+using namespace OBNsim::Shm;
+
+namespace {
+    const uint32_t SEGMENT_MAGIC = 0x4f424e31;  // "OBN1"
+    const uint32_t WRAP_MARKER = 0xffffffff;    // Size of the frame at the end of the ring that tells the reader to skip to the start
+    const std::size_t FRAME_HEADER_SIZE = 8;    // Size and channel of a frame, each a 32-bit integer
+    const std::size_t CACHE_LINE = 64;
+
+    inline std::size_t roundUp(std::size_t n, std::size_t m) {
+        return (n + m - 1) / m * m;
+    }
+
+    /** Whether a process is still running. */
+    bool isProcessAlive(pid_t pid) {
+        return pid > 0 && (::kill(pid, 0) == 0 || errno == EPERM);
+    }
+}
+
+
+/** The header at the start of a segment.
+ The positions of the writers (head) and of the reader (tail) increase monotonically; their values modulo the capacity are the locations in the ring.
+ The atomic variables are lock-free, hence can be shared between processes.
+ */
+struct Segment::Header {
+    std::atomic<uint32_t> magic;    ///< Set when the segment is initialized
+    uint32_t pid;                   ///< The owner's process
+    uint64_t capacity;              ///< Size of the ring
+    std::atomic<uint32_t> online;   ///< Whether the owner is reading the ring
+    std::atomic<uint32_t> lock;     ///< Spinlock of the writers
+    std::atomic<uint32_t> waiting;  ///< Whether the owner is (about to be) sleeping on the semaphore
+    sem_t doorbell;                 ///< Process-shared semaphore to wake up the owner
+
+    alignas(CACHE_LINE) std::atomic<uint64_t> head;     ///< End of the frames written
+    alignas(CACHE_LINE) std::atomic<uint64_t> tail;     ///< End of the frames read
+};
+
+
+std::string OBNsim::Shm::segmentName(const std::string& portName) {
+    std::string name("/obn.");
+    name += portName;
+    std::replace(name.begin() + 1, name.end(), '/', '.');
+    return name;
+}
+
+
+bool Segment::map(int fd, std::size_t size, std::string& error) {
+    void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        error = "Could not map shared memory " + m_name + ": " + std::strerror(errno);
+        return false;
+    }
+    m_header = static_cast<Header*>(p);
+    m_data = static_cast<char*>(p) + roundUp(sizeof(Header), CACHE_LINE);
+    m_map_size = size;
+    return true;
+}
+
+
+bool Segment::create(const std::string& name, std::size_t capacity, std::string& error) {
+    close();
+    m_name = name;
+
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        // Replace the segment if its owner has terminated
+        Segment old;
+        std::string ignored;
+        if (old.open(name, ignored) && isProcessAlive(old.m_header->pid)) {
+            error = "Shared memory " + name + " is in use by another process.";
+            return false;
+        }
+        old.close();
+        ::shm_unlink(name.c_str());
+        fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    }
+    if (fd < 0) {
+        error = "Could not create shared memory " + name + ": " + std::strerror(errno);
+        return false;
+    }
+
+    capacity = roundUp(std::max<std::size_t>(capacity, 4096), CACHE_LINE);
+    std::size_t size = roundUp(sizeof(Header), CACHE_LINE) + capacity;
+    if (::ftruncate(fd, size) != 0 || !map(fd, size, error)) {
+        if (error.empty()) {
+            error = "Could not allocate shared memory " + name + ": " + std::strerror(errno);
+            ::close(fd);
+        }
+        ::shm_unlink(name.c_str());
+        return false;
+    }
+
+    // The memory is zeroed by ftruncate(); the segment is valid once the magic number is set
+    m_owner = true;
+    m_capacity = capacity;
+    m_header->pid = static_cast<uint32_t>(::getpid());
+    m_header->capacity = capacity;
+    if (::sem_init(&m_header->doorbell, 1, 0) != 0) {
+        error = "Could not create semaphore in shared memory " + name + ": " + std::strerror(errno);
+        close();
+        return false;
+    }
+    m_header->magic.store(SEGMENT_MAGIC);
+    return true;
+}
+
+
+bool Segment::open(const std::string& name, std::string& error) {
+    close();
+    m_name = name;
+
+    int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        error = "Could not open shared memory " + name + ": " + std::strerror(errno);
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(roundUp(sizeof(Header), CACHE_LINE))) {
+        error = "Shared memory " + name + " is not initialized.";
+        ::close(fd);
+        return false;
+    }
+    if (!map(fd, st.st_size, error)) {
+        return false;
+    }
+
+    if (m_header->magic.load() != SEGMENT_MAGIC ||
+        m_header->capacity + roundUp(sizeof(Header), CACHE_LINE) > m_map_size) {
+        error = "Shared memory " + name + " is not initialized.";
+        close();
+        return false;
+    }
+    m_capacity = m_header->capacity;
+    return true;
+}
+
+
+void Segment::close() {
+    if (!m_header) {
+        return;
+    }
+    if (m_owner) {
+        m_header->online.store(0);
+        ::sem_destroy(&m_header->doorbell);
+        ::shm_unlink(m_name.c_str());
+    }
+    ::munmap(m_header, m_map_size);
+    m_header = nullptr;
+    m_data = nullptr;
+    m_owner = false;
+}
+
+
+bool Segment::isOnline() const {
+    return m_header && m_header->online.load() != 0 && isProcessAlive(m_header->pid);
+}
+
+
+void Segment::setOnline(bool online) {
+    if (m_header) {
+        m_header->online.store(online?1:0);
+    }
+}
+
+
+bool Segment::write(uint32_t channel, const void* data, std::size_t size, double timeout) {
+    return writeWith(channel, size, [data, size](char* dest) {
+        if (size > 0) {
+            std::memcpy(dest, data, size);
+        }
+    }, timeout);
+}
+
+
+char* Segment::reserve(uint32_t channel, std::size_t size, double timeout) {
+    if (!m_header) {
+        return nullptr;
+    }
+
+    std::size_t needed = FRAME_HEADER_SIZE + roundUp(size, 8);
+    if (needed > m_capacity / 2) {
+        return nullptr;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+    for (;;) {
+        // Take the writers' lock, spinning a little before yielding
+        for (int spins = 0; m_header->lock.exchange(1, std::memory_order_acquire) != 0; ++spins) {
+            if (spins >= 100) {
+                std::this_thread::yield();
+            }
+        }
+
+        uint64_t head = m_header->head.load(std::memory_order_relaxed);    // Only changed by the lock holder
+        uint64_t tail = m_header->tail.load(std::memory_order_acquire);
+        std::size_t pos = head % m_capacity;
+        std::size_t skip = (m_capacity - pos < needed)?(m_capacity - pos):0;  // A frame is never split at the end of the ring
+
+        if (m_capacity - (head - tail) >= skip + needed) {
+            if (skip > 0) {
+                std::memcpy(m_data + pos, &WRAP_MARKER, 4);
+                pos = 0;
+            }
+            uint32_t header[2] = {static_cast<uint32_t>(size), channel};
+            std::memcpy(m_data + pos, header, FRAME_HEADER_SIZE);
+            m_reserved_end = head + skip + needed;
+            return m_data + pos + FRAME_HEADER_SIZE;
+        }
+
+        // The ring is full: wait for the owner to read it
+        m_header->lock.store(0, std::memory_order_release);
+        if (!isOnline() || std::chrono::steady_clock::now() >= deadline) {
+            return nullptr;
+        }
+        std::this_thread::yield();
+    }
+}
+
+
+void Segment::commit() {
+    m_header->head.store(m_reserved_end);
+    m_header->lock.store(0, std::memory_order_release);
+
+    // Wake up the owner if it's sleeping; see wait() for the other side
+    if (m_header->waiting.exchange(0) != 0) {
+        ::sem_post(&m_header->doorbell);
+    }
+}
+
+
+bool Segment::peek(uint32_t& channel, const char*& data, std::size_t& size) {
+    for (;;) {
+        uint64_t tail = m_header->tail.load(std::memory_order_relaxed);    // Only changed by the owner
+        if (tail == m_header->head.load()) {
+            return false;
+        }
+
+        std::size_t pos = tail % m_capacity;
+        uint32_t header[2];
+        std::memcpy(header, m_data + pos, 4);
+        if (header[0] == WRAP_MARKER) {
+            m_header->tail.store(tail + (m_capacity - pos), std::memory_order_release);
+            continue;
+        }
+        std::memcpy(header, m_data + pos, FRAME_HEADER_SIZE);
+        channel = header[1];
+        data = m_data + pos + FRAME_HEADER_SIZE;
+        size = header[0];
+        m_frame_end = tail + FRAME_HEADER_SIZE + roundUp(size, 8);
+        return true;
+    }
+}
+
+
+void Segment::consume() {
+    m_header->tail.store(m_frame_end, std::memory_order_release);
+}
+
+
+void Segment::wait() {
+    // Announce that I'm going to sleep, then check the ring again: a writer either sees the announcement and posts the semaphore, or its frame is seen here
+    // A post may be left over when the owner finds frames without sleeping; it only causes a spurious wake-up later
+    m_header->waiting.store(1);
+    if (m_header->head.load() != m_header->tail.load(std::memory_order_relaxed)) {
+        m_header->waiting.store(0);
+        return;
+    }
+    while (::sem_wait(&m_header->doorbell) != 0 && errno == EINTR) { }
+}
+
+
+void Segment::wake() {
+    if (m_header) {
+        ::sem_post(&m_header->doorbell);
+    }
+}
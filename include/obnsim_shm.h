@@ -0,0 +1,161 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Ring buffers in shared memory, for processes on the same host.
+ *
+ * Each process (the SMN or a node) creates one segment in shared memory (/dev/shm on Linux), which holds a ring of frames sent to it.
+ * Any number of processes can write frames to a ring (they take turns with a spinlock in the segment), and only the owner reads them.
+ * The owner sleeps on a process-shared semaphore when its ring is empty, which the writers post only if the owner is sleeping.
+ * A frame is a channel number, which tells the owner what the frame is (see the CHANNEL_* constants), followed by its content.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#ifndef OBNSIM_SHM_H
+#define OBNSIM_SHM_H
+
+#include <cstdint>
+#include <string>
+
+namespace OBNsim {
+    namespace Shm {
+        const uint32_t CHANNEL_SMN = 0;         ///< SMN2N messages to a node, or N2SMN messages to the SMN
+        const uint32_t CHANNEL_SUBSCRIBE = 1;   ///< Request to send the data of an output port of the node to an input port of another node
+        const uint32_t CHANNEL_PORT_BASE = 2;   ///< Data of an input port: the channel is CHANNEL_PORT_BASE plus the index of the port in the node
+        const uint32_t CHANNEL_RAW = 0x80000000;    ///< Flag of the channel of raw data (the values of a fixed-size vector or matrix, not a ProtoBuf message)
+
+        const std::size_t DEFAULT_CAPACITY = 1024*1024; ///< Default size of the ring of a segment, in bytes
+
+        /** \brief The name of the segment of a GC port (of a node or of the SMN), e.g. "/obn.workspace.node._gc_" for "workspace/node/_gc_". */
+        std::string segmentName(const std::string& portName);
+
+
+        /** \brief A segment in shared memory, holding a ring of frames.
+
+         The segment is either created by its owner, which reads the frames, or opened by another process, which writes frames to it.
+         Writing is safe from any number of threads and processes; reading must be done by only one thread of the owner.
+         */
+        class Segment {
+        public:
+            Segment() = default;
+            Segment(const Segment&) = delete;
+            Segment& operator=(const Segment&) = delete;
+
+            ~Segment() {
+                close();
+            }
+
+            /** \brief Create the segment of this process.
+             A stale segment with the same name, left by a process that has terminated, is replaced.
+             \param name The name of the segment, see segmentName().
+             \param capacity The size of the ring, in bytes; frames larger than half of it can't be written.
+             \param error Receives the error message if the function fails.
+             \return true if successful.
+             */
+            bool create(const std::string& name, std::size_t capacity, std::string& error);
+
+            /** \brief Open the segment of another process, to write to it.
+             \return true if successful; false if the segment does not exist (yet) or is invalid.
+             */
+            bool open(const std::string& name, std::string& error);
+
+            /** Close the segment; if this process owns it, it is marked offline and removed. */
+            void close();
+
+            bool isOpen() const {
+                return m_header != nullptr;
+            }
+
+            const std::string& name() const {
+                return m_name;
+            }
+
+            /** Whether the owner of the segment is online, i.e. it has not closed the segment and it is still running. */
+            bool isOnline() const;
+
+            /** Mark the segment online (after the owner is ready to read) or offline. */
+            void setOnline(bool online);
+
+            /** \brief Write a frame to the ring.
+             Blocks while the ring is full.
+             \param channel The channel of the frame.
+             \param data The content of the frame.
+             \param size The size of the content.
+             \param timeout The maximum time to wait, in seconds, while the ring is full.
+             \return false if the frame could not be written: the segment is not open, the frame is too large, the owner is offline, or timeout.
+             */
+            bool write(uint32_t channel, const void* data, std::size_t size, double timeout = 10.0);
+
+            /** \brief Write a frame to the ring, filling its content in place.
+             \param fill Function (char* dest) that writes exactly size bytes to dest; it should be short because other writers wait for it.
+             \see write()
+             */
+            template <typename F>
+            bool writeWith(uint32_t channel, std::size_t size, F fill, double timeout = 10.0) {
+                char* dest = reserve(channel, size, timeout);
+                if (!dest) {
+                    return false;
+                }
+                fill(dest);
+                commit();
+                return true;
+            }
+
+            /** \brief Read all frames available in the ring, in place.
+             \param handler Function (uint32_t channel, const char* data, std::size_t size) called for each frame; the content is only valid during the call.
+             \return The number of frames read.
+             */
+            template <typename F>
+            std::size_t read(F handler) {
+                std::size_t n = 0;
+                uint32_t channel;
+                const char* data;
+                std::size_t size;
+                while (peek(channel, data, size)) {
+                    handler(channel, data, size);
+                    consume();
+                    ++n;
+                }
+                return n;
+            }
+
+            /** Wait until the ring may contain frames (it may return without any frame, e.g. after wake()). Only called by the owner. */
+            void wait();
+
+            /** Wake up the owner if it's waiting. */
+            void wake();
+
+        private:
+            struct Header;
+
+            std::string m_name;
+            Header* m_header = nullptr;
+            char* m_data = nullptr;         ///< The ring
+            std::size_t m_capacity = 0;     ///< Size of the ring
+            std::size_t m_map_size = 0;     ///< Size of the mapped memory
+            bool m_owner = false;           ///< Whether this process has created the segment
+
+            uint64_t m_reserved_end = 0;    ///< End of the frame being written (writers hold the lock)
+            uint64_t m_frame_end = 0;       ///< End of the frame being read
+
+            /** Map an open shared memory object. */
+            bool map(int fd, std::size_t size, std::string& error);
+
+            /** Reserve a frame in the ring, taking the writers' lock; returns the location of its content, or nullptr if failed. */
+            char* reserve(uint32_t channel, std::size_t size, double timeout);
+
+            /** Publish the reserved frame, release the writers' lock and wake up the owner. */
+            void commit();
+
+            /** Get the next frame in the ring, if any. */
+            bool peek(uint32_t& channel, const char*& data, std::size_t& size);
+
+            /** Remove the frame returned by peek() from the ring. */
+            void consume();
+        };
+    }
+}
+
+#endif // OBNSIM_SHM_H
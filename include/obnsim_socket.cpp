@@ -0,0 +1,448 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Implement the stream sockets carrying length-prefixed frames.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <algorithm>
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+
+#include <obnsim_socket.h>
+
+using namespace OBNsim::Socket;
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0      // SIGPIPE is disabled by SO_NOSIGPIPE instead
+#endif
+
+namespace {
+    const std::string UNIX_PREFIX{"unix:"};
+    const std::string TCP_PREFIX{"tcp:"};
+
+    /** Set the options of a new socket: no SIGPIPE on writes to a closed connection, no delay of small TCP messages. */
+    void setSocketOptions(int fd, bool tcp) {
+        int on = 1;
+#ifdef SO_NOSIGPIPE
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+        if (tcp) {
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        }
+    }
+
+    /** Fill the address of a Unix-domain socket. */
+    bool unixAddress(const std::string& path, sockaddr_un& addr, std::string& error) {
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            error = "Invalid path of Unix-domain socket: " + path;
+            return false;
+        }
+        path.copy(addr.sun_path, path.size());
+        return true;
+    }
+
+    /** Resolve the address of a TCP socket given as "HOST:PORT". */
+    addrinfo* tcpAddress(const std::string& hostport, bool passive, std::string& error) {
+        auto colon = hostport.rfind(':');
+        if (colon == std::string::npos || colon + 1 == hostport.size()) {
+            error = "Invalid TCP address (must be HOST:PORT): " + hostport;
+            return nullptr;
+        }
+        std::string host = hostport.substr(0, colon), port = hostport.substr(colon + 1);
+
+        addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = passive?AI_PASSIVE:0;
+
+        addrinfo* result = nullptr;
+        int rc = getaddrinfo((host.empty() || host == "*")?nullptr:host.c_str(), port.c_str(), &hints, &result);
+        if (rc != 0) {
+            error = "Could not resolve TCP address " + hostport + ": " + gai_strerror(rc);
+            return nullptr;
+        }
+        return result;
+    }
+
+    /** Write all bytes to a blocking socket. */
+    bool writeAll(int fd, const char* data, std::size_t size) {
+        while (size > 0) {
+            auto n = ::send(fd, data, size, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += n;
+            size -= n;
+        }
+        return true;
+    }
+}
+
+
+std::string OBNsim::Socket::defaultAddress(const std::string& workspace) {
+    const char* tmpdir = std::getenv("TMPDIR");
+    std::string dir = (tmpdir && *tmpdir)?tmpdir:"/tmp";
+    if (dir.back() != '/') {
+        dir.push_back('/');
+    }
+    // The workspace name is an identifier followed by '/'
+    return UNIX_PREFIX + dir + "obnsmn" + (workspace.empty()?"":('-' + workspace.substr(0, workspace.size() - 1))) + ".sock";
+}
+
+
+int OBNsim::Socket::listenOn(const std::string& address, std::string& error) {
+    int fd = -1;
+    if (address.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0) {
+        sockaddr_un addr;
+        std::string path = address.substr(UNIX_PREFIX.size());
+        if (!unixAddress(path, addr, error)) {
+            return -1;
+        }
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            error = std::string("Could not create socket: ") + std::strerror(errno);
+            return -1;
+        }
+        ::unlink(path.c_str());     // Replace the file of a previous SMN
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            error = "Could not bind socket to " + path + ": " + std::strerror(errno);
+            ::close(fd);
+            return -1;
+        }
+    } else if (address.compare(0, TCP_PREFIX.size(), TCP_PREFIX) == 0) {
+        addrinfo* ai = tcpAddress(address.substr(TCP_PREFIX.size()), true, error);
+        if (!ai) {
+            return -1;
+        }
+        for (addrinfo* p = ai; p; p = p->ai_next) {
+            fd = ::socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+            if (fd < 0) {
+                continue;
+            }
+            int on = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            if (::bind(fd, p->ai_addr, p->ai_addrlen) == 0) {
+                break;
+            }
+            ::close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(ai);
+        if (fd < 0) {
+            error = "Could not bind socket to " + address + ": " + std::strerror(errno);
+            return -1;
+        }
+    } else {
+        error = "Invalid socket address (must begin with unix: or tcp:): " + address;
+        return -1;
+    }
+
+    if (::listen(fd, SOMAXCONN) != 0) {
+        error = "Could not listen on " + address + ": " + std::strerror(errno);
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+int OBNsim::Socket::connectTo(const std::string& address, std::string& error) {
+    int fd = -1;
+    if (address.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0) {
+        sockaddr_un addr;
+        if (!unixAddress(address.substr(UNIX_PREFIX.size()), addr, error)) {
+            return -1;
+        }
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            error = std::string("Could not create socket: ") + std::strerror(errno);
+            return -1;
+        }
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            error = "Could not connect to " + address + ": " + std::strerror(errno);
+            ::close(fd);
+            return -1;
+        }
+        setSocketOptions(fd, false);
+    } else if (address.compare(0, TCP_PREFIX.size(), TCP_PREFIX) == 0) {
+        addrinfo* ai = tcpAddress(address.substr(TCP_PREFIX.size()), false, error);
+        if (!ai) {
+            return -1;
+        }
+        for (addrinfo* p = ai; p; p = p->ai_next) {
+            fd = ::socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+            if (fd < 0) {
+                continue;
+            }
+            if (::connect(fd, p->ai_addr, p->ai_addrlen) == 0) {
+                break;
+            }
+            ::close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(ai);
+        if (fd < 0) {
+            error = "Could not connect to " + address + ": " + std::strerror(errno);
+            return -1;
+        }
+        setSocketOptions(fd, true);
+    } else {
+        error = "Invalid socket address (must begin with unix: or tcp:): " + address;
+        return -1;
+    }
+    return fd;
+}
+
+
+int OBNsim::Socket::acceptFrom(int listen_fd) {
+    sockaddr_storage addr;
+    socklen_t addrlen = sizeof(addr);
+    int fd;
+    do {
+        fd = ::accept(listen_fd, reinterpret_cast<sockaddr*>(&addr), &addrlen);
+    } while (fd < 0 && errno == EINTR);
+
+    if (fd >= 0) {
+        setSocketOptions(fd, addr.ss_family != AF_UNIX);
+    }
+    return fd;
+}
+
+
+void OBNsim::Socket::unlinkAddress(const std::string& address) {
+    if (address.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0) {
+        ::unlink(address.c_str() + UNIX_PREFIX.size());
+    }
+}
+
+
+void OBNsim::Socket::closeSocket(int fd) {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+
+///////////////////////////////////////////////
+// Implementation of FrameReader
+///////////////////////////////////////////////
+
+long FrameReader::receive(int fd) {
+    const std::size_t MIN_SPACE = 4096;
+
+    // Move the unprocessed bytes to the beginning, then make sure there is some space after them
+    if (m_begin > 0) {
+        if (m_end > m_begin) {
+            std::memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+        }
+        m_end -= m_begin;
+        m_begin = 0;
+    }
+    if (m_buffer.size() - m_end < MIN_SPACE) {
+        m_buffer.resize(std::max(2*m_buffer.size(), m_end + MIN_SPACE));
+    }
+
+    long n;
+    do {
+        n = ::recv(fd, m_buffer.data() + m_end, m_buffer.size() - m_end, 0);
+    } while (n < 0 && errno == EINTR);
+
+    if (n > 0) {
+        m_end += n;
+    }
+    return n;
+}
+
+
+bool FrameReader::next(const char*& data, std::size_t& size) {
+    if (m_bad || m_end - m_begin < FRAME_HEADER_SIZE) {
+        return false;
+    }
+
+    const unsigned char* header = reinterpret_cast<const unsigned char*>(m_buffer.data() + m_begin);
+    std::size_t len = std::size_t(header[0]) | (std::size_t(header[1]) << 8) | (std::size_t(header[2]) << 16) | (std::size_t(header[3]) << 24);
+    if (len > MAX_FRAME_SIZE) {
+        m_bad = true;
+        return false;
+    }
+    if (m_end - m_begin < FRAME_HEADER_SIZE + len) {
+        return false;
+    }
+
+    data = m_buffer.data() + m_begin + FRAME_HEADER_SIZE;
+    size = len;
+    m_begin += FRAME_HEADER_SIZE + len;
+    return true;
+}
+
+
+///////////////////////////////////////////////
+// Implementation of FrameWriter
+///////////////////////////////////////////////
+
+void FrameWriter::attach(int fd) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_fd = fd;
+    m_pending.clear();
+    m_bundles = 0;
+}
+
+
+void FrameWriter::attach(const std::shared_ptr<FrameWriter>& shared, uint32_t tag) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_shared = shared;
+    m_tag = tag;
+    m_bundles = 0;
+}
+
+
+bool FrameWriter::detach(const std::shared_ptr<FrameWriter>& shared) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!shared || m_shared != shared) {
+        return false;
+    }
+    m_shared.reset();
+    m_bundles = 0;
+    return true;
+}
+
+
+bool FrameWriter::detach(int fd) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return !m_writing; });
+    if (fd < 0 || m_fd != fd) {
+        return false;
+    }
+    m_fd = -1;
+    m_pending.clear();
+    m_bundles = 0;
+    return true;
+}
+
+
+bool FrameWriter::isAttached() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_shared) {
+        auto shared = m_shared;
+        lock.unlock();
+        return shared->isAttached();
+    }
+    return m_fd >= 0;
+}
+
+
+bool FrameWriter::write(const char* data, std::size_t size) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_shared) {
+        // The shared connection is written by its own writer
+        auto shared = m_shared;
+        auto tag = m_tag;
+        lock.unlock();
+        return shared->write(tag, data, size);
+    }
+    lock.unlock();
+    return writeFrame(nullptr, 0, data, size);
+}
+
+
+bool FrameWriter::write(uint32_t tag, const char* data, std::size_t size) {
+    const char prefix[FRAME_TAG_SIZE] = {
+        char(tag & 0xFF), char((tag >> 8) & 0xFF), char((tag >> 16) & 0xFF), char((tag >> 24) & 0xFF)
+    };
+    return writeFrame(prefix, FRAME_TAG_SIZE, data, size);
+}
+
+
+bool FrameWriter::writeFrame(const char* prefix, std::size_t prefixSize, const char* data, std::size_t size) {
+    const std::size_t total = prefixSize + size;
+    const char header[FRAME_HEADER_SIZE] = {
+        char(total & 0xFF), char((total >> 8) & 0xFF), char((total >> 16) & 0xFF), char((total >> 24) & 0xFF)
+    };
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_fd < 0) {
+        return false;
+    }
+    m_pending.append(header, FRAME_HEADER_SIZE);
+    if (prefixSize > 0) {
+        m_pending.append(prefix, prefixSize);
+    }
+    m_pending.append(data, size);
+    if (m_writing || m_bundles > 0) {
+        // The writing thread will send this frame in its next batch, or the bundle will be sent when it ends
+        return true;
+    }
+    return writePending(lock);
+}
+
+
+bool FrameWriter::writePending(std::unique_lock<std::mutex>& lock) {
+    // This thread becomes the writing thread until no frame is pending
+    m_writing = true;
+    bool success = true;
+    while (success && !m_pending.empty() && m_bundles == 0) {
+        m_batch.swap(m_pending);
+        int fd = m_fd;
+        lock.unlock();
+        success = writeAll(fd, m_batch.data(), m_batch.size());
+        m_batch.clear();
+        lock.lock();
+    }
+    if (!success) {
+        m_pending.clear();
+    }
+    m_writing = false;
+    m_idle.notify_all();
+    return success;
+}
+
+
+void FrameWriter::beginBundle() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_shared) {
+        auto shared = m_shared;
+        lock.unlock();
+        shared->beginBundle();
+        return;
+    }
+    ++m_bundles;
+}
+
+
+bool FrameWriter::endBundle() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_shared) {
+        auto shared = m_shared;
+        lock.unlock();
+        return shared->endBundle();
+    }
+
+    // The bundle may have been cancelled by attach() or detach()
+    if (m_bundles == 0 || --m_bundles > 0 || m_writing || m_pending.empty()) {
+        return true;
+    }
+    if (m_fd < 0) {
+        m_pending.clear();
+        return false;
+    }
+    return writePending(lock);
+}
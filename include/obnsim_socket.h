@@ -0,0 +1,174 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Stream sockets (TCP or Unix-domain) carrying length-prefixed frames.
+ *
+ * Used by the SMN and the nodes to exchange SMN2N / N2SMN messages directly, without an MQTT broker.
+ * Each frame is a message serialized by ProtoBuf, preceded by its size as a 32-bit little-endian integer.
+ * A connection may be shared by several nodes of one process (see OBNnode::NodeHost): the frames to the nodes then start with a 32-bit little-endian tag, which tells the node.
+ * Frames can be bundled, i.e. queued and sent together, e.g. the messages of the GC to all nodes sharing a connection in a wave.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#ifndef OBNSIM_SOCKET_H
+#define OBNSIM_SOCKET_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+namespace OBNsim {
+    namespace Socket {
+        const std::size_t FRAME_HEADER_SIZE = 4;            ///< Size of the length prefix of a frame
+        const std::size_t MAX_FRAME_SIZE = 64*1024*1024;    ///< Frames larger than this are considered a protocol error
+        const std::size_t FRAME_TAG_SIZE = 4;               ///< Size of the tag of a frame on a shared connection
+
+        /** \brief The default address of the SMN of a workspace.
+         It is a Unix-domain socket in the temporary directory, e.g. "unix:/tmp/obnsmn-myworkspace.sock".
+         \param workspace The workspace name, either "" or of the form "workspace/".
+         */
+        std::string defaultAddress(const std::string& workspace);
+
+        /** \brief Open a listening socket.
+         \param address Either "unix:PATH" for a Unix-domain socket (an existing file at PATH is replaced) or "tcp:HOST:PORT" for TCP (HOST may be empty or "*" for all interfaces).
+         \param error Receives the error message if the function fails.
+         \return The socket descriptor, or -1 if failed.
+         */
+        int listenOn(const std::string& address, std::string& error);
+
+        /** \brief Connect to a listening socket.
+         \param address The address, see listenOn().
+         \param error Receives the error message if the function fails.
+         \return The socket descriptor, or -1 if failed.
+         */
+        int connectTo(const std::string& address, std::string& error);
+
+        /** \brief Accept a connection on a listening socket opened by listenOn().
+         \return The socket descriptor of the connection, or -1 if failed.
+         */
+        int acceptFrom(int listen_fd);
+
+        /** Remove the file of a Unix-domain socket opened by listenOn(), if address is of that kind. */
+        void unlinkAddress(const std::string& address);
+
+        /** Close a socket descriptor. */
+        void closeSocket(int fd);
+
+
+        /** \brief Extracts the frames from the bytes received on a socket. */
+        class FrameReader {
+            std::vector<char> m_buffer;
+            std::size_t m_begin = 0;    ///< Start of the unprocessed bytes in the buffer
+            std::size_t m_end = 0;      ///< End of the received bytes in the buffer
+            bool m_bad = false;
+
+        public:
+            /** \brief Read the bytes available on a socket (blocks if there is none).
+             \return The number of bytes read; 0 if the peer has closed the connection; negative if an error occurred.
+             */
+            long receive(int fd);
+
+            /** \brief Get the next complete frame received.
+             The frame's bytes are valid until the next call to receive().
+             \return false if no complete frame is available (or the stream is bad).
+             */
+            bool next(const char*& data, std::size_t& size);
+
+            /** Whether the stream is corrupted (a frame is larger than MAX_FRAME_SIZE). */
+            bool bad() const {
+                return m_bad;
+            }
+        };
+
+
+        /** \brief Writes frames to a socket, batching concurrent writes.
+
+         While one thread is writing to the socket, the frames written by other threads are queued and then sent by the writing thread in one batch, with a single system call.
+         The writes are blocking; the socket must not be non-blocking.
+         A writer can also be attached to the writer of a shared connection, to which it forwards its frames with a tag.
+
+         Between beginBundle() and the matching endBundle(), the frames are queued and then sent together.
+         Bundles can be nested, e.g. begun once for each node of a shared connection, and are sent when the outermost one ends.
+         Attaching or detaching the writer cancels the bundles in progress, so that a bundle which is never ended can't stop the writer.
+         */
+        class FrameWriter {
+            std::mutex m_mutex;
+            std::condition_variable m_idle;     ///< Notified when the writing thread finishes
+            int m_fd = -1;
+            bool m_writing = false;     ///< Whether a thread is writing to the socket
+            std::string m_pending;      ///< Frames queued for the writing thread
+            std::string m_batch;        ///< Frames being written
+            int m_bundles = 0;          ///< Number of bundles begun and not yet ended
+
+            std::shared_ptr<FrameWriter> m_shared;  ///< The writer of the shared connection, if attached to one
+            uint32_t m_tag = 0;         ///< The tag of the frames forwarded to m_shared
+
+            /** Write a frame made of a prefix (e.g. a tag) and a content. */
+            bool writeFrame(const char* prefix, std::size_t prefixSize, const char* data, std::size_t size);
+
+            /** Become the writing thread and write the queued frames, until no frame is queued or a bundle begins; the lock must be held and no thread must be writing. */
+            bool writePending(std::unique_lock<std::mutex>& lock);
+
+        public:
+            /** Set the socket to write to. */
+            void attach(int fd);
+
+            /** \brief Forward the frames to the writer of a shared connection, each one starting with a tag.
+             \param shared The writer of the shared connection.
+             \param tag The tag, which identifies the receiver of the frames on the connection.
+             */
+            void attach(const std::shared_ptr<FrameWriter>& shared, uint32_t tag);
+
+            /** \brief Stop forwarding the frames to the writer of a shared connection, if attached to it.
+             \return true if the writer was attached.
+             */
+            bool detach(const std::shared_ptr<FrameWriter>& shared);
+
+            /** \brief Stop writing to a socket, if it is attached.
+             Waits until the current batch has been written, so that the socket can be closed safely; the queued frames are dropped.
+             \return true if the socket was attached.
+             */
+            bool detach(int fd);
+
+            /** Whether a socket is attached, directly or through a shared connection. */
+            bool isAttached();
+
+            /** \brief Write a frame.
+             \param data The frame's content, e.g. a serialized message.
+             \param size The size of the frame.
+             \return false if no socket is attached or if the socket could not be written to.
+             */
+            bool write(const char* data, std::size_t size);
+
+            /** \brief Write a frame starting with a tag, on a shared connection.
+             \param tag The tag, written before the content as a 32-bit little-endian integer.
+             \param data The frame's content.
+             \param size The size of the content.
+             \return false if no socket is attached or if the socket could not be written to.
+             */
+            bool write(uint32_t tag, const char* data, std::size_t size);
+
+            /** Begin a bundle of frames; forwarded to the writer of the shared connection if attached to one. */
+            void beginBundle();
+
+            /** \brief End a bundle of frames begun by beginBundle(); the queued frames are sent if it is the outermost bundle.
+             \return false if the frames could not be sent.
+             */
+            bool endBundle();
+        };
+
+        /** Read the tag at the start of a frame received on a shared connection; the frame must have at least FRAME_TAG_SIZE bytes. */
+        inline uint32_t frameTag(const char* data) {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+            return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+        }
+    }
+}
+
+#endif // OBNSIM_SOCKET_H
@@ -385,6 +385,8 @@ namespace NodeChai {
         m->add(fun(&NodeFactory::callback_init, pNF), "callback_init");
         m->add(fun(&NodeFactory::callback_restart, pNF), "callback_restart");
         m->add(fun(&NodeFactory::callback_term, pNF), "callback_term");
+        m->add(fun(&NodeFactory::callback_save, pNF), "callback_save");    // returns the state of the node as a string, for checkpoints
+        m->add(fun(&NodeFactory::callback_load, pNF), "callback_load");    // restores the state saved by callback_save
         m->add(fun(&NodeFactory::callback_x, pNF), "callback_x");
         m->add(fun(&NodeFactory::callback_y, pNF), "callback_y");
         
@@ -392,6 +394,9 @@ namespace NodeChai {
         m->add(fun(&OBNnode::NodeBase::stopSimulation, pNode), "stop_simulation");
         m->add(fun(&OBNnode::NodeBase::requestStopSimulation, pNode), "request_stop_simulation");
         
+        // The parameters of the current simulation sent by the SMN (e.g. when it restarts the simulation), as a string
+        m->add(fun([pNode](){ return pNode->simulationParameters(); }), "simulation_parameters");
+        
         // Functions to get the current simulation time in different units
         m->add(fun(&OBNnode::NodeBase::currentSimulationTime<std::chrono::seconds>, pNode), "current_time_s"); // in seconds
         m->add(fun(&OBNnode::NodeBase::currentSimulationTime<std::chrono::minutes>, pNode), "current_time_m"); // in minutes
@@ -74,6 +74,8 @@ namespace NodeChai {
         virtual bool callback_init(const std::function<chaiscript::Boxed_Value ()>& f) = 0;
         virtual bool callback_restart(const std::function<chaiscript::Boxed_Value ()>& f) = 0;
         virtual bool callback_term(const std::function<void ()>& f) = 0;
+        virtual bool callback_save(const std::function<std::string ()>& f) = 0;
+        virtual bool callback_load(const std::function<chaiscript::Boxed_Value (const std::string&)>& f) = 0;
         
         /** Create the bindings specific for this node factory. */
         virtual std::shared_ptr<chaiscript::Module> create_bindings(std::shared_ptr<chaiscript::Module> m = std::make_shared<chaiscript::Module>()) = 0;
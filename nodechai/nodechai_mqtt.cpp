@@ -44,6 +44,30 @@ namespace NodeChai {
             m_onTermination_callback();
         }
     }
+    
+    int64_t MQTTNodeChai::onSaveState(std::string& state) {
+        if (m_onSaveState_callback) {
+            state = m_onSaveState_callback();
+            return 0;
+        }
+        
+        // Without a callback, the node can't save its state
+        return 1;
+    }
+    
+    int64_t MQTTNodeChai::onLoadState(const std::string& state) {
+        if (m_onLoadState_callback) {
+            chaiscript::Boxed_Value bval = m_onLoadState_callback(state);
+            if (bval.get_type_info().is_arithmetic()) {
+                // Cast to integer and return
+                return chaiscript::Boxed_Number(bval).get_as<int64_t>();
+            }
+            // else let's just return 0
+            return 0;
+        }
+        
+        return 1;
+    }
 
     
     
@@ -117,4 +141,22 @@ namespace NodeChai {
         m_node->m_onTermination_callback = f;
         return true;
     }
+    
+    bool NodeChai::NodeFactoryMQTT::callback_save(const std::function<std::string ()>& f) {
+        if (!check_node_object()) {
+            return false;
+        }
+        
+        m_node->m_onSaveState_callback = f;
+        return true;
+    }
+    
+    bool NodeChai::NodeFactoryMQTT::callback_load(const std::function<chaiscript::Boxed_Value (const std::string&)>& f) {
+        if (!check_node_object()) {
+            return false;
+        }
+        
+        m_node->m_onLoadState_callback = f;
+        return true;
+    }
 }
\ No newline at end of file
@@ -27,6 +27,10 @@ namespace NodeChai {
         std::function<void ()> m_onTermination_callback;
         std::function<chaiscript::Boxed_Value ()> m_onInitialization_callback, m_onRestart_callback;
         
+        /** The callbacks to save and restore the state of the node for checkpoints. */
+        std::function<std::string ()> m_onSaveState_callback;
+        std::function<chaiscript::Boxed_Value (const std::string&)> m_onLoadState_callback;
+        
         friend class NodeFactoryMQTT;
     public:
         MQTTNodeChai(const std::string& t_name, const std::string& t_workspace): OBNnode::MQTTNode(t_name, t_workspace) { }
@@ -34,6 +38,8 @@ namespace NodeChai {
         virtual int64_t onInitialization() override;
         virtual int64_t onRestart() override;
         virtual void onTermination() override;
+        virtual int64_t onSaveState(std::string& state) override;
+        virtual int64_t onLoadState(const std::string& state) override;
     };
     
     /** The abstract factory class for creating nodes. */
@@ -181,6 +187,8 @@ namespace NodeChai {
         virtual bool callback_init(const std::function<chaiscript::Boxed_Value ()>& f) override;
         virtual bool callback_restart(const std::function<chaiscript::Boxed_Value ()>& f) override;
         virtual bool callback_term(const std::function<void ()>& f) override;
+        virtual bool callback_save(const std::function<std::string ()>& f) override;
+        virtual bool callback_load(const std::function<chaiscript::Boxed_Value (const std::string&)>& f) override;
         
         virtual std::shared_ptr<chaiscript::Module> create_bindings(std::shared_ptr<chaiscript::Module> m = std::make_shared<chaiscript::Module>()) override;
     };
@@ -16,3 +16,13 @@
 #include <obnnode_mqttport.h>
 #include <obnnode_mqttnode.h>
 #endif
+
+#ifdef OBNNODE_COMM_SOCKET
+#include <obnnode_socketnode.h>
+#include <obnnode_host.h>
+#endif
+
+#ifdef OBNNODE_COMM_SHM
+#include <obnnode_shmport.h>
+#include <obnnode_shmnode.h>
+#endif
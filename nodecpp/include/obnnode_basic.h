@@ -37,7 +37,9 @@ namespace OBNnode {
     /** Communication protocol/platform selection. */
     enum CommProtocol {
         COMM_YARP,
-        COMM_MQTT
+        COMM_MQTT,
+        COMM_SOCKET,
+        COMM_SHM
     };
     
     class NodeBase;
@@ -255,6 +257,13 @@ namespace OBNnode {
             return _timeunit;
         }
         
+        /** Returns the parameters of the current simulation sent by the SMN, e.g. when it restarts the simulation with new parameters; empty if none.
+         They are available in onRestart() and onInitialization(); their format is agreed between the SMN's script and the nodes.
+         */
+        const std::string& simulationParameters() const {
+            return _sim_parameters;
+        }
+        
         /** Return the current simulation time.
          This is an integer number of clock ticks from the start of the simulation.
          One clock tick is equivalent to one time unit.
@@ -284,6 +293,13 @@ namespace OBNnode {
             return _node_state;
         }
         
+        /** \brief Declare that the node does not need UPDATE_X in the current iteration.
+         This can be called in the UPDATE_Y callback, e.g. when the node's state won't change in this iteration; the SMN will then skip the node's UPDATE_X, saving one round trip.
+         */
+        void skipUpdateX() {
+            _skip_update_x = true;
+        }
+        
         /** \brief Run the node (simulation in the network) */
         void run(double timeout = -1.0);
         
@@ -298,6 +314,22 @@ namespace OBNnode {
          */
         virtual bool openSMNPort() = 0;
         
+        /** \brief Signal to the process which launched this node that the node is ready, once its SMN port is open.
+         If the node was launched by the SMN (see SMNChai::NodeLauncher), the environment variable OBN_READY_FD names a pipe to the SMN,
+         to which the full name of the first node of the process to become ready is written; the pipe is then closed. Otherwise this does nothing.
+         */
+        void signalReady() const;
+        
+        /** \brief Start receiving, on the SMN port, the messages that the SMN sends to a group of nodes.
+         \param channel The name of the group's channel, specific to the communication protocol (e.g. an MQTT topic).
+         \return A pair of a result code (0 if successful, 1 if already subscribed, <0 if failed) and an error message.
+         
+         The default implementation does not support node groups.
+         */
+        virtual std::pair<int, std::string> subscribeSMNGroup(const std::string& channel) {
+            return std::make_pair(-1, "Node groups are not supported by this communication protocol.");
+        }
+        
         /* ========== Methods to add ports ============ */
         
         /** \brief Add an existing (physical) input port to the node. */
@@ -337,6 +369,19 @@ namespace OBNnode {
         /** Convenient methods to send an ACK message to the SMN. */
         void sendACK(OBNSimMsg::N2SMN::MSGTYPE type);
         void sendACK(OBNSimMsg::N2SMN::MSGTYPE type, int64_t I);
+        void sendACK(OBNSimMsg::N2SMN::MSGTYPE type, int64_t I, const std::string& B);
+        
+        /** Sequence number of the SMN message being acknowledged (0 if none), to be echoed in the next ACK. */
+        int64_t _ack_seq = 0;
+        
+        /** The last ACK with a sequence number, to be re-sent if the SMN retransmits its message (see postEvent()). */
+        OBNSimMsg::N2SMN _last_ack;
+        
+        /** \brief Re-send the last ACK if it acknowledged a given sequence number. */
+        void resendACK(int64_t seq);
+        
+        /** Sequence number of the last message received from the SMN (0 if none); only accessed by the communication thread in postEvent(). */
+        int64_t _last_seq = 0;
         
         /** Name of the node. */
         std::string _nodeName;
@@ -357,6 +402,9 @@ namespace OBNnode {
         /** Current state of the node. */
         std::atomic<NODE_STATE> _node_state;
         
+        /** Whether the node does not need UPDATE_X in the current iteration, see skipUpdateX(). */
+        bool _skip_update_x = false;
+        
         /** The ID of the node in the network (assigned by the GC in its messages to the node) */
         int32_t _node_id;
         
@@ -370,6 +418,9 @@ namespace OBNnode {
         /** The simulation time unit, in microseconds. */
         simtime_t _timeunit = 1;
         
+        /** The parameters of the current simulation, sent by the SMN in SIM_INIT. */
+        std::string _sim_parameters;
+        
         /** \brief Initialize node for simulation. */
         virtual bool initializeForSimulation();
         
@@ -459,6 +510,7 @@ namespace OBNnode {
             simtime_t _time;
             bool _hasID;
             int32_t _id;
+            int64_t _seq;
             
             /** Method to process basic details of an SMN event; should be called in the execute() methods of child classes. */
             void basic_processing(NodeBase* p) {
@@ -472,12 +524,31 @@ namespace OBNnode {
             NodeEventSMN(const OBNSimMsg::SMN2N& msg) {
                 _time = msg.time();
                 if ((_hasID = msg.has_id())) { _id = msg.id(); }
+                _seq = msg.seq();
+            }
+            
+            /** Send an ACK of this event's message to the SMN, echoing its sequence number. */
+            void sendACK(NodeBase* p, OBNSimMsg::N2SMN::MSGTYPE type) {
+                p->_ack_seq = _seq;
+                p->sendACK(type);
+            }
+            void sendACK(NodeBase* p, OBNSimMsg::N2SMN::MSGTYPE type, int64_t I) {
+                p->_ack_seq = _seq;
+                p->sendACK(type, I);
+            }
+            void sendACK(NodeBase* p, OBNSimMsg::N2SMN::MSGTYPE type, int64_t I, const std::string& B) {
+                p->_ack_seq = _seq;
+                p->sendACK(type, I, B);
             }
         };
         
         /** Event class for cosimulation's UPDATE_Y messages. */
         class NodeEvent_UPDATEY: public NodeEventSMN {
+        protected:
             updatemask_t _updates;
+            
+            /** Send out values from output ports which have been updated. */
+            void sendChangedOutputs(NodeBase* pnode);
         public:
             virtual void executeMain(NodeBase*) override;
             virtual void executePost(NodeBase*) override;
@@ -487,6 +558,30 @@ namespace OBNnode {
         };
         friend NodeEvent_UPDATEY;
         
+        /** Event class for cosimulation's fused UPDATE_Y + UPDATE_X messages (SIM_YX), sent to nodes whose outputs are not needed by other nodes in the current iteration. */
+        class NodeEvent_UPDATEYX: public NodeEvent_UPDATEY {
+            updatemask_t _xupdates;
+        public:
+            virtual void executePost(NodeBase*) override;
+            NodeEvent_UPDATEYX(const OBNSimMsg::SMN2N& msg): NodeEvent_UPDATEY(msg) {
+                _xupdates = (msg.has_data() && msg.data().has_i())?msg.data().i():_updates;
+            }
+        };
+        friend NodeEvent_UPDATEYX;
+        
+        /** Event class for cosimulation's lookahead windows (SIM_YW): the node performs a list of updates (UPDATE_Y then UPDATE_X for each) locally, then ACKs once. */
+        class NodeEvent_UPDATEYW: public NodeEvent_UPDATEY {
+            OBNsim::UpdateList _window;
+            bool _valid;
+        public:
+            virtual void executeMain(NodeBase*) override;
+            virtual void executePost(NodeBase*) override;
+            NodeEvent_UPDATEYW(const OBNSimMsg::SMN2N& msg): NodeEvent_UPDATEY(msg) {
+                _valid = msg.has_data() && msg.data().has_b() && OBNsim::Utils::decodeUpdateList(msg.data().b(), _window) && !_window.empty();
+            }
+        };
+        friend NodeEvent_UPDATEYW;
+        
         /** Event class for cosimulation's UPDATE_X messages. */
         class NodeEvent_UPDATEX: public NodeEventSMN {
             updatemask_t _updates;
@@ -505,6 +600,7 @@ namespace OBNnode {
             simtime_t _timeunit;
             bool _has_wallclock = false;
             bool _has_timeunit = false;
+            std::string _parameters;
         public:
             virtual void executeMain(NodeBase*) override;
             virtual void executePost(NodeBase*) override;
@@ -513,6 +609,7 @@ namespace OBNnode {
                     if ((_has_wallclock = msg.data().has_t())) {
                         _wallclock = msg.data().t();
                     }
+                    _parameters = msg.data().b();
                     if ((_has_timeunit = msg.has_i())) {
                         _timeunit = msg.i();
                     }
@@ -530,6 +627,32 @@ namespace OBNnode {
         };
         friend NodeEvent_TERMINATE;
         
+        /** Event class for checkpoint's SAVE messages: the node saves its state, sent to the SMN in the ACK. */
+        class NodeEvent_SAVE: public NodeEventSMN {
+            int64_t _run_result = 1;
+            std::string _state;
+        public:
+            virtual void executeMain(NodeBase*) override;
+            virtual void executePost(NodeBase*) override;
+            NodeEvent_SAVE(const OBNSimMsg::SMN2N& msg): NodeEventSMN(msg) { }
+        };
+        friend NodeEvent_SAVE;
+        
+        /** Event class for checkpoint's LOAD messages: the node restores its state saved by NodeEvent_SAVE, to resume the simulation. */
+        class NodeEvent_LOAD: public NodeEventSMN {
+            int64_t _run_result = 1;
+            std::string _state;
+        public:
+            virtual void executeMain(NodeBase*) override;
+            virtual void executePost(NodeBase*) override;
+            NodeEvent_LOAD(const OBNSimMsg::SMN2N& msg): NodeEventSMN(msg) {
+                if (msg.has_data()) {
+                    _state = msg.data().b();
+                }
+            }
+        };
+        friend NodeEvent_LOAD;
+        
         
         /** Event class for system's SYS_PORT_CONNECT messages. */
         class NodeEvent_PORT_CONNECT: public NodeEventSMN {
@@ -554,6 +677,44 @@ namespace OBNnode {
         };
         friend NodeEvent_PORT_CONNECT;
         
+        /** Event class for system's SYS_PORT_CONNECT_BATCH messages: several port connections, with one ACK containing all their results. */
+        class NodeEvent_PORT_CONNECT_BATCH: public NodeEventSMN {
+            int64_t _request_id;
+            OBNsim::IntStringList _connections;     ///< Each connection is (I, B) of a SYS_PORT_CONNECT
+            bool _valid_msg;  ///< true if the received request message is valid
+        public:
+            virtual void executeMain(NodeBase*) override;
+            
+            NodeEvent_PORT_CONNECT_BATCH(const OBNSimMsg::SMN2N& msg): NodeEventSMN(msg), _request_id(msg.i()) {
+                _valid_msg = msg.has_i() && msg.has_data() && OBNsim::Utils::decodeIntStringList(msg.data().b(), _connections);
+            }
+        };
+        friend NodeEvent_PORT_CONNECT_BATCH;
+        
+        /** Event class for system's SYS_SUBSCRIBE messages. */
+        class NodeEvent_SUBSCRIBE: public NodeEventSMN {
+            std::string _channel;
+        public:
+            virtual void executeMain(NodeBase*) override;
+            
+            NodeEvent_SUBSCRIBE(const OBNSimMsg::SMN2N& msg): NodeEventSMN(msg) {
+                if (msg.has_data()) {
+                    _channel = msg.data().b();
+                }
+            }
+        };
+        friend NodeEvent_SUBSCRIBE;
+        
+        /** Event class for a message from the SMN received twice: its ACK is re-sent, once the message has been processed. */
+        class NodeEvent_RESEND_ACK: public NodeEvent {
+            int64_t _seq;
+        public:
+            virtual void executeMain(NodeBase* p) override {
+                p->resendACK(_seq);
+            }
+            NodeEvent_RESEND_ACK(int64_t seq): _seq(seq) { }
+        };
+        
         
         /** Event class for any exception (error) thrown anywhere in the program but must be caught by the main thread. */
         class NodeEventException: public NodeEvent {
@@ -642,6 +803,24 @@ namespace OBNnode {
         virtual int64_t onRestart() { return -1; }
         
         
+        /** \brief Callback to save the node's state for a checkpoint of the simulation.
+         
+         This callback is called between two iterations when the SMN saves a checkpoint of the simulation (see GCThread::setCheckpoint() of the SMN).
+         The node should serialize into state everything it needs to continue the simulation from the current time (e.g. its internal state and the current values of its outputs), in a format of its choice; the SMN stores it in the checkpoint file.
+         This callback returns an integer: 0 if successful; >0 if failed (and it is the error code to be returned to the SMN/GC).
+         The default callback fails (returns 1), because only the node knows its state: a node must override it to support checkpoints.
+         */
+        virtual int64_t onSaveState(std::string& state) { return 1; }
+        
+        /** \brief Callback to restore the node's state from a checkpoint of the simulation.
+         
+         This callback is called when the SMN resumes a simulation from a checkpoint, after the node has been initialized (see onInitialization()); the current simulation time is then the time of the checkpoint.
+         The state is the one saved by onSaveState(). After this callback finishes, the output ports whose values have been set send them out, as after onInitialization().
+         This callback returns an integer: 0 if successful; >0 if failed (and it is the error code to be returned to the SMN/GC).
+         The default callback fails (returns 1).
+         */
+        virtual int64_t onLoadState(const std::string& state) { return 1; }
+        
         /** \brief Callback before the node's current simulation is terminated.
          
          This callback is called when the node's current simulation is about to be terminated (after it has received the TERMINATE message from the SMN).
@@ -0,0 +1,195 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Host running several socket nodes in one process.
+ *
+ * The nodes are added directly, or created by factories, which can be loaded from shared libraries.
+ * They share one connection to the SMN, which sees them as ordinary socket nodes, and their MQTT ports exchange data directly when they are connected to each other.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#ifndef OBNNODE_HOST_H_
+#define OBNNODE_HOST_H_
+
+#ifndef OBNNODE_COMM_SOCKET
+#error To use this library the program must be compiled with socket support.
+#endif
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <mutex>
+
+#include <obnsim_socket.h>
+#include <obnnode_socketnode.h>
+
+namespace OBNnode {
+    /** \brief Runs several socket nodes in one process.
+
+     When it runs, the host connects to the SMN and registers all its nodes on the connection (see obnsmn_comm_socket.h).
+     A thread receives the SMN's messages and posts each one to the event queue of its node; the nodes write their messages to the connection directly.
+     Each node runs its simulation on its own thread, so a node waiting for its events does not hold up the others.
+
+     The SMN sends the commands of a wave (SIM_INIT, UPDATE_Y, UPDATE_X) to the host's nodes in one bundle.
+     If ACK bundling is enabled (the default), the ACKs are held until all nodes that have received a command have acknowledged it, then sent to the SMN together (see OBNsim::Socket::FrameWriter::beginBundle()).
+     Any other message from a node (e.g. an irregular update request, for which the node may wait) is sent immediately, together with the ACKs held so far.
+
+     The MQTT clients of the nodes share a bus (see MQTTLocalBus): an input port connected to an output port of another node in the host receives its data directly, on the thread of the output port.
+     If the host is isolated, the nodes' data are not published to the broker, and the nodes do not connect to it.
+
+     A shared library of nodes exports a function, with C linkage and named obnnode_register_nodes, which registers the library's node factories:
+     \code
+     extern "C" void obnnode_register_nodes(OBNnode::NodeHost* host) {
+         host->addFactory("controller", [](OBNnode::NodeHost& h, const std::string& name) {
+             auto* node = new Controller(name, h.workspace());
+             return h.addNode(node, true) && node->initialize();
+         });
+     }
+     \endcode
+     */
+    class NodeHost {
+    public:
+        /** \brief Factory of a type of nodes.
+         It creates a node of the given name, adds it to the host (see addNode()) then initializes it (e.g. adds its ports); it returns false if failed.
+         */
+        typedef std::function<bool (NodeHost& host, const std::string& name)> Factory;
+
+        /** The function that a shared library of nodes exports to register its factories. */
+        typedef void (*RegisterFunction)(NodeHost* host);
+
+        /** \brief Construct a host.
+         \param ws The workspace of the nodes, as passed to their constructors.
+         */
+        NodeHost(const std::string& ws = ""): m_workspace(ws) { }
+        NodeHost(const NodeHost&) = delete;
+        NodeHost& operator=(const NodeHost&) = delete;
+
+        /** Disconnect from the SMN, delete the nodes owned by the host and unload the libraries. */
+        ~NodeHost();
+
+        /** The workspace of the nodes. */
+        const std::string& workspace() const {
+            return m_workspace;
+        }
+
+        /** Set the address of the SMN's socket; by default, the address of the first node is used. */
+        void setSMNAddress(const std::string& addr) {
+            m_smn_address = addr;
+        }
+
+        /** Set how long (in seconds) the host keeps trying to connect to the SMN, which may start after the host. */
+        void setConnectTimeout(double timeout) {
+            m_connect_timeout = timeout;
+        }
+
+        /** Set whether the nodes' data are only exchanged among them, i.e. not published to the broker, see MQTTLocalBus. */
+        void setIsolated(bool isolated) {
+            m_bus.setIsolated(isolated);
+        }
+
+        /** Set whether the nodes' ACKs of the commands received in a bundle are sent together; must be called before the host runs.
+         This saves messages to the SMN, but an ACK may wait for the other nodes', which delays the dataflow dispatch of the GC.
+         */
+        void setBundleAcks(bool bundle) {
+            m_bundle_acks = bundle;
+        }
+
+        /** Register a factory of nodes, replacing any factory of the same type. */
+        void addFactory(const std::string& type, const Factory& factory) {
+            m_factories[type] = factory;
+        }
+
+        /** \brief Load a shared library of nodes and register its factories.
+         \param path The path of the library.
+         \param error Receives the error message if the function fails.
+         \return true if successful.
+         */
+        bool loadLibrary(const std::string& path, std::string& error);
+
+        /** \brief Create a node by the factory of a given type.
+         \param type The type of the node.
+         \param name The name of the node.
+         \param error Receives the error message if the function fails.
+         \return true if successful.
+         */
+        bool createNode(const std::string& type, const std::string& name, std::string& error);
+
+        /** \brief Add a node to the host; must be called before the node opens its SMN port and before the host runs.
+         \param node The node, in the host's workspace.
+         \param owned Whether the host deletes the node when it is destroyed.
+         \return false if a node of the same name is already in the host, or if the host is running.
+         */
+        bool addNode(SocketNodeBase* node, bool owned = false);
+
+        /** The number of nodes in the host. */
+        std::size_t size() const {
+            return m_nodes.size();
+        }
+
+        /** \brief Run the nodes until all of them have stopped.
+         \param timeout The timeout of each node, see NodeBase::run().
+         \return true if no node has stopped with an error.
+         */
+        bool run(double timeout = -1.0);
+
+        /** \brief Called by a node after it has sent a message to the SMN, which ends the bundle of ACKs if the node was due to send one.
+         \param index The index of the node in the host.
+         \param type The type of the message.
+         */
+        void messageSent(std::size_t index, OBNSimMsg::N2SMN::MSGTYPE type);
+
+    private:
+        /** A node in the host. */
+        struct Entry {
+            SocketNodeBase* node;
+            bool owned;
+            bool running = false;       ///< Whether the node's thread is running
+            bool ack_due = false;       ///< Whether the node has received a command that it has not yet acknowledged, and holds a bundle
+            int64_t last_seq = -1;      ///< Sequence number of the last command received by the node
+
+            Entry(SocketNodeBase* t_node, bool t_owned): node(t_node), owned(t_owned) { }
+        };
+
+        std::string m_workspace;
+        std::string m_smn_address;          ///< Address of the SMN's socket, empty for the first node's address
+        double m_connect_timeout = 30.0;    ///< Timeout of connecting to the SMN, in seconds
+
+        std::vector<Entry> m_nodes;         ///< The nodes, in the order of their registration on the connection
+        std::unordered_map<std::string, Factory> m_factories;
+        std::vector<void*> m_libraries;     ///< Handles of the loaded libraries
+
+        MQTTLocalBus m_bus;                 ///< The bus of the nodes' MQTT clients
+
+        int m_smn_socket = -1;              ///< The connection to the SMN
+        std::atomic_bool m_running{false};  ///< Set while the nodes run
+        std::atomic_bool m_closing{false};  ///< Set when the host closes the connection itself
+        std::thread m_receive_thread;       ///< The thread receiving the SMN's messages
+        OBNsim::Socket::FrameWriter m_writer;   ///< Writes the frames to the SMN, shared by the nodes
+
+        bool m_bundle_acks = true;          ///< Whether the ACKs of a bundle are sent together
+        std::mutex m_acks_mutex;            ///< Protects the running, ack_due and last_seq fields of the nodes
+
+        /** Connect to the SMN and register the nodes on the connection. */
+        bool connect();
+
+        /** Close the connection and stop the receiving thread. */
+        void disconnect();
+
+        /** The main function of the receiving thread. */
+        void receiveMain();
+
+        /** Hold the ACKs if a node has received a new command that it will acknowledge. */
+        void holdAck(Entry& entry, const OBNSimMsg::SMN2N& msg);
+
+        /** Stop holding the ACKs for a node; m_acks_mutex must be locked. */
+        void releaseAck(Entry& entry);
+    };
+}
+
+#endif /* OBNNODE_HOST_H_ */
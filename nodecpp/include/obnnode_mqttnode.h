@@ -50,6 +50,11 @@ namespace OBNnode {
             mqtt_client.setServerAddress(addr);
         }
         
+        /** Set the QOS of the data sent by the output ports, see MQTTClient::setDataQoS(). */
+        void setDataQoS(int qos) {
+            mqtt_client.setDataQoS(qos);
+        }
+        
         /** Start the MQTT communication. */
         bool startMQTT();
         
@@ -75,6 +80,9 @@ namespace OBNnode {
          */
         virtual bool openSMNPort() override;
         
+        /** Subscribes the SMN port to the topic of a node group. */
+        virtual std::pair<int, std::string> subscribeSMNGroup(const std::string& channel) override;
+        
         /** Callback for permanent communication lost error (e.g. the communication server has shut down).
          \param comm The communication protocol/platform that has lost.
          The node should stop its simulation (if comm is not used by the GC) and exit as cleanly as possible.
@@ -44,8 +44,57 @@ namespace OBNnode {
          \param msglen Number of bytes of the message data.
          */
         virtual void parse_message(void* msg, int msglen) = 0;
+        
+        /** Parse a binary message into the port, given the QOS at which it was delivered.
+         By default, the QOS is ignored and parse_message() is called.
+         */
+        virtual void parse_message_with_qos(void* msg, int msglen, int qos) {
+            parse_message(msg, msglen);
+        }
     };
     
+    /** \brief Delivers the data of MQTT output ports to the input ports of the nodes in the same process, without the broker.
+     
+     The nodes hosted in one process (see NodeHost) share a bus. The topics of their output ports start with the nodes' names, so an input port connected from such a topic subscribes to the bus, and the data published on the topic are passed directly to it by the thread of the output port.
+     If the bus is isolated, the data are not published to the broker at all, i.e. the output ports have no subscriber outside of the process.
+     */
+    class MQTTLocalBus {
+        std::vector<std::string> m_prefixes;    ///< The prefixes of the topics of the nodes on the bus, e.g. "workspace/node/"
+        std::unordered_map< std::string, std::vector<IMQTTInputPort*> > m_topics;   ///< Map of topics to list of subscribing input ports
+        std::recursive_mutex m_mutex;   ///< A port may publish in the callback of another port, on the same thread
+        bool m_isolated = false;
+        
+    public:
+        /** Add a node to the bus, given its full name, e.g. "workspace/node". */
+        void addNode(const std::string& fullName);
+        
+        /** Whether a topic is published by a node on the bus. */
+        bool isLocal(const std::string& topic);
+        
+        /** Set whether the data of the nodes on the bus are only delivered on the bus, i.e. not published to the broker. */
+        void setIsolated(bool isolated) {
+            m_isolated = isolated;
+        }
+        
+        bool isIsolated() const {
+            return m_isolated;
+        }
+        
+        /** \brief Subscribe a port to a topic on the bus.
+         \return 0 if successful, 1 if the port is already subscribed (same as MQTTClient::addSubscription()).
+         */
+        int addSubscription(IMQTTInputPort* port, const std::string& topic);
+        
+        /** Remove a given port from all subscriptions. */
+        void removeSubscription(IMQTTInputPort* port);
+        
+        /** \brief Deliver data published on a topic to the subscribing ports.
+         \return The number of ports to which the data were delivered.
+         */
+        std::size_t deliver(void* data, int size, const std::string& topic);
+    };
+    
+    
     /** \brief The object that manages all MQTT communications (i.e. the MQTT communication thread).
      
      Uses the Async communication interface of Paho MQTT library.
@@ -54,6 +103,8 @@ namespace OBNnode {
     private:
         static const int QOS;   // The desired QOS
         
+        int m_data_qos = -1;    ///< The QOS of the data sent by output ports, see setDataQoS()
+        
         NodeBase* m_node;  ///< The node object to which this client is attached
         
         MQTTAsync m_client;     ///< The MQTT client, used for all communication needs
@@ -90,6 +141,8 @@ namespace OBNnode {
         
         std::mutex m_topics_mutex;  ///< Mutex to access the list of topics
         
+        MQTTLocalBus* m_local_bus = nullptr;    ///< The bus of the nodes in the same process, if any
+        
         /** \brief Subscribe to all topics of the current input ports.
          \param resubscribe Set to true if this is a resubscription request => if still fails, it's communication error
          */
@@ -144,6 +197,16 @@ namespace OBNnode {
             m_node = pnode;
         }
         
+        /** Set the bus of the nodes in the same process, through which the topics of these nodes are subscribed and published. */
+        void setLocalBus(MQTTLocalBus* bus) {
+            m_local_bus = bus;
+        }
+        
+        /** Whether the client must connect to the broker, i.e. unless all its data are exchanged on an isolated bus. */
+        bool needsBroker() const {
+            return !(m_local_bus && m_local_bus->isIsolated());
+        }
+        
         /** \brief Subscribe a given input port to a given topic (i.e. output port in MQTT).
          
          If the topic already exists, the given port will be added to the vector associated with that topic; otherwise a new topic is added.
@@ -160,9 +223,23 @@ namespace OBNnode {
          \param size The number of bytes of the data.
          \param topic The topic to send to.
          \param retained Whether the message should be retained by the broker/server.
+         \param qos The QOS of the message; if negative, the default QOS is used.
          \return true if successful.
          */
-        bool sendData(void *data, int size, const std::string& topic, int retained=0);
+        bool sendData(void *data, int size, const std::string& topic, int retained=0, int qos=-1);
+        
+        /** \brief Set the QOS (0, 1 or 2) of the data sent by output ports; a negative value selects the default QOS (2).
+         Lower QOS values save round trips with the broker, but with QOS 0 a sample may be lost, and with QOS 1 it may be received twice.
+         */
+        void setDataQoS(int qos) {
+            assert(qos <= 2);
+            m_data_qos = qos;
+        }
+        
+        /** The QOS of the data sent by output ports (negative for the default QOS). */
+        int dataQoS() const {
+            return m_data_qos;
+        }
         
         /** \brief Start the MQTT client (thread).
          
@@ -235,6 +312,7 @@ namespace OBNnode {
     class MQTTGCPort: public IMQTTInputPort {
         NodeBase* m_node;       // The node object to which the GC port will push events
         OBNSimMsg::SMN2N m_smn_msg; ///< The internal ProtoBuf message for parsing incoming SMN2N messages
+        std::atomic_int m_smn_qos{-1};  ///< The QOS of the last message from the SMN (negative if none)
         
     public:
         MQTTGCPort(NodeBase* pnode): m_node(pnode) {
@@ -248,6 +326,12 @@ namespace OBNnode {
 //        }
         
         virtual void parse_message(void* msg, int msglen) override;
+        virtual void parse_message_with_qos(void* msg, int msglen, int qos) override;
+        
+        /** The QOS at which the SMN sent its last message (negative if none); the ACKs with sequence numbers are sent back at the same QOS. */
+        int smnQoS() const {
+            return m_smn_qos;
+        }
     };
     
     
@@ -866,7 +950,7 @@ namespace OBNnode {
                 }
                 
                 // Send the MQTT message
-                if (!m_mqtt_client->sendData(m_buffer.data(), m_buffer.size(), portTopicName())) {
+                if (!m_mqtt_client->sendData(m_buffer.data(), m_buffer.size(), portTopicName(), 0, m_mqtt_client->dataQoS())) {
                     // Error while sending the message
                     throw OBNnode::outputport_error(this, OBNnode::outputport_error::ERR_SENDMSG);
                 }
@@ -923,7 +1007,7 @@ namespace OBNnode {
                 }
                 
                 // Send the MQTT message
-                if (!m_mqtt_client->sendData(m_buffer.data(), m_buffer.size(), portTopicName())) {
+                if (!m_mqtt_client->sendData(m_buffer.data(), m_buffer.size(), portTopicName(), 0, m_mqtt_client->dataQoS())) {
                     // Error while sending the message
                     throw OBNnode::outputport_error(this, OBNnode::outputport_error::ERR_SENDMSG);
                 }
@@ -974,7 +1058,7 @@ namespace OBNnode {
                 }
                 
                 // Send the MQTT message
-                if (!m_mqtt_client->sendData(m_cur_message.data(), m_cur_message.size(), portTopicName())) {
+                if (!m_mqtt_client->sendData(m_cur_message.data(), m_cur_message.size(), portTopicName(), 0, m_mqtt_client->dataQoS())) {
                     // Error while sending the message
                     throw OBNnode::outputport_error(this, OBNnode::outputport_error::ERR_SENDMSG);
                 }
@@ -0,0 +1,126 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Shared-memory node class for the C++ node interface.
+ *
+ * Implement a node which communicates with the SMN, and with the other nodes on the same host, through rings in shared memory (see obnsim_shm.h).
+ * Its shared-memory ports (ShmInput, ShmOutput) exchange their data through the rings; MQTT ports can also be added, in which case the MQTT client is started.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#ifndef OBNNODE_SHMNODE_H_
+#define OBNNODE_SHMNODE_H_
+
+#ifndef OBNNODE_COMM_SHM
+#error To use this library the program must be compiled with shared-memory support.
+#endif
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include <obnsim_shm.h>
+#include <obnnode_mqttnode.h>
+#include <obnnode_shmport.h>
+
+namespace OBNnode {
+    /* ============ Shared-memory Node Interface ===============*/
+    /** \brief Basic shared-memory node.
+
+     When its SMN port is opened, the node creates its segment, whose ring receives the SMN's messages and the data of its input ports,
+     and opens the SMN's segment, which may be created after the node.
+     A thread reads the ring: it posts the SMN's messages to the event queue and passes the data to the input ports.
+
+     To connect one of its input ports from an output port, the node sends a subscription request to the ring of the output port's node.
+     That node's thread processes the request before the SMN's next message, so the output port sends its data to the input port once the simulation starts.
+     */
+    class ShmNodeBase: public MQTTNodeBase {
+    public:
+        /** \brief Construct a node object. */
+        ShmNodeBase(const std::string& _name, const std::string& ws = ""): MQTTNodeBase(_name, ws) { }
+
+        virtual ~ShmNodeBase();
+
+        /** Set how long (in seconds) the node waits for the SMN's segment, as the SMN may start after the node. */
+        void setConnectTimeout(double timeout) {
+            m_connect_timeout = timeout;
+        }
+
+        /** Set the size of the node's ring, in bytes; must be called before the SMN port is opened. */
+        void setRingCapacity(std::size_t capacity) {
+            m_capacity = capacity;
+        }
+
+        /** Creates the node's segment and opens the SMN's segment, if they haven't been.
+         \return true if successful.
+         */
+        virtual bool openSMNPort() override;
+
+        /** Node groups are not supported in shared memory: the SMN writes its messages to each node's ring. */
+        virtual std::pair<int, std::string> subscribeSMNGroup(const std::string& channel) override {
+            return NodeBase::subscribeSMNGroup(channel);
+        }
+
+        // This method also stops passing data to the port
+        virtual void removePort(InputPortBase* port) override;
+
+        /** \brief Connect a shared-memory input port of this node from a shared-memory output port.
+         \param port The input port.
+         \param source The full name of the output port, e.g. "workspace/node/port".
+         \return A pair of the connection result and an optional error message, see InputPortBase::connect_from_port().
+         */
+        std::pair<int, std::string> connectShmInput(IShmInputPort* port, const std::string& source);
+
+        /** Callback for permanent communication lost error. */
+        virtual void onPermanentCommunicationLost(CommProtocol comm) override;
+
+    protected:
+        /** Send the current message in _n2smn_message to the SMN's ring. */
+        virtual void sendN2SMNMsg() override;
+
+        /** Initialize the simulation, even before we start receiving the INIT message. */
+        virtual bool initializeForSimulation() override;
+
+    private:
+        double m_connect_timeout = 30.0;    ///< Timeout of waiting for the SMN's segment, in seconds
+        std::size_t m_capacity = OBNsim::Shm::DEFAULT_CAPACITY; ///< Size of the node's ring
+
+        OBNsim::Shm::Segment m_segment;     ///< The node's segment
+        OBNsim::Shm::Segment m_smn_segment; ///< The SMN's segment
+
+        std::atomic_bool m_closing{false};  ///< Set when the node closes its segment
+        std::thread m_receive_thread;       ///< The thread reading the node's ring
+
+        /** The input ports connected from shared-memory output ports, by channel (minus CHANNEL_PORT_BASE); removed ports are null. */
+        std::vector<IShmInputPort*> m_input_channels;
+
+        /** The segments of the nodes to which this node sends data, by segment name. */
+        std::unordered_map<std::string, std::shared_ptr<OBNsim::Shm::Segment> > m_peers;
+
+        std::mutex m_channels_mutex;    ///< Protects m_input_channels and m_peers
+
+        /** Get the segment of another node, opening it if necessary; returns nullptr if failed. */
+        std::shared_ptr<OBNsim::Shm::Segment> peerSegment(const std::string& name, std::string& error);
+
+        /** The main function of the receiving thread. */
+        void receiveMain();
+
+        /** Process a subscription request from another node. */
+        void processSubscription(const char* data, std::size_t size);
+
+        /** Close the segments and stop the receiving thread. */
+        void closeSMNPort();
+    };
+
+
+    /** The main ShmNode class, which supports defining updates, _info_ port, etc. */
+    typedef OBNNodeBase<ShmNodeBase> ShmNode;
+}
+
+#endif /* OBNNODE_SHMNODE_H_ */
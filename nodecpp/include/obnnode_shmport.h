@@ -0,0 +1,586 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Shared-memory ports.
+ *
+ * Implement the ports of the nodes that communicate through rings in shared memory (see obnsim_shm.h).
+ * An output port writes its data to the rings of the nodes whose input ports are connected to it.
+ * The values of fixed-size vectors and matrices (obn_vector_fixed, obn_matrix_fixed) are written as raw bytes, directly into the ring, without ProtoBuf;
+ * the other data types are sent as ProtoBuf messages, as with MQTT.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#ifndef OBNNODE_SHMPORT_H
+#define OBNNODE_SHMPORT_H
+
+#ifndef OBNNODE_COMM_SHM
+#error To use this library the program must be compiled with shared-memory support.
+#endif
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <type_traits>
+
+#include <obnsim_shm.h>
+#include "obnnode_exceptions.h"
+#include "obnnode_basic.h"
+#include "obnnode_mqttport.h"
+
+namespace OBNnode {
+    /** \brief Whether the values of a data type are sent as raw bytes between shared-memory ports, i.e. they have a fixed size; if so, size is their number of bytes. */
+    template <typename F, typename D>
+    struct shm_raw_type: std::false_type { };
+
+    template <typename T, const std::size_t N>
+    struct shm_raw_type<OBN_PB, obn_vector_fixed<T, N> >: std::true_type {
+        static const std::size_t size = sizeof(T) * N;
+    };
+
+    template <typename T, const std::size_t NR, const std::size_t NC>
+    struct shm_raw_type<OBN_PB, obn_matrix_fixed<T, NR, NC> >: std::true_type {
+        static const std::size_t size = sizeof(T) * NR * NC;
+    };
+
+
+    /** \brief Interface of a shared-memory input port.
+     The frames received for the port are passed to it by the node's communication thread.
+     */
+    class IShmInputPort {
+    public:
+        /** Parse a frame received by the port.
+         If there is an error, the exception should be posted to the main thread.
+         \param data The frame's content.
+         \param size The size of the content.
+         \param raw Whether the content is raw values (see rawSize()); otherwise it's a ProtoBuf message.
+         */
+        virtual void parse_frame(const char* data, std::size_t size, bool raw) = 0;
+
+        /** The size in bytes of the raw values accepted by the port; 0 if it only accepts ProtoBuf messages. */
+        virtual uint32_t rawSize() const {
+            return 0;
+        }
+
+    protected:
+        /** Connect the port, attached to a given node, from a shared-memory output port, see ShmNodeBase::connectShmInput(). */
+        std::pair<int, std::string> shm_connect_from_port(NodeBase* node, const std::string& source);
+    };
+
+
+    /** \brief Base class for an openBuildNet output port in shared memory.
+     The port writes its data to the rings of the nodes whose input ports are connected to it (the subscribers).
+     */
+    class ShmOutputPortBase: public OutputPortBase {
+    protected:
+        friend class ShmNodeBase;
+
+        /** An input port connected to this port. */
+        struct Subscriber {
+            std::shared_ptr<OBNsim::Shm::Segment> segment;  ///< The segment of the input port's node
+            uint32_t channel;   ///< The channel of the input port in its node
+            uint32_t rawSize;   ///< The size of the raw values accepted by the input port, 0 if none
+        };
+
+        std::vector<Subscriber> m_subscribers;
+        std::mutex m_subscribers_mutex;     ///< Protects the subscribers, which are added by the node's communication thread
+
+        /** Add a subscriber; an existing one is ignored. */
+        void addSubscriber(const std::shared_ptr<OBNsim::Shm::Segment>& segment, uint32_t channel, uint32_t rawSize);
+
+        /** Close the port, which forgets its subscribers. */
+        virtual void close() override {
+            std::lock_guard<std::mutex> mylock(m_subscribers_mutex);
+            m_subscribers.clear();
+        }
+
+        /** Open the port given a full network name.
+         For a shared-memory output port, this does nothing. */
+        virtual bool open(const std::string& full_name) override {
+            return true;
+        }
+
+        /** Write a ProtoBuf message to all subscribers; throws outputport_error if failed.
+         The subscribers that have gone offline are skipped.
+         */
+        void sendToSubscribers(const char* data, std::size_t size);
+
+        /** Write raw values to the subscribers accepting them, and a ProtoBuf message to the others; throws outputport_error if failed.
+         \param raw The raw values.
+         \param rawSize The number of bytes of the values.
+         \param serialize Function (OBNsim::ResizableBuffer&) that serializes the message to a buffer, called only if a subscriber needs it.
+         */
+        template <typename S>
+        void sendRawToSubscribers(const char* raw, uint32_t rawSize, S serialize) {
+            bool serialized = false;
+            std::lock_guard<std::mutex> mylock(m_subscribers_mutex);
+            for (const auto& sub: m_subscribers) {
+                bool success;
+                if (sub.rawSize == rawSize) {
+                    // The values are copied directly into the ring
+                    success = sub.segment->writeWith(sub.channel | OBNsim::Shm::CHANNEL_RAW, rawSize, [raw, rawSize](char* dest) {
+                        std::memcpy(dest, raw, rawSize);
+                    });
+                } else {
+                    if (!serialized) {
+                        if (!serialize(m_buffer)) {
+                            throw OBNnode::outputport_error(this, OBNnode::outputport_error::ERR_SENDMSG);
+                        }
+                        serialized = true;
+                    }
+                    success = sub.segment->write(sub.channel, m_buffer.data(), m_buffer.size());
+                }
+                if (!success && sub.segment->isOnline()) {
+                    throw OBNnode::outputport_error(this, OBNnode::outputport_error::ERR_SENDMSG);
+                }
+            }
+        }
+
+        OBNsim::ResizableBuffer m_buffer;   ///< The buffer to store the serialized data
+
+    public:
+        ShmOutputPortBase(const std::string& t_name): OutputPortBase(t_name) { }
+
+        /** \brief Returns the full path of the output port, which is used to connect input ports to it. */
+        virtual std::string fullPortName() const override {
+            return isValid()?m_node->fullPortName(m_name):"";
+        }
+    };
+
+
+    /** \brief Template class for a shared-memory input port with specific type.
+
+     The template has the same parameters as MQTTInput (see MQTTInput for details), and the ports have the same interface.
+     A shared-memory input port can only be connected from a shared-memory output port of a node on the same host.
+     The last parameter is for internal use.
+     */
+    template <typename F, typename D, const bool S=false, const bool RAW=shm_raw_type<F, D>::value>
+    class ShmInput: public MQTTInput<F, D, S>, public IShmInputPort {
+    public:
+        ShmInput(const std::string& _name): MQTTInput<F, D, S>(_name) { }
+
+        virtual std::pair<int, std::string> connect_from_port(const std::string& source) override {
+            return shm_connect_from_port(this->m_node, source);
+        }
+
+        virtual void parse_frame(const char* data, std::size_t size, bool raw) override {
+            this->parse_message(const_cast<char*>(data), size);
+        }
+    };
+
+
+    /** Implementation of ShmInput for fixed-size vectors and matrices, non-strict reading; accepts raw values. */
+    template <typename D>
+    class ShmInput<OBN_PB, D, false, true>: public MQTTInputPortBase, public IShmInputPort {
+    private:
+        typedef OBN_DATA_TYPE_CLASS<D> _obn_data_type_class;
+        typedef typename _obn_data_type_class::PB_message_class _pb_message_class;
+
+        typename _obn_data_type_class::input_data_container m_cur_value;    ///< The typed value stored in this port
+        std::atomic_bool m_pending_value{false};    ///< If a new value is pending (hasn't been read)
+
+        _pb_message_class m_PBMessage;  ///< The ProtoBuf message object to receive the data, if it's not sent as raw values
+
+        std::mutex m_valueMutex;    ///< Mutex for accessing the value
+
+    public:
+        typedef typename _obn_data_type_class::input_data_type ValueType;
+
+        virtual void parse_frame(const char* data, std::size_t size, bool raw) override {
+            try {
+                bool result;
+                if (raw) {
+                    // The values are copied directly from the ring
+                    result = (size == shm_raw_type<OBN_PB, D>::size);
+                    if (result) {
+                        std::lock_guard<std::mutex> mylock(m_valueMutex);
+                        std::memcpy(m_cur_value.v.data(), data, size);
+                    }
+                } else {
+                    if (!m_PBMessage.ParseFromArray(data, size)) {
+                        throw OBNnode::inputport_error(this, OBNnode::inputport_error::ERR_RAWMSG);
+                    }
+                    std::lock_guard<std::mutex> mylock(m_valueMutex);
+                    result = _obn_data_type_class::readPBMessage(m_cur_value, m_PBMessage);
+                }
+
+                if (result) {
+                    m_pending_value = true;
+                    triggerMsgRcvCallback();    // Trigger the Message Received Event Callback
+                } else {
+                    // Error while reading the value, e.g. sizes don't match
+                    throw OBNnode::inputport_error(this, OBNnode::inputport_error::ERR_READVALUE);
+                }
+            } catch (...) {
+                // Catch everything and pass it to the main thread
+                m_node->postExceptionEvent(std::current_exception());
+            }
+        }
+
+        virtual void parse_message(void* msg, int msglen) override {
+            parse_frame(static_cast<const char*>(msg), msglen, false);
+        }
+
+        virtual uint32_t rawSize() const override {
+            return shm_raw_type<OBN_PB, D>::size;
+        }
+
+        virtual std::pair<int, std::string> connect_from_port(const std::string& source) override {
+            return shm_connect_from_port(m_node, source);
+        }
+
+    public:
+        ShmInput(const std::string& _name): MQTTInputPortBase(_name) { }
+
+        /** Get the current value of the port. If no message has been received, the value is undefined. */
+        ValueType operator() () {
+            m_pending_value = false; // the value has been read
+            std::lock_guard<std::mutex> mlock(m_valueMutex);
+            return m_cur_value.v;
+        }
+
+        ValueType get() {
+            m_pending_value = false; // the value has been read
+            std::lock_guard<std::mutex> mlock(m_valueMutex);
+            return m_cur_value.v;
+        }
+
+        typedef OBNnode::LockedAccess<typename _obn_data_type_class::input_data_container::data_type, std::mutex> LockedAccess;
+
+        /** Returns a thread-safe direct access to the value of the port. */
+        LockedAccess lock_and_get() {
+            m_pending_value = false; // the value has been read
+            return LockedAccess(&m_cur_value.v, &m_valueMutex);
+        }
+
+        /** Check if there is a pending input value (that hasn't been read). */
+        virtual bool isValuePending() const override {
+            return m_pending_value;
+        }
+    };
+
+
+    /** Implementation of ShmInput for fixed-size vectors and matrices, strict reading; accepts raw values. */
+    template <typename D>
+    class ShmInput<OBN_PB, D, true, true>: public MQTTInputPortBase, public IShmInputPort {
+    private:
+        typedef OBN_DATA_TYPE_CLASS<D> _obn_data_type_class;
+        typedef typename _obn_data_type_class::PB_message_class _pb_message_class;
+
+    public:
+        typedef typename _obn_data_type_class::input_queue_elem_type ValueType;
+
+    private:
+        /** The queue of typed values stored in this port. */
+        typename _obn_data_type_class::input_queue_type m_value_queue;
+
+        std::mutex m_valueMutex;    ///< Mutex for accessing the value
+
+        // Number of pending values in the queue, kept separately from the queue for quick access
+        std::atomic_uint m_pending_value_count{0};
+
+        _pb_message_class m_PBMessage;  ///< The ProtoBuf message object to receive the data, if it's not sent as raw values
+
+    public:
+        virtual void parse_frame(const char* data, std::size_t size, bool raw) override {
+            try {
+                bool result;
+                if (raw) {
+                    result = (size == shm_raw_type<OBN_PB, D>::size);
+                    if (result) {
+                        ValueType elem(new typename _obn_data_type_class::input_data_type());
+                        std::memcpy(elem->data(), data, size);
+                        std::lock_guard<std::mutex> mylock(m_valueMutex);
+                        m_value_queue.push_back(std::move(elem));
+                    }
+                } else {
+                    if (!m_PBMessage.ParseFromArray(data, size)) {
+                        throw OBNnode::inputport_error(this, OBNnode::inputport_error::ERR_RAWMSG);
+                    }
+                    std::lock_guard<std::mutex> mylock(m_valueMutex);
+                    result = _obn_data_type_class::readPBMessageStrict(m_value_queue, m_PBMessage);
+                }
+
+                if (result) {
+                    ++m_pending_value_count;
+                    triggerMsgRcvCallback();    // Trigger the Message Received Event Callback
+                } else {
+                    // Error while reading the value, e.g. sizes don't match
+                    throw OBNnode::inputport_error(this, OBNnode::inputport_error::ERR_READVALUE);
+                }
+            } catch (...) {
+                // Catch everything and pass it to the main thread
+                m_node->postExceptionEvent(std::current_exception());
+            }
+        }
+
+        virtual void parse_message(void* msg, int msglen) override {
+            parse_frame(static_cast<const char*>(msg), msglen, false);
+        }
+
+        virtual uint32_t rawSize() const override {
+            return shm_raw_type<OBN_PB, D>::size;
+        }
+
+        virtual std::pair<int, std::string> connect_from_port(const std::string& source) override {
+            return shm_connect_from_port(m_node, source);
+        }
+
+    public:
+        ShmInput(const std::string& _name): MQTTInputPortBase(_name) { }
+
+        /** Pop the top / front value of the port, see MQTTInput::pop(). */
+        ValueType pop() {
+            if (m_pending_value_count > 0) {
+                std::lock_guard<std::mutex> mylock(m_valueMutex);
+                ValueType val(std::move(m_value_queue.front()));
+                m_value_queue.pop_front();
+                --m_pending_value_count;
+                return val;
+            }
+            return ValueType();
+        }
+
+        /** Check if there is a pending input value (that hasn't been read). */
+        virtual bool isValuePending() const override {
+            return m_pending_value_count > 0;
+        }
+
+        /** Get the number of values in the queue. */
+        std::size_t size() const {
+            return m_pending_value_count;
+        }
+    };
+
+
+    /** \brief Template class for a shared-memory output port with specific type.
+
+     The template has the same parameters as MQTTOutput (see MQTTOutput for details), and the ports have the same interface.
+     The last parameter is for internal use.
+     */
+    template <typename F, typename D, const bool RAW=shm_raw_type<F, D>::value>
+    class ShmOutput;
+
+
+    /** Implementation of ShmOutput for fixed data type encoded with ProtoBuf (OBN_PB).
+     This class of ShmOutput is not thread-safe because usually it's accessed in the main thread only.
+     */
+    template <typename D>
+    class ShmOutput<OBN_PB, D, false>: public ShmOutputPortBase {
+        typedef OBN_DATA_TYPE_CLASS<D> _obn_data_type_class;
+
+    public:
+        typedef typename _obn_data_type_class::output_data_type ValueType;
+
+    private:
+        ValueType m_cur_value;    ///< The value stored in this port
+        typename _obn_data_type_class::PB_message_class m_PBMessage;   ///< The ProtoBuf message object to format the data
+
+    public:
+        ShmOutput(const std::string& _name): ShmOutputPortBase(_name) { }
+
+        /** Get the current (read-only) value of the port. */
+        ValueType operator() () const {
+            return m_cur_value;
+        }
+
+        /** Directly access the value stored in this port; can change it (so it'll be marked as changed). */
+        ValueType& operator* () {
+            m_isChanged = true;
+            return m_cur_value;
+        }
+
+        /** Assign new value to the port. */
+        ValueType& operator= (ValueType && rhs) {
+            m_cur_value = std::move(rhs);
+            m_isChanged = true;
+            return m_cur_value;
+        }
+
+        /** Assign new value to the port. */
+        ValueType& operator= (const ValueType & rhs) {
+            m_cur_value = rhs;
+            m_isChanged = true;
+            return m_cur_value;
+        }
+
+        /** Send data synchronously */
+        virtual void sendSync() override {
+            try {
+                // Convert data to message
+                _obn_data_type_class::writePBMessage(m_cur_value, m_PBMessage);
+
+                // Generate the binary content
+                m_buffer.allocateData(m_PBMessage.ByteSizeLong());
+                if (!m_PBMessage.SerializeToArray(m_buffer.data(), m_buffer.size())) {
+                    // Error while serializing the raw message
+                    throw OBNnode::outputport_error(this, OBNnode::outputport_error::ERR_SENDMSG);
+                }
+
+                sendToSubscribers(m_buffer.data(), m_buffer.size());
+                m_isChanged = false;
+            }
+            catch (...) {
+                // Catch everything and pass it to the main thread
+                m_node->postExceptionEvent(std::current_exception());
+            }
+        }
+    };
+
+
+    /** Implementation of ShmOutput for fixed-size vectors and matrices: the values are written as raw bytes to the input ports of the same type.
+     This class of ShmOutput is not thread-safe because usually it's accessed in the main thread only.
+     */
+    template <typename D>
+    class ShmOutput<OBN_PB, D, true>: public ShmOutputPortBase {
+        typedef OBN_DATA_TYPE_CLASS<D> _obn_data_type_class;
+
+    public:
+        typedef typename _obn_data_type_class::output_data_type ValueType;
+
+    private:
+        ValueType m_cur_value;    ///< The value stored in this port
+        typename _obn_data_type_class::PB_message_class m_PBMessage;   ///< The ProtoBuf message object, for the input ports that don't accept raw values
+
+    public:
+        ShmOutput(const std::string& _name): ShmOutputPortBase(_name) { }
+
+        /** Get the current (read-only) value of the port. */
+        ValueType operator() () const {
+            return m_cur_value;
+        }
+
+        /** Directly access the value stored in this port; can change it (so it'll be marked as changed). */
+        ValueType& operator* () {
+            m_isChanged = true;
+            return m_cur_value;
+        }
+
+        /** Assign new value to the port. */
+        ValueType& operator= (ValueType && rhs) {
+            m_cur_value = std::move(rhs);
+            m_isChanged = true;
+            return m_cur_value;
+        }
+
+        /** Assign new value to the port. */
+        ValueType& operator= (const ValueType & rhs) {
+            m_cur_value = rhs;
+            m_isChanged = true;
+            return m_cur_value;
+        }
+
+        /** Send data synchronously */
+        virtual void sendSync() override {
+            try {
+                sendRawToSubscribers(reinterpret_cast<const char*>(m_cur_value.data()), shm_raw_type<OBN_PB, D>::size,
+                                     [this](OBNsim::ResizableBuffer& buffer) {
+                                         _obn_data_type_class::writePBMessage(m_cur_value, m_PBMessage);
+                                         buffer.allocateData(m_PBMessage.ByteSizeLong());
+                                         return m_PBMessage.SerializeToArray(buffer.data(), buffer.size());
+                                     });
+                m_isChanged = false;
+            }
+            catch (...) {
+                // Catch everything and pass it to the main thread
+                m_node->postExceptionEvent(std::current_exception());
+            }
+        }
+    };
+
+
+    /** Implementation of ShmOutput for custom ProtoBuf data message (OBN_PB_USER).
+     This class of ShmOutput is not thread-safe because usually it's accessed in the main thread only.
+     */
+    template <typename PBCLS>
+    class ShmOutput<OBN_PB_USER, PBCLS, false>: public ShmOutputPortBase {
+        PBCLS m_cur_message;    ///< The ProtoBuf message stored in this port
+
+    public:
+        ShmOutput(const std::string& _name): ShmOutputPortBase(_name) { }
+
+        /** Directly access the ProtoBuf message stored in this port; can change it (so it'll be marked as changed). */
+        PBCLS& message() {
+            m_isChanged = true;
+            return m_cur_message;
+        }
+
+        /** Set the message content. */
+        PBCLS& setMessage (const PBCLS& m) {
+            m_isChanged = true;
+            return (m_cur_message = m);
+        }
+
+        /** Assign a new message to the content of the port. */
+        PBCLS& operator= (const PBCLS& m) {
+            return setMessage(m);
+        }
+
+        /** Send data synchronously */
+        virtual void sendSync() override {
+            try {
+                // Generate the binary content
+                m_buffer.allocateData(m_cur_message.ByteSizeLong());
+                if (!m_cur_message.SerializeToArray(m_buffer.data(), m_buffer.size())) {
+                    // Error while serializing the raw message
+                    throw OBNnode::outputport_error(this, OBNnode::outputport_error::ERR_SENDMSG);
+                }
+
+                sendToSubscribers(m_buffer.data(), m_buffer.size());
+                m_isChanged = false;
+            }
+            catch (...) {
+                // Catch everything and pass it to the main thread
+                m_node->postExceptionEvent(std::current_exception());
+            }
+        }
+    };
+
+
+    /** Implementation of ShmOutput for binary data message (OBN_BIN).
+     This class of ShmOutput is not thread-safe because usually it's accessed in the main thread only.
+     */
+    template <typename D>
+    class ShmOutput<OBN_BIN, D, false>: public ShmOutputPortBase {
+        OBNsim::ResizableBuffer m_cur_message;  ///< The binary data message stored in this port
+
+    public:
+        ShmOutput(const std::string& _name): ShmOutputPortBase(_name) { }
+
+        /** Access the message buffer as read-only. */
+        const char* message() const {
+            return m_cur_message.data();
+        }
+
+        /** Set the binary data content to a std::string */
+        void message(const std::string &s) {
+            m_isChanged = true;
+            m_cur_message.allocateData(s.size());
+            s.copy(m_cur_message.data(), s.npos);
+        }
+
+        /** Set the binary data content to n characters starting from a pointer. */
+        void message(const char* s, std::size_t n) {
+            m_isChanged = true;
+            m_cur_message.allocateData(n);
+            if (n > 0) std::copy_n(s, n, m_cur_message.data());
+        }
+
+        /** Send data synchronously */
+        virtual void sendSync() override {
+            try {
+                sendToSubscribers(m_cur_message.data(), m_cur_message.size());
+                m_isChanged = false;
+            }
+            catch (...) {
+                // Catch everything and pass it to the main thread
+                m_node->postExceptionEvent(std::current_exception());
+            }
+        }
+    };
+}
+
+#endif // OBNNODE_SHMPORT_H
@@ -0,0 +1,108 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Socket node class for the C++ node interface.
+ *
+ * Implement a node which communicates with the SMN over a TCP or Unix-domain socket, without a broker.
+ * Its data ports are MQTT ports; the MQTT client is only started if the node has ports.
+ * A socket node can also run in a NodeHost, with other nodes, in which case it shares the host's connection (see obnnode_host.h).
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#ifndef OBNNODE_SOCKETNODE_H_
+#define OBNNODE_SOCKETNODE_H_
+
+#ifndef OBNNODE_COMM_SOCKET
+#error To use this library the program must be compiled with socket support.
+#endif
+
+#include <thread>
+#include <atomic>
+
+#include <obnsim_socket.h>
+#include <obnnode_mqttnode.h>
+
+namespace OBNnode {
+    class NodeHost;
+    
+    /* ============ Socket Node Interface ===============*/
+    /** \brief Basic socket node.
+
+     The node connects to the SMN's socket when its SMN port is opened, and sends the name of its GC port as the first frame.
+     A thread receives the SMN's messages and posts them to the event queue; the messages to the SMN are written directly by the thread that sends them.
+     */
+    class SocketNodeBase: public MQTTNodeBase {
+    public:
+        /** \brief Construct a node object. */
+        SocketNodeBase(const std::string& _name, const std::string& ws = ""): MQTTNodeBase(_name, ws),
+        m_smn_address(OBNsim::Socket::defaultAddress(_workspace))
+        { }
+
+        virtual ~SocketNodeBase();
+
+        /** Set the address of the SMN's socket, see OBNsim::Socket::listenOn(); the default is OBNsim::Socket::defaultAddress() of the workspace. */
+        void setSMNAddress(const std::string& addr) {
+            m_smn_address = addr;
+        }
+
+        /** Set how long (in seconds) the node keeps trying to connect to the SMN, which may start after the node. */
+        void setConnectTimeout(double timeout) {
+            m_connect_timeout = timeout;
+        }
+
+        /** Opens the connection to the SMN, if it hasn't been opened.
+         If the node is hosted, its host opens the shared connection when it runs, so this does nothing.
+         \return true if successful.
+         */
+        virtual bool openSMNPort() override;
+        
+        /** The host of the node, or nullptr if the node has its own connection. */
+        NodeHost* host() const {
+            return m_host;
+        }
+
+        /** Node groups are not supported over sockets: the SMN sends its messages to each node's connection. */
+        virtual std::pair<int, std::string> subscribeSMNGroup(const std::string& channel) override {
+            return NodeBase::subscribeSMNGroup(channel);
+        }
+
+        /** Callback for permanent communication lost error (e.g. the SMN has closed the connection). */
+        virtual void onPermanentCommunicationLost(CommProtocol comm) override;
+
+    protected:
+        /** Send the current message in _n2smn_message over the connection. */
+        virtual void sendN2SMNMsg() override;
+
+        /** Initialize the simulation, even before we start receiving the INIT message. */
+        virtual bool initializeForSimulation() override;
+
+    private:
+        std::string m_smn_address;      ///< Address of the SMN's socket
+        double m_connect_timeout = 30.0;    ///< Timeout of connecting to the SMN, in seconds
+
+        int m_smn_socket = -1;          ///< The connection to the SMN
+        std::atomic_bool m_closing{false};  ///< Set when the node closes the connection itself
+        std::thread m_receive_thread;   ///< The thread receiving the SMN's messages
+        OBNsim::Socket::FrameWriter m_writer;   ///< Writes the frames to the SMN
+        
+        NodeHost* m_host = nullptr;     ///< The host of the node, if any
+        std::size_t m_host_index = 0;   ///< The index of the node in its host
+        OBNsim::Socket::FrameWriter* m_smn_writer = &m_writer;  ///< Writes the frames to the SMN: m_writer, or the host's writer
+        friend class NodeHost;
+
+        /** The main function of the receiving thread. */
+        void receiveMain();
+
+        /** Close the connection and stop the receiving thread. */
+        void closeSMNPort();
+    };
+
+
+    /** The main SocketNode class, which supports defining updates, _info_ port, etc. */
+    typedef OBNNodeBase<SocketNodeBase> SocketNode;
+}
+
+#endif /* OBNNODE_SOCKETNODE_H_ */
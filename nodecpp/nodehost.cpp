@@ -0,0 +1,87 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file nodehost.cpp
+ * \brief Program hosting several socket nodes, loaded from shared libraries, in one process.
+ *
+ * Usage: obnnodehost [-w WORKSPACE] [-s SMN_ADDRESS] [-i] [-u] -l LIBRARY [-l LIBRARY ...] TYPE:NAME [TYPE:NAME ...]
+ *  -w: the workspace of the nodes.
+ *  -s: the address of the SMN's socket (default: the default address of the workspace).
+ *  -i: the nodes only exchange data among themselves (no MQTT broker is used).
+ *  -u: the nodes' ACKs are sent one by one, instead of in bundles (see NodeHost::setBundleAcks()).
+ *  -l: a shared library of nodes, see NodeHost.
+ * Each TYPE:NAME creates a node named NAME by the factory of TYPE.
+ *
+ * The libraries must not contain the node.cpp framework, which is exported by this program.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <obnnode.h>
+
+using namespace OBNnode;
+
+int main(int argc, char **argv) {
+    std::string workspace, address;
+    bool isolated = false, bundleAcks = true;
+    std::vector<std::string> libraries, nodes;
+
+    for (int k = 1; k < argc; ++k) {
+        std::string arg(argv[k]);
+        if ((arg == "-w" || arg == "-s" || arg == "-l") && k + 1 < argc) {
+            std::string value(argv[++k]);
+            if (arg == "-w") {
+                workspace = value;
+            } else if (arg == "-s") {
+                address = value;
+            } else {
+                libraries.push_back(value);
+            }
+        } else if (arg == "-i") {
+            isolated = true;
+        } else if (arg == "-u") {
+            bundleAcks = false;
+        } else if (arg.find(':') != std::string::npos && arg[0] != '-') {
+            nodes.push_back(arg);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [-w WORKSPACE] [-s SMN_ADDRESS] [-i] [-u] -l LIBRARY [-l LIBRARY ...] TYPE:NAME [TYPE:NAME ...]" << std::endl;
+            return 1;
+        }
+    }
+
+    NodeHost host(workspace);
+    if (!address.empty()) {
+        host.setSMNAddress(address);
+    }
+    host.setIsolated(isolated);
+    host.setBundleAcks(bundleAcks);
+
+    std::string error;
+    for (const auto& lib: libraries) {
+        if (!host.loadLibrary(lib, error)) {
+            std::cerr << "ERROR: " << error << std::endl;
+            return 2;
+        }
+    }
+    for (const auto& spec: nodes) {
+        auto pos = spec.find(':');
+        if (!host.createNode(spec.substr(0, pos), spec.substr(pos + 1), error)) {
+            std::cerr << "ERROR: " << error << std::endl;
+            return 2;
+        }
+    }
+    if (host.size() == 0) {
+        std::cerr << "ERROR: no node to host." << std::endl;
+        return 1;
+    }
+
+    std::cout << "Hosting " << host.size() << " nodes..." << std::endl;
+    bool success = host.run();
+    std::cout << "Simulation finished. Goodbye!" << std::endl;
+
+    return success?0:3;
+}
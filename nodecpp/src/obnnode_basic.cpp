@@ -10,6 +10,9 @@
 
 #include <chrono>
 #include <thread>
+#include <unordered_map>
+#include <cstdlib>
+#include <unistd.h>
 
 #include <obnsim_basic.h>
 #include <obnnode_basic.h>
@@ -233,6 +236,11 @@ void NodeBase::sendACK(OBNSimMsg::N2SMN::MSGTYPE type) {
     _n2smn_message.Clear();
     _n2smn_message.set_msgtype(type);
     _n2smn_message.set_id(_node_id);
+    if (_ack_seq > 0) {
+        _n2smn_message.set_seq(_ack_seq);
+        _ack_seq = 0;
+        _last_ack = _n2smn_message;
+    }
 
     sendN2SMNMsg();
 }
@@ -249,10 +257,82 @@ void NodeBase::sendACK(OBNSimMsg::N2SMN::MSGTYPE type, int64_t I) {
     auto *data = new OBNSimMsg::MSGDATA;
     data->set_i(I);
     _n2smn_message.set_allocated_data(data);
+    if (_ack_seq > 0) {
+        _n2smn_message.set_seq(_ack_seq);
+        _ack_seq = 0;
+        _last_ack = _n2smn_message;
+    }
 
     sendN2SMNMsg();
 }
 
+/** This method sends an ACK message with data to the SMN.
+ \param type The type of the ACK message.
+ \param I Integer value for MSGDATA.I
+ \param B Bytes for MSGDATA.B
+ */
+void NodeBase::sendACK(OBNSimMsg::N2SMN::MSGTYPE type, int64_t I, const std::string& B) {
+    _n2smn_message.Clear();
+    _n2smn_message.set_msgtype(type);
+    _n2smn_message.set_id(_node_id);
+    
+    auto *data = new OBNSimMsg::MSGDATA;
+    data->set_i(I);
+    data->set_b(B);
+    _n2smn_message.set_allocated_data(data);
+    if (_ack_seq > 0) {
+        _n2smn_message.set_seq(_ack_seq);
+        _ack_seq = 0;
+        _last_ack = _n2smn_message;
+    }
+    
+    sendN2SMNMsg();
+}
+
+/** This method re-sends the last ACK with a sequence number, if it acknowledged the given message, e.g. because the ACK was lost and the SMN retransmitted the message.
+ \param seq The sequence number of the message received twice.
+ */
+void NodeBase::resendACK(int64_t seq) {
+    if (_last_ack.has_seq() && _last_ack.seq() == seq) {
+        _n2smn_message = _last_ack;
+        sendN2SMNMsg();
+    }
+}
+
+
+
+void NodeBase::signalReady() const {
+    // Only the first node of the process signals, because the launcher reads one name per process
+    static std::mutex signal_mutex;
+    static bool signaled = false;
+    
+    std::lock_guard<std::mutex> mylock(signal_mutex);
+    if (signaled) {
+        return;
+    }
+    signaled = true;
+    
+    const char* fd_str = std::getenv("OBN_READY_FD");
+    if (!fd_str) {
+        return;
+    }
+    int fd = std::atoi(fd_str);
+    if (fd <= 2) {
+        return;
+    }
+    std::string line = full_name() + '\n';
+    const char* p = line.data();
+    std::size_t n = line.size();
+    while (n > 0) {
+        auto k = ::write(fd, p, n);
+        if (k <= 0) {
+            break;
+        }
+        p += k;
+        n -= k;
+    }
+    ::close(fd);
+}
 
 
 /** This method runs the node in the openBuildNet simulation network.
@@ -269,6 +349,7 @@ void NodeBase::run(double timeout) {
         onReportInfo("[NODE] Could not open the SMN port. Check the network and the name server.");
         return;
     }
+    signalReady();
     
     // Must start from the STOPPED state
     if (_node_state != NODE_STOPPED) {
@@ -464,6 +545,20 @@ void NodeBase::requestStopSimulation() {
  \param msg Reference to the SMN2N message.
  */
 void NodeBase::postEvent(const OBNSimMsg::SMN2N& msg) {
+    // A message with a sequence number may be retransmitted by the SMN if its ACK did not arrive in time (e.g. over an unreliable transport).
+    // A duplicate is not processed again, but the ACK of the last message is re-sent after it has been processed.
+    // SIM_INIT starts a new sequence, unless it is the same as the last message.
+    if (msg.has_seq()) {
+        auto seq = msg.seq();
+        if (seq == _last_seq || (seq < _last_seq && msg.msgtype() != SMN2N_MSGTYPE_SIM_INIT)) {
+            if (seq == _last_seq) {
+                eventqueue_push(new NodeEvent_RESEND_ACK(seq));
+            }
+            return;
+        }
+        _last_seq = seq;
+    }
+    
     // The cases should be ordered in the frequency of the message types
     switch (msg.msgtype()) {
         case SMN2N_MSGTYPE_SIM_Y:
@@ -474,12 +569,22 @@ void NodeBase::postEvent(const OBNSimMsg::SMN2N& msg) {
             eventqueue_push(new NodeEvent_UPDATEX(msg));
             break;
             
+        case SMN2N_MSGTYPE_SIM_YX:
+            eventqueue_push(new NodeEvent_UPDATEYX(msg));
+            break;
+            
+        case SMN2N_MSGTYPE_SIM_YW:
+            eventqueue_push(new NodeEvent_UPDATEYW(msg));
+            break;
+            
         case SMN2N_MSGTYPE_SIM_EVENT_ACK:
             checkWaitForCondition(msg);
             break;
             
         case SMN2N_MSGTYPE_SIM_TERM:
             // Stop the simulation (often at the end of the simulation time, or requested by the user, but not because of a system error
+            // The next simulation starts a new sequence of messages
+            _last_seq = 0;
             eventqueue_push_front(new NodeEvent_TERMINATE(msg));
             break;
             
@@ -487,11 +592,31 @@ void NodeBase::postEvent(const OBNSimMsg::SMN2N& msg) {
             eventqueue_push(new NodeEvent_INITIALIZE(msg));
             break;
             
+        case SMN2N_MSGTYPE_SIM_SAVE:
+            // Checkpoint of the simulation
+            eventqueue_push(new NodeEvent_SAVE(msg));
+            break;
+            
+        case SMN2N_MSGTYPE_SIM_LOAD:
+            // Resume from a checkpoint
+            eventqueue_push(new NodeEvent_LOAD(msg));
+            break;
+            
         case SMN2N_MSGTYPE_SYS_PORT_CONNECT:
             // Request from the SMN to connect ports
             eventqueue_push(new NodeEvent_PORT_CONNECT(msg));
             break;
             
+        case SMN2N_MSGTYPE_SYS_PORT_CONNECT_BATCH:
+            // Request from the SMN to connect several ports
+            eventqueue_push(new NodeEvent_PORT_CONNECT_BATCH(msg));
+            break;
+            
+        case SMN2N_MSGTYPE_SYS_SUBSCRIBE:
+            // Request from the SMN to receive the messages of a node group
+            eventqueue_push(new NodeEvent_SUBSCRIBE(msg));
+            break;
+            
         case SMN2N_MSGTYPE_SYS_REQUEST_STOP_ACK:
             // We catch this but don't do anything about it for now
             // Later we should have a waitfor condition for this
@@ -521,7 +646,7 @@ void NodeBase::NodeEvent_UPDATEX::executeMain(NodeBase* pnode) {
 /** Handle UPDATE_X events: Post. */
 void NodeBase::NodeEvent_UPDATEX::executePost(NodeBase* pnode) {
     // Send ACK to the SMN
-    pnode->sendACK(OBNSimMsg::N2SMN_MSGTYPE_SIM_X_ACK);
+    sendACK(pnode, OBNSimMsg::N2SMN_MSGTYPE_SIM_X_ACK);
 }
 
 /** Handle UPDATE_Y events: Main. */
@@ -532,6 +657,7 @@ void NodeBase::NodeEvent_UPDATEY::executeMain(NodeBase* pnode) {
     }
     
     basic_processing(pnode);
+    pnode->_skip_update_x = false;
     
     // Save the current update type mask, just in case UPDATE_X needs it
     // pnode->_current_updates = _updates;
@@ -540,9 +666,8 @@ void NodeBase::NodeEvent_UPDATEY::executeMain(NodeBase* pnode) {
     pnode->onUpdateY(_updates);
 }
 
-/** Handle UPDATE_Y events: Post. */
-void NodeBase::NodeEvent_UPDATEY::executePost(NodeBase* pnode) {
-    // Send out values from output ports which have been updated
+/** Send out values from output ports which have been updated. */
+void NodeBase::NodeEvent_UPDATEY::sendChangedOutputs(NodeBase* pnode) {
     for (auto port: pnode->_output_ports) {
         if (port.first->isChanged()) {
             //TODO: Should change this to asynchronous send.
@@ -552,10 +677,67 @@ void NodeBase::NodeEvent_UPDATEY::executePost(NodeBase* pnode) {
             }
         }
     }
+}
+
+/** Handle UPDATE_Y events: Post. */
+void NodeBase::NodeEvent_UPDATEY::executePost(NodeBase* pnode) {
+    sendChangedOutputs(pnode);
     
     // Send ACK to the SMN, regardless of whether it had an error or not
     // If an error happened and the node should stop, it should also send an error message to the SMN to notify it
-    pnode->sendACK(OBNSimMsg::N2SMN_MSGTYPE_SIM_Y_ACK);
+    if (pnode->_skip_update_x) {
+        sendACK(pnode, OBNSimMsg::N2SMN_MSGTYPE_SIM_Y_ACK, OBNsim::YACK_NO_UPDATE_X);
+    } else {
+        sendACK(pnode, OBNSimMsg::N2SMN_MSGTYPE_SIM_Y_ACK);
+    }
+}
+
+/** Handle fused UPDATE_Y + UPDATE_X events: Post.
+ The outputs are sent out first, then UPDATE_X is performed (unless the node opted out), then a single SIM_Y_ACK is sent, which also acknowledges the UPDATE_X.
+ */
+void NodeBase::NodeEvent_UPDATEYX::executePost(NodeBase* pnode) {
+    sendChangedOutputs(pnode);
+    
+    if (pnode->_node_state == NodeBase::NODE_RUNNING && !pnode->_skip_update_x) {
+        pnode->onUpdateX(_xupdates);
+    }
+    
+    sendACK(pnode, OBNSimMsg::N2SMN_MSGTYPE_SIM_Y_ACK);
+}
+
+/** Handle lookahead windows: Main.
+ Each update of the window is performed as an UPDATE_Y, whose outputs are sent out, followed by an UPDATE_X (unless the node opted out).
+ The simulation time is advanced to the time of each update.
+ */
+void NodeBase::NodeEvent_UPDATEYW::executeMain(NodeBase* pnode) {
+    if (pnode->_node_state != NodeBase::NODE_RUNNING) {
+        return;
+    }
+    
+    basic_processing(pnode);
+    if (!_valid) {
+        pnode->onOBNError("Invalid lookahead window from the SMN at time " + std::to_string(_time));
+        return;
+    }
+    
+    for (const auto& update: _window) {
+        pnode->_current_sim_time = update.first;
+        pnode->_skip_update_x = false;
+        pnode->onUpdateY(update.second);
+        sendChangedOutputs(pnode);
+        if (pnode->_node_state != NodeBase::NODE_RUNNING) {
+            break;
+        }
+        if (!pnode->_skip_update_x) {
+            pnode->onUpdateX(update.second);
+        }
+    }
+}
+
+/** Handle lookahead windows: Post. */
+void NodeBase::NodeEvent_UPDATEYW::executePost(NodeBase* pnode) {
+    // Send ACK to the SMN, regardless of whether it had an error or not
+    sendACK(pnode, OBNSimMsg::N2SMN_MSGTYPE_SIM_Y_ACK);
 }
 
 /** Handle Initialization before simulation: Main. */
@@ -564,6 +746,9 @@ void NodeBase::NodeEvent_INITIALIZE::executeMain(NodeBase* pnode) {
     
     basic_processing(pnode);
     
+    // The parameters of the simulation are available to onRestart() and onInitialization()
+    pnode->_sim_parameters = _parameters;
+    
     // If the node is running, attempt to restart it
     if (pnode->_node_state == NodeBase::NODE_RUNNING) {
         _run_result = pnode->onRestart();
@@ -604,7 +789,7 @@ void NodeBase::NodeEvent_INITIALIZE::executePost(NodeBase* pnode) {
     if (_run_result) {
         // Error initializing the node => ACK with data.I > 0
         pnode->_node_state = NodeBase::NODE_ERROR;
-        pnode->sendACK(OBNSimMsg::N2SMN::MSGTYPE::N2SMN_MSGTYPE_SIM_INIT_ACK, _run_result);
+        sendACK(pnode, OBNSimMsg::N2SMN::MSGTYPE::N2SMN_MSGTYPE_SIM_INIT_ACK, _run_result);
         return;
     }
 
@@ -627,10 +812,10 @@ void NodeBase::NodeEvent_INITIALIZE::executePost(NodeBase* pnode) {
             }
         }
         
-        pnode->sendACK(OBNSimMsg::N2SMN::MSGTYPE::N2SMN_MSGTYPE_SIM_INIT_ACK);
+        sendACK(pnode, OBNSimMsg::N2SMN::MSGTYPE::N2SMN_MSGTYPE_SIM_INIT_ACK);
     } else {
         // Not running --> problem
-        pnode->sendACK(OBNSimMsg::N2SMN::MSGTYPE::N2SMN_MSGTYPE_SIM_INIT_ACK, 1);
+        sendACK(pnode, OBNSimMsg::N2SMN::MSGTYPE::N2SMN_MSGTYPE_SIM_INIT_ACK, 1);
     }
 }
 
@@ -657,6 +842,61 @@ void NodeBase::NodeEvent_TERMINATE::executePost(NodeBase* pnode) {
     // No ACK is needed
 }
 
+/** Handle checkpoint: Main. */
+void NodeBase::NodeEvent_SAVE::executeMain(NodeBase* pnode) {
+    // Skip if the node is not RUNNING: the ACK reports the error
+    if (pnode->_node_state != NodeBase::NODE_RUNNING) {
+        return;
+    }
+    
+    basic_processing(pnode);
+    _run_result = pnode->onSaveState(_state);
+}
+
+/** Handle checkpoint: Post. */
+void NodeBase::NodeEvent_SAVE::executePost(NodeBase* pnode) {
+    // The state is sent to the SMN in the ACK
+    if (_run_result) {
+        sendACK(pnode, OBNSimMsg::N2SMN::MSGTYPE::N2SMN_MSGTYPE_SIM_SAVE_ACK, _run_result);
+    } else {
+        sendACK(pnode, OBNSimMsg::N2SMN::MSGTYPE::N2SMN_MSGTYPE_SIM_SAVE_ACK, 0, _state);
+    }
+}
+
+/** Handle resuming from a checkpoint: Main. */
+void NodeBase::NodeEvent_LOAD::executeMain(NodeBase* pnode) {
+    // Skip if the node is not RUNNING (e.g. its initialization failed): the ACK reports the error
+    if (pnode->_node_state != NodeBase::NODE_RUNNING) {
+        return;
+    }
+    
+    // The current simulation time is the time of the checkpoint
+    basic_processing(pnode);
+    _run_result = pnode->onLoadState(_state);
+}
+
+/** Handle resuming from a checkpoint: Post. */
+void NodeBase::NodeEvent_LOAD::executePost(NodeBase* pnode) {
+    if (_run_result) {
+        // Error restoring the state => ACK with data.I > 0
+        pnode->_node_state = NodeBase::NODE_ERROR;
+        sendACK(pnode, OBNSimMsg::N2SMN::MSGTYPE::N2SMN_MSGTYPE_SIM_LOAD_ACK, _run_result);
+        return;
+    }
+    
+    // Send out values from output ports if they have been restored, as after the initialization
+    for (auto port: pnode->_output_ports) {
+        if (port.first->isChanged()) {
+            port.first->sendSync();
+            if (pnode->hasError()) {
+                break;
+            }
+        }
+    }
+    
+    sendACK(pnode, OBNSimMsg::N2SMN::MSGTYPE::N2SMN_MSGTYPE_SIM_LOAD_ACK);
+}
+
 /** Handle port error */
 void NodeBase::NodeEventException::executeMain(NodeBase* pnode) {
     // rethrow the exception and catch it to call the appropriate error callback function
@@ -731,6 +971,80 @@ void NodeBase::NodeEvent_PORT_CONNECT::executeMain(NodeBase* pnode) {
     pnode->sendN2SMNMsg();
 }
 
+/** Handle a batch of port connection requests. */
+void NodeBase::NodeEvent_PORT_CONNECT_BATCH::executeMain(NodeBase* pnode) {
+    OBNsim::IntStringList results;
+    
+    if (_valid_msg) {
+        // Look up the ports by their names once for all connections
+        std::unordered_map<std::string, PortBase*> ports;
+        for (const auto& p: pnode->_input_ports) {
+            ports.emplace(p.first->getPortName(), p.first);
+        }
+        
+        results.reserve(_connections.size());
+        for (const auto& conn: _connections) {
+            std::pair<int, std::string> result{-3, ""};
+            auto i = conn.first;
+            const std::string& names = conn.second;
+            if (i > 0 && names.length() > static_cast<std::size_t>(i)) {
+                auto myport = ports.find(names.substr(0, i));
+                result.first = -1;
+                if (myport != ports.end()) {
+                    // Found --> ask the port to connect
+                    result = myport->second->connect_from_port(names.substr(i));
+                }
+            }
+            results.emplace_back(result.first, std::move(result.second));
+        }
+    }
+    
+    // Prepare the ACK message, with the results in the same order as the connections
+    pnode->_n2smn_message.Clear();
+    pnode->_n2smn_message.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SYS_PORT_CONNECT_BATCH_ACK);
+    if (_hasID) {
+        pnode->_n2smn_message.set_id(_id);
+    }
+    
+    OBNSimMsg::MSGDATA* pData = new OBNSimMsg::MSGDATA();
+    pData->set_t(_request_id);
+    if (_valid_msg) {
+        OBNsim::Utils::encodeIntStringList(results, *pData->mutable_b());
+    } else {
+        pData->set_i(-3);
+    }
+    pnode->_n2smn_message.set_allocated_data(pData);
+    
+    pnode->sendN2SMNMsg();
+}
+
+/** Handle subscription request to a node group. */
+void NodeBase::NodeEvent_SUBSCRIBE::executeMain(NodeBase* pnode) {
+    std::pair<int, std::string> result{-3, ""};
+    if (!_channel.empty()) {
+        result = pnode->subscribeSMNGroup(_channel);
+    }
+    
+    // Prepare the ACK message
+    pnode->_n2smn_message.Clear();
+    pnode->_n2smn_message.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SYS_SUBSCRIBE_ACK);
+    if (_hasID) {
+        pnode->_n2smn_message.set_id(_id);
+    }
+    
+    // Only need Data field if not successful
+    if (result.first < 0) {
+        OBNSimMsg::MSGDATA* pData = new OBNSimMsg::MSGDATA();
+        pData->set_i(result.first);
+        if (!result.second.empty()) {
+            pData->set_b(result.second);
+        }
+        pnode->_n2smn_message.set_allocated_data(pData);
+    }
+    
+    pnode->sendN2SMNMsg();
+}
+
 void NodeBase::NodeEventCallback::executeMain(OBNnode::NodeBase *pnode) {
     m_callback_func();
 }
@@ -284,6 +284,7 @@ int MQTTNodeExt::runStep(double timeout) {
                     reportError("Could not open the SMN port; check the network and the name server.");
                     break;
                 }
+                signalReady();
                 
                 // Initialize the node's state
                 initializeForSimulation();
@@ -0,0 +1,278 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Host running several socket nodes in one process.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <dlfcn.h>
+#include <sys/socket.h>
+#include <obnnode_host.h>
+
+using namespace OBNnode;
+
+
+NodeHost::~NodeHost() {
+    disconnect();
+
+    // The nodes must be deleted before their libraries are unloaded
+    for (auto& entry: m_nodes) {
+        if (entry.owned) {
+            delete entry.node;
+        }
+    }
+    m_nodes.clear();
+    m_factories.clear();
+
+    for (auto handle: m_libraries) {
+        ::dlclose(handle);
+    }
+}
+
+
+bool NodeHost::loadLibrary(const std::string& path, std::string& error) {
+    void* handle = ::dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        error = "Could not load library " + path + ": " + ::dlerror();
+        return false;
+    }
+
+    auto func = reinterpret_cast<RegisterFunction>(::dlsym(handle, "obnnode_register_nodes"));
+    if (!func) {
+        error = "Library " + path + " does not export obnnode_register_nodes.";
+        ::dlclose(handle);
+        return false;
+    }
+
+    m_libraries.push_back(handle);
+    func(this);
+    return true;
+}
+
+
+bool NodeHost::createNode(const std::string& type, const std::string& name, std::string& error) {
+    auto factory = m_factories.find(type);
+    if (factory == m_factories.end()) {
+        error = "Unknown type of node: " + type;
+        return false;
+    }
+    if (!factory->second(*this, name)) {
+        error = "Could not create node " + name + " of type " + type + '.';
+        return false;
+    }
+    return true;
+}
+
+
+bool NodeHost::addNode(SocketNodeBase* node, bool owned) {
+    assert(node);
+    if (m_running || node->m_host) {
+        return false;
+    }
+    for (const auto& entry: m_nodes) {
+        if (entry.node->full_name() == node->full_name()) {
+            return false;
+        }
+    }
+
+    node->m_host = this;
+    node->m_host_index = m_nodes.size();
+    node->m_smn_writer = &m_writer;
+    node->mqtt_client.setLocalBus(&m_bus);
+    m_bus.addNode(node->full_name());
+    m_nodes.emplace_back(node, owned);
+    return true;
+}
+
+
+bool NodeHost::connect() {
+    if (m_nodes.empty()) {
+        return false;
+    }
+
+    // Connect to the SMN, which may not be listening yet
+    const std::string& address = m_smn_address.empty()?m_nodes.front().node->m_smn_address:m_smn_address;
+    std::string error;
+    auto start = std::chrono::steady_clock::now();
+    while ((m_smn_socket = OBNsim::Socket::connectTo(address, error)) < 0) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() >= m_connect_timeout) {
+            m_nodes.front().node->onReportInfo("[HOST] " + error);
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    // Register the nodes: the SMN tags its messages to each node by the node's index in this list
+    std::string names;
+    for (const auto& entry: m_nodes) {
+        names += entry.node->fullPortName("_gc_");
+        names += '\0';
+    }
+    m_writer.attach(m_smn_socket);
+    if (!m_writer.write(names.data(), names.size())) {
+        m_nodes.front().node->onReportInfo("[HOST] Could not send the nodes' names to the SMN.");
+        disconnect();
+        return false;
+    }
+
+    m_closing = false;
+    m_receive_thread = std::thread(&NodeHost::receiveMain, this);
+    return true;
+}
+
+
+void NodeHost::disconnect() {
+    if (m_smn_socket < 0) {
+        return;
+    }
+
+    // Shutting down the socket wakes up the receiving thread
+    m_closing = true;
+    ::shutdown(m_smn_socket, SHUT_RDWR);
+    if (m_receive_thread.joinable()) {
+        m_receive_thread.join();
+    }
+    m_writer.detach(m_smn_socket);
+    OBNsim::Socket::closeSocket(m_smn_socket);
+    m_smn_socket = -1;
+}
+
+
+void NodeHost::receiveMain() {
+    OBNsim::Socket::FrameReader reader;
+    OBNSimMsg::SMN2N msg;
+    const char* data;
+    std::size_t size;
+
+    while (reader.receive(m_smn_socket) > 0) {
+        while (reader.next(data, size)) {
+            // The frame starts with the index of its node
+            std::size_t index = (size >= OBNsim::Socket::FRAME_TAG_SIZE)?OBNsim::Socket::frameTag(data):m_nodes.size();
+            if (index >= m_nodes.size()) {
+                std::cerr << "ERROR: [HOST] Message received from the SMN for an unknown node." << std::endl;
+                continue;
+            }
+            auto* node = m_nodes[index].node;
+            if (msg.ParseFromArray(data + OBNsim::Socket::FRAME_TAG_SIZE, size - OBNsim::Socket::FRAME_TAG_SIZE)) {
+                if (m_bundle_acks) {
+                    holdAck(m_nodes[index], msg);
+                }
+                node->postEvent(msg);
+            } else {
+                node->onOBNError("Error while parsing a system message from the SMN.");
+            }
+        }
+        if (reader.bad()) {
+            break;
+        }
+    }
+
+    if (!m_closing) {
+        for (auto& entry: m_nodes) {
+            entry.node->onPermanentCommunicationLost(COMM_SOCKET);
+        }
+    }
+}
+
+
+bool NodeHost::run(double timeout) {
+    if (m_running || !connect()) {
+        return false;
+    }
+    m_running = true;
+
+    for (auto& entry: m_nodes) {
+        entry.running = true;
+        entry.ack_due = false;
+        entry.last_seq = -1;
+    }
+
+    // A node which stops no longer holds the others' ACKs
+    std::vector<std::thread> threads;
+    for (auto& entry: m_nodes) {
+        threads.emplace_back([this, &entry, timeout]() {
+            entry.node->run(timeout);
+            std::lock_guard<std::mutex> lock(m_acks_mutex);
+            entry.running = false;
+            releaseAck(entry);
+        });
+    }
+    for (auto& t: threads) {
+        t.join();
+    }
+
+    disconnect();
+    m_running = false;
+
+    bool success = true;
+    for (const auto& entry: m_nodes) {
+        success = success && !entry.node->hasError();
+    }
+    return success;
+}
+
+
+void NodeHost::holdAck(Entry& entry, const OBNSimMsg::SMN2N& msg) {
+    switch (msg.msgtype()) {
+        case OBNSimMsg::SMN2N_MSGTYPE_SIM_INIT:
+        case OBNSimMsg::SMN2N_MSGTYPE_SIM_Y:
+        case OBNSimMsg::SMN2N_MSGTYPE_SIM_YX:
+        case OBNSimMsg::SMN2N_MSGTYPE_SIM_YW:
+        case OBNSimMsg::SMN2N_MSGTYPE_SIM_X:
+        case OBNSimMsg::SMN2N_MSGTYPE_SIM_SAVE:
+        case OBNSimMsg::SMN2N_MSGTYPE_SIM_LOAD:
+            break;
+        default:
+            return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_acks_mutex);
+    if (msg.has_seq()) {
+        // The node may not acknowledge a duplicate again (see NodeBase::postEvent()), so it must not hold the ACKs
+        auto seq = msg.seq();
+        if (seq == entry.last_seq || (seq < entry.last_seq && msg.msgtype() != OBNSimMsg::SMN2N_MSGTYPE_SIM_INIT)) {
+            return;
+        }
+        entry.last_seq = seq;
+    }
+    if (entry.running && !entry.ack_due) {
+        entry.ack_due = true;
+        m_writer.beginBundle();
+    }
+}
+
+
+void NodeHost::releaseAck(Entry& entry) {
+    if (entry.ack_due) {
+        entry.ack_due = false;
+        m_writer.endBundle();
+    }
+}
+
+
+void NodeHost::messageSent(std::size_t index, OBNSimMsg::N2SMN::MSGTYPE type) {
+    assert(index < m_nodes.size());
+    std::lock_guard<std::mutex> lock(m_acks_mutex);
+    switch (type) {
+        case OBNSimMsg::N2SMN_MSGTYPE_SIM_INIT_ACK:
+        case OBNSimMsg::N2SMN_MSGTYPE_SIM_Y_ACK:
+        case OBNSimMsg::N2SMN_MSGTYPE_SIM_X_ACK:
+        case OBNSimMsg::N2SMN_MSGTYPE_SIM_SAVE_ACK:
+        case OBNSimMsg::N2SMN_MSGTYPE_SIM_LOAD_ACK:
+            releaseAck(m_nodes[index]);
+            break;
+        default:
+            // The node may wait for the SMN's response, so the message can't be held
+            for (auto& entry: m_nodes) {
+                releaseAck(entry);
+            }
+            break;
+    }
+}
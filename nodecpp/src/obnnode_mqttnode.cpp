@@ -77,7 +77,8 @@ void MQTTNodeBase::sendN2SMNMsg() {
     // Generate the binary content
     m_gcbuffer.allocateData(_n2smn_message.ByteSize());
     bool success = _n2smn_message.SerializeToArray(m_gcbuffer.data(), m_gcbuffer.size());
-    success = success && mqtt_client.sendData(m_gcbuffer.data(), m_gcbuffer.size(), m_smn_topic);
+    // ACKs with sequence numbers may be sent at the lower QOS chosen by the SMN, which retransmits its messages if needed
+    success = success && mqtt_client.sendData(m_gcbuffer.data(), m_gcbuffer.size(), m_smn_topic, 0, _n2smn_message.has_seq()?m_smn_port.smnQoS():-1);
     
     // std::cout << "Message sent: " << std::chrono::duration <double, std::nano> (std::chrono::steady_clock::now()-OBNsim::clockStart).count() << " ns\n";
 
@@ -100,6 +101,16 @@ bool MQTTNodeBase::openSMNPort() {
 }
 
 
+std::pair<int, std::string> MQTTNodeBase::subscribeSMNGroup(const std::string& channel) {
+    // The subscription is complete when addSubscription() returns, so the node receives all messages sent to the group after its ACK
+    auto result = mqtt_client.addSubscription(&m_smn_port, channel);
+    if (result < 0) {
+        return std::make_pair(result, "Could not subscribe to topic " + channel);
+    }
+    return std::make_pair(result, std::string());
+}
+
+
 bool MQTTNodeBase::initializeForSimulation() {
     //onReportInfo("MQTT initializeForSimulation.");
     
@@ -98,10 +98,18 @@ void MQTTClient::stop() {
 }
 
 
-bool MQTTClient::sendData(void *data, int size, const std::string& topic, int retained) {
+bool MQTTClient::sendData(void *data, int size, const std::string& topic, int retained, int qos) {
     if (topic.empty() || data == nullptr || size <= 0) {
         return false;
     }
+    
+    // The nodes in the same process receive the data directly
+    if (m_local_bus && m_local_bus->isLocal(topic)) {
+        m_local_bus->deliver(data, size, topic);
+        if (m_local_bus->isIsolated()) {
+            return true;
+        }
+    }
 
     MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
     MQTTAsync_message pubmsg = MQTTAsync_message_initializer;
@@ -111,7 +119,7 @@ bool MQTTClient::sendData(void *data, int size, const std::string& topic, int re
     
     pubmsg.payload = data;
     pubmsg.payloadlen = size;
-    pubmsg.qos = MQTTClient::QOS;
+    pubmsg.qos = (qos < 0)?MQTTClient::QOS:qos;
     pubmsg.retained = retained;
     
     // Request to send the message
@@ -124,6 +132,17 @@ int MQTTClient::addSubscription(IMQTTInputPort* port, const std::string& topic)
         return -3;
     }
     
+    // Topics of the nodes in the same process are subscribed on their bus
+    if (m_local_bus) {
+        if (m_local_bus->isLocal(topic)) {
+            return m_local_bus->addSubscription(port, topic);
+        }
+        if (m_local_bus->isIsolated()) {
+            // Not connected to the broker
+            return -2;
+        }
+    }
+    
     std::unique_lock<std::mutex> lock(m_topics_mutex);
     
     // Find or insert the topic in the map
@@ -160,6 +179,10 @@ void MQTTClient::removeSubscription(IMQTTInputPort* port) {
         return;
     }
     
+    if (m_local_bus) {
+        m_local_bus->removeSubscription(port);
+    }
+    
     std::unique_lock<std::mutex> lock(m_topics_mutex);
     
     // Find the given port in all topics and remove it
@@ -294,8 +317,9 @@ void MQTTClient::on_connection_lost(void *context, char *cause)
 
 int MQTTClient::on_message_arrived(void *context, char *topicName, int topicLen, MQTTAsync_message *message)
 {
-    // Ignore if the message is a duplicate
-    if (!(message->dup)) {
+    // Ignore if the message is a duplicate, except with QOS 1 where it may be the only copy delivered
+    // (messages from the SMN are then de-duplicated by their sequence numbers, see NodeBase::postEvent())
+    if (!(message->dup) || message->qos == 1) {
         MQTTClient* client = static_cast<MQTTClient*>(context);
         
         // copy the topic to C++ string
@@ -312,7 +336,7 @@ int MQTTClient::on_message_arrived(void *context, char *topicName, int topicLen,
         if (found != client->m_topics.end()) {
             // Ask the subscribing ports to process the message
             for (auto& port: found->second) {
-                port->parse_message(message->payload, message->payloadlen);
+                port->parse_message_with_qos(message->payload, message->payloadlen, message->qos);
             }
         } else {
             // Not found
@@ -440,6 +464,60 @@ void MQTTClient::onDisconnect(void* context, MQTTAsync_successData* response)
 }
 
 
+///////////////////////////////////////////////
+// Implementation of MQTTLocalBus
+///////////////////////////////////////////////
+void MQTTLocalBus::addNode(const std::string& fullName) {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    m_prefixes.push_back(fullName + '/');
+}
+
+bool MQTTLocalBus::isLocal(const std::string& topic) {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    for (const auto& prefix: m_prefixes) {
+        if (topic.compare(0, prefix.size(), prefix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int MQTTLocalBus::addSubscription(IMQTTInputPort* port, const std::string& topic) {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    auto& ports = m_topics[topic];
+    if (std::find(ports.begin(), ports.end(), port) != ports.end()) {
+        return 1;
+    }
+    ports.push_back(port);
+    return 0;
+}
+
+void MQTTLocalBus::removeSubscription(IMQTTInputPort* port) {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    for (auto topic = m_topics.begin(); topic != m_topics.end(); ) {
+        topic->second.erase(std::remove(topic->second.begin(), topic->second.end(), port), topic->second.end());
+        if (topic->second.empty()) {
+            topic = m_topics.erase(topic);
+        } else {
+            ++topic;
+        }
+    }
+}
+
+std::size_t MQTTLocalBus::deliver(void* data, int size, const std::string& topic) {
+    // The lock keeps the ports from being removed while they parse the data
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    auto found = m_topics.find(topic);
+    if (found == m_topics.end()) {
+        return 0;
+    }
+    for (auto& port: found->second) {
+        port->parse_message(data, size);
+    }
+    return found->second.size();
+}
+
+
 ///////////////////////////////////////////////
 // Implementation of MQTTGCPort
 ///////////////////////////////////////////////
@@ -458,6 +536,11 @@ void MQTTGCPort::parse_message(void *msg, int msglen) {
     }
 }
 
+void MQTTGCPort::parse_message_with_qos(void *msg, int msglen, int qos) {
+    m_smn_qos = qos;    // Set before the message is posted, so that its ACK can use it
+    parse_message(msg, msglen);
+}
+
 
 ///////////////////////////////////////////////
 // Implementation of MQTT base port classes
@@ -0,0 +1,314 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Shared-memory node class and ports for the C++ node interface.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <obnnode_shmnode.h>
+#include <obnnode_exceptions.h>
+
+using namespace OBNnode;
+using namespace OBNSimMsg;
+
+
+///////////////////////////////////////////////
+// Shared-memory ports
+///////////////////////////////////////////////
+
+std::pair<int, std::string> IShmInputPort::shm_connect_from_port(NodeBase* node, const std::string& source) {
+    assert(!source.empty());
+
+    ShmNodeBase* shmnode = dynamic_cast<ShmNodeBase*>(node);
+    if (!shmnode) {
+        return std::make_pair(-2, "Internal error of shared-memory port: the port does not belong to a shared-memory node.");
+    }
+    return shmnode->connectShmInput(this, source);
+}
+
+
+void ShmOutputPortBase::addSubscriber(const std::shared_ptr<OBNsim::Shm::Segment>& segment, uint32_t channel, uint32_t rawSize) {
+    std::lock_guard<std::mutex> mylock(m_subscribers_mutex);
+    for (const auto& sub: m_subscribers) {
+        if (sub.segment == segment && sub.channel == channel) {
+            return;
+        }
+    }
+    m_subscribers.push_back({segment, channel, rawSize});
+}
+
+
+void ShmOutputPortBase::sendToSubscribers(const char* data, std::size_t size) {
+    std::lock_guard<std::mutex> mylock(m_subscribers_mutex);
+    for (const auto& sub: m_subscribers) {
+        if (!sub.segment->write(sub.channel, data, size) && sub.segment->isOnline()) {
+            throw OBNnode::outputport_error(this, OBNnode::outputport_error::ERR_SENDMSG);
+        }
+    }
+}
+
+
+///////////////////////////////////////////////
+// Shared-memory node
+///////////////////////////////////////////////
+
+ShmNodeBase::~ShmNodeBase() {
+    closeSMNPort();
+}
+
+
+bool ShmNodeBase::openSMNPort() {
+    if (m_segment.isOpen()) {
+        return true;
+    }
+
+    std::string error;
+    if (!m_segment.create(OBNsim::Shm::segmentName(fullPortName("_gc_")), m_capacity, error)) {
+        onReportInfo("[SHM] " + error);
+        return false;
+    }
+
+    // Open the SMN's segment, which may not exist yet
+    auto start = std::chrono::steady_clock::now();
+    while (!m_smn_segment.open(OBNsim::Shm::segmentName(m_smn_topic), error) || !m_smn_segment.isOnline()) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() >= m_connect_timeout) {
+            onReportInfo("[SHM] The SMN is not online: " + error);
+            m_smn_segment.close();
+            m_segment.close();
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    m_closing = false;
+    m_receive_thread = std::thread(&ShmNodeBase::receiveMain, this);
+
+    // The SMN considers the node online from now
+    m_segment.setOnline(true);
+    return true;
+}
+
+
+void ShmNodeBase::closeSMNPort() {
+    if (!m_segment.isOpen()) {
+        return;
+    }
+
+    m_closing = true;
+    m_segment.setOnline(false);
+    m_segment.wake();
+    if (m_receive_thread.joinable()) {
+        m_receive_thread.join();
+    }
+
+    m_segment.close();
+    m_smn_segment.close();
+
+    std::lock_guard<std::mutex> mylock(m_channels_mutex);
+    m_peers.clear();
+}
+
+
+void ShmNodeBase::receiveMain() {
+    OBNSimMsg::SMN2N msg;
+
+    while (!m_closing) {
+        m_segment.read([this, &msg](uint32_t channel, const char* data, std::size_t size) {
+            if (channel == OBNsim::Shm::CHANNEL_SMN) {
+                if (msg.ParseFromArray(data, size)) {
+                    postEvent(msg);
+                } else {
+                    onOBNError("Error while parsing a system message from the SMN.");
+                }
+            } else if (channel == OBNsim::Shm::CHANNEL_SUBSCRIBE) {
+                processSubscription(data, size);
+            } else {
+                // Data of an input port; the lock prevents the port from being removed meanwhile
+                std::size_t index = (channel & ~OBNsim::Shm::CHANNEL_RAW) - OBNsim::Shm::CHANNEL_PORT_BASE;
+                std::lock_guard<std::mutex> mylock(m_channels_mutex);
+                if (index < m_input_channels.size() && m_input_channels[index]) {
+                    m_input_channels[index]->parse_frame(data, size, (channel & OBNsim::Shm::CHANNEL_RAW) != 0);
+                }
+            }
+        });
+        if (!m_closing) {
+            m_segment.wait();
+        }
+    }
+}
+
+
+std::shared_ptr<OBNsim::Shm::Segment> ShmNodeBase::peerSegment(const std::string& name, std::string& error) {
+    std::lock_guard<std::mutex> mylock(m_channels_mutex);
+    auto& peer = m_peers[name];
+    if (peer && peer->isOnline()) {
+        return peer;
+    }
+
+    // Open the segment; a new object is created because the previous one may be used by output ports
+    peer = std::make_shared<OBNsim::Shm::Segment>();
+    if (!peer->open(name, error) || !peer->isOnline()) {
+        if (error.empty()) {
+            error = "Shared memory " + name + " is offline.";
+        }
+        m_peers.erase(name);
+        return nullptr;
+    }
+    return peer;
+}
+
+
+std::pair<int, std::string> ShmNodeBase::connectShmInput(IShmInputPort* port, const std::string& source) {
+    if (!m_segment.isOpen()) {
+        return std::make_pair(-2, "The node's shared memory is not open.");
+    }
+
+    // The source is of the form "workspace/node/port"
+    auto pos = source.rfind('/');
+    if (pos == std::string::npos || pos == 0 || pos + 1 == source.size()) {
+        return std::make_pair(-1, "Invalid name of output port: " + source);
+    }
+
+    std::string error;
+    auto peer = peerSegment(OBNsim::Shm::segmentName(source.substr(0, pos + 1) + "_gc_"), error);
+    if (!peer) {
+        return std::make_pair(-2, "Could not connect from " + source + ": " + error);
+    }
+
+    // Assign a channel to the port
+    uint32_t channel;
+    {
+        std::lock_guard<std::mutex> mylock(m_channels_mutex);
+        auto it = std::find(m_input_channels.begin(), m_input_channels.end(), port);
+        channel = OBNsim::Shm::CHANNEL_PORT_BASE + (it - m_input_channels.begin());
+        if (it == m_input_channels.end()) {
+            m_input_channels.push_back(port);
+        }
+    }
+
+    // The request: the channel and the raw size of the port, then the name of the output port and the name of my segment
+    uint32_t header[2] = {channel, port->rawSize()};
+    std::string request(reinterpret_cast<const char*>(header), sizeof(header));
+    request += source.substr(pos + 1);
+    request += '\0';
+    request += m_segment.name();
+
+    if (!peer->write(OBNsim::Shm::CHANNEL_SUBSCRIBE, request.data(), request.size())) {
+        return std::make_pair(-2, "Could not send the subscription request to the node of " + source + ".");
+    }
+    return std::make_pair(0, std::string());
+}
+
+
+void ShmNodeBase::processSubscription(const char* data, std::size_t size) {
+    uint32_t header[2];
+    std::string names;
+    if (size > sizeof(header)) {
+        std::memcpy(header, data, sizeof(header));
+        names.assign(data + sizeof(header), size - sizeof(header));
+    }
+    auto sep = names.find('\0');
+    if (sep == std::string::npos) {
+        postExceptionEvent(std::make_exception_ptr(std::runtime_error("Invalid subscription request received in shared memory.")));
+        return;
+    }
+    auto portName = names.substr(0, sep);
+    auto segmentName = names.substr(sep + 1);
+
+    ShmOutputPortBase* port = nullptr;
+    for (const auto& p: _output_ports) {
+        if (p.first->getPortName() == portName) {
+            port = dynamic_cast<ShmOutputPortBase*>(p.first);
+            break;
+        }
+    }
+    if (!port) {
+        postExceptionEvent(std::make_exception_ptr(std::runtime_error("Could not connect from port " + fullPortName(portName) + ", which is not a shared-memory output port.")));
+        return;
+    }
+
+    std::string error;
+    auto peer = peerSegment(segmentName, error);
+    if (!peer) {
+        postExceptionEvent(std::make_exception_ptr(std::runtime_error("Could not connect from port " + fullPortName(portName) + ": " + error)));
+        return;
+    }
+    port->addSubscriber(peer, header[0], header[1]);
+}
+
+
+void ShmNodeBase::removePort(InputPortBase* port) {
+    // Stop passing data to the port
+    IShmInputPort* shmport = dynamic_cast<IShmInputPort*>(port);
+    if (shmport) {
+        std::lock_guard<std::mutex> mylock(m_channels_mutex);
+        std::replace(m_input_channels.begin(), m_input_channels.end(), shmport, static_cast<IShmInputPort*>(nullptr));
+    }
+
+    MQTTNodeBase::removePort(port);
+}
+
+
+void ShmNodeBase::sendN2SMNMsg() {
+    // The message is serialized directly into the SMN's ring
+    auto size = _n2smn_message.ByteSizeLong();
+    bool success = m_smn_segment.writeWith(OBNsim::Shm::CHANNEL_SMN, size, [this](char* dest) {
+        _n2smn_message.SerializeWithCachedSizesToArray(reinterpret_cast<google::protobuf::uint8*>(dest));
+    });
+
+    if (!success) {
+        onOBNError("Error while sending a system message to the SMN.");
+    }
+}
+
+
+bool ShmNodeBase::initializeForSimulation() {
+    // Skip the MQTT node's initialization, which announces the node on the broker
+    if (!NodeBase::initializeForSimulation()) {
+        return false;
+    }
+
+    if (!m_smn_segment.isOnline()) {
+        onReportInfo("[SHM] The SMN is not online.");
+        return false;
+    }
+
+    // The MQTT client is only needed by the MQTT ports
+    bool needMQTT = false;
+    for (const auto& p: _input_ports) {
+        needMQTT = needMQTT || !dynamic_cast<IShmInputPort*>(p.first);
+    }
+    for (const auto& p: _output_ports) {
+        needMQTT = needMQTT || !dynamic_cast<ShmOutputPortBase*>(p.first);
+    }
+    if (needMQTT && !startMQTT()) {
+        onReportInfo("[MQTT] MQTT Client could not be started; check the communication network or the MQTT broker.");
+        return false;
+    }
+    return true;
+}
+
+
+void ShmNodeBase::onPermanentCommunicationLost(CommProtocol comm) {
+    auto error_message = std::string("Permanent connection lost for protocol ") + (comm==COMM_SHM?"SHM":"MQTT");
+    std::cerr << "ERROR: " << error_message << " => Terminate." << std::endl;
+
+    if (comm != COMM_SHM) {
+        // We can still try to stop the simulation as the communication with the SMN is not affected
+        stopSimulation();
+
+        // Wait a bit
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    // Push an error event to the main thread
+    postExceptionEvent(std::make_exception_ptr(std::runtime_error(error_message)));
+}
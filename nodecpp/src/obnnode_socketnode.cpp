@@ -0,0 +1,151 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Socket node class for the C++ node interface.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <chrono>
+#include <thread>
+#include <sys/socket.h>
+#include <obnnode_socketnode.h>
+#include <obnnode_host.h>
+#include <obnnode_exceptions.h>
+
+using namespace OBNnode;
+using namespace OBNSimMsg;
+
+
+SocketNodeBase::~SocketNodeBase() {
+    closeSMNPort();
+}
+
+
+bool SocketNodeBase::openSMNPort() {
+    if (m_smn_socket >= 0 || m_host) {
+        return true;
+    }
+
+    // Connect to the SMN, which may not be listening yet
+    std::string error;
+    auto start = std::chrono::steady_clock::now();
+    while ((m_smn_socket = OBNsim::Socket::connectTo(m_smn_address, error)) < 0) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() >= m_connect_timeout) {
+            onReportInfo("[SOCKET] " + error);
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    // Announce the name of my GC port, by which the SMN identifies the connection
+    auto portName = fullPortName("_gc_");
+    m_writer.attach(m_smn_socket);
+    if (!m_writer.write(portName.data(), portName.size())) {
+        onReportInfo("[SOCKET] Could not send the node's name to the SMN.");
+        closeSMNPort();
+        return false;
+    }
+
+    m_closing = false;
+    m_receive_thread = std::thread(&SocketNodeBase::receiveMain, this);
+    return true;
+}
+
+
+void SocketNodeBase::closeSMNPort() {
+    if (m_smn_socket < 0) {
+        return;
+    }
+
+    // Shutting down the socket wakes up the receiving thread
+    m_closing = true;
+    ::shutdown(m_smn_socket, SHUT_RDWR);
+    if (m_receive_thread.joinable()) {
+        m_receive_thread.join();
+    }
+    m_writer.detach(m_smn_socket);
+    OBNsim::Socket::closeSocket(m_smn_socket);
+    m_smn_socket = -1;
+}
+
+
+void SocketNodeBase::receiveMain() {
+    OBNsim::Socket::FrameReader reader;
+    OBNSimMsg::SMN2N msg;
+    const char* data;
+    std::size_t size;
+
+    while (reader.receive(m_smn_socket) > 0) {
+        while (reader.next(data, size)) {
+            if (msg.ParseFromArray(data, size)) {
+                postEvent(msg);
+            } else {
+                onOBNError("Error while parsing a system message from the SMN.");
+            }
+        }
+        if (reader.bad()) {
+            break;
+        }
+    }
+
+    if (!m_closing) {
+        onPermanentCommunicationLost(COMM_SOCKET);
+    }
+}
+
+
+void SocketNodeBase::sendN2SMNMsg() {
+    // Generate the binary content
+    m_gcbuffer.allocateData(_n2smn_message.ByteSizeLong());
+    bool success = _n2smn_message.SerializeToArray(m_gcbuffer.data(), m_gcbuffer.size());
+    success = success && m_smn_writer->write(m_gcbuffer.data(), m_gcbuffer.size());
+    if (m_host) {
+        // The host may be holding the message to send it with the other nodes' ACKs
+        m_host->messageSent(m_host_index, _n2smn_message.msgtype());
+    }
+
+    if (!success) {
+        onOBNError("Error while sending a system message to the SMN.");
+    }
+}
+
+
+bool SocketNodeBase::initializeForSimulation() {
+    // Skip the MQTT node's initialization, which announces the node on the broker
+    if (!NodeBase::initializeForSimulation()) {
+        return false;
+    }
+
+    if (!m_smn_writer->isAttached()) {
+        onReportInfo("[SOCKET] The node is not connected to the SMN.");
+        return false;
+    }
+
+    // The MQTT client is only needed by the data ports, unless they are all on the host's isolated bus
+    if ((!_input_ports.empty() || !_output_ports.empty()) && mqtt_client.needsBroker() && !startMQTT()) {
+        onReportInfo("[MQTT] MQTT Client could not be started; check the communication network or the MQTT broker.");
+        return false;
+    }
+    return true;
+}
+
+
+void SocketNodeBase::onPermanentCommunicationLost(CommProtocol comm) {
+    auto error_message = std::string("Permanent connection lost for protocol ") + (comm==COMM_SOCKET?"SOCKET":"MQTT");
+    std::cerr << "ERROR: " << error_message << " => Terminate." << std::endl;
+
+    if (comm != COMM_SOCKET) {
+        // We can still try to stop the simulation as the connection with the SMN is not affected
+        stopSimulation();
+
+        // Wait a bit
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    // Push an error event to the main thread
+    postExceptionEvent(std::make_exception_ptr(std::runtime_error(error_message)));
+}
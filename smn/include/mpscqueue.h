@@ -0,0 +1,244 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Lock-free multi-producer single-consumer queue of pointers to objects.
+ *
+ * Header file to implement a lock-free, intrusive multi-producer single-consumer (MPSC) queue of pointers to objects, and an event count to wake up the single consumer.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ * \see http://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
+ */
+
+
+#ifndef OBNSIM_MPSCQUEUE_H_
+#define OBNSIM_MPSCQUEUE_H_
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+
+/** \brief Event count to put a single consumer thread to sleep and wake it up.
+
+ Producers call notify() after they have made something available (e.g. pushed to a queue, set a flag).
+ The consumer waits in three steps: key = prepare_wait(); re-check its conditions; then either cancel_wait() if a condition is true, or wait(key) otherwise.
+ A notification between prepare_wait() and wait() is never lost, because wait() returns immediately if the key has changed.
+
+ Notifying costs one memory fence and one atomic load, unless the consumer is (about to be) sleeping, in which case a single producer increments the epoch and uses the mutex and condition variable to wake it up.
+ The fences in notify() and prepare_wait() guarantee that either the producer sees the consumer waiting, or the consumer sees what the producer made available when it re-checks.
+ */
+class event_count
+{
+    std::atomic<unsigned int> mEpoch{0};    // incremented by each notification to a waiting consumer
+    std::atomic<bool> mWaiting{false};      // whether the consumer is (about to be) sleeping
+    std::mutex mMut;
+    std::condition_variable mCond;
+
+public:
+    /** \brief Wake up the consumer if it's waiting. Thread safe, lock free unless the consumer is sleeping. */
+    void notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // Only the first producer that sees the consumer waiting wakes it up; the others return immediately
+        if (mWaiting.load(std::memory_order_relaxed) && mWaiting.exchange(false)) {
+            mEpoch.fetch_add(1);
+            std::lock_guard<std::mutex> lock(mMut);
+            mCond.notify_one();
+        }
+    }
+
+    /** \brief Announce that the consumer is going to wait; the consumer must then re-check its conditions before calling wait() or cancel_wait().
+     \return The key to be passed to wait().
+     */
+    unsigned int prepare_wait()
+    {
+        unsigned int key = mEpoch.load();
+        mWaiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return key;
+    }
+
+    /** \brief Cancel the wait announced by prepare_wait(). */
+    void cancel_wait()
+    {
+        mWaiting.store(false);
+    }
+
+    /** \brief Wait until notified after prepare_wait() returned the given key. */
+    void wait(unsigned int key)
+    {
+        std::unique_lock<std::mutex> lock(mMut);
+        while (mEpoch.load() == key) {
+            mCond.wait(lock);
+        }
+        mWaiting.store(false);
+    }
+
+    /** \brief Wait until notified after prepare_wait() returned the given key, or until a time point.
+     \return false if timed out; true if notified.
+     */
+    template <class Clock, class Duration>
+    bool wait_until(unsigned int key, const std::chrono::time_point<Clock, Duration>& tp)
+    {
+        std::unique_lock<std::mutex> lock(mMut);
+        while (mEpoch.load() == key) {
+            if (mCond.wait_until(lock, tp) == std::cv_status::timeout) {
+                bool notified = (mEpoch.load() != key);
+                mWaiting.store(false);
+                return notified;
+            }
+        }
+        mWaiting.store(false);
+        return true;
+    }
+};
+
+
+/** \brief Link of an object in an mpsc_queue.
+
+ The objects pushed to an mpsc_queue<T> must derive from this class, so that the queue links the objects themselves and pushing doesn't allocate memory.
+ An object can only be in one queue at a time.
+ */
+class mpsc_queue_hook
+{
+    template <typename T> friend class mpsc_queue;
+    std::atomic<mpsc_queue_hook*> mpsc_next{nullptr};
+};
+
+
+/** \brief Template of lock-free multi-producer single-consumer queue.
+
+ This queue has the same ownership semantics as shared_queue: it contains smart pointers to objects of type T, it takes ownership of pushed pointers, and popped objects are returned as smart pointers.
+ Any thread can push to the queue, without locking; but only one thread (the consumer) can pop from it or check if it's empty.
+ After each push, the given event_count is notified, so the consumer can sleep on it while the queue is empty.
+ The consumer should drain the queue in batches with pop_all().
+
+ The queue is intrusive: T must derive from mpsc_queue_hook, which holds the link to the next object, and a stub hook in the queue is re-inserted whenever the queue runs empty.
+ Pushing is one atomic exchange and one store, with no memory allocation.
+
+ \param T Type of the objects (the queue contains smart pointers to these objects, not the objects themselves).
+ */
+template <typename T>
+class mpsc_queue
+{
+public:
+    typedef typename std::unique_ptr<T> item_type; ///< Smart pointer type to the objects.
+
+private:
+    std::atomic<mpsc_queue_hook*> mHead;    // the most recently pushed object, where producers push
+    mpsc_queue_hook* mTail;                 // the oldest object (or the stub); accessed by the consumer only
+    mpsc_queue_hook mStub;                  // the stub, which keeps the list non-empty when there is no object
+    event_count &mSignal;                   // event count to notify after pushing to queue
+
+    /** Link an object (or the stub) at the head of the queue. */
+    void link(mpsc_queue_hook* n)
+    {
+        n->mpsc_next.store(nullptr, std::memory_order_relaxed);
+        mpsc_queue_hook* prev = mHead.exchange(n, std::memory_order_acq_rel);
+        prev->mpsc_next.store(n, std::memory_order_release);   // link after exchange; the consumer sees the object once this is done
+    }
+
+public:
+    /**
+     An event_count object must be given. After an item is pushed to the queue successfully, it will be notified.
+
+     \param sig Reference to a valid event_count, that will be used to wait for items being pushed into the queue.
+     */
+    mpsc_queue(event_count& sig): mTail(&mStub), mSignal(sig) {
+        mHead.store(&mStub);
+    }
+
+    mpsc_queue(const mpsc_queue&) = delete;
+    mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+    ~mpsc_queue() {
+        while (try_pop()) { }
+    }
+
+    ///@{
+    /** Push an object into the queue. Thread safe and lock free.
+
+     \param pValue The object to be pushed, of type T and must be dynamically allocated.
+     */
+    void push(T* pValue)
+    {
+        link(pValue);
+        mSignal.notify();
+    }
+
+    void push(item_type&& v)
+    {
+        push(v.release());
+    }
+    ///@}
+
+    /** \brief Try to pop if non-empty. Consumer only.
+
+     If the queue is non-empty, pop the oldest element; otherwise, return nil pointer.
+     An element whose push has not completed yet is not visible, nor are the elements pushed after it; its producer will notify the event count when it completes.
+     \return The oldest item, or nil pointer if the queue is empty.
+     */
+    item_type try_pop()
+    {
+        mpsc_queue_hook* tail = mTail;
+        mpsc_queue_hook* next = tail->mpsc_next.load(std::memory_order_acquire);
+        if (tail == &mStub) {
+            // Skip the stub
+            if (!next) {
+                return item_type();  // nil
+            }
+            mTail = next;
+            tail = next;
+            next = next->mpsc_next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            mTail = next;
+            return item_type(static_cast<T*>(tail));
+        }
+        if (tail != mHead.load(std::memory_order_acquire)) {
+            return item_type();  // a push after tail is in progress
+        }
+        // tail is the last object: put the stub behind it so it can be unlinked
+        link(&mStub);
+        next = tail->mpsc_next.load(std::memory_order_acquire);
+        if (next) {
+            mTail = next;
+            return item_type(static_cast<T*>(tail));
+        }
+        return item_type();  // a push after tail is in progress
+    }
+
+    /** \brief Pop all available elements, in order, and append them to a container. Consumer only.
+     \param out A container of item_type supporting push_back(), e.g. std::deque.
+     \return The number of popped elements.
+     */
+    template <class C>
+    std::size_t pop_all(C& out)
+    {
+        std::size_t n = 0;
+        while (item_type v = try_pop()) {
+            out.push_back(std::move(v));
+            ++n;
+        }
+        return n;
+    }
+
+    /** \brief Check if the queue has no element that can be popped now. Consumer only.
+
+     An element whose push is in progress is not counted, so the consumer can wait for its producer's notification instead of spinning.
+     */
+    bool empty() const
+    {
+        const mpsc_queue_hook* tail = mTail;
+        if (tail->mpsc_next.load(std::memory_order_acquire)) {
+            return false;
+        }
+        // tail has no successor: it's the stub (empty), the last object, or an object followed by a push in progress
+        return tail == &mStub || tail != mHead.load(std::memory_order_acquire);
+    }
+};
+
+#endif /* OBNSIM_MPSCQUEUE_H_ */
@@ -0,0 +1,212 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Lock-free tracker of the ACKs expected by the GC's wait-for events.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#ifndef OBNSIM_ACKTRACKER_H
+#define OBNSIM_ACKTRACKER_H
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+
+namespace OBNsmn {
+    /** \brief Tracker of the ACKs that the GC is waiting for, from communication threads.
+
+     The GC starts a wait-for with begin() and expect(), then sends its messages; each ACK is then registered by acknowledge(), from any communication thread, without locks nor memory allocation.
+     The tracker consists of:
+     - An atomic bit array, where bit i is set if an ACK is expected from node i.
+     - An atomic state word, which packs the epoch of the wait-for (incremented by each begin()), its status, and the countdown of the expected ACKs.
+
+     An ACK is accepted if the wait-for is active, its type is the expected type, and its bit is set. Its bit is cleared, then the countdown is decremented with a compare-and-swap which requires the epoch to be unchanged: an ACK checked against a previous wait-for is therefore rejected (as stale) and its bit is restored.
+     Because a new wait-for can only begin after the previous one has finished, a stale ACK can only claim a bit set by the new wait-for, which is detected by re-reading the epoch right after claiming the bit.
+     The result of acknowledge() tells the caller whether the wait-for has just completed or failed, so that the GC is only woken up in these cases.
+
+     Only the GC thread may call begin(), expect() (except as noted), reset(), resize() and clearPending().
+     */
+    class AckTracker {
+    public:
+        /** Status of the wait-for. */
+        enum Status {
+            WAITFOR_NONE = 0,   ///< Inactive
+            WAITFOR_ACTIVE,     ///< Going on
+            WAITFOR_ERROR,      ///< Error
+            WAITFOR_DONE        ///< All ACKs received
+        };
+
+        /** Result of acknowledge(). */
+        enum Result {
+            ACCEPTED,       ///< ACK accepted, more ACKs are expected
+            COMPLETED,      ///< ACK accepted and it was the last one: the wait-for is WAITFOR_DONE
+            FAILED,         ///< ACK rejected by the caller's check: the wait-for is in WAITFOR_ERROR
+            IGNORED,        ///< The wait-for is in WAITFOR_ERROR, so the ACK is ignored
+            UNEXPECTED,     ///< No active wait-for or the ACK type is not expected
+            DUPLICATE,      ///< ACK from a node which is not expected (or already acknowledged)
+            STALE           ///< The wait-for was restarted while the ACK was being registered
+        };
+
+        AckTracker(): m_state(0), m_type(0) { }
+
+        /** \brief Resize the tracker for a given number of nodes, and reset it (no wait-for). Not thread safe. */
+        void resize(std::size_t numNodes);
+
+        /** \brief Clear all pending bits, e.g. after an error, keeping the status. */
+        void clearPending();
+
+        /** \brief Start a new wait-for (with a new epoch) for ACKs of a given type, with no expected ACKs yet.
+         The nodes from which ACKs are expected must be added with expect() before sending messages to them.
+         */
+        void begin(int type) {
+            m_type.store(type, std::memory_order_relaxed);
+            auto s = m_state.load(std::memory_order_relaxed);
+            m_state.store(pack(epochOf(s) + 1, WAITFOR_ACTIVE, 0), std::memory_order_release);
+        }
+
+        /** \brief Add a node from which an ACK is expected in the active wait-for.
+         Besides the GC, this can be called by the thread that is registering an ACK, from the callback of acknowledge(), because the countdown can't reach zero then.
+         \return false if the node is already expected.
+         */
+        bool expect(int id) {
+            auto mask = bitMask(id);
+            if (m_bits[id / BITS_PER_WORD].fetch_or(mask, std::memory_order_release) & mask) {
+                return false;
+            }
+            m_state.fetch_add(1, std::memory_order_release);
+            return true;
+        }
+
+        /** \brief Expect ACKs from all nodes in the active wait-for, which must have no expected ACKs yet. */
+        void expectAll();
+
+        /** \brief Finish the current wait-for with a given status (WAITFOR_NONE, WAITFOR_ERROR or WAITFOR_DONE), keeping its epoch. Thread safe.
+         \return true if the status was changed from WAITFOR_ACTIVE by this call.
+         */
+        bool finish(Status st) {
+            auto s = m_state.load(std::memory_order_acquire);
+            while (statusOf(s) == WAITFOR_ACTIVE) {
+                if (m_state.compare_exchange_weak(s, pack(epochOf(s), st, countOf(s)), std::memory_order_acq_rel)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /** \brief Make the wait-for inactive (WAITFOR_NONE), whatever its status, keeping its epoch. */
+        void reset() {
+            auto s = m_state.load(std::memory_order_relaxed);
+            m_state.store(pack(epochOf(s), WAITFOR_NONE, 0), std::memory_order_release);
+        }
+
+        /** \brief Register an ACK from a node. Thread safe, lock free.
+         \param id ID of the node.
+         \param type Type of the ACK message.
+         \param check Callable returning bool, called after the ACK has been accepted and before the countdown is decremented (so the wait-for can't complete in the meantime); if it returns false, the wait-for fails with WAITFOR_ERROR.
+         \return The result of the registration, see Result.
+         */
+        template <typename F>
+        Result acknowledge(int id, int type, F check) {
+            auto s = m_state.load(std::memory_order_acquire);
+            switch (statusOf(s)) {
+                case WAITFOR_ACTIVE: break;
+                case WAITFOR_ERROR: return IGNORED;
+                default: return UNEXPECTED;
+            }
+            if (m_type.load(std::memory_order_relaxed) != type) {
+                return UNEXPECTED;
+            }
+            if (id < 0 || static_cast<std::size_t>(id) >= m_size) {
+                return DUPLICATE;
+            }
+
+            // Claim the node's bit
+            auto mask = bitMask(id);
+            auto& word = m_bits[id / BITS_PER_WORD];
+            if (!(word.fetch_and(~mask, std::memory_order_acq_rel) & mask)) {
+                return DUPLICATE;
+            }
+            if (epochOf(m_state.load(std::memory_order_acquire)) != epochOf(s)) {
+                // The bit was set by a new wait-for, which started after we checked the state -> restore it
+                word.fetch_or(mask, std::memory_order_relaxed);
+                return STALE;
+            }
+
+            if (!check()) {
+                return finish(WAITFOR_ERROR)?FAILED:IGNORED;
+            }
+
+            // Count down, only in the same epoch
+            while (true) {
+                auto cur = m_state.load(std::memory_order_acquire);
+                if (epochOf(cur) != epochOf(s)) {
+                    // The bit we cleared belongs to a new wait-for -> restore it
+                    word.fetch_or(mask, std::memory_order_relaxed);
+                    return STALE;
+                }
+                if (statusOf(cur) != WAITFOR_ACTIVE) {
+                    return IGNORED;
+                }
+                auto n = countOf(cur) - 1;
+                if (m_state.compare_exchange_weak(cur, pack(epochOf(cur), (n == 0)?WAITFOR_DONE:WAITFOR_ACTIVE, n), std::memory_order_acq_rel)) {
+                    return (n == 0)?COMPLETED:ACCEPTED;
+                }
+            }
+        }
+
+        /** \brief Register an ACK from a node, without any check. \see acknowledge(int, int, F) */
+        Result acknowledge(int id, int type) {
+            return acknowledge(id, type, []() { return true; });
+        }
+
+        /** \brief Status of the current wait-for. Thread safe. */
+        Status status() const {
+            return statusOf(m_state.load(std::memory_order_acquire));
+        }
+
+        /** \brief Whether the current wait-for is active. Thread safe. */
+        bool active() const { return status() == WAITFOR_ACTIVE; }
+
+        /** \brief Whether the current wait-for has finished, successfully or not. Thread safe. */
+        bool finished() const {
+            auto st = status();
+            return st == WAITFOR_DONE || st == WAITFOR_ERROR;
+        }
+
+        /** \brief Whether an ACK is still expected from a node in the current wait-for. Thread safe. */
+        bool isExpected(int id) const {
+            return id >= 0 && static_cast<std::size_t>(id) < m_size &&
+            (m_bits[id / BITS_PER_WORD].load(std::memory_order_acquire) & bitMask(id));
+        }
+
+        /** \brief Number of ACKs still expected. Thread safe. */
+        std::size_t remaining() const { return countOf(m_state.load(std::memory_order_acquire)); }
+
+        /** \brief The expected ACK type. */
+        int type() const { return m_type.load(std::memory_order_relaxed); }
+
+    private:
+        typedef std::uint64_t word_t;
+        static const std::size_t BITS_PER_WORD = 64;
+
+        static word_t bitMask(int id) { return word_t(1) << (id % BITS_PER_WORD); }
+
+        // State word: epoch (bits 34-63) | status (bits 32-33) | countdown (bits 0-31)
+        static std::uint64_t pack(std::uint64_t epoch, Status st, std::uint64_t count) {
+            return (epoch << 34) | (std::uint64_t(st) << 32) | (count & 0xFFFFFFFFu);
+        }
+        static std::uint64_t epochOf(std::uint64_t s) { return s >> 34; }
+        static Status statusOf(std::uint64_t s) { return static_cast<Status>((s >> 32) & 3); }
+        static std::uint64_t countOf(std::uint64_t s) { return s & 0xFFFFFFFFu; }
+
+        std::unique_ptr< std::atomic<word_t>[] > m_bits;    ///< Bit i is set if an ACK is expected from node i
+        std::size_t m_size = 0;                             ///< Number of nodes
+        std::atomic<std::uint64_t> m_state;                 ///< Packed state, see pack()
+        std::atomic<int> m_type;                            ///< Expected ACK type
+    };
+}
+
+#endif /* OBNSIM_ACKTRACKER_H */
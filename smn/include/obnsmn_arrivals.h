@@ -0,0 +1,63 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Registry of the nodes that have arrived (gone online), notified by the communication threads.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#ifndef OBNSIM_ARRIVALS_H
+#define OBNSIM_ARRIVALS_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_set>
+#include <mutex>
+#include <condition_variable>
+
+namespace OBNsmn {
+    /** \brief Registry of the nodes that are online, by name.
+     
+     A communication thread notifies the registry when a node arrives (e.g. an MQTT announcement, a connection to the socket server) or departs.
+     Any thread can wait for a set of nodes to arrive: it is woken up as soon as the last of them arrives, instead of polling the nodes.
+     Each arrival is matched against the sets of the waiting threads in constant time.
+     All methods are thread safe.
+     */
+    class ArrivalRegistry {
+    public:
+        /** \brief Register the arrival of a node, and wake up the threads waiting for it as their last node. */
+        void arrive(const std::string& name);
+        
+        /** \brief Register the departure of a node. */
+        void depart(const std::string& name);
+        
+        /** \brief Check if a node is online. */
+        bool isOnline(const std::string& name) const;
+        
+        /** \brief Forget all online nodes. */
+        void clear();
+        
+        /** \brief Wait until all given nodes are online.
+         \param names The names of the nodes.
+         \param timeout The timeout in seconds; if it's not positive, wait forever.
+         \return The names of the nodes that are still not online (empty if all nodes are online).
+         */
+        std::vector<std::string> waitForAll(const std::vector<std::string>& names, double timeout);
+        
+    private:
+        /** A thread waiting for nodes. */
+        struct Waiter {
+            std::unordered_set<std::string> missing;    ///< The nodes not yet online
+        };
+        
+        std::unordered_set<std::string> m_online;
+        std::list<Waiter*> m_waiters;
+        mutable std::mutex m_mutex;     ///< Protects m_online, m_waiters and the waiters' missing sets
+        std::condition_variable m_cond;
+    };
+}
+
+#endif /* OBNSIM_ARRIVALS_H */
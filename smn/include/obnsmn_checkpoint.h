@@ -0,0 +1,94 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Checkpoint files of a simulation, written and read by the GC.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#ifndef OBNSIM_CHECKPOINT_H
+#define OBNSIM_CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+
+#include <obnsmn_basic.h>
+
+namespace OBNsmn {
+    /** \brief The state of a node in a checkpoint: its update schedule in the GC, and its own state saved by the node.
+     */
+    struct CheckpointNode {
+        std::string name;                   ///< The node's name, to check that the resumed system has the same nodes
+
+        /** An update type: period, mask and next update time (see OBNNode::UpdateType). */
+        struct UpdateType {
+            simtime_t period;
+            updatemask_t mask;
+            simtime_t next_update;
+        };
+        std::vector<UpdateType> update_types;
+
+        simtime_t next_regupdate_time = -1;                 ///< The next regular update time
+        updatemask_t next_regupdate_mask = 0;               ///< The mask of the next regular update
+        std::map<simtime_t, updatemask_t> irreg_updates;    ///< The requested irregular updates
+
+        std::string state;                  ///< The state serialized by the node (Data.B of its SIM_SAVE_ACK)
+    };
+
+    /** \brief Writer of a checkpoint file.
+
+     A checkpoint file is a compact binary file: a header (magic string, time unit, simulation time, number of nodes), then one record per node, in the order of their IDs.
+     All integers are 64-bit little-endian; strings and lists are preceded by their lengths.
+     The records are written one at a time, so the states of the nodes need not be all in memory.
+     */
+    class CheckpointWriter {
+    public:
+        /** \brief Create the file and write the header. */
+        bool open(const std::string& file, simtime_t timeUnit, simtime_t simTime, std::size_t numNodes);
+
+        /** \brief Write the record of the next node. */
+        bool write(const CheckpointNode& node);
+
+        /** \brief Finish the file. \return false if any record could not be written, or fewer records than announced have been written. */
+        bool close();
+
+    private:
+        std::ofstream m_file;
+        std::size_t m_remaining = 0;    ///< Number of records still to be written
+
+        void writeInt(int64_t v);
+        void writeString(const std::string& s);
+    };
+
+    /** \brief Streaming reader of a checkpoint file written by CheckpointWriter.
+
+     The header is read by open(), then the node records are read one at a time by next(), so that the GC can send the state of each node while reading the next one.
+     */
+    class CheckpointReader {
+    public:
+        /** \brief Open the file and read its header. \return false if the file can't be read or is not a checkpoint file. */
+        bool open(const std::string& file);
+
+        simtime_t timeUnit() const { return m_time_unit; }      ///< The simulation time unit of the checkpoint
+        simtime_t simTime() const { return m_sim_time; }        ///< The simulation time of the checkpoint
+        std::size_t numNodes() const { return m_num_nodes; }    ///< The number of node records
+
+        /** \brief Read the next node record, replacing the content of node. \return false if there are no more records or the file is corrupted. */
+        bool next(CheckpointNode& node);
+
+    private:
+        std::ifstream m_file;
+        simtime_t m_time_unit = 0, m_sim_time = -1;
+        std::size_t m_num_nodes = 0, m_remaining = 0;
+
+        bool readInt(int64_t& v);
+        bool readString(std::string& s);
+    };
+}
+
+#endif /* OBNSIM_CHECKPOINT_H */
@@ -23,12 +23,13 @@
 #include <condition_variable>
 #include <atomic>
 #include <unordered_set>
+#include <unordered_map>
 
-#include <regex>    // For checking topic names
 
 #include <obnsmn_node.h>
 #include <obnsmn_report.h>
 #include <obnsmn_gc.h>
+#include <obnsmn_arrivals.h>
 
 #include "MQTTAsync.h"
 
@@ -52,6 +53,8 @@ namespace OBNsmn {
             
             std::atomic_int m_msgout_count{0};      ///< Keep track of the current number of out messages
             
+            int m_seq_qos = QOS;    ///< The QOS of messages with sequence numbers, see setSeqQoS()
+            
             // The result variable, mutex and condition variable is used by MQTT callbacks to notify the main execution.
             bool m_notify_done;
             int m_notify_result;    // Result of the action, typically 0 means success
@@ -79,12 +82,24 @@ namespace OBNsmn {
             /** The N2SMN message used for receiving data from GC port. */
             OBNSimMsg::N2SMN m_n2smn_msg;
             
-            /** List of nodes that have announced their availability. */
-            std::unordered_set<std::string> m_online_nodes;
-            std::string m_online_nodes_topic;
+            /** Registry of the nodes that have announced their availability, by their full names "workspace/node". */
+            ArrivalRegistry m_arrivals;
+            std::unordered_set<std::string> m_online_nodes_topics;  ///< The arrival topics of the workspaces listening for arrivals, without the last level "+"
             bool m_listening_for_arrivals{false};
-            std::mutex m_online_nodes_mutex;
-            static std::regex online_nodes_topic_regex;
+            std::mutex m_online_nodes_mutex;    ///< Protects m_online_nodes_topics
+            
+            /** The GC topics of other workspaces sharing this client, and their GCs (see addWorkspace()). */
+            std::unordered_map<std::string, GCThread*> m_workspaces;
+            std::mutex m_workspaces_mutex;
+            
+            /** Serializes the requests which wait for the broker's answers (subscriptions), as they share the notification variables. */
+            std::mutex m_request_mutex;
+            
+            /** Subscribe to a topic and wait for the result. */
+            bool subscribeAndWait(const std::string& t_topic);
+            
+            /** Unsubscribe from a topic (without waiting). */
+            void unsubscribe(const std::string& t_topic);
             
             friend class OBNNodeMQTT;
             
@@ -120,9 +135,24 @@ namespace OBNsmn {
             
             /** \brief Send a raw message to a given topic.
              \param retained If this message should be retained on the broker.
+             \param qos The QOS of the message; if negative, the QOS of the main connection is used.
              \return The return code of MQTT's sendMessage().
              */
-            int sendMessage(char* msg, std::size_t msglen, const std::string& topic, int retained = 0);
+            int sendMessage(char* msg, std::size_t msglen, const std::string& topic, int retained = 0, int qos = -1);
+            
+            /** \brief Set the QOS (0, 1 or 2) of the messages to nodes which have sequence numbers.
+             The GC retransmits these messages if their ACKs don't arrive in time (see GCThread::ack_retries), and the nodes discard duplicates, so a lower QOS than the default (2) can be used to save round trips with the broker.
+             Other messages (e.g. SIM_TERM, system messages) always use the default QOS.
+             */
+            void setSeqQoS(int qos) {
+                assert(qos >= 0 && qos <= 2);
+                m_seq_qos = qos;
+            }
+            
+            /** The QOS of the messages to nodes which have sequence numbers. */
+            int seqQoS() const {
+                return m_seq_qos;
+            }
             
             /** Set the port's name. */
             void setPortName(const std::string &t_port) {
@@ -167,16 +197,40 @@ namespace OBNsmn {
             }
             
             /** Start waiting for nodes to announce their arrivals.
+             Several workspaces sharing this client can listen at the same time.
              \param t_workspace The workspace name; either "" (default) or of the form "workspace/" (note the / at the end)
              */
             bool startListeningForArrivals(const std::string& t_workspace);
             
-            /** Stop waiting for nodes to announce their arrivals. */
-            void stopListeningForArrivals();
+            /** Stop waiting for nodes of a given workspace to announce their arrivals.
+             \param t_workspace The workspace name, as given to startListeningForArrivals().
+             */
+            void stopListeningForArrivals(const std::string& t_workspace);
             
-            /** Check if a given node has announced its arrival. */
+            /** Check if a given node has announced its arrival.
+             \param name The full name of the node, i.e. "workspace/node", or only the node's name in the default workspace.
+             */
             bool checkNodeOnline(const std::string& name);
             
+            /** The registry of the nodes that have announced their arrivals, by their full names (see checkNodeOnline()), to wait for nodes to arrive. */
+            ArrivalRegistry& arrivals() {
+                return m_arrivals;
+            }
+            
+            /** \brief Route the GC topic of another workspace to its own GC.
+             
+             Several simulations (workspaces) in the same SMN process can share this client, hence its connection to the broker.
+             The messages on the GC topic of such a workspace are pushed to the workspace's GC, instead of the GC of this client,
+             and the system port of that GC sends to its topic. The client must be running.
+             \param t_topic The GC topic of the workspace, typically of the form "workspace/_smn_/_gc_".
+             \param t_gc The GC of the workspace; it must be valid until removeWorkspace() is called.
+             \return True if successful; false if the topic is already used or the subscription failed.
+             */
+            bool addWorkspace(const std::string& t_topic, GCThread* t_gc);
+            
+            /** Stop routing the GC topic of a workspace (see addWorkspace()). */
+            void removeWorkspace(const std::string& t_topic);
+            
             /** Clear the list of online nodes. */
             void clearListOfOnlineNodes();
             
@@ -233,8 +287,12 @@ namespace OBNsmn {
             
             /** Connection is permanently lost. Need to stop!!! */
             void onPermanentConnectionLost() {
-                // Notify the GC that a critical error has happened
+                // Notify the GCs that a critical error has happened
                 pGC->criticalErrorExit();
+                std::lock_guard<std::mutex> mylock(m_workspaces_mutex);
+                for (const auto& ws: m_workspaces) {
+                    ws.second->criticalErrorExit();
+                }
             }
             
             /** Called when the disconnection with the server is successful. */
@@ -242,6 +300,31 @@ namespace OBNsmn {
         };
         
         
+        /** Group of MQTT nodes which subscribe to a common topic (see OBNNodeGroup). */
+        class OBNNodeGroupMQTT: public OBNNodeGroup {
+        public:
+            /** \brief Construct a group with a given topic.
+             \param t_topic The topic of the group, typically of the form "workspace_name/_smn_/_all_".
+             \param t_client Pointer to the MQTTClient.
+             */
+            OBNNodeGroupMQTT(const std::string &t_topic, MQTTClient* t_client): m_topic(t_topic), m_client(t_client)
+            {
+                assert(t_client);
+                assert(!t_topic.empty());
+            }
+            
+            /** \brief Asynchronously send a serialized message to all member nodes. */
+            virtual bool sendFrame(const SMN2NFrame &frame) override;
+            
+        private:
+            /** The MQTT topic of the group. */
+            std::string m_topic;
+            
+            /** \brief MQTTClient object with which this group is associated. */
+            MQTTClient *m_client;
+        };
+        
+        
         /** Node implementation using MQTT for communication. */
         class OBNNodeMQTT: public OBNNode {
         public:
@@ -274,6 +357,9 @@ namespace OBNsmn {
             /** \brief Asynchronously send a message to a node. */
             virtual bool sendMessage(int nodeID, OBNSimMsg::SMN2N &msg) override;
             
+            /** \brief Asynchronously send a serialized message to a node. */
+            virtual bool sendFrame(int nodeID, const SMN2NFrame &frame) override;
+            
             /* \brief Synchronously send a message to a node.  */
             // virtual bool sendMessageSync(int nodeID, OBNSimMsg::SMN2N &msg);
             
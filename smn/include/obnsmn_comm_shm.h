@@ -0,0 +1,149 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Shared-memory communication interface.
+ *
+ * Implement the communication interface with the nodes running on the same host as the SMN, through rings in shared memory (see obnsim_shm.h).
+ * The SMN reads the N2SMN messages of all nodes from its own segment, whose name is derived from the SMN's GC port (e.g. "workspace/_smn_/_gc_").
+ * It writes the SMN2N messages to the segment of each node, whose name is derived from the node's GC port (e.g. "workspace/node/_gc_").
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#ifndef OBNSIM_COMM_SHM_H
+#define OBNSIM_COMM_SHM_H
+
+#ifndef OBNSIM_COMM_SHM
+#error To use this library the program must be compiled with shared-memory support.
+#endif
+
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+
+#include <obnsim_basic.h>
+#include <obnsim_shm.h>
+#include <obnsmn_node.h>
+#include <obnsmn_report.h>
+#include <obnsmn_gc.h>
+
+
+namespace OBNsmn {
+    namespace SHM {
+
+        /** \brief The object that manages all shared-memory communications (i.e. the shared-memory communication thread).
+
+         The thread sleeps until a node writes to the SMN's ring, then pushes the messages to the GC.
+         Messages are written to the nodes' rings directly by the GC thread.
+         */
+        class ShmServer {
+        public:
+            /**
+             Construct the shared-memory server object, associated with a given GC.
+             \param _gc Pointer to a valid GC thread, with which this thread is associated.
+             */
+            ShmServer(GCThread* _gc): pGC(_gc) { }
+
+            ~ShmServer() {
+                // Shutdown thread, remove the segment
+                stop();
+            }
+
+            bool isRunning() const {
+                return m_running;
+            }
+
+            /** Set the name of the SMN's GC port, e.g. "workspace/_smn_/_gc_", from which the name of its segment is derived. */
+            void setPortName(const std::string& name) {
+                assert(!name.empty());
+                m_port_name = name;
+            }
+
+            const std::string& portName() const {
+                return m_port_name;
+            }
+
+            /** Set the size of the SMN's ring, in bytes. */
+            void setCapacity(std::size_t capacity) {
+                m_capacity = capacity;
+            }
+
+            /** \brief Create the SMN's segment and start the communication thread.
+             \return True if successful; false otherwise.
+             */
+            bool start();
+
+            /** Stop the communication thread and remove the SMN's segment. */
+            void stop();
+
+            /** \brief Check if a node is online, given the name of its GC port.
+             The node's segment is (re)opened if necessary, so this must not be called while the GC is running.
+             */
+            bool checkNodeOnline(const std::string& portName);
+
+            /** \brief Get the segment of a node, given the name of its GC port.
+             The segment is opened by checkNodeOnline().
+             */
+            std::shared_ptr<OBNsim::Shm::Segment> getSegment(const std::string& portName);
+
+        private:
+            /** The GC object with which this communication thread is associated. */
+            GCThread *pGC;
+
+            std::string m_port_name;
+            std::size_t m_capacity = 4*OBNsim::Shm::DEFAULT_CAPACITY;
+
+            /** The SMN's segment, from which the thread reads. */
+            OBNsim::Shm::Segment m_segment;
+
+            std::thread m_thread;
+            std::atomic_bool m_running{false};
+
+            /** The segments of the nodes, by name of GC port. */
+            std::unordered_map<std::string, std::shared_ptr<OBNsim::Shm::Segment> > m_nodes;
+            std::mutex m_nodes_mutex;
+
+            /** The N2SMN message used for receiving data from the nodes. */
+            OBNSimMsg::N2SMN m_n2smn_msg;
+
+            /** The main function of the communication thread. */
+            void threadMain();
+        };
+
+
+        /** Node implementation using shared memory for communication. */
+        class OBNNodeShm: public OBNNode {
+        public:
+
+            /** \brief Construct a shared-memory node.
+
+             \param _name The name of the node.
+             \param t_nUpdates The number of computating tasks/update types.
+             \param t_portName The name of the GC port of this node, typically of the form "workspace_name/node_name/_gc_", from which the name of its segment is derived.
+             \param t_server Pointer to the ShmServer.
+             */
+            OBNNodeShm(const std::string& _name, int t_nUpdates, const std::string &t_portName, ShmServer* t_server):
+            OBNNode(_name, t_nUpdates), m_segment(t_server->getSegment(t_portName))
+            {
+                assert(!t_portName.empty());
+            }
+
+            /** \brief Send a message to a node (without waiting for it to be received). */
+            virtual bool sendMessage(int nodeID, OBNSimMsg::SMN2N &msg) override;
+
+            /** \brief Send a serialized message to a node. */
+            virtual bool sendFrame(int nodeID, const SMN2NFrame &frame) override;
+
+        private:
+            /** The node's segment. */
+            std::shared_ptr<OBNsim::Shm::Segment> m_segment;
+        };
+    }
+}
+
+#endif // OBNSIM_COMM_SHM_H
@@ -0,0 +1,203 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Socket communication interface.
+ *
+ * Implement the communication interface with the nodes over TCP or Unix-domain sockets, without a broker.
+ * The SMN listens on a socket, to which the nodes connect.
+ * The first frame sent by a node on its connection is the name of its GC port (e.g. "workspace/node/_gc_"), which associates the connection with the node.
+ * The following frames are N2SMN messages from the node and SMN2N messages to the node (see obnsim_socket.h for the framing).
+ * Several nodes hosted in one process (see OBNnode::NodeHost) can share a connection: the first frame is then the list of their GC port names, each one terminated by '\0',
+ * and each SMN2N frame starts with the index of its node in that list (a tag, see OBNsim::Socket::FrameWriter); the N2SMN messages are identified by their ID fields as usual.
+ * The messages of a wave to the nodes sharing a connection are bundled (see OBNNode::beginBundle()), i.e. sent in one write; the host likewise sends the ACKs of a bundle together.
+ * Only the SMN's control traffic uses the sockets; the nodes' data ports use their own communication protocol (e.g. MQTT).
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#ifndef OBNSIM_COMM_SOCKET_H
+#define OBNSIM_COMM_SOCKET_H
+
+#ifndef OBNSIM_COMM_SOCKET
+#error To use this library the program must be compiled with socket support.
+#endif
+
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+
+#include <obnsim_basic.h>
+#include <obnsim_socket.h>
+#include <obnsmn_node.h>
+#include <obnsmn_report.h>
+#include <obnsmn_gc.h>
+#include <obnsmn_arrivals.h>
+
+
+namespace OBNsmn {
+    namespace SOCKET {
+
+        /** \brief The object that manages all socket communications (i.e. the socket communication thread).
+
+         The thread waits on the listening socket and the nodes' connections (with epoll on Linux, poll elsewhere), accepts new connections and pushes the nodes' messages to the GC.
+         Messages are sent to the nodes directly by the GC thread, through the channels of the nodes.
+         */
+        class SocketServer {
+        public:
+            /**
+             Construct the socket server object, associated with a given GC.
+             \param _gc Pointer to a valid GC thread, with which this thread is associated.
+             */
+            SocketServer(GCThread* _gc): pGC(_gc) { }
+
+            ~SocketServer() {
+                // Close all connections, shutdown thread
+                stop();
+            }
+
+            bool isRunning() const {
+                return m_running;
+            }
+
+            /** Set the address to listen on, see OBNsim::Socket::listenOn(). */
+            void setAddress(const std::string& addr) {
+                assert(!addr.empty());
+                m_address = addr;
+            }
+
+            /** The address to listen on. */
+            const std::string& address() const {
+                return m_address;
+            }
+
+            /** \brief Start listening and the communication thread.
+             \return True if successful; false otherwise.
+             */
+            bool start();
+
+            /** Stop the communication thread and close all connections. */
+            void stop();
+
+            /** Check if a node has connected, given the name of its GC port. */
+            bool checkNodeOnline(const std::string& portName);
+
+            /** The registry of the connected nodes, by name of GC port, to wait for nodes to connect. */
+            ArrivalRegistry& arrivals() {
+                return m_arrivals;
+            }
+
+            /** \brief Get the channel to send frames to a node, given the name of its GC port.
+             The channel is attached to the node's connection when the node connects (and detached when it disconnects).
+             */
+            std::shared_ptr<OBNsim::Socket::FrameWriter> getChannel(const std::string& portName);
+
+        private:
+            /** A connection from a node, or from a process hosting several nodes. */
+            struct Connection {
+                int fd;
+                OBNsim::Socket::FrameReader reader;
+                std::vector<std::string> names;     ///< Names of the nodes' GC ports, empty until the first frame has been received
+                std::shared_ptr<OBNsim::Socket::FrameWriter> shared;    ///< Writer of the connection, if it is shared by several nodes
+
+                Connection(int t_fd): fd(t_fd) { }
+
+                /** Describe the connection in error messages. */
+                std::string description() const;
+            };
+
+            /** The GC object with which this communication thread is associated. */
+            GCThread *pGC;
+
+            /** The address to listen on. */
+            std::string m_address;
+
+            int m_listen_fd = -1;
+            int m_poll_fd = -1;             ///< The epoll instance (Linux only)
+            int m_wakeup_fds[2] = {-1, -1}; ///< Pipe to wake up the thread when it must stop
+
+            std::thread m_thread;
+            std::atomic_bool m_running{false};
+
+            /** The connections, by socket; only accessed by the communication thread (or after it has stopped). */
+            std::unordered_map<int, std::unique_ptr<Connection> > m_connections;
+
+            /** The channels of the nodes, by name of GC port. */
+            std::unordered_map<std::string, std::shared_ptr<OBNsim::Socket::FrameWriter> > m_channels;
+
+            /** The nodes that are connected, by name of GC port. */
+            ArrivalRegistry m_arrivals;
+
+            std::mutex m_channels_mutex;    ///< Protects m_channels
+
+            /** The N2SMN message used for receiving data from the nodes. */
+            OBNSimMsg::N2SMN m_n2smn_msg;
+
+            /** The main function of the communication thread. */
+            void threadMain();
+
+            /** Start waiting on a socket. */
+            bool watch(int fd);
+
+            /** Accept a new connection. */
+            void acceptConnection();
+
+            /** Read and process the frames received on a connection.
+             \return false if the connection has been closed.
+             */
+            bool receiveFrames(Connection& conn);
+
+            /** Associate a connection with the node(s) whose GC port names have been received in its first frame. */
+            void registerConnection(Connection& conn, const char* data, std::size_t len);
+
+            /** Stop waiting on a connection and close it. */
+            void closeConnection(int fd);
+        };
+
+
+        /** Node implementation using a socket connection for communication. */
+        class OBNNodeSocket: public OBNNode {
+        public:
+
+            /** \brief Construct a socket node.
+
+             \param _name The name of the node.
+             \param t_nUpdates The number of computating tasks/update types.
+             \param t_portName The name of the GC port of this node, typically of the form "workspace_name/node_name/_gc_", which the node sends when it connects.
+             \param t_server Pointer to the SocketServer.
+             */
+            OBNNodeSocket(const std::string& _name, int t_nUpdates, const std::string &t_portName, SocketServer* t_server):
+            OBNNode(_name, t_nUpdates), m_channel(t_server->getChannel(t_portName))
+            {
+                assert(!t_portName.empty());
+            }
+
+            /** \brief Send a message to a node (without waiting for it to be received). */
+            virtual bool sendMessage(int nodeID, OBNSimMsg::SMN2N &msg) override;
+
+            /** \brief Send a serialized message to a node. */
+            virtual bool sendFrame(int nodeID, const SMN2NFrame &frame) override;
+
+            /** \brief Begin a bundle of messages on the node's connection, which may be shared with other nodes. */
+            virtual void beginBundle() override {
+                m_channel->beginBundle();
+            }
+
+            /** \brief End a bundle of messages on the node's connection. */
+            virtual bool endBundle() override;
+
+        private:
+            /** The channel to the node's connection. */
+            std::shared_ptr<OBNsim::Socket::FrameWriter> m_channel;
+
+            /** The buffer for sending messages. */
+            OBNsim::ResizableBuffer m_buffer;
+        };
+    }
+}
+
+#endif // OBNSIM_COMM_SOCKET_H
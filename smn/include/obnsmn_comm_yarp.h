@@ -17,6 +17,7 @@
 #error To use this library the program must be compiled with YARP support.
 #endif
 
+#include <cstring>
 #include <cassert>
 #include <memory>
 #include <thread>
@@ -65,6 +66,12 @@ namespace OBNsmn {
                 return msg.SerializeToArray(m_msgbuffer.data(), m_msgbuffer.size());
             }
             
+            /** \brief Set the contents from a serialized SMN2N message. */
+            void setFrame(const SMN2NFrame &frame) {
+                m_msgbuffer.allocateData(frame.size());
+                std::memcpy(m_msgbuffer.data(), frame.data(), frame.size());
+            }
+            
             /** \brief Get the contents of the message to a N2SMN object. */
             bool getMessage(OBNSimMsg::N2SMN &msg) const {
                 if (!m_msgbuffer.data() || m_msgbuffer.size() <= 0) {
@@ -111,6 +118,9 @@ namespace OBNsmn {
             /** \brief Asynchronously send a message to a node. */
             virtual bool sendMessage(int nodeID, OBNSimMsg::SMN2N &msg) override;
             
+            /** \brief Asynchronously send a serialized message to a node. */
+            virtual bool sendFrame(int nodeID, const SMN2NFrame &frame) override;
+            
             /* \brief Synchronously send a message to a node.  */
             // virtual bool sendMessageSync(int nodeID, OBNSimMsg::SMN2N &msg);
             
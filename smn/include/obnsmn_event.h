@@ -15,6 +15,7 @@
 
 #include <iostream>
 #include <obnsmn_basic.h>
+#include <mpscqueue.h>     // The events are linked in the GC's event queue
 #include <obnsim_msg.pb.h>
 
 namespace OBNsmn {
@@ -46,8 +47,9 @@ namespace OBNsmn {
     /** \brief The node event class
      
      This class implements the events that are sent from other nodes to the SMN (e.g. for synchronous simulation).
+     It derives from mpsc_queue_hook so that the events are linked directly in the GC's event queue.
      */
-    struct SMNNodeEvent //: public SMNEvent
+    struct SMNNodeEvent: public mpsc_queue_hook //: public SMNEvent
     {
         /** ID of the node that sent event. */
         int nodeID;
@@ -20,6 +20,7 @@
 #ifndef OBNSIM_GC_H_
 #define OBNSIM_GC_H_
 
+#include <thread>
 #include <mutex>
 #include <functional>
 #include <vector>
@@ -28,11 +29,19 @@
 #include <utility>  // pair
 #include <ctime>    // For wall-clock time
 
-#include <sharedqueue.h>    // Thread-safe shared event queue
+#include <atomic>
+#include <deque>
+#include <set>
+#include <map>
+#include <limits>
+
+#include <mpscqueue.h>      // Lock-free event queue
 #include <obnsmn_event.h>
 #include <obnsim_msg.pb.h>  // Protobuf-generated code for OBN-Sim messages
 #include <obnsmn_node.h>
 #include <obnsmn_nodegraph.h>
+#include <obnsmn_scheduler.h>
+#include <obnsmn_acktracker.h>
 #include <obnsim_msg.pb.h>
 
 
@@ -44,7 +53,7 @@ namespace OBNsmn {
     class GCThread {
     public:
         
-        GCThread(): OBNEventQueue(mWakeupCondition), rtNodeGraph(nullptr) {}
+        GCThread(): OBNEventQueue(mWakeupSignal), _SysRequest(SYSREQ_NONE), rtNodeGraph(nullptr) {}
         
         virtual ~GCThread() {
             if (_gcthread) {
@@ -91,14 +100,17 @@ namespace OBNsmn {
         
         /** \brief Set system request to GC.
          
-         Set the system request to the GC, which overrides the current system request. Thread safe.
+         Set the system request to the GC, which overrides the current system request. Thread safe and lock free.
          \param r The system request.
          */
         void setSysRequest(OBNSysRequestType r) {
-            std::unique_lock<std::mutex> mlock(mSysReq);
-            _SysRequest = r;
-            mlock.unlock();
-            mWakeupCondition.notify_one();
+            _SysRequest.store(r);
+            mWakeupSignal.notify();
+            
+            // The parallel components are controlled together
+            for (auto& comp: m_components) {
+                comp->setSysRequest(r);
+            }
         }
         
         /** \brief Return current system request.
@@ -106,8 +118,7 @@ namespace OBNsmn {
          Returns the current system request. Thread safe.
          */
         OBNSysRequestType getSysRequest() {
-            std::unique_lock<std::mutex> mlock(mSysReq);
-            return _SysRequest;
+            return _SysRequest.load();
         }
         
         /** \brief Reset the system request to NONE.
@@ -115,8 +126,7 @@ namespace OBNsmn {
          Reset the system request to NONE (i.e. no request).
          */
         void resetSysRequest() {
-            std::unique_lock<std::mutex> mlock(mSysReq);
-            _SysRequest = SYSREQ_NONE;
+            _SysRequest.store(SYSREQ_NONE);
         }
         
         
@@ -127,6 +137,103 @@ namespace OBNsmn {
          */
         int ack_timeout = 0;
         
+        /** Number of times the messages of a wait-for are retransmitted, when ack_timeout fires, before the simulation is stopped with a timeout error.
+         If it is positive (and ack_timeout is positive), the messages that start a wait-for (SIM_INIT, UPDATE_Y, UPDATE_X) carry a sequence number, which the nodes echo in their ACKs, so that messages lost by an unreliable transport (e.g. MQTT with QoS 0 or 1) can be retransmitted.
+         A node that receives the same message twice does not process it again but re-sends its ACK; ACKs with an old sequence number are ignored by the GC.
+         All nodes must support sequence numbers (e.g. nodes built with nodecpp).
+         */
+        unsigned int ack_retries = 0;
+        
+        /** Whether UPDATE_Y messages are dispatched in dataflow mode instead of in waves.
+         In dataflow mode, as soon as a node has ACKed its UPDATE_Y, the nodes depending on it are re-evaluated and those that have become independent receive their UPDATE_Y immediately, without waiting for the rest of the wave.
+         It is only used if the dependency graph supports it (see RTNodeDepGraph::supportsDataflow()); otherwise waves are used.
+         In dataflow mode, the ACK timeout applies to the whole UPDATE_Y phase of each iteration.
+         */
+        bool dataflow_dispatch = false;
+        
+        /** Whether UPDATE_Y and UPDATE_X are fused into one SIM_YX message for nodes that are sinks of the run-time graph (see RTNodeDepGraph::isSink()).
+         This saves one round trip per such node and iteration, but all nodes must support SIM_YX (e.g. nodes built with nodecpp).
+         Independently of this option, a node may declare in its SIM_Y_ACK that it does not need UPDATE_X in the current iteration (see OBNsim::YACK_NO_UPDATE_X).
+         */
+        bool fuse_update_x = false;
+        
+        /** Whether lookahead windows are granted to the nodes enabled with enableLookahead().
+         Instead of one UPDATE_Y / UPDATE_X exchange per update, such a node receives a single SIM_YW message listing all its updates up to a safe horizon, which it performs locally before ACKing.
+         The horizon is the earliest next update time of the node's consumers, so that they can't observe its outputs from the future.
+         All enabled nodes must support SIM_YW (e.g. nodes built with nodecpp).
+         */
+        bool lookahead = false;
+        
+        /** Whether the messages of a wave (SIM_INIT, UPDATE_Y, UPDATE_X) are bundled by connection (see OBNNode::beginBundle()).
+         With nodes sharing a connection (e.g. a node host over sockets), the GC then sends one transport message per connection instead of one per node in each wave.
+         It has no effect on the other nodes, nor on the protocol seen by the nodes.
+         */
+        bool bundle_messages = true;
+        
+        /** Whether the nodes are kept running when the simulation reaches its final time, for warm restarts.
+         The GC then does not send SIM_TERM to the nodes, and the communication threads keep running; the next startThread() sends SIM_INIT to the running nodes,
+         which restart (see onRestart() of the nodes), so the simulation is run again from t=0 without launching and connecting the nodes again.
+         If the simulation stops for any other reason (an error, a request to stop), the nodes are terminated as usual.
+         Call terminateNodes() after the last simulation. Warm restarts are not supported with sub-coordinators.
+         */
+        bool keep_nodes_running = false;
+        
+        /** Whether the nodes were kept running by the last simulation (see keep_nodes_running), so that the simulation can be restarted. */
+        bool nodesKeptRunning() const;
+        
+        /** \brief Terminate the nodes kept running by the last simulation (see keep_nodes_running), and signal the communication threads to stop.
+         The GC must not be running.
+         \return true if successful.
+         */
+        bool terminateNodes();
+        
+        /** Set the parameters of the simulation, sent to the nodes in SIM_INIT (as Data.B), e.g. the parameters of a warm restart.
+         Their format is agreed between the script and the nodes; they are empty by default.
+         \return true if successful.
+         */
+        bool setSimulationParameters(const std::string& params) {
+            // Only set them when the GC is not (yet) running.
+            if (_gcthread) {
+                return false;
+            }
+            sim_parameters = params;
+            for (auto& comp: m_components) {
+                comp->setSimulationParameters(params);
+            }
+            return true;
+        }
+        
+        /** Set a checkpoint of the simulation: between the last iteration at or before time t and the next one, the GC saves the state of the simulation to a file, then continues.
+         The nodes save their states on SIM_SAVE (see onSaveState() of the nodes); the GC saves them with its own state (simulation time, update schedules of the nodes) in a checkpoint file (see CheckpointWriter).
+         Checkpoints are not supported with sub-coordinators, parallel components or lookahead windows.
+         \param t The time of the checkpoint, in the time unit; negative to disable the checkpoint.
+         \param file The path of the checkpoint file.
+         \return true if successful.
+         */
+        bool setCheckpoint(simtime_t t, const std::string& file) {
+            // Only set it when the GC is not (yet) running.
+            if (_gcthread || !m_components.empty() || (t >= 0 && file.empty())) {
+                return false;
+            }
+            checkpoint_time = t;
+            checkpoint_file = file;
+            return true;
+        }
+        
+        /** Set the checkpoint file from which the next simulation resumes, empty to start from t=0.
+         After SIM_INIT, the GC restores its state from the file and sends each node its saved state (SIM_LOAD, see onLoadState() of the nodes); the simulation then continues from the time of the checkpoint.
+         The system must have the same nodes, with the same IDs, as the system that saved the checkpoint.
+         \return true if successful.
+         */
+        bool setResumeFile(const std::string& file) {
+            // Only set it when the GC is not (yet) running.
+            if (_gcthread || !m_components.empty()) {
+                return false;
+            }
+            resume_file = file;
+            return true;
+        }
+        
         /** Set the simulation time unit.
          \param T The simulation time unit, in number of microseconds.
          \return true if successful.
@@ -135,6 +242,9 @@ namespace OBNsmn {
             // Only set it when the GC is not (yet) running.
             if ((T > 0) && (!_gcthread)) {
                 sim_time_unit = T;
+                for (auto& comp: m_components) {
+                    comp->setSimulationTimeUnit(T);
+                }
                 return true;
             }
             
@@ -148,6 +258,9 @@ namespace OBNsmn {
             // Only set final time when the GC is not (yet) running.
             if ((T > 0) && (!_gcthread)) {
                 final_sim_time = T;
+                for (auto& comp: m_components) {
+                    comp->setFinalSimulationTime(T);
+                }
                 return true;
             }
             
@@ -162,12 +275,25 @@ namespace OBNsmn {
             // Only set the time when the GC is not (yet) running.
             if (!_gcthread) {
                 initial_wallclock = T;
+                for (auto& comp: m_components) {
+                    comp->setInitialWallclock(T);
+                }
                 return true;
             }
             
             return false;
         }
         
+        /** The current simulation time, in the time unit of the simulation; once the GC has stopped, the time at which the simulation stopped. */
+        simtime_t currentSimulationTime() const {
+            return current_sim_time;
+        }
+        
+        /** The simulation time unit, in number of microseconds. */
+        simtime_t simulationTimeUnit() const {
+            return sim_time_unit;
+        }
+        
         
         ///@{
         /** Set the node dependency graph.
@@ -208,6 +334,128 @@ namespace OBNsmn {
         /** Return number of nodes in the node list. */
         int numberOfNodes() const { return _nodes.size(); }
         
+        /** Enable lookahead windows for a node (see lookahead).
+         The node must not receive any input from other nodes (through any port), and its update types must not depend on each other; this is not checked.
+         Its consumers are the nodes that receive messages from its ports.
+         A node running a window can't request irregular updates before the end of the window.
+         \param id ID of the node.
+         \param consumers IDs of the consumers of the node.
+         \return true if successful.
+         */
+        bool enableLookahead(std::size_t id, const std::vector<int>& consumers) {
+            if (!_gcthread && id < _nodes.size()) {
+                if (m_lookahead_consumers.size() <= id) {
+                    m_lookahead_consumers.resize(id+1);
+                }
+                m_lookahead_consumers[id].reset(new std::vector<int>(consumers));
+                return true;
+            }
+            return false;
+        }
+        
+        /** \brief Add a group of nodes which receive the same message with a single send. */
+        bool addNodeGroup(OBNNodeGroup* group, const std::vector<int>& members);
+        
+        /** Set the group of all nodes, to which the messages to all nodes (except SIM_INIT) are sent once.
+         It can only be set when the GC is not running; the GC takes ownership of the group object.
+         \return true if successful.
+         */
+        bool setBroadcastGroup(OBNNodeGroup* group) {
+            if (!_gcthread) {
+                m_broadcast_group.reset(group);
+                return true;
+            }
+            return false;
+        }
+        
+        // ========== Sub-coordinators ============
+        
+        typedef std::function<void (const OBNSimMsg::N2SMN&)> TSendMsgToParentFunc;   ///< A function type to send an N2SMN message from a sub-coordinator to its parent GC
+        
+        /** \brief Make this GC a sub-coordinator, which runs a partition of the nodes under the commands of a parent GC.
+         
+         A sub-coordinator appears to its parent as a single node (see OBNNodePartition), which speaks the node protocol:
+         it receives SIM_INIT, SIM_Y, SIM_YX, SIM_X and SIM_TERM from postParentCommand(), and sends its ACKs and requests with the given function.
+         On SIM_Y at time t, it updates its nodes scheduled at t in the order of its own dependency graph, so the dependencies inside the partition are resolved locally, then it sends one SIM_Y_ACK; likewise for SIM_X.
+         If the partition has gates (see setPartitionGates()), the parent may send several SIM_Y at time t, each opening some gates: each runs the updates which no longer wait for a closed gate.
+         It requests each of its next update times from the parent as an irregular update (SIM_EVENT), with the gates of the updates at that time, before acknowledging the iteration.
+         The final simulation time, the time unit and the initial wall-clock time are those of the parent.
+         It can only be set when the GC is not running.
+         \return true if successful.
+         */
+        bool setParent(TSendMsgToParentFunc f) {
+            if (!_gcthread && f) {
+                m_send_msg_to_parent = f;
+                final_sim_time = std::numeric_limits<simtime_t>::max();
+                return true;
+            }
+            return false;
+        }
+        
+        /** \brief Set the gates of the partition run by this sub-coordinator (see NodeDepGraph_Partitioned::partitionGates()).
+         It can only be set when the GC is not running.
+         \return true if successful.
+         */
+        bool setPartitionGates(const PartitionGates& gates) {
+            if (!_gcthread) {
+                gc_parent_gates = gates;
+                return true;
+            }
+            return false;
+        }
+        
+        /** \brief Post a message of the parent GC to this sub-coordinator. Thread safe. */
+        void postParentCommand(const OBNSimMsg::SMN2N& msg);
+        
+        /** Number of messages posted by the parent GC to this sub-coordinator so far. */
+        std::size_t numberOfParentMessages() const { return m_parent_messages; }
+        
+        /** Set the ID of the first node of this GC in the messages to and from the nodes; the IDs of the other nodes follow.
+         The sub-coordinators of a GC use distinct ranges of IDs, above those of the GC, so that their nodes can share the GC's communication servers (see addSubCoordinator()).
+         It can only be set when the GC is not running.
+         \return true if successful.
+         */
+        bool setFirstNodeID(int id) {
+            if (!_gcthread && id >= 0) {
+                m_first_node_id = id;
+                return true;
+            }
+            return false;
+        }
+        
+        /** \brief Add a sub-coordinator, which runs a partition of the nodes, as a node of this GC.
+         
+         The GC takes ownership of the sub GC, makes it a sub-coordinator (see setParent()) and inserts its proxy node (see OBNNodePartition).
+         The messages of the communication servers of this GC from nodes whose IDs are in the range of the sub GC (see setFirstNodeID()) are forwarded to it;
+         the first IDs of the sub GCs must be increasing, and above the IDs of the nodes of this GC.
+         The sub GCs' threads are started and joined together with this GC's; they must be added when the GC is not running, before their nodes communicate.
+         \param sub The sub GC, with its nodes and dependency graph.
+         \param name Name of the proxy node.
+         \return a pair of <bool success, size_t index> where index is the ID of the proxy node.
+         */
+        std::pair<bool, std::size_t> addSubCoordinator(GCThread* sub, const std::string& name);
+        
+        /** Number of sub-coordinators of this GC. */
+        std::size_t numberOfSubCoordinators() const { return m_subs.size(); }
+        
+        
+        // ============ Parallel components =============
+        
+        /** \brief Add a GC running an independent component of the system, in parallel with the other components.
+         
+         A component has its own nodes, dependency graph, clock and final time; it exchanges no data with the other components.
+         The GC takes ownership of the component GC. A GC with components has no nodes itself: it forwards to the components the messages of its communication servers, by the IDs of their nodes (see setFirstNodeID()), and its system requests.
+         The first IDs of the components must be increasing.
+         The components' threads are started together with this GC's, whose thread waits for all of them and reports the combined results.
+         \param comp The component GC, with its nodes and dependency graph.
+         \return true if successful.
+         */
+        bool addComponent(GCThread* comp);
+        
+        /** Number of parallel components of this GC. */
+        std::size_t numberOfComponents() const { return m_components.size(); }
+        
+        
         typedef std::function<bool(const OBNSimMsg::SMN2N&)> TSendMsgToSysPortFunc;   ///< A function type to send a SMN2N message to the system port (instead of a node's port)
         
         /** Set the function to send an SMN2N message to the system port (_gc_) */
@@ -232,8 +480,21 @@ namespace OBNsmn {
         bool startThread() {
             if (_gcthread) return false;
             
-            // Initialize the simulation
-            initialize();
+            // The sub-coordinators wait for the commands of this GC
+            for (auto& sub: m_subs) {
+                sub->startThread();
+            }
+            
+            // The components run their own simulations
+            for (auto& comp: m_components) {
+                comp->keep_nodes_running = keep_nodes_running;
+                comp->startThread();
+            }
+            
+            // Initialize the simulation, unless it is run by the components
+            if (m_components.empty()) {
+                initialize();
+            }
 
             _gcthread = new std::thread(&GCThread::GCThreadMain, this);
             
@@ -253,6 +514,11 @@ namespace OBNsmn {
             // We can now safely destroy _gcthread
             delete _gcthread;
             _gcthread = nullptr;
+            
+            // The sub-coordinators were terminated by this GC
+            for (auto& sub: m_subs) {
+                sub->joinThread();
+            }
             return true;
         }
         
@@ -310,16 +576,56 @@ namespace OBNsmn {
          */
         std::pair<int, std::string> request_port_connect(std::size_t idx, const std::string& target, const std::string& source, unsigned int timeout = 5000);
         
+        /** \brief A port connection, requested by request_port_connect_batch(). */
+        struct PortConnectRequest {
+            std::size_t idx;        ///< The index of the node
+            std::string target;     ///< The name of the target/input port on the node
+            std::string source;     ///< The full path of the source/output port
+        };
+        
+        /** \brief Connect many ports at once, with one request per node.
+         
+         This method has the same effect as calling request_port_connect() for each connection, but it sends all the connections of a node in one message SMN2N:SYS_PORT_CONNECT_BATCH,
+         and the requests to all the nodes before waiting for any ACK; each ACK is matched to its request by the request ID, and contains the result of each connection.
+         So the time to connect the ports is that of the slowest node, instead of one round trip per connection.
+         
+         \param requests The connections.
+         \param timeout The timeout value in milliseconds (default: 5000 = 5s) to receive the ACKs of all the nodes.
+         \return The results of the connections, in the same order as the requests, with the same result codes as request_port_connect().
+         */
+        std::vector< std::pair<int, std::string> > request_port_connect_batch(const std::vector<PortConnectRequest>& requests, unsigned int timeout = 5000);
+        
+        /** \brief Request a node to receive the messages sent to a group of nodes.
+         
+         This method requests a given node (specified by its ID) to listen to the channel of a node group (see OBNNodeGroup), e.g. to subscribe to an MQTT topic.
+         It uses the system message SMN2N:SYS_SUBSCRIBE, and has the same requirements and error codes as request_port_connect().
+         When it returns successfully, the node has started to listen to the channel.
+         
+         \param idx The index of the node.
+         \param channel The name of the channel, specific to the communication protocol.
+         \param timeout The timeout value in milliseconds (default: 5000 = 5s).
+         \return A pair of the result of the request (int) and an error message (if available).
+         */
+        std::pair<int, std::string> request_subscribe(std::size_t idx, const std::string& channel, unsigned int timeout = 5000);
+        
     private:
+        /** \brief Send a system request to a node and wait for its ACK, for request_port_connect() and request_subscribe(). */
+        std::pair<int, std::string> gc_request_sys(std::size_t idx, OBNSimMsg::SMN2N& msg, OBNSimMsg::N2SMN::MSGTYPE acktype, unsigned int timeout);
+        
+        int64_t gc_sys_request_id = 0;  ///< The ID of the last SYS_PORT_CONNECT_BATCH request, to match the ACKs to the requests
+        
         // =========== Event queue ============
 
-        typedef shared_queue<OBNsmn::SMNNodeEvent> OBNEventQueueType;
+        event_count mWakeupSignal;  // event count for the GC thread to wait idly and be waken up (by events, system requests, ACKs); declared before the queue, which is constructed with it
+
+        typedef mpsc_queue<OBNsmn::SMNNodeEvent> OBNEventQueueType;
         /** \brief The main event queue.
          
          This is the main event queue. GC is the sole consumer which reads
          and processes the events in this queue, mainly to drive the
          simulation. Other threads (communication, main) pushes to this
          queue so that GC can process them in order.
+         The queue is lock free; GC drains it in batches into gc_event_batch.
          
          \note This shared queue contains smart pointers to objects of type SMNEvent.
          When pushing new objects, remember to dynamically create the objects, not a local scope object, e.g. using make_shared.
@@ -328,12 +634,12 @@ namespace OBNsmn {
          */
         OBNEventQueueType OBNEventQueue;
         
+        /** Events drained from OBNEventQueue but not yet processed by GC, in order. Accessed by GC only. */
+        std::deque<OBNEventQueueType::item_type> gc_event_batch;
+        
 
         // ============ Thread control =============
-        OBNSysRequestType _SysRequest;
-        mutable std::mutex mSysReq;     // mutex for thread-safe access to _SysRequest
-        
-        std::condition_variable mWakeupCondition;   // condition variable for the main thread to wait idly and be waken up
+        std::atomic<OBNSysRequestType> _SysRequest;
         
         std::thread * _gcthread = nullptr;
         
@@ -342,6 +648,27 @@ namespace OBNsmn {
         TSendMsgToSysPortFunc m_send_msg_to_sys_port;   ///< The function to send a SMN2N message to the system port (instead of a node's port)
         
         
+        // ============ Sub-coordinators =============
+        
+        TSendMsgToParentFunc m_send_msg_to_parent;  ///< The function to send a message to the parent GC, if this GC is a sub-coordinator
+        
+        int m_first_node_id = 0;    ///< The ID of the first node in the messages (see setFirstNodeID())
+        
+        /** The sub-coordinators of this GC, in increasing order of their first IDs (see addSubCoordinator()). */
+        std::vector< std::unique_ptr<GCThread> > m_subs;
+        
+        /** The parallel components of this GC, in increasing order of their first IDs (see addComponent()). */
+        std::vector< std::unique_ptr<GCThread> > m_components;
+        
+        /** Wait for the parallel components to finish, then report their combined results. */
+        void gc_run_components();
+        
+        std::mutex m_parent_mutex;      ///< Protects m_parent_commands
+        std::deque<OBNSimMsg::SMN2N> m_parent_commands;     ///< The messages of the parent not yet processed
+        std::size_t m_parent_messages = 0;                  ///< Number of messages of the parent, protected by m_parent_mutex
+        std::atomic_bool gc_parent_pending{false};          ///< Whether m_parent_commands is not empty
+        
+        
         // ============ Node management ==============
         
         /** \brief List of nodes in the network, their indices will be their IDs. */
@@ -350,6 +677,15 @@ namespace OBNsmn {
         /** Maximum valid ID of node (number of nodes - 1). */
         int maxID;
         
+        /** \brief Groups of nodes which receive the same message with a single send, see addNodeGroup(). */
+        std::vector< std::unique_ptr<OBNNodeGroup> > m_node_groups;
+        
+        /** For each node, the index of its group in m_node_groups, or -1. */
+        std::vector<int> m_node_group_of;
+        
+        /** The group of all nodes, if set (see setBroadcastGroup()). */
+        std::unique_ptr<OBNNodeGroup> m_broadcast_group;
+        
         /** \brief Graph of nodes' dependency. */
         std::unique_ptr<NodeDepGraph> _nodeGraph;
         
@@ -359,11 +695,32 @@ namespace OBNsmn {
         simtime_t sim_time_unit = 1;
         
         /** The current simulation time (not wall clock). */
-        simtime_t current_sim_time;
+        simtime_t current_sim_time = -1;
         
         /** The final simulation time. Every simulation must have a stop time. */
         simtime_t final_sim_time;
         
+        /** Whether the current simulation has reached its final time. */
+        bool gc_reached_final_time = false;
+        
+        /** Whether the nodes were kept running at the end of the last simulation (see keep_nodes_running). */
+        bool gc_nodes_kept = false;
+        
+        /** The parameters of the simulation, sent in SIM_INIT (see setSimulationParameters()). */
+        std::string sim_parameters;
+        
+        simtime_t checkpoint_time = -1;     ///< The time of the checkpoint, if non-negative (see setCheckpoint())
+        std::string checkpoint_file;        ///< The checkpoint file to be written
+        std::string resume_file;            ///< The checkpoint file to resume from (see setResumeFile())
+        bool gc_checkpoint_saved = false;   ///< Whether the checkpoint of the current simulation has been saved
+        std::vector<std::string> gc_checkpoint_states;  ///< The states of the nodes received in their SIM_SAVE_ACKs, by their IDs
+        
+        /** \brief Save the checkpoint of the simulation at the current time, between two iterations. */
+        bool gc_save_checkpoint();
+        
+        /** \brief Resume the simulation from the checkpoint in resume_file, after SIM_INIT. */
+        bool gc_resume();
+        
         /** The initial wall clock time at the start of the simulation. */
         std::time_t initial_wallclock = 0;
         
@@ -403,6 +760,41 @@ namespace OBNsmn {
         /** \brief Process system request, mostly to switch between modes. */
         void gc_process_sysreq(OBNSysRequestType req);
         
+        // ============ Sub-coordinator (see setParent()) ============
+        
+        bool gc_waiting_parent = false;     ///< Whether the GC is waiting for a message of its parent, which wakes it up
+        int32_t gc_parent_id = -1;          ///< The ID of this sub-coordinator at its parent, as received in SIM_INIT; -1 before SIM_INIT
+        int64_t gc_parent_seq = 0;          ///< Sequence number of the last command of the parent
+        OBNSimMsg::N2SMN gc_parent_ack;     ///< The last ACK sent to the parent, re-sent if the parent retransmits its command
+        bool gc_parent_update_x = false;    ///< Whether UPDATE_X of the current iteration is pending
+        std::map<simtime_t, updatemask_t> gc_parent_requested;  ///< Update times requested from the parent and not yet reached, with the requested gates
+        PartitionGates gc_parent_gates;     ///< The gates of the partition (see setPartitionGates())
+        bool gc_parent_in_step = false;     ///< Whether the UPDATE_Y of the current iteration has started and may continue with the next SIM_Y
+        updatemask_t gc_parent_open = 0;    ///< The gates open in the current iteration
+        std::vector<updatemask_t> gc_parent_left;   ///< For each node updating in the current iteration, its update types not yet run
+        NodeUpdateInfoList gc_parent_batch;         ///< The updates run for the current SIM_Y of the parent
+        int gc_parent_event_acks = 0;       ///< Number of requests (SIM_EVENT) not yet acknowledged by the parent
+        int gc_parent_stop_requester = -1;  ///< The node whose stop request was forwarded to the parent
+        
+        /** \brief The main algorithm of a sub-coordinator: run the iterations commanded by the parent until SIM_TERM. */
+        void gc_subordinate_main();
+        
+        /** \brief Wait for the next message of the parent, while processing the events of the nodes. */
+        bool gc_wait_for_parent(OBNSimMsg::SMN2N& cmd, bool untilEventAcks = false);
+        
+        /** \brief Open the given gates and run the UPDATE_Y of the updates of the current iteration which are released. */
+        bool gc_parent_run_update_y(updatemask_t gates);
+        
+        /** \brief Request the next update time of the sub-coordinator from the parent, if it has not been requested. */
+        void gc_parent_request_next();
+        
+        /** \brief Send an ACK to the parent, once all requests of next update times have been acknowledged. */
+        void gc_parent_send_ack(OBNSimMsg::N2SMN::MSGTYPE type, int64_t seq, int64_t I = 0);
+        
+        /** \brief Send a message to the parent, with the ID of this sub-coordinator. */
+        void gc_send_to_parent(OBNSimMsg::N2SMN& msg);
+        
+        
         /** \brief Method to process SIM_EVENT request. */
         inline void gc_process_msg_sim_event(OBNsmn::SMNNodeEvent* pEv);
         
@@ -412,20 +804,11 @@ namespace OBNsmn {
         
         // ============ Wait-for event for the GC algorithm =============
         
-        /** The mutex to access the wait-for part of GC. */
-        mutable std::mutex gc_waitfor_mutex;
-        
-        /** Indicate if a wait-for event is active */
-        //bool gc_waitfor_active;
-        
-        /** Bit vector to store the status of nodes' ACK for wait-for event. */
-        std::vector<bool> gc_waitfor_bits;
+        /** Tracker of the ACKs expected by the current wait-for event; ACKs are registered without locks. */
+        AckTracker gc_waitfor;
         
-        /** Number of nodes from which we are waiting for ACK = number of 0 bits in gc_waitfor_bits. */
-        int gc_waitfor_num;
-        
-        /** Type of the ACK expected for the wait-for event. */
-        OBNSimMsg::N2SMN::MSGTYPE gc_waitfor_type;
+        /** The mutex to serialize the processing of ACKs in dataflow dispatch, which changes the run-time graph and sends UPDATE_Y messages. */
+        mutable std::mutex gc_waitfor_mutex;
         
         /** Validater of ACK messages, should return true if the ACK message is good. */
         typedef std::function<bool (const OBNSimMsg::N2SMN&)> GC_WaitFor_Predicate;
@@ -433,12 +816,8 @@ namespace OBNsmn {
         /** The function to validate the ACK message, if provided. */
         GC_WaitFor_Predicate gc_waitfor_predicate;
         
-        enum {
-            GC_WAITFOR_RESULT_NONE,     // Inactive
-            GC_WAITFOR_RESULT_ACTIVE,   // Going on
-            GC_WAITFOR_RESULT_ERROR,    // Error
-            GC_WAITFOR_RESULT_DONE      // All checked
-        } gc_waitfor_status = GC_WAITFOR_RESULT_NONE;    // Result of the most recent wait-for
+        /** Whether the current wait-for is for a dataflow UPDATE_Y dispatch, in which ACKs trigger new UPDATE_Y messages. */
+        std::atomic<bool> gc_waitfor_dataflow{false};
         
         /** Start a new wait-for event.
          \param nodes List of indices of nodes expected to send ACKs. It's ASSUMED WITHOUT CHECKING that these indices are unique.
@@ -448,36 +827,86 @@ namespace OBNsmn {
          */
         template <class L>
         bool gc_waitfor_start(const L & nodes, OBNSimMsg::N2SMN::MSGTYPE type, GC_WaitFor_Predicate f = GC_WaitFor_Predicate()) {
-            std::lock_guard<std::mutex> lock(gc_waitfor_mutex);
-            if (gc_waitfor_status == GC_WAITFOR_RESULT_ACTIVE) {
+            if (gc_waitfor.active()) {
                 return false;
             }
             
-            //gc_waitfor_active = true;
-            gc_waitfor_type = type;
+            // The predicate and mode must be set before the wait-for is published by begin()
+            gc_waitfor_predicate = f;
+            gc_waitfor_dataflow = false;
+            gc_next_seq();
+            gc_waitfor.begin(type);
             for (const auto & it: nodes) {
-                gc_waitfor_bits[it.first] = false;
+                gc_waitfor.expect(it.first);
             }
-            gc_waitfor_num = nodes.size();
-            gc_waitfor_status = GC_WAITFOR_RESULT_ACTIVE;
-            gc_waitfor_predicate = f;
             return true;
         }
         
         /** Start a new wait-for event for all nodes. */
         bool gc_waitfor_start_all(OBNSimMsg::N2SMN::MSGTYPE type, GC_WaitFor_Predicate f = GC_WaitFor_Predicate()) {
-            std::lock_guard<std::mutex> lock(gc_waitfor_mutex);
-            if (gc_waitfor_status == GC_WAITFOR_RESULT_ACTIVE) {
+            if (gc_waitfor.active()) {
                 return false;
             }
-            std::fill(gc_waitfor_bits.begin(), gc_waitfor_bits.end(), false);    // Reset all bits
-            gc_waitfor_type = type;
-            gc_waitfor_num = gc_waitfor_bits.size();
-            gc_waitfor_status = GC_WAITFOR_RESULT_ACTIVE;
             gc_waitfor_predicate = f;
+            gc_waitfor_dataflow = false;
+            gc_next_seq();
+            gc_waitfor.begin(type);
+            gc_waitfor.expectAll();
             return true;
         }
         
+        /** Sequence number of the messages of the current wait-for if they may be retransmitted (see ack_retries), or 0. It is read by the communication threads to check the ACKs. */
+        std::atomic<int64_t> gc_seq{0};
+        
+        /** The last sequence number used; it is never reset, so the nodes can't mistake a message for one of a previous wait-for. */
+        int64_t gc_seq_counter = 0;
+        
+        /** Set the sequence number of a new wait-for; must be called before the wait-for begins. */
+        void gc_next_seq() {
+            gc_seq = (ack_retries > 0)?++gc_seq_counter:0;
+        }
+        
+        /** The last message with a sequence number sent to a node, to be retransmitted if its ACK doesn't arrive in time. */
+        struct ResendRecord {
+            int64_t seq = 0;        ///< Sequence number of the message (0 if none)
+            int group = -1;         ///< If non-negative, the message was sent to this node group and its frame is kept in gc_group_state
+            SMN2NFrame frame;       ///< The message, if it was sent to the node itself
+        };
+        
+        /** For each node, its last message with a sequence number. Written with gc_waitfor_mutex locked in dataflow dispatch, otherwise only by the GC thread. */
+        std::vector<ResendRecord> gc_resend;
+        
+        std::size_t gc_retransmissions;     ///< Number of messages retransmitted in the simulation
+        
+        /** \brief Send a frame to a node, recording it for retransmission if it has a sequence number. */
+        bool gc_send_frame(int id, const SMN2NFrame& frame) {
+            if (frame.hasSeq()) {
+                auto & rec = gc_resend[id];
+                rec.seq = gc_seq;
+                rec.group = -1;
+                rec.frame = frame;
+            }
+            return _nodes[id]->sendFrame(m_first_node_id + id, frame);
+        }
+        
+        /** \brief Send a message to a node; if it has a sequence number, it is sent as a frame recorded for retransmission. */
+        bool gc_send_message(int id, OBNSimMsg::SMN2N& msg) {
+            if (!msg.has_seq()) {
+                return _nodes[id]->sendMessage(m_first_node_id + id, msg);
+            }
+            auto & rec = gc_resend[id];
+            rec.seq = msg.seq();
+            rec.group = -1;
+            if (!rec.frame.setMessage(msg)) {
+                return false;
+            }
+            rec.frame.setNode(m_first_node_id + id);
+            return _nodes[id]->sendFrame(m_first_node_id + id, rec.frame);
+        }
+        
+        /** \brief Retransmit the messages of the current wait-for to the nodes whose ACKs are still expected. */
+        void gc_retransmit();
+        
         /** Process ACK messages for waitfor. */
         bool gc_waitfor_process_ACK(const OBNSimMsg::N2SMN& msg, int ID);
         
@@ -517,6 +946,36 @@ namespace OBNsmn {
         /* Number of regular updates
         size_t gc_update_regular_size; */
         
+        /** Scheduler of the next update times of all nodes, to quickly find the next updating nodes. */
+        NodeUpdateScheduler gc_scheduler;
+        
+        /** Pre-allocated vector of IDs of the next updating nodes, obtained from the scheduler. */
+        std::vector<int> gc_next_nodes;
+        
+        /** For each node, whether its UPDATE_X is not needed in the current iteration, because it was fused with UPDATE_Y (SIM_YX) or the node opted out in its SIM_Y_ACK.
+         Elements may be written by communication threads (for distinct nodes, while a wait-for is active) and are read by the GC after the wait-for has finished.
+         */
+        std::vector<char> gc_skip_update_x;
+        
+        /** For each node enabled with enableLookahead(), the list of its consumers; null for other nodes (or out of range). */
+        std::vector< std::unique_ptr< std::vector<int> > > m_lookahead_consumers;
+        
+        /** For each node, the time of the last update it has performed in a lookahead window (-1 if none).
+         If it is not before the current time, the node's current update has already been finished by gc_lookahead_window().
+         */
+        std::vector<simtime_t> gc_lookahead_end;
+        
+        OBNsim::UpdateList gc_lookahead_updates;    ///< Pre-allocated list of the updates of a lookahead window
+        std::string gc_lookahead_bytes;             ///< Pre-allocated buffer to encode a lookahead window
+        std::size_t gc_lookahead_windows;           ///< Number of lookahead windows granted in the simulation
+        std::size_t gc_lookahead_count;             ///< Number of updates performed in lookahead windows in the simulation
+        
+        /** \brief Compute the lookahead window of an updating node, which has been returned by the run-time graph with its full update mask. */
+        bool gc_lookahead_window(int id, updatemask_t mask);
+        
+        /** \brief Return the update mask of an updating node in the current iteration (0 if it's not updating). */
+        updatemask_t gc_update_mask_of(int id) const;
+        
         /** \brief Start the next update. */
         bool startNextUpdate();
         ///@}
@@ -528,14 +987,90 @@ namespace OBNsmn {
         /** \brief Send UPDATEY to certain nodes and start wait-for for them. */
         bool gc_send_update_y();
         
+        /** \brief Start the dataflow dispatch of UPDATEY for the current run-time graph and start wait-for for it. */
+        bool gc_send_update_y_dataflow();
+        
+        /** \brief Send UPDATEY messages to the given nodes (in dataflow dispatch), registering them in the current wait-for. Must be called with gc_waitfor_mutex locked, and before the ACK being processed (if any) is counted. */
+        void gc_dataflow_send(const std::vector< std::pair<int, updatemask_t> >& nodes, bool fromGC = false);
+        
+        /** \brief Set up the UPDATE_Y message to a node just returned by the run-time graph, with a lookahead window (SIM_YW) or fused with UPDATE_X (SIM_YX) if possible. Lookahead windows are only considered if called from the GC thread. */
+        bool gc_set_update_y_msg(OBNSimMsg::SMN2N& msg, int id, updatemask_t mask, bool fromGC);
+        
+        /** \brief Send UPDATE_Y messages to nodes just returned by the run-time graph, from the GC thread. */
+        void gc_send_update_y_nodes(const std::vector< std::pair<int, updatemask_t> >& nodes);
+        
+        /** Frame to serialize messages sent to several nodes once (only used by the GC thread). */
+        SMN2NFrame gc_frame;
+        
+        /** Pre-allocated list of the nodes, with their I fields, to which gc_send_grouped() sends gc_frame. */
+        std::vector< std::pair<int, int64_t> > gc_grouped_nodes;
+        
+        /** A node to which gc_send_update_y_nodes() sends a SIM_YX message. */
+        struct FusedUpdate {
+            int64_t X;      ///< The UPDATE_X mask, in the data of the message
+            int id;         ///< ID of the node
+            int64_t I;      ///< The UPDATE_Y mask
+        };
+        
+        /** Pre-allocated list of the nodes to which gc_send_update_y_nodes() sends SIM_YX messages, grouped by their UPDATE_X masks. */
+        std::vector<FusedUpdate> gc_fused_nodes;
+        
+        /** \brief Begin a bundle of messages to each of the given nodes (pairs of ID and mask), if bundle_messages is set. */
+        template <typename T>
+        void gc_begin_bundle(const T& nodes) {
+            if (bundle_messages) {
+                for (const auto & node: nodes) {
+                    _nodes[node.first]->beginBundle();
+                }
+            }
+        }
+        
+        /** \brief End the bundles begun by gc_begin_bundle() for the same nodes, which sends the bundled messages. */
+        template <typename T>
+        void gc_end_bundle(const T& nodes) {
+            if (bundle_messages) {
+                for (const auto & node: nodes) {
+                    _nodes[node.first]->endBundle();
+                }
+            }
+        }
+        
+        /** \brief Send gc_frame to the nodes in gc_grouped_nodes, once to each node group whose members are all in the list with the same I field. */
+        void gc_send_grouped();
+        
+        /** State of a node group in gc_send_grouped(). */
+        struct NodeGroupState {
+            std::size_t size = 0;       ///< Number of members
+            std::size_t count = 0;      ///< Number of members in the list
+            int64_t I = 0;              ///< I field of the first member in the list
+            bool same = true;           ///< Whether all members in the list have the same I field
+            bool sent = false;          ///< Whether the frame has been sent to the group
+            SMN2NFrame frame;           ///< The last frame with a sequence number sent to the group, for retransmission
+        };
+        std::vector<NodeGroupState> gc_group_state;
+        
+        std::size_t gc_group_sends;     ///< Number of messages sent to node groups in the simulation
+        
+        /** \brief Report an algebraic loop among the remaining nodes of the run-time graph. */
+        void gc_report_algebraic_loop();
+        
         /* \brief Send irregular UPDATEY to certain nodes and start wait-for for them.
         bool gc_send_update_y_irregular(); */
 
         /** \brief Send UPDATEX to certain nodes and start wait-for for them. */
         bool gc_send_update_x();
         
+        /** \brief Send SIM_INIT to all nodes and start the wait-for of their ACKs. */
+        bool gc_send_init();
+        
+        /** \brief Run the UPDATE_Y phase of the current iteration for the given updates. */
+        bool gc_run_update_y(GCUpdateListIterator itbegin, size_t n);
+        
+        /** \brief Run the UPDATE_X phase of the current iteration, then re-schedule the updated nodes. */
+        bool gc_run_update_x();
+        
         /** \brief Send a given simple message to all nodes without waiting for ACKs. */
-        bool gc_send_to_all(simtime_t t, OBNSimMsg::SMN2N::MSGTYPE msgtype, int64_t *pI = nullptr, OBNSimMsg::MSGDATA *pData = nullptr);
+        bool gc_send_to_all(simtime_t t, OBNSimMsg::SMN2N::MSGTYPE msgtype, int64_t *pI = nullptr, OBNSimMsg::MSGDATA *pData = nullptr, int64_t seq = 0);
         
         /** \brief Send a given simple message to all nodes and start wait-for event. */
         bool gc_send_to_all(simtime_t t, OBNSimMsg::SMN2N::MSGTYPE msgtype, OBNSimMsg::N2SMN::MSGTYPE acktype, int64_t *pI = nullptr, OBNSimMsg::MSGDATA *pData = nullptr, GC_WaitFor_Predicate pred = GC_WaitFor_Predicate());
@@ -561,6 +1096,28 @@ namespace OBNsmn {
             gc_timer_active = false;
         }
     };
+    
+    
+    /** \brief The node representing a sub-coordinator in its parent GC (see GCThread::addSubCoordinator()).
+     
+     It has one irregular update type (mask 1), whose updates are requested by the sub-coordinator; the masks of the requests also have the bits of the partition's gates (see PartitionGates).
+     Its messages are posted directly to the sub-coordinator, which runs in the same process.
+     */
+    class OBNNodePartition: public OBNNode {
+    public:
+        OBNNodePartition(const std::string& _name, GCThread* sub): OBNNode(_name, 1), m_sub(sub) {
+            setUpdateType(0, 0, 1);
+        }
+        
+        virtual bool sendMessage(int nodeID, OBNSimMsg::SMN2N &msg) override {
+            msg.set_id(nodeID);
+            m_sub->postParentCommand(msg);
+            return true;
+        }
+        
+    private:
+        GCThread* m_sub;    ///< The sub-coordinator, owned by the parent GC
+    };
 }
 
 #endif /* OBNSIM_GC_H_ */
@@ -26,14 +26,16 @@ inline void OBNsmn::GCThread::gc_process_msg_sim_event(OBNsmn::SMNNodeEvent* pEv
     if (pEv->has_t) {
         data->set_t(pEv->t);
         
-        if (pEv->t > current_sim_time) {
+        if (pEv->t > current_sim_time && pEv->t > gc_lookahead_end[pEv->nodeID]) {
             // Requested time is in the future: it's accepted
             data->set_i(0);  // OK
             _nodes[pEv->nodeID]->insertIrregularUpdate(pEv->t, (pEv->has_i)?pEv->i:0);
+            // Re-schedule the node; if it's being updated, its next update time does not change until it finishes the current update
+            gc_scheduler.set(pEv->nodeID, _nodes[pEv->nodeID]->getNextUpdate());
             //report_info(0, "Accept event for node " + _nodes[pEv->nodeID]->name + " for mask " + std::to_string((pEv->has_i)?pEv->i:0) + " at time " + std::to_string(pEv->t));
         }
         else {
-            // Requested time is invalid: denied
+            // Requested time is invalid (in the past, possibly of the node's lookahead window): denied
             report_warning(0, "An invalid irregular update request from node " + std::to_string(pEv->nodeID) +
                            " (" + _nodes[pEv->nodeID]->name + ") with past time.");
             
@@ -48,7 +50,7 @@ inline void OBNsmn::GCThread::gc_process_msg_sim_event(OBNsmn::SMNNodeEvent* pEv
     }
     
     msg.set_allocated_data(data);
-    _nodes[pEv->nodeID]->sendMessage(pEv->nodeID, msg);
+    _nodes[pEv->nodeID]->sendMessage(m_first_node_id + pEv->nodeID, msg);
 }
 
 
@@ -82,7 +84,7 @@ inline bool OBNsmn::GCThread::gc_process_msg_sys_request_stop(OBNsmn::SMNNodeEve
     msg.set_msgtype(OBNSimMsg::SMN2N_MSGTYPE_SYS_REQUEST_STOP_ACK);
     msg.set_time(current_sim_time);
     if (pEv->has_id) {
-        msg.set_id(pEv->nodeID);
+        msg.set_id(m_first_node_id + pEv->nodeID);
     } else {
         msg.clear_id();
     }
@@ -96,7 +98,7 @@ inline bool OBNsmn::GCThread::gc_process_msg_sys_request_stop(OBNsmn::SMNNodeEve
     
     // Send the ACK message either to the node or to the main GC port
     if (pEv->has_id) {
-        _nodes[pEv->nodeID]->sendMessage(pEv->nodeID, msg);
+        _nodes[pEv->nodeID]->sendMessage(m_first_node_id + pEv->nodeID, msg);
     } else if (m_send_msg_to_sys_port) {
         m_send_msg_to_sys_port(msg);
     }
@@ -26,6 +26,61 @@ namespace OBNsmn {
     
     class GCThread;  // will be used later to be a friend class
     
+    /** \brief An SMN2N message serialized once, to be sent to several nodes.
+     
+     When the GC sends the same message to many nodes (e.g. SIM_INIT, SIM_X, or a wave of SIM_Y), only the node's ID and possibly the I field (the update mask) differ between the nodes.
+     The fields common to all nodes (type, time, data, ...) are serialized once by setMessage(); then for each node, setNode() appends the node's ID and I fields to the serialized bytes.
+     The result is a valid serialized SMN2N message, because the fields of a protobuf message may appear in any order.
+     */
+    class SMN2NFrame {
+    public:
+        /** \brief Serialize the common fields of a message, whose ID and I fields should not be set.
+         \return false if the message could not be serialized.
+         */
+        bool setMessage(const OBNSimMsg::SMN2N& msg);
+        
+        /** \brief Complete the frame for a given node, with the node's ID and optionally an I field.
+         The previous node's fields are replaced.
+         \param nodeID The node's ID; if negative, the ID is not set (for a frame sent to a group of nodes, see OBNNodeGroup).
+         \param pI Pointer to the value of the I field; if null, the field is not set.
+         */
+        void setNode(int nodeID, const int64_t* pI = nullptr);
+        
+        /** Pointer to the serialized bytes of the current frame. */
+        const char* data() const {
+            return m_buffer.data();
+        }
+        
+        /** Size of the current frame, in bytes. */
+        std::size_t size() const {
+            return m_buffer.size();
+        }
+        
+        /** Whether the message of the frame has a sequence number (see GCThread::ack_retries). */
+        bool hasSeq() const {
+            return m_has_seq;
+        }
+        
+        /** \brief Parse the current frame into a message object. */
+        bool getMessage(OBNSimMsg::SMN2N& msg) const {
+            return msg.ParseFromArray(m_buffer.data(), m_buffer.size());
+        }
+        
+    private:
+        std::string m_buffer;           ///< The serialized bytes
+        std::size_t m_common_size = 0;  ///< Size of the common fields, at the beginning of the buffer
+        bool m_has_seq = false;         ///< Whether the message has a sequence number
+        
+        /** Append an unsigned integer in varint encoding. */
+        void appendVarint(uint64_t v) {
+            while (v >= 0x80) {
+                m_buffer.push_back(static_cast<char>((v & 0x7F) | 0x80));
+                v >>= 7;
+            }
+            m_buffer.push_back(static_cast<char>(v));
+        }
+    };
+    
     /** \brief A node in the network.
      
      This class represents a node in the simulation network. It contains all information about the node that is required by the GC.
@@ -63,6 +118,32 @@ namespace OBNsmn {
          */
         virtual bool sendMessage(int nodeID, OBNSimMsg::SMN2N &msg) = 0;
         
+        /** \brief Send a message serialized in a frame to the node.
+         
+         The frame must have been completed for this node (see SMN2NFrame::setNode()).
+         Communication protocols should override this method to send the serialized bytes directly; the default implementation parses the frame and calls sendMessage().
+         \param nodeID The node's ID, which is its index in the list of all nodes, managed by the GC.
+         \param frame The serialized message.
+         \return True if successful.
+         */
+        virtual bool sendFrame(int nodeID, const SMN2NFrame &frame) {
+            OBNSimMsg::SMN2N msg;
+            return frame.getMessage(msg) && sendMessage(nodeID, msg);
+        }
+        
+        /** \brief Begin a bundle of messages to the node.
+         
+         Until the matching endBundle(), the messages to the node may be queued, so that the messages to all nodes sharing its connection (e.g. the nodes of a node host over sockets) are sent together, in one transport message.
+         The GC begins a bundle for each node of a wave; bundles on a shared connection are nested, and sent when the last one ends.
+         The default implementation does nothing.
+         */
+        virtual void beginBundle() { }
+        
+        /** \brief End a bundle of messages begun by beginBundle().
+         \return false if the queued messages could not be sent.
+         */
+        virtual bool endBundle() { return true; }
+        
         
         /** \brief Returns the update type mask of the next update of this node. */
         updatemask_t getNextUpdateMask() const { return next_update_mask; }
@@ -174,6 +255,21 @@ namespace OBNsmn {
             return true;
         }
     };
+    
+    
+    /** \brief A group of nodes which receive the same message with a single send.
+     
+     A group is a channel of the communication protocol to which all member nodes listen, in addition to their own channels (e.g. a common MQTT topic to which the nodes subscribe).
+     The GC sends a message once to the group, instead of once to each member, when all members receive the same message at the same time (e.g. SIM_TERM, or a wave of SIM_Y with identical masks).
+     Messages sent to a group don't have the ID field; the nodes learn their IDs from SIM_INIT, which is always sent to each node.
+     */
+    class OBNNodeGroup {
+    public:
+        virtual ~OBNNodeGroup() { }
+        
+        /** \brief Send a message serialized in a frame, without ID, to all member nodes. */
+        virtual bool sendFrame(const SMN2NFrame &frame) = 0;
+    };
 
 }
 
@@ -15,6 +15,10 @@
 #include <memory>
 #include <vector>
 #include <utility>
+#include <string>
+#include <unordered_map>
+#include <map>
+#include <functional>
 
 #include <obnsmn_basic.h>
 
@@ -66,6 +70,47 @@ namespace OBNsmn {
          \return Vector of IDs of the nodes.
          */
         virtual std::vector< std::pair<int,updatemask_t> > getCurrentNodes() const = 0;
+        
+        /** \brief Check if a node that has just been returned for update is a sink of the run-time graph.
+         
+         A node is a sink if, once the returned updates are done, it has no remaining updates in the run-time graph and no other updating node depends on its outputs.
+         Its UPDATE_X can then be performed right after its UPDATE_Y (see SIM_YX).
+         It must be called right after the node is returned by getAndRemoveIndependentNodes(), startDataflow() or finishNodeUpdate().
+         The default implementation conservatively returns false.
+         \param id ID of the node.
+         */
+        virtual bool isSink(int id) const {
+            return false;
+        }
+        
+        /* ======== Optional dataflow interface ========= */
+        
+        /** \brief Check if the graph supports dataflow dispatch (startDataflow() and finishNodeUpdate()). */
+        virtual bool supportsDataflow() const {
+            return false;
+        }
+        
+        /** \brief Start dataflow dispatch.
+         
+         Return the currently independent nodes and mark their independent updates as in progress.
+         Unlike getAndRemoveIndependentNodes(), these updates are not removed until finishNodeUpdate() is called for their nodes, so their dependents will wait for them.
+         \return Vector of (ID, update-mask) of the nodes to be updated.
+         */
+        virtual std::vector< std::pair<int, updatemask_t> > const& startDataflow() {
+            static const std::vector< std::pair<int, updatemask_t> > noNodes;
+            return noNodes;
+        }
+        
+        /** \brief Finish the in-progress updates of a node in dataflow dispatch.
+         
+         Remove the in-progress updates of the given node, then return the nodes that become independent because of that, marking their independent updates as in progress.
+         \param id ID of the node whose updates have finished.
+         \return Vector of (ID, update-mask) of the nodes to be updated next.
+         */
+        virtual std::vector< std::pair<int, updatemask_t> > const& finishNodeUpdate(int id) {
+            static const std::vector< std::pair<int, updatemask_t> > noNodes;
+            return noNodes;
+        }
     };
     
     /** \brief Graph of nodes' dependency, with weights on edges.
@@ -109,6 +154,21 @@ namespace OBNsmn {
          \return Pointer to a RTNodeDepGraph object
          */
         virtual RTNodeDepGraph* getRTNodeDepGraph(GCUpdateListIterator itbegin, size_t n) = 0;
+        
+        /** \brief Return a human-readable summary of run-time statistics of the graph (e.g. cache hits), or an empty string if there is none. */
+        virtual std::string statistics() const {
+            return std::string();
+        }
+        
+    protected:
+        /** A link (source update mask, target update mask) between two nodes. */
+        typedef std::pair<updatemask_t, updatemask_t> LinkLabel;
+        
+        /** \brief Combine two links into one if possible. */
+        static bool combineLinks(LinkLabel& link1, const LinkLabel& link2);
+        
+        /** \brief Add a new link to a list of parallel links between the same two nodes, combining links if possible. */
+        static void addLinkToList(std::vector<LinkLabel>& links, const LinkLabel& newlink);
     };
     
     
@@ -217,6 +277,12 @@ namespace OBNsmn {
         /** \brief Return the current, remaining nodes. */
         virtual std::vector< std::pair<int,updatemask_t> > getCurrentNodes() const;
         
+        /** \brief Check if a node that has just been returned for update is a sink of the run-time graph. */
+        virtual bool isSink(int id) const {
+            const auto& thisNode = _graph[static_cast<GraphT::vertex_descriptor>(id)];
+            return !thisNode.active && !thisNode.hasDependents;
+        }
+        
     private:
         /**
          Here we use vecS to store the list of vertices, which is essentially a vector of integers (IDs of the vertices) starting from 0.
@@ -231,7 +297,6 @@ namespace OBNsmn {
          - For each edge: a bool property to mark if the edge is "removed" or not yet.
          - For each vertex (node): enum value of UNMARKED, MARKED, and REMOVED.
          */
-        typedef std::pair<updatemask_t, updatemask_t> LinkLabel;
         struct EdgeLabel {
             std::vector<LinkLabel> links;   ///< List of links from the same source node to the same target nodes
             bool active;        // Whether this edge is active
@@ -243,6 +308,7 @@ namespace OBNsmn {
             bool active;                // Whether the vertex is active in the RT graph (used in the run-time algorithm)
             updatemask_t updateMask;    // The current update mask of this node
             updatemask_t inputMask;     // Combination of the update masks of all active input edges to this node
+            bool hasDependents;         // Whether this node has an active out-edge in the RT graph (when it was constructed)
         };
         typedef boost::adjacency_list<boost::vecS, boost::vecS, boost::directedS, VertexLabel, EdgeLabel> GraphT;
         GraphT _graph;
@@ -250,10 +316,349 @@ namespace OBNsmn {
         int rtNodesLeft;        ///< Number of nodes left to be considered in the run-time graph
         
         std::vector< std::pair<int, updatemask_t> > rtResult;   ///< This holds the result vector getAndRemoveIndependentNodes(), which is pre-allocated to avoid re-allocation.
+    };
+    
+    
+    // =============================================
+    // Implementation using compressed sparse rows (CSR)
+    // =============================================
+    
+    /** \brief Implementation of NodeDepGraph and RTNodeDepGraph using compressed-sparse-row arrays.
+     
+     Dependencies are collected (and their links combined exactly as in NodeDepGraph_BGL) while addDependency() is called.
+     Before the first run-time graph is created, the graph is frozen into CSR arrays of out-edges and in-edges.
+     
+     The run-time algorithm produces exactly the same waves as NodeDepGraph_BGL, but incrementally:
+     - The input mask of a node only changes when its own update mask changes or when one of its sources changes, i.e. when the node or one of its sources is released in a wave.
+     - So after each wave, only the released nodes and the targets of their out-edges are re-evaluated (Kahn-style), and only they can become independent in the next wave.
+     
+     The cost of each step is therefore proportional to the size of the active subgraph (the updating nodes and their edges), not the whole network.
+     
+     This graph also supports dataflow dispatch (see RTNodeDepGraph::startDataflow()), in which a node's updates are only removed when the node has finished them, and its dependents are re-evaluated right away.
+     */
+    class NodeDepGraph_CSR: public NodeDepGraph, public RTNodeDepGraph {
+    public:
+        /* ======== Implementation of the NodeDepGraph interface ========= */
         
-        /** \brief Combine two links into one if possible. */
-        bool combineLinks(LinkLabel& link1, const LinkLabel& link2);
+        /** \brief Construct a graph of a given number of nodes.
+         \param numNodes Number of nodes, whose indices are from 0 to (numNodes-1).
+         */
+        NodeDepGraph_CSR(int numNodes): m_numNodes(numNodes), m_nodes(numNodes), m_stamps(numNodes, 0) {
+            assert(numNodes > 0);
+            // Pre-allocate enough space for the run-time vectors
+            rtResult.reserve(numNodes);
+            m_ready.reserve(numNodes);
+            m_dirty.reserve(numNodes);
+            m_rtNodes.reserve(numNodes);
+        }
+        
+        /** \brief Add dependency of a node on another node.
+         
+         Refer to NodeDepGraph::addDependency() for details.
+         */
+        virtual void addDependency(int s, int t, updatemask_t smask, updatemask_t tmask);
+        
+        /** \brief Return a runtime node dependency graph, keeping only updating nodes. */
+        virtual RTNodeDepGraph* getRTNodeDepGraph(GCUpdateListIterator itbegin, size_t n);
+        
+        /* ======== Implementation of the RTNodeDepGraph interface ========= */
+        /** \brief Return and remove independent nodes. */
+        virtual std::vector< std::pair<int, updatemask_t> > const& getAndRemoveIndependentNodes();
+        
+        /** \brief Check if the run-time graph is empty.
+         \return True if empty.
+         */
+        virtual bool empty() const {
+            return (rtNodesLeft < 1);
+        }
+        
+        /** \brief Return the current, remaining nodes. */
+        virtual std::vector< std::pair<int,updatemask_t> > getCurrentNodes() const;
+        
+        /** \brief Dataflow dispatch is supported. */
+        virtual bool supportsDataflow() const {
+            return true;
+        }
+        
+        /** \brief Start dataflow dispatch. */
+        virtual std::vector< std::pair<int, updatemask_t> > const& startDataflow();
+        
+        /** \brief Finish the in-progress updates of a node in dataflow dispatch. */
+        virtual std::vector< std::pair<int, updatemask_t> > const& finishNodeUpdate(int id);
+        
+        /** \brief Check if a node that has just been returned for update is a sink of the run-time graph. */
+        virtual bool isSink(int id) const {
+            const auto& thisNode = m_nodes[id];
+            return !thisNode.hasDependents && (!thisNode.active || (thisNode.updateMask & (~thisNode.inProgress)) == 0);
+        }
+        
+    private:
+        int m_numNodes;     ///< Number of nodes
+        
+        /** Edges collected by addDependency(), each with its list of combined links; converted to CSR arrays by freeze(). */
+        std::map< std::pair<int,int>, std::vector<LinkLabel> > m_edges;
+        bool m_frozen = false;  ///< Whether the CSR arrays are up-to-date with m_edges
+        
+        /** \brief Build the CSR arrays from m_edges. */
+        void freeze();
+        
+        // CSR arrays of out-edges: the targets of node i are m_outTargets[m_outOffsets[i] .. m_outOffsets[i+1]-1]
+        std::vector<std::size_t> m_outOffsets;
+        std::vector<int> m_outTargets;
+        
+        // CSR arrays of in-edges: the j-th in-edge (in the order of m_inOffsets) comes from m_inSources[j], and its links are m_links[m_inLinkOffsets[j] .. m_inLinkOffsets[j+1]-1]
+        std::vector<std::size_t> m_inOffsets;
+        std::vector<int> m_inSources;
+        std::vector<std::size_t> m_inLinkOffsets;
+        std::vector<LinkLabel> m_links;
+        
+        /** Run-time state of a node. */
+        struct NodeState {
+            bool active = false;            // Whether the node is active in the RT graph
+            updatemask_t updateMask = 0;    // The current update mask of this node
+            updatemask_t inputMask = 0;     // Combination of the update masks of all active input edges to this node
+            updatemask_t inProgress = 0;    // Updates dispatched but not yet finished (dataflow dispatch only)
+            bool hasDependents = false;     // Whether this node has an active out-edge in the RT graph
+        };
+        std::vector<NodeState> m_nodes;
+        
+        int rtNodesLeft = 0;    ///< Number of nodes left to be considered in the run-time graph
+        
+        std::vector<int> m_rtNodes;     ///< Nodes of the current run-time graph, so that they can be reset cheaply in the next iteration
+        std::vector<int> m_ready;       ///< Active nodes that have independent updates, i.e. the next wave
+        std::vector<int> m_dirty;       ///< Nodes to be re-evaluated after a wave
+        std::vector<unsigned int> m_stamps; ///< Stamps to mark dirty nodes without clearing
+        unsigned int m_stamp = 0;
+        
+        std::vector< std::pair<int, updatemask_t> > rtResult;   ///< This holds the result vector getAndRemoveIndependentNodes(), which is pre-allocated to avoid re-allocation.
+        
+        /** \brief Re-calculate the input mask of an active node from its active in-edges. */
+        void updateInputMask(int t);
+        
+        /** \brief In dataflow dispatch, check if an active, idle node has become independent; if so, mark its updates in progress and add it to the result. */
+        void dispatchIfIndependent(int t);
+    };
+    
+    
+    // =============================================
+    // Cache of wave plans on top of another graph
+    // =============================================
+    
+    /** \brief Cache of wave plans for recurring sets of updating nodes.
+     
+     In most simulations, the same sets of updating nodes (with the same update masks) occur over and over again, e.g. periodic nodes repeat their pattern every hyperperiod.
+     For a fixed dependency graph, the sequence of waves returned by getAndRemoveIndependentNodes() depends only on the list of updating nodes, so it can be computed once and replayed afterwards.
+     
+     This class wraps another NodeDepGraph object (which it owns). On a cache miss, it runs the wrapped graph's run-time algorithm to completion and stores the resulting waves as a plan, keyed by a hash of the list of updating nodes.
+     On a cache hit, the plan is simply replayed, so a step costs O(number of updating nodes) instead of O(V+E) per wave.
+     Because the key is the exact list of (ID, update-mask) pairs, each phase of the hyperperiod of purely periodic nodes is naturally a separate plan.
+     
+     When the cache is full, it is cleared entirely; this keeps the implementation simple and bounds its memory.
+     */
+    class NodeDepGraph_WaveCache: public NodeDepGraph, public RTNodeDepGraph {
+    public:
+        /** \brief Construct a cache on top of a given graph.
+         \param graph The underlying graph, which will be owned by this object.
+         \param capacity Maximum number of plans to be cached (positive).
+         */
+        NodeDepGraph_WaveCache(NodeDepGraph* graph, std::size_t capacity = 1024): m_graph(graph), m_capacity(capacity) {
+            assert(graph != nullptr);
+            assert(capacity > 0);
+        }
+        
+        /* ======== Implementation of the NodeDepGraph interface ========= */
+        
+        /** \brief Add dependency of a node on another node; invalidates all cached plans. */
+        virtual void addDependency(int s, int t, updatemask_t smask, updatemask_t tmask);
+        
+        /** \brief Return a runtime node dependency graph, replaying a cached plan if possible. */
+        virtual RTNodeDepGraph* getRTNodeDepGraph(GCUpdateListIterator itbegin, size_t n);
+        
+        /** \brief Return the cache statistics. */
+        virtual std::string statistics() const;
+        
+        /* ======== Implementation of the RTNodeDepGraph interface ========= */
+        /** \brief Return the next wave of the current plan. */
+        virtual std::vector< std::pair<int, updatemask_t> > const& getAndRemoveIndependentNodes();
+        
+        /** \brief Check if the current plan has been entirely replayed. */
+        virtual bool empty() const {
+            return !m_current || (m_nextWave >= m_current->waves.size() && m_current->remaining.empty());
+        }
+        
+        /** \brief Return the current, remaining nodes. */
+        virtual std::vector< std::pair<int,updatemask_t> > getCurrentNodes() const;
+        
+        /** \brief Check if a node of the last returned wave is a sink, as recorded in the plan. */
+        virtual bool isSink(int id) const;
+        
+        /* ======== Statistics ========= */
+        std::size_t hits() const { return m_hits; }         ///< Number of steps whose plan was found in the cache
+        std::size_t misses() const { return m_misses; }     ///< Number of steps whose plan had to be computed
+        std::size_t size() const { return m_plans.size(); } ///< Number of plans currently in the cache
+        
+    private:
+        typedef std::vector< std::pair<int, updatemask_t> > WaveT;
+        
+        /** A wave plan: the list of updating nodes (the exact key), the waves and their sinks, and the remaining nodes if the algorithm got stuck (algebraic loop). */
+        struct WavePlan {
+            NodeUpdateInfoList updates;
+            std::vector<WaveT> waves;
+            std::vector< std::vector<int> > sinks;  ///< For each wave, the sorted IDs of its sink nodes
+            WaveT remaining;
+            
+            bool matches(GCUpdateListIterator itnode, size_t nNodes) const;
+        };
+        
+        std::unique_ptr<NodeDepGraph> m_graph;  ///< The underlying graph
+        std::size_t m_capacity;                 ///< Maximum number of plans
+        
+        std::unordered_multimap<std::size_t, WavePlan> m_plans;    ///< The cached plans, keyed by the hash of their update lists
+        
+        const WavePlan* m_current = nullptr;    ///< The plan being replayed
+        std::size_t m_nextWave = 0;             ///< Index of the next wave to be returned
+        
+        const WaveT m_emptyWave{};              ///< Returned when there is no more wave
+        
+        std::size_t m_hits = 0, m_misses = 0;
+        
+        /** Compute the hash key of a list of updating nodes. */
+        static std::size_t hashUpdateList(GCUpdateListIterator itnode, size_t nNodes);
+    };
+    
+    
+    // =============================================
+    // Partitioned graph for sub-coordinators
+    // =============================================
+    
+    /** \brief The gates of a partition, by which the parent GC releases the updates of the partition's nodes that depend on other nodes (see NodeDepGraph_Partitioned).
+     
+     A gate is an update type of a node of the partition with inputs from outside the partition. Each gate has its own update type (bit) in the proxy node of the partition,
+     in addition to the update type 1 of the updates that depend on no gate; the parent GC updates a gate once its inputs are updated.
+     An update type of a node of the partition waits for the gates on which it depends through the partition's dependencies (including its own gate), and can be run by the sub-coordinator once they are open.
+     */
+    class PartitionGates {
+    public:
+        /** Check if the partition has no gates, i.e. all its updates are run at once. */
+        bool empty() const {
+            return m_gates.empty();
+        }
+        
+        /** \brief Return the gates (update types of the proxy) of given update types of a node. */
+        updatemask_t gatesOf(int id, updatemask_t mask) const {
+            return empty()?0:maskOf(m_gates[id], mask);
+        }
+        
+        /** \brief Return the gates for which given update types of a node wait. */
+        updatemask_t waitsOf(int id, updatemask_t mask) const {
+            return empty()?0:maskOf(m_waits[id], mask);
+        }
+        
+        /** \brief Return the update types among given ones of a node which can be run once the given gates are open. */
+        updatemask_t released(int id, updatemask_t mask, updatemask_t open) const {
+            if (!empty()) {
+                for (const auto& w: m_waits[id]) {
+                    if (w.second & ~open) {
+                        mask &= ~w.first;
+                    }
+                }
+            }
+            return mask;
+        }
+        
+    private:
+        friend class NodeDepGraph_Partitioned;
+        
+        typedef std::vector< std::pair<updatemask_t, updatemask_t> > TypeMasksT;   ///< List of (update types of a node, gates)
+        std::vector<TypeMasksT> m_gates;    ///< For each node, the gates of its update types which are gates
+        std::vector<TypeMasksT> m_waits;    ///< For each node, the gates for which its update types wait, if any
+        
+        /** The union of the gates of the update types in the mask. */
+        static updatemask_t maskOf(const TypeMasksT& list, updatemask_t mask) {
+            updatemask_t result = 0;
+            for (const auto& m: list) {
+                if (m.first & mask) {
+                    result |= m.second;
+                }
+            }
+            return result;
+        }
+    };
+    
+    
+    /** \brief Split the dependency graph of the nodes among a root GC and its sub-coordinators (see GCThread::addSubCoordinator()).
+     
+     Each node is either in a partition, run by a sub-coordinator, or at the root level, run by the root GC directly.
+     In its partition, a node's ID is its index among the nodes of the partition (in the order of their global IDs).
+     In the root GC, the partitions are represented by their proxy nodes, with IDs 0 to P-1, followed by the root-level nodes in the order of their global IDs.
+     
+     A dependency between two nodes of the same partition is added to the partition's graph, so the sub-coordinator resolves it.
+     Any other dependency is added to the root graph, where a partition is its proxy node, whose update types are the gates of the partition (see PartitionGates):
+     the gates of the target's update types wait for the gates for which the source's update types wait, and for the update type 1 of the source's partition.
+     Therefore the dependencies between two partitions in both directions don't form an algebraic loop in the root graph unless the update types of the nodes do.
+     The root graph is conservative in two cases: an update type waits for a gate through nodes which are not updating, and the gates of a partition beyond the 63rd share the last update type of the proxy.
+     
+     The root graph and the gates are computed when the root graph is released, so all dependencies must be added before.
+     */
+    class NodeDepGraph_Partitioned {
+    public:
+        /** The function creating a graph of a given number of nodes, e.g. NodeDepGraph_CSR. */
+        typedef std::function<NodeDepGraph* (std::size_t)> GraphFactory;
+        
+        /** \brief Construct the graphs.
+         \param partitions The partition of each node (by global ID), from 0 to P-1, or -1 for a node at the root level.
+         \param factory The function creating the graphs.
+         */
+        NodeDepGraph_Partitioned(const std::vector<int>& partitions, const GraphFactory& factory);
+        
+        /** \brief Add dependency of a node on another node, by their global IDs (see NodeDepGraph::addDependency()). */
+        void addDependency(int s, int t, updatemask_t smask, updatemask_t tmask);
+        
+        /** Number of partitions. */
+        std::size_t numberOfPartitions() const { return m_graphs.size() - 1; }
+        
+        /** Number of nodes in a partition. */
+        std::size_t partitionSize(std::size_t p) const { return m_sizes[p]; }
+        
+        /** The partition of a node, or -1 if it is at the root level. */
+        int partitionOf(int id) const { return m_partitions[id]; }
+        
+        /** The ID of a node in its partition, or in the root GC if it is at the root level. */
+        int localID(int id) const { return m_local_ids[id]; }
+        
+        /** \brief Release the graph of a partition, which the caller owns afterwards. */
+        NodeDepGraph* releasePartitionGraph(std::size_t p) { return m_graphs[p].release(); }
+        
+        /** \brief Release the graph of the root GC, which the caller owns afterwards. */
+        NodeDepGraph* releaseRootGraph();
+        
+        /** \brief The gates of a partition, for its sub-coordinator (see GCThread::setPartitionGates()). */
+        const PartitionGates& partitionGates(std::size_t p) {
+            computeGates();
+            return m_gates[p];
+        }
+        
+    private:
+        std::vector<int> m_partitions;      ///< Partition of each node
+        std::vector<int> m_local_ids;       ///< Local ID of each node
+        std::vector<std::size_t> m_sizes;   ///< Number of nodes in each partition
+        
+        /** The graphs of the partitions, followed by the root graph. */
+        std::vector< std::unique_ptr<NodeDepGraph> > m_graphs;
+        
+        /** A dependency: source, target and their update masks. */
+        struct Dependency {
+            int s, t;
+            updatemask_t smask, tmask;
+        };
+        std::vector< std::vector<Dependency> > m_local_deps;    ///< The dependencies inside each partition, by local IDs
+        std::vector<Dependency> m_root_deps;                    ///< The other dependencies, by global IDs
+        
+        std::vector<PartitionGates> m_gates;    ///< The gates of each partition
+        bool m_gates_computed = false;
         
+        /** Compute the gates of the partitions and the update types for which they wait. */
+        void computeGates();
     };
 }
 
@@ -0,0 +1,91 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Scheduler of the next updates of nodes, used by the GC.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#ifndef OBNSIM_SCHEDULER_H
+#define OBNSIM_SCHEDULER_H
+
+#include <cassert>
+#include <vector>
+#include <utility>
+
+#include <obnsmn_basic.h>
+
+namespace OBNsmn {
+    /** \brief Indexed priority queue of the next update times of nodes.
+     
+     The GC must find, in each iteration, the earliest next update time among all nodes and the nodes to be updated at that time.
+     Instead of scanning all nodes, the GC keeps their next update times in this scheduler, which is an indexed binary min-heap of (time, node ID):
+     - The next update time of a node is set with set(), and only needs to be changed when it may have changed, i.e. after the node finishes an update or requests an irregular update. Each change costs O(log N).
+     - nextNodes() returns the k nodes with the earliest time in O(k log k), without removing them, because their times will be changed after their updates anyway.
+     
+     Nodes without any next update (time < 0) are not kept in the heap.
+     */
+    class NodeUpdateScheduler {
+    public:
+        /** \brief Reset the scheduler for a given number of nodes, with no scheduled updates. */
+        void reset(std::size_t numNodes) {
+            m_heap.clear();
+            m_heap.reserve(numNodes);
+            m_pos.assign(numNodes, NOT_IN_HEAP);
+        }
+        
+        /** \brief Set the next update time of a node.
+         \param id ID of the node, between 0 and N-1.
+         \param t The next update time of the node; if t < 0, the node has no next update and is removed from the scheduler.
+         */
+        void set(int id, simtime_t t);
+        
+        /** \brief Check if a node has a scheduled update. */
+        bool contains(int id) const {
+            return m_pos[id] != NOT_IN_HEAP;
+        }
+        
+        /** \brief Return the next update time of a node, or -1 if it has no scheduled update. */
+        simtime_t timeOf(int id) const {
+            return contains(id)?m_heap[m_pos[id]].first:-1;
+        }
+        
+        /** \brief Check if no update is scheduled. */
+        bool empty() const {
+            return m_heap.empty();
+        }
+        
+        /** \brief Return the earliest next update time, or -1 if there is none. */
+        simtime_t nextTime() const {
+            return m_heap.empty()?-1:m_heap.front().first;
+        }
+        
+        /** \brief Get the nodes whose next update time is the earliest one, in increasing order of their IDs.
+         The nodes are not removed from the scheduler.
+         \param ids The vector to receive the IDs of the nodes (its content is replaced).
+         \return The earliest next update time, or -1 if there is none (then ids is empty).
+         */
+        simtime_t nextNodes(std::vector<int>& ids);
+        
+    private:
+        static const std::size_t NOT_IN_HEAP = static_cast<std::size_t>(-1);
+        
+        typedef std::pair<simtime_t, int> EntryT;     ///< An entry in the heap: (time, node ID); entries are compared lexicographically
+        std::vector<EntryT> m_heap;         ///< The binary heap
+        std::vector<std::size_t> m_pos;     ///< Position of each node in the heap, or NOT_IN_HEAP
+        std::vector<std::size_t> m_stack;   ///< Pre-allocated stack for nextNodes()
+        
+        void swapEntries(std::size_t i, std::size_t j) {
+            std::swap(m_heap[i], m_heap[j]);
+            m_pos[m_heap[i].second] = i;
+            m_pos[m_heap[j].second] = j;
+        }
+        
+        void siftUp(std::size_t i);
+        void siftDown(std::size_t i);
+    };
+}
+
+#endif /* defined(OBNSIM_SCHEDULER_H) */
@@ -0,0 +1,41 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Implement the tracker of the ACKs expected by the GC.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <obnsmn_acktracker.h>
+
+using namespace OBNsmn;
+
+const std::size_t AckTracker::BITS_PER_WORD;
+
+void AckTracker::resize(std::size_t numNodes) {
+    auto numWords = (numNodes + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    m_bits.reset(new std::atomic<word_t>[numWords]);
+    m_size = numNodes;
+    for (std::size_t k = 0; k < numWords; ++k) {
+        m_bits[k].store(0, std::memory_order_relaxed);
+    }
+    m_state.store(pack(epochOf(m_state.load()), WAITFOR_NONE, 0));
+}
+
+void AckTracker::clearPending() {
+    auto numWords = (m_size + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    for (std::size_t k = 0; k < numWords; ++k) {
+        m_bits[k].store(0, std::memory_order_relaxed);
+    }
+}
+
+void AckTracker::expectAll() {
+    auto numWords = (m_size + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    for (std::size_t k = 0; k < numWords; ++k) {
+        auto bits = (k + 1 < numWords || m_size % BITS_PER_WORD == 0)?~word_t(0):(bitMask(m_size) - 1);
+        m_bits[k].store(bits, std::memory_order_relaxed);
+    }
+    m_state.fetch_add(m_size, std::memory_order_release);
+}
@@ -0,0 +1,70 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Implement the registry of the nodes that have arrived.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <chrono>
+#include <obnsmn_arrivals.h>
+
+using namespace OBNsmn;
+
+
+void ArrivalRegistry::arrive(const std::string& name) {
+    std::lock_guard<std::mutex> mylock(m_mutex);
+    if (!m_online.insert(name).second) {
+        // Already online
+        return;
+    }
+    
+    bool done = false;
+    for (auto* waiter: m_waiters) {
+        done = (waiter->missing.erase(name) > 0 && waiter->missing.empty()) || done;
+    }
+    if (done) {
+        m_cond.notify_all();
+    }
+}
+
+void ArrivalRegistry::depart(const std::string& name) {
+    std::lock_guard<std::mutex> mylock(m_mutex);
+    m_online.erase(name);
+}
+
+bool ArrivalRegistry::isOnline(const std::string& name) const {
+    std::lock_guard<std::mutex> mylock(m_mutex);
+    return m_online.count(name) > 0;
+}
+
+void ArrivalRegistry::clear() {
+    std::lock_guard<std::mutex> mylock(m_mutex);
+    m_online.clear();
+}
+
+std::vector<std::string> ArrivalRegistry::waitForAll(const std::vector<std::string>& names, double timeout) {
+    Waiter waiter;
+    
+    std::unique_lock<std::mutex> mylock(m_mutex);
+    for (const auto& name: names) {
+        if (m_online.count(name) == 0) {
+            waiter.missing.insert(name);
+        }
+    }
+    
+    if (!waiter.missing.empty()) {
+        auto it = m_waiters.insert(m_waiters.end(), &waiter);
+        auto isDone = [&waiter]() { return waiter.missing.empty(); };
+        if (timeout > 0.0) {
+            m_cond.wait_for(mylock, std::chrono::duration<double>(timeout), isDone);
+        } else {
+            m_cond.wait(mylock, isDone);
+        }
+        m_waiters.erase(it);
+    }
+    
+    return std::vector<std::string>(waiter.missing.begin(), waiter.missing.end());
+}
@@ -0,0 +1,157 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Implement the checkpoint files of a simulation.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <algorithm>
+#include <obnsmn_checkpoint.h>
+
+using namespace OBNsmn;
+
+static const char CHECKPOINT_MAGIC[8] = {'O', 'B', 'N', 'C', 'K', 'P', 'T', '1'};
+
+
+bool CheckpointWriter::open(const std::string& file, simtime_t timeUnit, simtime_t simTime, std::size_t numNodes) {
+    m_file.open(file, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!m_file) {
+        return false;
+    }
+    m_file.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    writeInt(timeUnit);
+    writeInt(simTime);
+    writeInt(numNodes);
+    m_remaining = numNodes;
+    return bool(m_file);
+}
+
+bool CheckpointWriter::write(const CheckpointNode& node) {
+    if (m_remaining == 0) {
+        return false;
+    }
+    --m_remaining;
+
+    writeString(node.name);
+    writeInt(node.update_types.size());
+    for (const auto& u: node.update_types) {
+        writeInt(u.period);
+        writeInt(u.mask);
+        writeInt(u.next_update);
+    }
+    writeInt(node.next_regupdate_time);
+    writeInt(node.next_regupdate_mask);
+
+    std::string irregular;
+    OBNsim::Utils::encodeUpdateList(OBNsim::UpdateList(node.irreg_updates.begin(), node.irreg_updates.end()), irregular);
+    writeString(irregular);
+
+    writeString(node.state);
+    return bool(m_file);
+}
+
+bool CheckpointWriter::close() {
+    m_file.close();
+    return m_remaining == 0 && !m_file.fail();
+}
+
+void CheckpointWriter::writeInt(int64_t v) {
+    char bytes[8];
+    uint64_t x = static_cast<uint64_t>(v);
+    for (int k = 0; k < 8; ++k, x >>= 8) {
+        bytes[k] = static_cast<char>(x & 0xFF);
+    }
+    m_file.write(bytes, 8);
+}
+
+void CheckpointWriter::writeString(const std::string& s) {
+    writeInt(s.size());
+    m_file.write(s.data(), s.size());
+}
+
+
+bool CheckpointReader::open(const std::string& file) {
+    m_file.open(file, std::ios::in | std::ios::binary);
+    if (!m_file) {
+        return false;
+    }
+
+    char magic[sizeof(CHECKPOINT_MAGIC)];
+    int64_t numNodes;
+    if (!m_file.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), CHECKPOINT_MAGIC) ||
+        !readInt(m_time_unit) || !readInt(m_sim_time) || !readInt(numNodes) || numNodes < 0) {
+        return false;
+    }
+    m_num_nodes = m_remaining = numNodes;
+    return true;
+}
+
+bool CheckpointReader::next(CheckpointNode& node) {
+    if (m_remaining == 0) {
+        return false;
+    }
+    --m_remaining;
+
+    int64_t numUpdates, mask;
+    if (!readString(node.name) || !readInt(numUpdates) || numUpdates < 0 || numUpdates > 64) {
+        return false;
+    }
+    node.update_types.resize(numUpdates);
+    for (auto& u: node.update_types) {
+        if (!readInt(u.period) || !readInt(mask) || !readInt(u.next_update)) {
+            return false;
+        }
+        u.mask = mask;
+    }
+    if (!readInt(node.next_regupdate_time) || !readInt(mask)) {
+        return false;
+    }
+    node.next_regupdate_mask = mask;
+
+    std::string irregular;
+    OBNsim::UpdateList updates;
+    if (!readString(irregular) || !OBNsim::Utils::decodeUpdateList(irregular, updates)) {
+        return false;
+    }
+    node.irreg_updates.clear();
+    node.irreg_updates.insert(updates.begin(), updates.end());
+
+    return readString(node.state);
+}
+
+bool CheckpointReader::readInt(int64_t& v) {
+    unsigned char bytes[8];
+    if (!m_file.read(reinterpret_cast<char*>(bytes), 8)) {
+        return false;
+    }
+    uint64_t x = 0;
+    for (int k = 0; k < 8; ++k) {
+        x |= static_cast<uint64_t>(bytes[k]) << (8*k);
+    }
+    v = static_cast<int64_t>(x);
+    return true;
+}
+
+bool CheckpointReader::readString(std::string& s) {
+    int64_t n;
+    if (!readInt(n) || n < 0) {
+        return false;
+    }
+
+    // A corrupted length must not cause a huge allocation: the string is read in chunks
+    const std::size_t chunk = 1 << 20;
+    s.clear();
+    while (n > 0) {
+        std::size_t k = std::min<int64_t>(n, chunk);
+        auto pos = s.size();
+        s.resize(pos + k);
+        if (!m_file.read(&s[pos], k)) {
+            return false;
+        }
+        n -= k;
+    }
+    return true;
+}
@@ -13,9 +13,6 @@
 
 using namespace OBNsmn::MQTT;
 
-// The regex expression to check for topics of node arrival announcements
-std::regex OBNsmn::MQTT::MQTTClient::online_nodes_topic_regex("^(\\w+/)?_smn_/_nodes_/(\\w+)$", std::regex::ECMAScript|std::regex::optimize);
-
 bool MQTTClient::start() {
     if (m_running) return false;  // Already running
     if (!pGC) return false;    // pGC must point to a valid GC object
@@ -92,7 +89,7 @@ void MQTTClient::stop() {
 }
 
 
-int MQTTClient::sendMessage(char* msg, std::size_t msglen, const std::string& topic, int retained) {
+int MQTTClient::sendMessage(char* msg, std::size_t msglen, const std::string& topic, int retained, int qos) {
     if (topic.empty()) {
         return false;
     }
@@ -105,7 +102,7 @@ int MQTTClient::sendMessage(char* msg, std::size_t msglen, const std::string& to
     
     pubmsg.payload = msg;
     pubmsg.payloadlen = msglen;
-    pubmsg.qos = MQTTClient::QOS;
+    pubmsg.qos = (qos < 0)?MQTTClient::QOS:qos;
     pubmsg.retained = retained;
     
     ++m_msgout_count;   // Increase the message count (assuming the next function will be successful).
@@ -143,72 +140,140 @@ bool MQTTClient::sendMessageToGC(const OBNSimMsg::SMN2N &msg) {
 }
 
 
-/* Start waiting for nodes to announce their arrivals. */
-bool MQTTClient::startListeningForArrivals(const std::string& t_workspace) {
-    if (!m_running) {
-        // The client must already be running
-        return false;
-    }
+/* Subscribe to a topic and wait for the result. */
+bool MQTTClient::subscribeAndWait(const std::string& t_topic) {
+    std::lock_guard<std::mutex> requestlock(m_request_mutex);
     
-    if (m_listening_for_arrivals) {
-        // Already listening
-        return true;
-    }
-    
-    // subscribe to the topic
     MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
     int rc;
     opts.onSuccess = &MQTTClient::onSubscribe;
     opts.onFailure = &MQTTClient::onSubscribeFailure;
     opts.context = this;
     
-    auto topic_name = t_workspace + "_smn_/_nodes_/+";  // subscribe to all nodes' announcements
+    // Reset the notification before the request, as the callback may come before we wait
+    std::unique_lock<std::mutex> mylock(m_notify_mutex);
+    m_notify_done = false;
+    mylock.unlock();
     
-    if ((rc = MQTTAsync_subscribe(m_client, topic_name.c_str(), MQTTClient::QOS, &opts)) != MQTTASYNC_SUCCESS)
+    if ((rc = MQTTAsync_subscribe(m_client, t_topic.c_str(), MQTTClient::QOS, &opts)) != MQTTASYNC_SUCCESS)
     {
         OBNsmn::report_error(0, "MQTT error: failed to start subscribe with error code = " + std::to_string(rc));
         return false;
     }
     
     // Wait until subscribed successfully (or failed)
-    std::unique_lock<std::mutex> mylock(m_notify_mutex);
-    m_notify_done = false;
+    mylock.lock();
     m_notify_var.wait(mylock, [this](){ return m_notify_done; });
     
-    m_listening_for_arrivals = (m_notify_result == 0);
-    m_online_nodes_topic = topic_name;
+    return m_notify_result == 0;
+}
+
+/* Unsubscribe from a topic. */
+void MQTTClient::unsubscribe(const std::string& t_topic) {
+    MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
+    int rc;
     
-    return m_listening_for_arrivals;
+    if ((rc = MQTTAsync_unsubscribe(m_client, t_topic.c_str(), &opts)) != MQTTASYNC_SUCCESS)
+    {
+        OBNsmn::report_error(0, "MQTT error: failed to unsubscribe from " + t_topic + " with error code = " + std::to_string(rc));
+    }
 }
 
-/* Stop waiting for nodes to announce their arrivals. */
-void MQTTClient::stopListeningForArrivals() {
-    if (m_running && m_listening_for_arrivals) {
-        // Unsubscribe from the topic
-        MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
-        int rc;
-        // opts.context = this;
-        
-        if ((rc = MQTTAsync_unsubscribe(m_client, m_online_nodes_topic.c_str(), &opts)) != MQTTASYNC_SUCCESS)
-        {
-            OBNsmn::report_error(0, "MQTT error: failed to unsubscribe for nodes' arrival announcements with error code = " + std::to_string(rc));
+/* Start waiting for nodes to announce their arrivals. */
+bool MQTTClient::startListeningForArrivals(const std::string& t_workspace) {
+    if (!m_running) {
+        // The client must already be running
+        return false;
+    }
+    
+    auto topic_prefix = t_workspace + "_smn_/_nodes_/";
+    {
+        std::lock_guard<std::mutex> mylock(m_online_nodes_mutex);
+        if (m_online_nodes_topics.count(topic_prefix) > 0) {
+            // Already listening
+            return true;
         }
-        
-        m_listening_for_arrivals = false;
-        
-        //std::cout << "Stop listening for arrivals\n";
+    }
+    
+    if (!subscribeAndWait(topic_prefix + '+')) {   // subscribe to all nodes' announcements
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> mylock(m_online_nodes_mutex);
+    m_online_nodes_topics.insert(topic_prefix);
+    m_listening_for_arrivals = true;
+    
+    return true;
+}
+
+/* Stop waiting for nodes of a workspace to announce their arrivals. */
+void MQTTClient::stopListeningForArrivals(const std::string& t_workspace) {
+    auto topic_prefix = t_workspace + "_smn_/_nodes_/";
+    {
+        std::lock_guard<std::mutex> mylock(m_online_nodes_mutex);
+        if (m_online_nodes_topics.erase(topic_prefix) == 0) {
+            return;
+        }
+        m_listening_for_arrivals = !m_online_nodes_topics.empty();
+    }
+    
+    if (m_running) {
+        // Unsubscribe from the topic
+        unsubscribe(topic_prefix + '+');
     }
 }
 
 /* Check if a given node has announced its arrival. */
 bool MQTTClient::checkNodeOnline(const std::string& name) {
-    std::lock_guard<std::mutex> mylock(m_online_nodes_mutex);
-    return m_online_nodes.count(name) != 0;
+    return m_arrivals.isOnline(name);
 }
 
 void MQTTClient::clearListOfOnlineNodes() {
-    std::lock_guard<std::mutex> mylock(m_online_nodes_mutex);
-    m_online_nodes.clear();
+    m_arrivals.clear();
+}
+
+/* Route the GC topic of another workspace to its GC. */
+bool MQTTClient::addWorkspace(const std::string& t_topic, GCThread* t_gc) {
+    assert(t_gc);
+    if (!m_running || t_topic.empty() || t_topic == m_portName) {
+        return false;
+    }
+    
+    {
+        std::lock_guard<std::mutex> mylock(m_workspaces_mutex);
+        if (!m_workspaces.emplace(t_topic, t_gc).second) {
+            OBNsmn::report_error(0, "MQTT error: the GC topic " + t_topic + " is already used by another workspace.");
+            return false;
+        }
+    }
+    
+    if (!subscribeAndWait(t_topic)) {
+        std::lock_guard<std::mutex> mylock(m_workspaces_mutex);
+        m_workspaces.erase(t_topic);
+        return false;
+    }
+    
+    // The system port of the workspace's GC sends to its own topic, then calls the previous function (as sendMessageToGC())
+    auto prev = t_gc->getSendMsgToSysPortFunc();
+    t_gc->setSendMsgToSysPortFunc([this, t_topic, prev](const OBNSimMsg::SMN2N &msg) {
+        bool result = sendMessage(msg, t_topic) == MQTTASYNC_SUCCESS;
+        return (prev?prev(msg):true) && result;
+    });
+    return true;
+}
+
+/* Stop routing the GC topic of a workspace. */
+void MQTTClient::removeWorkspace(const std::string& t_topic) {
+    {
+        std::lock_guard<std::mutex> mylock(m_workspaces_mutex);
+        if (m_workspaces.erase(t_topic) == 0) {
+            return;
+        }
+    }
+    
+    if (m_running) {
+        unsubscribe(t_topic);
+    }
 }
 
 
@@ -246,10 +311,24 @@ int MQTTClient::on_message_arrived(void *context, char *topicName, int topicLen,
         
         // Check main GC topic
         bool isGCTopic = topicLen>0?(client->m_portName.compare(0, std::string::npos, topicName, topicLen) == 0):(client->m_portName == topicName);
+        
+        // Otherwise, check the GC topics of the other workspaces
+        GCThread* pGC = client->pGC;
+        if (!isGCTopic) {
+            std::lock_guard<std::mutex> mylock(client->m_workspaces_mutex);
+            if (!client->m_workspaces.empty()) {
+                auto it = client->m_workspaces.find(topicLen>0?std::string(topicName, topicLen):std::string(topicName));
+                if (it != client->m_workspaces.end()) {
+                    pGC = it->second;
+                    isGCTopic = true;
+                }
+            }
+        }
+        
         if (isGCTopic) {
             // Get message and Push to queue
             if (client->m_n2smn_msg.ParseFromArray(message->payload, message->payloadlen)) {
-                client->pGC->pushNodeEvent(client->m_n2smn_msg, 0);
+                pGC->pushNodeEvent(client->m_n2smn_msg, 0);
             } else {
                 OBNsmn::report_error(0, "Critical error: error while parsing input message to MQTT.");
             }
@@ -266,27 +345,25 @@ int MQTTClient::on_message_arrived(void *context, char *topicName, int topicLen,
             
             //std::cout << "Arrival: " << theTopic << "(" << std::string((const char*)message->payload, message->payloadlen) << ") [retained=" << message->retained << "]" << std::endl;
             
-            std::smatch m;
-            bool isArrivalTopic = std::regex_match(theTopic, m, MQTTClient::online_nodes_topic_regex);
+            // An announcement's topic is "workspace/_smn_/_nodes_/node": its prefix must be one of the topics we listen to
+            auto pos = theTopic.rfind('/');
+            bool isArrivalTopic = false;
+            if (pos != std::string::npos) {
+                std::lock_guard<std::mutex> mylock(client->m_online_nodes_mutex);
+                isArrivalTopic = client->m_online_nodes_topics.count(theTopic.substr(0, pos+1)) > 0;
+            }
             if (isArrivalTopic) {
                 // The node names must match
-                if (m.str(2).compare(0, std::string::npos, (const char*)(message->payload), message->payloadlen) == 0) {
-                    {
-                        // Add this node to the list
-                        std::lock_guard<std::mutex> mylock(client->m_online_nodes_mutex);
-                        client->m_online_nodes.emplace((const char*)(message->payload), message->payloadlen);
-                    }
+                if (OBNsim::Utils::isValidIdentifier(theTopic.substr(pos+1)) &&
+                    theTopic.compare(pos+1, std::string::npos, (const char*)(message->payload), message->payloadlen) == 0) {
+                    // Register this node, with its workspace (the topic without "_smn_/_nodes_/")
+                    static const std::size_t nodesTopicLen = std::string("_smn_/_nodes_/").size();
+                    client->m_arrivals.arrive(theTopic.substr(0, pos+1-nodesTopicLen) + theTopic.substr(pos+1));
                     
                     // Send an empty retained message to the topic to delete the retained message on the broker
                     client->sendMessage(nullptr, 0, theTopic, 1);
                 }
-//                else {
-//                    std::cout << "Arrival topic does not match name, got: " << m.str(2) << std::endl;
-//                }
             }
-//            else {
-//                std::cout << "Arrival topic does not match regex\n";
-//            }
         }
     }
     
@@ -365,6 +442,17 @@ void MQTTClient::onReconnect(void* context, MQTTAsync_successData* response)
         client->m_running = false;
         OBNsmn::report_error(0, "MQTT error: failed to restart subscribe with error code = " + std::to_string(rc));
         client->onPermanentConnectionLost();
+        return;
+    }
+    
+    // And the GC topics of the other workspaces
+    std::lock_guard<std::mutex> mylock(client->m_workspaces_mutex);
+    for (const auto& ws: client->m_workspaces) {
+        if ((rc = MQTTAsync_subscribe(client->m_client, ws.first.c_str(), MQTTClient::QOS, &opts)) != MQTTASYNC_SUCCESS)
+        {
+            OBNsmn::report_error(0, "MQTT error: failed to restart subscribe to " + ws.first + " with error code = " + std::to_string(rc));
+            ws.second->criticalErrorExit();
+        }
     }
 }
 
@@ -436,7 +524,7 @@ bool OBNNodeMQTT::sendMessage(int nodeID, OBNSimMsg::SMN2N &msg) {
     
     // Request to send the message
     int rc;
-    if ((rc = m_client->sendMessage(m_buffer, msgsize, m_topic.c_str())) != MQTTASYNC_SUCCESS) {
+    if ((rc = m_client->sendMessage(m_buffer, msgsize, m_topic.c_str(), 0, msg.has_seq()?m_client->seqQoS():-1)) != MQTTASYNC_SUCCESS) {
         OBNsmn::report_error(0, "MQTT error: failed to start sending message to node " + std::to_string(nodeID) +
                              " with error code " + std::to_string(rc));
         return false;
@@ -446,3 +534,35 @@ bool OBNNodeMQTT::sendMessage(int nodeID, OBNSimMsg::SMN2N &msg) {
 
     return true;
 }
+
+
+/** Sends a message, already serialized and completed for the node, asynchronously.
+ MQTT copies the payload, so the frame's bytes are sent without being copied to the node's buffer.
+ \param nodeID The node's ID, which is its index in the list of all nodes, managed by the GC.
+ \param frame The serialized message.
+ \return True if successful.
+ */
+bool OBNNodeMQTT::sendFrame(int nodeID, const SMN2NFrame &frame) {
+    int rc;
+    if ((rc = m_client->sendMessage(const_cast<char*>(frame.data()), frame.size(), m_topic.c_str(), 0, frame.hasSeq()?m_client->seqQoS():-1)) != MQTTASYNC_SUCCESS) {
+        OBNsmn::report_error(0, "MQTT error: failed to start sending message to node " + std::to_string(nodeID) +
+                             " with error code " + std::to_string(rc));
+        return false;
+    }
+    return true;
+}
+
+
+/** Publishes a message, serialized without ID, once on the group's topic.
+ \param frame The serialized message.
+ \return True if successful.
+ */
+bool OBNNodeGroupMQTT::sendFrame(const SMN2NFrame &frame) {
+    int rc;
+    if ((rc = m_client->sendMessage(const_cast<char*>(frame.data()), frame.size(), m_topic.c_str(), 0, frame.hasSeq()?m_client->seqQoS():-1)) != MQTTASYNC_SUCCESS) {
+        OBNsmn::report_error(0, "MQTT error: failed to start sending message to topic " + m_topic +
+                             " with error code " + std::to_string(rc));
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,131 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Implement the communication interface over shared memory.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <obnsmn_basic.h>
+#include <obnsmn_comm_shm.h>
+
+using namespace OBNsmn::SHM;
+
+
+bool ShmServer::start() {
+    if (m_running) return false;  // Already running
+    if (!pGC) return false;    // pGC must point to a valid GC object
+
+    if (m_port_name.empty()) {
+        OBNsmn::report_error(0, "Shared memory error: the SMN's port name must be set.");
+        return false;
+    }
+
+    std::string error;
+    if (!m_segment.create(OBNsim::Shm::segmentName(m_port_name), m_capacity, error)) {
+        OBNsmn::report_error(0, "Shared memory error: " + error);
+        return false;
+    }
+    m_segment.setOnline(true);
+
+    m_running = true;
+    m_thread = std::thread(&ShmServer::threadMain, this);
+
+    OBNsmn::report_info(0, "Shared memory server started on " + m_segment.name() + ".");
+    return true;
+}
+
+
+void ShmServer::stop() {
+    if (m_running) {
+        // Wake up the thread, which then exits
+        m_running = false;
+        m_segment.wake();
+    }
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    m_segment.close();
+}
+
+
+bool ShmServer::checkNodeOnline(const std::string& portName) {
+    auto segment = getSegment(portName);
+    if (segment->isOnline()) {
+        return true;
+    }
+
+    // The node may not have created its segment yet, or it may have restarted with a new segment
+    std::string error;
+    return segment->open(OBNsim::Shm::segmentName(portName), error) && segment->isOnline();
+}
+
+
+std::shared_ptr<OBNsim::Shm::Segment> ShmServer::getSegment(const std::string& portName) {
+    std::lock_guard<std::mutex> mylock(m_nodes_mutex);
+    auto& segment = m_nodes[portName];
+    if (!segment) {
+        segment = std::make_shared<OBNsim::Shm::Segment>();
+    }
+    return segment;
+}
+
+
+void ShmServer::threadMain() {
+    while (m_running) {
+        m_segment.read([this](uint32_t channel, const char* data, std::size_t size) {
+            if (channel != OBNsim::Shm::CHANNEL_SMN) {
+                OBNsmn::report_warning(0, "Shared memory error: frame on unknown channel " + std::to_string(channel) + " ignored.");
+            } else if (m_n2smn_msg.ParseFromArray(data, size)) {
+                pGC->pushNodeEvent(m_n2smn_msg, 0);
+            } else {
+                OBNsmn::report_error(0, "Critical error: error while parsing input message from shared memory.");
+            }
+        });
+        if (m_running) {
+            m_segment.wait();
+        }
+    }
+}
+
+
+///////////////////////////////////////////////
+// Implementation of OBNNodeShm
+///////////////////////////////////////////////
+
+/** Sends an SMN2N message to a given node, without waiting for it to be received.
+ \param nodeID The node's ID, which is its index in the list of all nodes, managed by the GC.
+ \param msg The message object, of type OBNSimMsg::SMN2N, that contains the message data.
+ \return True if successful.
+ */
+bool OBNNodeShm::sendMessage(int nodeID, OBNSimMsg::SMN2N &msg) {
+    msg.set_id(nodeID);
+
+    // The message is serialized directly into the node's ring
+    auto size = msg.ByteSizeLong();
+    bool success = m_segment->writeWith(OBNsim::Shm::CHANNEL_SMN, size, [&msg](char* dest) {
+        msg.SerializeWithCachedSizesToArray(reinterpret_cast<google::protobuf::uint8*>(dest));
+    });
+    if (!success) {
+        OBNsmn::report_error(0, "Shared memory error: failed to send message to node " + std::to_string(nodeID) +
+                             (m_segment->isOnline()?".":" (offline)."));
+    }
+    return success;
+}
+
+
+/** Sends a message, already serialized and completed for the node.
+ \param nodeID The node's ID, which is its index in the list of all nodes, managed by the GC.
+ \param frame The serialized message.
+ \return True if successful.
+ */
+bool OBNNodeShm::sendFrame(int nodeID, const SMN2NFrame &frame) {
+    if (!m_segment->write(OBNsim::Shm::CHANNEL_SMN, frame.data(), frame.size())) {
+        OBNsmn::report_error(0, "Shared memory error: failed to send message to node " + std::to_string(nodeID) +
+                             (m_segment->isOnline()?".":" (offline)."));
+        return false;
+    }
+    return true;
+}
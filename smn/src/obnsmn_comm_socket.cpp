@@ -0,0 +1,400 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Implement the communication interface over sockets.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+#include <obnsmn_basic.h>
+#include <obnsmn_comm_socket.h>
+
+using namespace OBNsmn::SOCKET;
+
+
+bool SocketServer::start() {
+    if (m_running) return false;  // Already running
+    if (!pGC) return false;    // pGC must point to a valid GC object
+
+    if (m_address.empty()) {
+        OBNsmn::report_error(0, "Socket error: the address to listen on must be set.");
+        return false;
+    }
+
+    std::string error;
+    m_listen_fd = OBNsim::Socket::listenOn(m_address, error);
+    if (m_listen_fd < 0) {
+        OBNsmn::report_error(0, "Socket error: " + error);
+        return false;
+    }
+
+    if (::pipe(m_wakeup_fds) != 0) {
+        OBNsmn::report_error(0, std::string("Socket error: could not create pipe: ") + std::strerror(errno));
+        OBNsim::Socket::closeSocket(m_listen_fd);
+        m_listen_fd = -1;
+        return false;
+    }
+
+#ifdef __linux__
+    m_poll_fd = ::epoll_create1(0);
+    if (m_poll_fd < 0) {
+        OBNsmn::report_error(0, std::string("Socket error: could not create epoll instance: ") + std::strerror(errno));
+        stop();
+        return false;
+    }
+#endif
+
+    if (!watch(m_listen_fd) || !watch(m_wakeup_fds[0])) {
+        stop();
+        return false;
+    }
+
+    m_running = true;
+    m_thread = std::thread(&SocketServer::threadMain, this);
+
+    OBNsmn::report_info(0, "Socket server listening on " + m_address + ".");
+    return true;
+}
+
+
+void SocketServer::stop() {
+    if (m_running) {
+        // Wake up the thread, which then exits
+        m_running = false;
+        char c = 0;
+        while (::write(m_wakeup_fds[1], &c, 1) < 0 && errno == EINTR) { }
+    }
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    // Close the connections, the listening socket and the pipe
+    std::vector<int> fds;
+    for (const auto& conn: m_connections) {
+        fds.push_back(conn.first);
+    }
+    for (auto fd: fds) {
+        closeConnection(fd);
+    }
+
+    if (m_listen_fd >= 0) {
+        OBNsim::Socket::closeSocket(m_listen_fd);
+        OBNsim::Socket::unlinkAddress(m_address);
+        m_listen_fd = -1;
+    }
+    for (auto& fd: m_wakeup_fds) {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    if (m_poll_fd >= 0) {
+        ::close(m_poll_fd);
+        m_poll_fd = -1;
+    }
+}
+
+
+bool SocketServer::checkNodeOnline(const std::string& portName) {
+    return m_arrivals.isOnline(portName);
+}
+
+
+std::shared_ptr<OBNsim::Socket::FrameWriter> SocketServer::getChannel(const std::string& portName) {
+    std::lock_guard<std::mutex> mylock(m_channels_mutex);
+    auto& channel = m_channels[portName];
+    if (!channel) {
+        channel = std::make_shared<OBNsim::Socket::FrameWriter>();
+    }
+    return channel;
+}
+
+
+bool SocketServer::watch(int fd) {
+#ifdef __linux__
+    epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (::epoll_ctl(m_poll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        OBNsmn::report_error(0, std::string("Socket error: could not watch socket: ") + std::strerror(errno));
+        return false;
+    }
+#endif
+    // With poll(), the sockets to wait on are collected in each iteration of the thread
+    return true;
+}
+
+
+void SocketServer::threadMain() {
+    std::vector<int> ready;     // The sockets ready to be read in an iteration
+
+#ifdef __linux__
+    const int MAX_EVENTS = 64;
+    epoll_event events[MAX_EVENTS];
+#else
+    std::vector<pollfd> pollfds;
+#endif
+
+    while (m_running) {
+        ready.clear();
+#ifdef __linux__
+        int n = ::epoll_wait(m_poll_fd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            OBNsmn::report_error(0, std::string("Socket error: epoll_wait failed: ") + std::strerror(errno));
+            pGC->criticalErrorExit();
+            break;
+        }
+        for (int k = 0; k < n; ++k) {
+            ready.push_back(events[k].data.fd);
+        }
+#else
+        pollfds.clear();
+        pollfds.push_back({m_wakeup_fds[0], POLLIN, 0});
+        pollfds.push_back({m_listen_fd, POLLIN, 0});
+        for (const auto& conn: m_connections) {
+            pollfds.push_back({conn.first, POLLIN, 0});
+        }
+        int n = ::poll(pollfds.data(), pollfds.size(), -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            OBNsmn::report_error(0, std::string("Socket error: poll failed: ") + std::strerror(errno));
+            pGC->criticalErrorExit();
+            break;
+        }
+        for (const auto& p: pollfds) {
+            if (p.revents != 0) {
+                ready.push_back(p.fd);
+            }
+        }
+#endif
+
+        for (auto fd: ready) {
+            if (fd == m_wakeup_fds[0]) {
+                // stop() has been called
+                return;
+            }
+            if (fd == m_listen_fd) {
+                acceptConnection();
+                continue;
+            }
+            auto it = m_connections.find(fd);
+            if (it != m_connections.end() && !receiveFrames(*(it->second))) {
+                closeConnection(fd);
+            }
+        }
+    }
+}
+
+
+void SocketServer::acceptConnection() {
+    int fd = OBNsim::Socket::acceptFrom(m_listen_fd);
+    if (fd < 0) {
+        OBNsmn::report_warning(0, std::string("Socket error: could not accept connection: ") + std::strerror(errno));
+        return;
+    }
+    m_connections[fd].reset(new Connection(fd));
+    if (!watch(fd)) {
+        m_connections.erase(fd);
+        OBNsim::Socket::closeSocket(fd);
+    }
+}
+
+
+std::string SocketServer::Connection::description() const {
+    if (names.size() == 1) {
+        return "node " + names.front();
+    }
+    std::string result = "nodes";
+    for (const auto& name: names) {
+        result += (' ' + name);
+    }
+    return result;
+}
+
+
+bool SocketServer::receiveFrames(Connection& conn) {
+    auto n = conn.reader.receive(conn.fd);
+    if (n <= 0) {
+        if (n < 0) {
+            OBNsmn::report_warning(0, "Socket error: could not read from " + conn.description() + ": " + std::strerror(errno));
+        }
+        return false;
+    }
+
+    const char* data;
+    std::size_t size;
+    while (conn.reader.next(data, size)) {
+        if (conn.names.empty()) {
+            // The first frame is the name of the node's GC port, or the names of the hosted nodes' ports
+            registerConnection(conn, data, size);
+        } else if (m_n2smn_msg.ParseFromArray(data, size)) {
+            pGC->pushNodeEvent(m_n2smn_msg, 0);
+        } else {
+            OBNsmn::report_error(0, "Critical error: error while parsing input message from socket.");
+        }
+    }
+
+    if (conn.reader.bad()) {
+        OBNsmn::report_warning(0, "Socket error: invalid frame received from " + conn.description() + "; its connection is closed.");
+        return false;
+    }
+    return true;
+}
+
+
+void SocketServer::registerConnection(Connection& conn, const char* data, std::size_t len) {
+    // A list of names, each terminated by '\0', is sent by a process hosting several nodes
+    const char* end = data + len;
+    bool shared = std::find(data, end, '\0') != end;
+    if (shared) {
+        for (const char* p = data; p < end; ) {
+            const char* next = std::find(p, end, '\0');
+            if (next > p) {
+                conn.names.emplace_back(p, next);
+            }
+            p = next + 1;
+        }
+    } else if (len > 0) {
+        conn.names.emplace_back(data, len);
+    }
+    if (conn.names.empty()) {
+        OBNsmn::report_warning(0, "Socket error: a node has connected with an empty name.");
+        return;
+    }
+
+    // A node which reconnects replaces its previous connection
+    std::vector<int> previous;
+    for (const auto& other: m_connections) {
+        if (other.first == conn.fd) {
+            continue;
+        }
+        for (const auto& name: other.second->names) {
+            if (std::find(conn.names.begin(), conn.names.end(), name) != conn.names.end()) {
+                previous.push_back(other.first);
+                break;
+            }
+        }
+    }
+    for (auto fd: previous) {
+        closeConnection(fd);
+    }
+
+    if (shared) {
+        // The nodes' channels forward their frames to the writer of the connection, tagged with the nodes' indices
+        conn.shared = std::make_shared<OBNsim::Socket::FrameWriter>();
+        conn.shared->attach(conn.fd);
+        for (std::size_t k = 0; k < conn.names.size(); ++k) {
+            getChannel(conn.names[k])->attach(conn.shared, k);
+        }
+    } else {
+        getChannel(conn.names.front())->attach(conn.fd);
+    }
+
+    for (const auto& name: conn.names) {
+        m_arrivals.arrive(name);
+    }
+}
+
+
+void SocketServer::closeConnection(int fd) {
+    auto it = m_connections.find(fd);
+    if (it == m_connections.end()) {
+        return;
+    }
+
+#ifdef __linux__
+    ::epoll_ctl(m_poll_fd, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+
+    // The GC may be writing to the connection, so it must be detached before being closed
+    const auto& conn = *(it->second);
+    if (conn.shared) {
+        for (const auto& name: conn.names) {
+            getChannel(name)->detach(conn.shared);
+        }
+        conn.shared->detach(fd);
+    } else if (!conn.names.empty()) {
+        getChannel(conn.names.front())->detach(fd);
+    }
+    for (const auto& name: conn.names) {
+        m_arrivals.depart(name);
+    }
+
+    OBNsim::Socket::closeSocket(fd);
+    m_connections.erase(it);
+}
+
+
+///////////////////////////////////////////////
+// Implementation of OBNNodeSocket
+///////////////////////////////////////////////
+
+/** Sends an SMN2N message to a given node, without waiting for it to be received.
+ \param nodeID The node's ID, which is its index in the list of all nodes, managed by the GC.
+ \param msg The message object, of type OBNSimMsg::SMN2N, that contains the message data.
+ \return True if successful.
+ */
+bool OBNNodeSocket::sendMessage(int nodeID, OBNSimMsg::SMN2N &msg) {
+    msg.set_id(nodeID);
+
+    // Serialize the message to the buffer
+    m_buffer.allocateData(msg.ByteSizeLong());
+    if (!msg.SerializeToArray(m_buffer.data(), m_buffer.size())) {
+        return false;
+    }
+
+    if (!m_channel->write(m_buffer.data(), m_buffer.size())) {
+        OBNsmn::report_error(0, "Socket error: failed to send message to node " + std::to_string(nodeID) +
+                             (m_channel->isAttached()?".":" (not connected)."));
+        return false;
+    }
+    return true;
+}
+
+
+/** Sends a message, already serialized and completed for the node.
+ \param nodeID The node's ID, which is its index in the list of all nodes, managed by the GC.
+ \param frame The serialized message.
+ \return True if successful.
+ */
+bool OBNNodeSocket::sendFrame(int nodeID, const SMN2NFrame &frame) {
+    if (!m_channel->write(frame.data(), frame.size())) {
+        OBNsmn::report_error(0, "Socket error: failed to send message to node " + std::to_string(nodeID) +
+                             (m_channel->isAttached()?".":" (not connected)."));
+        return false;
+    }
+    return true;
+}
+
+
+/** Ends a bundle of messages; the bundled messages are sent if no other node of the connection has a bundle in progress.
+ \return True if successful.
+ */
+bool OBNNodeSocket::endBundle() {
+    if (!m_channel->endBundle()) {
+        OBNsmn::report_error(0, "Socket error: failed to send a bundle of messages" +
+                             std::string(m_channel->isAttached()?".":" (not connected)."));
+        return false;
+    }
+    return true;
+}
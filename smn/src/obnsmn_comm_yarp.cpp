@@ -66,6 +66,18 @@ bool OBNNodeYARP::sendMessage(int nodeID, OBNSimMsg::SMN2N &msg) {
 }
 
 
+/** Sends a message, already serialized and completed for the node, asynchronously.
+\param nodeID The node's ID, which is its index in the list of all nodes, managed by the GC.
+\param frame The serialized message.
+\return True if successful.
+*/
+bool OBNNodeYARP::sendFrame(int nodeID, const SMN2NFrame &frame) {
+    port->prepare().setFrame(frame);
+    port->writeStrict();
+    return true;
+}
+
+
 // NOT USED
 /* Sends an SMN2N message to a given node synchronously, i.e. it will wait until the message has been sent to the node.
 The method may time out, depending on the configuration of the communication framework.
@@ -14,28 +14,62 @@
 
 bool OBNsmn::GCThread::gc_waitfor_process_ACK(const OBNSimMsg::N2SMN& msg, int ID) {
     OBNSimMsg::N2SMN::MSGTYPE type = msg.msgtype();
+    AckTracker::Result result;
     
-    std::lock_guard<std::mutex> lock(gc_waitfor_mutex);
-    if (gc_waitfor_status == GC_WAITFOR_RESULT_ERROR) { return true; }
-    if (gc_waitfor_status != GC_WAITFOR_RESULT_ACTIVE || gc_waitfor_type != type) {
-        report_warning(0, "Unexpected ACK received from node " + std::to_string(ID) + " with type " + std::to_string(type) +
-                       " expecting type " + std::to_string(gc_waitfor_type));
+    // An ACK of a message of a previous wait-for (e.g. re-sent by a node which received a retransmitted message twice) is ignored
+    if (msg.has_seq() && msg.seq() != gc_seq.load()) {
         return true;
     }
-    if (gc_waitfor_predicate && !gc_waitfor_predicate(msg)) {
-        // Invalid ACK messasge
-        gc_waitfor_status = GC_WAITFOR_RESULT_ERROR;
-        mWakeupCondition.notify_all();
-        return true;
-    }
-    // This ACK message has been checked -> check it in the bit array
-    if (!gc_waitfor_bits[ID]) {
-        gc_waitfor_bits[ID] = true;
-        gc_waitfor_num--;
+    
+    // A node may declare in its SIM_Y_ACK that it doesn't need UPDATE_X in this iteration
+    auto checkUpdateX = [this, &msg, type, ID]() {
+        if (type == OBNSimMsg::N2SMN::SIM_Y_ACK && msg.has_data() && (msg.data().i() & OBNsim::YACK_NO_UPDATE_X)) {
+            gc_skip_update_x[ID] = 1;
+        }
+    };
+    
+    if (gc_waitfor_dataflow) {
+        // ACKs of a dataflow dispatch change the run-time graph, so they are processed one at a time.
+        // The nodes which become independent are registered before this ACK is counted, so the wait-for can't finish too early.
+        std::lock_guard<std::mutex> lock(gc_waitfor_mutex);
+        result = gc_waitfor.acknowledge(ID, type, [this, ID, &checkUpdateX]() {
+            checkUpdateX();
+            const auto & nextNodes = rtNodeGraph->finishNodeUpdate(ID);
+            if (!nextNodes.empty()) {
+                gc_dataflow_send(nextNodes);
+            }
+            else if (gc_waitfor.remaining() == 1 && !rtNodeGraph->empty()) {
+                // Nothing else is in progress but there are remaining nodes: algebraic loop
+                gc_report_algebraic_loop();
+                return false;
+            }
+            return true;
+        });
+    } else {
+        result = gc_waitfor.acknowledge(ID, type, [this, &msg, &checkUpdateX]() {
+            if (gc_waitfor_predicate && !gc_waitfor_predicate(msg)) {
+                return false;
+            }
+            checkUpdateX();
+            return true;
+        });
     }
-    if (gc_waitfor_num == 0) {
-        gc_waitfor_status = GC_WAITFOR_RESULT_DONE;
-        mWakeupCondition.notify_all();
+    
+    switch (result) {
+        case AckTracker::COMPLETED:
+        case AckTracker::FAILED:
+            // Only wake up the GC when the wait-for has finished, successfully or not
+            mWakeupSignal.notify();
+            break;
+            
+        case AckTracker::UNEXPECTED:
+            report_warning(0, "Unexpected ACK received from node " + std::to_string(ID) + " with type " + std::to_string(type) +
+                           " expecting type " + std::to_string(gc_waitfor.type()));
+            break;
+            
+        default:
+            // ACKs accepted but not the last one, or ignored (duplicate, stale, in error)
+            break;
     }
     return true;
 }
@@ -50,7 +84,35 @@ bool OBNsmn::GCThread::gc_waitfor_process_ACK(const OBNSimMsg::N2SMN& msg, int I
  \return true if successful.
  */
 bool OBNsmn::GCThread::pushNodeEvent(const OBNSimMsg::N2SMN& msg, int defaultID, bool overrideID) {
-    int ID = overrideID?defaultID:(msg.has_id()?msg.id():defaultID);
+    // The messages of the nodes of the parallel components are processed by them; the anonymous messages (e.g. requests to stop) by all of them
+    if (!m_components.empty()) {
+        if (!overrideID && !msg.has_id()) {
+            bool success = true;
+            for (auto& comp: m_components) {
+                success = comp->pushNodeEvent(msg, defaultID) && success;
+            }
+            return success;
+        }
+        int wireID = overrideID?defaultID:msg.id();
+        for (auto it = m_components.rbegin(); it != m_components.rend(); ++it) {
+            if (wireID >= (*it)->m_first_node_id) {
+                return (*it)->pushNodeEvent(msg, defaultID, overrideID);
+            }
+        }
+        report_warning(0, "Received message (type: " + std::to_string(msg.msgtype()) + ") with an invalid ID (" + std::to_string(wireID) + ").");
+        return false;
+    }
+    
+    // The messages of the nodes of the sub-coordinators are processed by them
+    if (!overrideID && msg.has_id() && !m_subs.empty() && msg.id() >= m_subs.front()->m_first_node_id) {
+        for (auto it = m_subs.rbegin(); it != m_subs.rend(); ++it) {
+            if (msg.id() >= (*it)->m_first_node_id) {
+                return (*it)->pushNodeEvent(msg, defaultID);
+            }
+        }
+    }
+    
+    int ID = overrideID?defaultID:(msg.has_id()?(msg.id() - m_first_node_id):defaultID);
     bool hasID = msg.has_id() || overrideID;
     OBNSimMsg::N2SMN::MSGTYPE type = msg.msgtype();
     
@@ -71,6 +133,8 @@ bool OBNsmn::GCThread::pushNodeEvent(const OBNSimMsg::N2SMN& msg, int defaultID,
             case OBNSimMsg::N2SMN::SIM_Y_ACK:
             case OBNSimMsg::N2SMN::SIM_X_ACK:
             case OBNSimMsg::N2SMN::SIM_INIT_ACK:
+            case OBNSimMsg::N2SMN::SIM_SAVE_ACK:
+            case OBNSimMsg::N2SMN::SIM_LOAD_ACK:
                 // pushEvent(new SMNNodeEvent(type, OBNsmn::SMNNodeEvent::EVT_ACK, ID));
                 // return true;
                 // Process wait-for here
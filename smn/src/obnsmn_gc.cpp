@@ -13,7 +13,9 @@
 #include <chrono>
 #include <iostream>
 #include <algorithm>
+#include <map>
 #include <obnsmn_gc.h>
+#include <obnsmn_checkpoint.h>
 #include <obnsmn_gc_inline.h>
 #include <obnsmn_report.h>
 
@@ -90,79 +92,49 @@ void GCThread::GCThreadMain() {
     
     bool continueSimulation = true; // whether the simulation continues
     
-    // Send the SIM_INIT message to all nodes to start the simulation
-    {
-        OBNSimMsg::MSGDATA *pMsgData = new OBNSimMsg::MSGDATA();
-        pMsgData->set_t(initial_wallclock); // initial wallclock time
-        
-        int64_t time_unit = sim_time_unit;  // simulation time unit, in microseconds
-        
-        noCriticalError = gc_send_to_all(0, OBNSimMsg::SMN2N_MSGTYPE_SIM_INIT, OBNSimMsg::N2SMN_MSGTYPE_SIM_INIT_ACK, &time_unit, pMsgData,
-                                         [this](const OBNSimMsg::N2SMN& msg) {
-                                             if (!msg.has_id()) {
-                                                 return false;
-                                             }
-                                             if (msg.has_data() && msg.data().has_i() && msg.data().i() != 0) {
-                                                 report_error(0, "Node \"" + _nodes[msg.id()]->name + "\" had initialization error #" + std::to_string(msg.data().i()));
-                                                 return false;
-                                             }
-                                             return true;
-                                         });
+    if (!m_components.empty()) {
+        // The simulation is run by the parallel components
+        gc_run_components();
+        return;
     }
     
-    // Wait for ACKs from all nodes, checking for initialization errors
-    if (noCriticalError) {
-        continueSimulation = gc_wait_for_ack();
+    if (m_send_msg_to_parent) {
+        // A sub-coordinator runs the iterations commanded by its parent, until SIM_TERM
+        gc_subordinate_main();
+        noCriticalError = true;
+        continueSimulation = false;
+    }
+    else {
+        // Send the SIM_INIT message to all nodes to start the simulation, then wait for ACKs from all nodes, checking for initialization errors
+        noCriticalError = gc_send_init();
+        if (noCriticalError) {
+            continueSimulation = gc_wait_for_ack();
+        }
+        
+        // Resume from a checkpoint, if any: the nodes restore their saved states
+        if (noCriticalError && continueSimulation && !resume_file.empty()) {
+            continueSimulation = gc_resume();
+        }
     }
     
     // Running while the current state is not STOPPED
     while (continueSimulation && noCriticalError && gc_exec_state != GCSTATE_TERMINATING) {
-        if (!startNextUpdate()) {
-            // Error, can't continue simulation
-            break;
-        }
-
-        // Update-Y
-        if (gc_update_size > 0) {
-            // Create the run-time node graph, for regular updates
-            rtNodeGraph = _nodeGraph->getRTNodeDepGraph(gc_update_list.begin(), gc_update_size);
-            
-            // Send regular UPDATE_Y messages to nodes in the run-time graph, in correct order
-            bool success;
-            while (!rtNodeGraph->empty()) {
-                if (!(success = gc_send_update_y())) {
-                    // Error, stop simulation
-                    break;
-                }
-                
-                // Wait for ACKs while processing all events: returns true if there is an error (e.g. timeout)
-                if (!gc_wait_for_ack()) {
-                    success = false;
-                    break;
-                }
-            }
-            if (!success) {
+        // Save the checkpoint, if any, before the first iteration after its time
+        if (checkpoint_time >= 0 && !gc_checkpoint_saved && (gc_scheduler.empty() || gc_scheduler.nextTime() > checkpoint_time)) {
+            if (!gc_save_checkpoint()) {
                 break;
             }
         }
         
-        // Send UPDATE_X to all nodes that are updated in this iteration
-        if (!gc_send_update_x()) {
-            // Error, stop simulation
-            break;
-        }
-        
-        // Wait for ACKs while processing all events: returns false if the simulation should stop (e.g. timeout)
-        if (!gc_wait_for_ack()) {
+        if (!startNextUpdate()) {
+            // Error, can't continue simulation
             break;
         }
 
-        gc_timer_reset();   // Turn off the timer, just in case
-        
-        
-        // Update nodes in the update list to their next regular updates.
-        for (auto i = 0; i < gc_update_size; ++i) {
-            _nodes[gc_update_list[i].nodeID]->finishCurrentUpdate();
+        // Update-Y, then UPDATE_X to all nodes that are updated in this iteration
+        if (!gc_run_update_y(gc_update_list.begin(), gc_update_size) || !gc_run_update_x()) {
+            // Error, stop simulation
+            break;
         }
         
         
@@ -209,18 +181,82 @@ void GCThread::GCThreadMain() {
 
     }
     
+    // With warm restarts, the nodes are kept running if the simulation has reached its final time
+    gc_nodes_kept = keep_nodes_running && noCriticalError && gc_reached_final_time && m_subs.empty();
+    
     // The simulation is going to be terminated, send terminating messages to all nodes, unless there was a critical error
-    if (noCriticalError) {
+    if (noCriticalError && !gc_nodes_kept) {
         noCriticalError = gc_send_to_all(current_sim_time, OBNSimMsg::SMN2N_MSGTYPE_SIM_TERM);
     }
+    
+    // Report statistics of lookahead windows, if any
+    if (gc_lookahead_windows > 0) {
+        report_info(0, "Lookahead: " + std::to_string(gc_lookahead_windows) + " windows granted, " +
+                    std::to_string(gc_lookahead_count) + " updates performed in them.");
+    }
+    
+    // Report statistics of node groups, if any
+    if (!m_node_groups.empty()) {
+        report_info(0, "Node groups: " + std::to_string(m_node_groups.size()) + " groups, " +
+                    std::to_string(gc_group_sends) + " messages sent to groups.");
+    }
+    
+    // Report the retransmissions, if any
+    if (gc_retransmissions > 0) {
+        report_info(0, "Reliability: " + std::to_string(gc_retransmissions) + " messages retransmitted.");
+    }
+    
+    // Report statistics of the dependency graph, if any
+    {
+        auto graph_stats = _nodeGraph->statistics();
+        if (!graph_stats.empty()) {
+            report_info(0, graph_stats);
+        }
+    }
 
-    // Signal simple threads, which are associated with this GC, to terminate
-    simple_thread_terminate = true;
+    // The sub-coordinators have received SIM_TERM, unless there was a critical error: make sure that they stop
+    for (auto& sub: m_subs) {
+        sub->setSysRequest(SYSREQ_TERMINATE);
+    }
+    
+    // Signal simple threads, which are associated with this GC, to terminate, unless the nodes are kept for a restart
+    if (!gc_nodes_kept) {
+        simple_thread_terminate = true;
+    }
     
     gc_exec_state = GCSTATE_STOPPED;
 }
 
 
+bool GCThread::nodesKeptRunning() const {
+    if (!m_components.empty()) {
+        return std::all_of(m_components.begin(), m_components.end(), [](const std::unique_ptr<GCThread>& comp) { return comp->nodesKeptRunning(); });
+    }
+    return gc_nodes_kept;
+}
+
+
+bool GCThread::terminateNodes() {
+    if (_gcthread) {
+        return false;
+    }
+    
+    bool success = true;
+    for (auto& comp: m_components) {
+        success = comp->terminateNodes() && success;
+    }
+    
+    if (gc_nodes_kept) {
+        gc_nodes_kept = false;
+        success = gc_send_to_all(current_sim_time, OBNSimMsg::SMN2N_MSGTYPE_SIM_TERM) && success;
+    }
+    
+    // Signal simple threads, which are associated with this GC, to terminate
+    simple_thread_terminate = true;
+    return success;
+}
+
+
 /**
  Initialize the simulation before it can start, e.g. reset the clock, reset the node's state.
  
@@ -268,22 +304,56 @@ bool GCThread::initialize() {
     // Start the simulation clock at < 0 to ensure that the next update will be at t=0,
     // otherwise it will be an error (no progress).
     current_sim_time = -1;
+    gc_reached_final_time = false;
+    gc_nodes_kept = false;
+    gc_checkpoint_saved = false;
     
     // Reset the wait-for mechanism
-    {
-        std::lock_guard<std::mutex> mlock(gc_waitfor_mutex);
-        gc_waitfor_status = GC_WAITFOR_RESULT_NONE;
-        gc_waitfor_bits.resize(_nodes.size());  // One bit for each node
-        std::fill(gc_waitfor_bits.begin(), gc_waitfor_bits.end(), true);    // Set all bits
-    }
+    gc_waitfor_dataflow = false;
+    gc_waitfor.resize(_nodes.size());   // One bit for each node
     
     // Turn off timer event
     gc_timer_reset();
     
     // Pre-allocate the update info list
     gc_update_list.resize(_nodes.size());
+    gc_skip_update_x.assign(_nodes.size(), 0);
+    
+    // Nodes which are not in any group
+    m_node_group_of.resize(_nodes.size(), -1);
+    gc_group_sends = 0;
+    
+    // Reset the retransmission records
+    gc_resend.clear();
+    gc_resend.resize(_nodes.size());
+    gc_seq = 0;
+    gc_retransmissions = 0;
+    
+    // Reset the lookahead windows
+    m_lookahead_consumers.resize(_nodes.size());
+    gc_lookahead_end.assign(_nodes.size(), -1);
+    gc_lookahead_windows = 0;
+    gc_lookahead_count = 0;
     gc_update_size = 0;
     
+    // Schedule the first updates of all nodes
+    gc_scheduler.reset(_nodes.size());
+    for (int nodeID = 0; nodeID <= maxID; ++nodeID) {
+        gc_scheduler.set(nodeID, _nodes[nodeID]->getNextUpdate());
+    }
+    gc_next_nodes.reserve(_nodes.size());
+    
+    // Reset the state of the sub-coordinator, if any
+    gc_parent_id = -1;
+    gc_parent_seq = 0;
+    gc_parent_ack.Clear();
+    gc_parent_update_x = false;
+    gc_parent_requested.clear();
+    gc_parent_in_step = false;
+    gc_parent_open = 0;
+    gc_parent_event_acks = 0;
+    gc_parent_stop_requester = -1;
+    
     return true;
 }
 
@@ -296,38 +366,16 @@ bool GCThread::initialize() {
  \return true if the simulation can continue
  */
 bool GCThread::startNextUpdate() {
-    // All nodes should have already updated their next update times
-    simtime_t t = -1;
-    simtime_t t_node;
+    // All nodes should have already updated their next update times in the scheduler
+    // NOTE THAT node's update time can be < 0, which means it is completely irregular and no next update time; such nodes are not in the scheduler
+    simtime_t t = gc_scheduler.nextNodes(gc_next_nodes);
     
-    // Reset the update info list
-    gc_update_size = 0;
+    // Fill in the update info list, in increasing order of node IDs
+    gc_update_size = gc_next_nodes.size();
     auto updateIt = gc_update_list.begin();
-    
-    // Iterate the node list and find the next update time, while filling in the update info list
-    int nodeID = 0;
-    for (auto it = _nodes.begin(); it != _nodes.end(); ++it) {
-        t_node = (*it)->getNextUpdate();
-        
-        // NOTE THAT node's update time can be < 0, which means it is completely irregular and no next update time
-        if (t_node >= 0) {
-            if (t_node == t) {
-                // Add the node to the list
-                gc_update_size++;  // increase total nodes
-                
-                (updateIt++)->nodeID = nodeID;
-            }
-            else if ((t_node < t) || (t < 0)) {
-                // Found earlier update (or first one), reset everything and add node
-                t = t_node;
-                gc_update_size = 1;
-                
-                //*(gc_update_list.begin()) = *updateIt;  // copy record to first
-                updateIt = gc_update_list.begin();      // reset pointer
-                (updateIt++)->nodeID = nodeID;
-            }
-        }
-        nodeID++;
+    for (auto nodeID: gc_next_nodes) {
+        (updateIt++)->nodeID = nodeID;
+        gc_skip_update_x[nodeID] = 0;
     }
     
     // Continue if and only if not exceeding end time and there is progress (i.e. there is a next update time)
@@ -337,6 +385,7 @@ bool GCThread::startNextUpdate() {
     }
     if (t > final_sim_time) {
         report_info(0, "Reached final simulation time; stop now.");
+        gc_reached_final_time = true;
         return false;
     }
     
@@ -360,18 +409,15 @@ bool GCThread::startNextUpdate() {
  \return false if timed out; true otherwise.
  */
 bool GCThread::gc_wait_for_next_event(OBNEventQueueType::item_type& ev, OBNSysRequestType& req) {
-    // We will control directly both locks, to achieve the best performance by saving one lock() and one unlock()
-    // It may not seem much, but in overloaded communication, it saves time.
+    // Events are drained from the lock-free queue in batches, so most calls return an event from the local batch without touching any shared state.
+    // The GC only sleeps (on the event count) when the batch and the queue are empty, and there is no system request or finished wait-for.
     
     bool gc_timer_fired = false;  // Has the timer event fired?
     
-    std::unique_lock<std::mutex> slock(mSysReq);  // Lock on the system request
-    std::unique_lock<std::mutex> qlock(OBNEventQueue.getMutex());  // Lock on the queue access
-    std::unique_lock<std::mutex> wlock(gc_waitfor_mutex);  // Lock on wait-for
-    
-    // Because we have locks on both SysRequest and the event queue, we can access them directly
-    // PRE-CONDITION: both slock and qlock are locked.
-    while ((gc_waitfor_status == GC_WAITFOR_RESULT_ACTIVE || gc_waitfor_status == GC_WAITFOR_RESULT_NONE) && SYSREQ_NONE == _SysRequest && OBNEventQueue.empty_with_lock()) {
+    // Checks if the current wait-for has finished (successfully or not)
+    // A sub-coordinator waiting for its parent is also woken up by the parent's messages.
+    while (gc_event_batch.empty() && OBNEventQueue.pop_all(gc_event_batch) == 0 &&
+           SYSREQ_NONE == _SysRequest.load() && !gc_waitfor.finished() && !(gc_waiting_parent && gc_parent_pending.load())) {
         // If a timer event is active and the end time has passed, break the loop
         gc_timer_fired = gc_timer_active && gc_timer_endtime <= std::chrono::steady_clock::now();
         if (gc_timer_fired) {
@@ -380,30 +426,31 @@ bool GCThread::gc_wait_for_next_event(OBNEventQueueType::item_type& ev, OBNSysRe
             break;
         }
         
-        // Unlock queue immediately to allow communication threads to push to it, which happens more frequently than system request being set.
-        wlock.unlock();
-        qlock.unlock();
+        // Announce the wait, then re-check everything: anything pushed or set after this point will change the key and wake us up
+        unsigned int key = mWakeupSignal.prepare_wait();
+        if (!OBNEventQueue.empty() || SYSREQ_NONE != _SysRequest.load() || gc_waitfor.finished() || (gc_waiting_parent && gc_parent_pending.load())) {
+            mWakeupSignal.cancel_wait();
+            continue;
+        }
         
         // If a timer event is active, use wait_until(), otherwise use normal wait()
         if (gc_timer_active) {
-            mWakeupCondition.wait_until(slock, gc_timer_endtime);
+            mWakeupSignal.wait_until(key, gc_timer_endtime);
         } else {
-            mWakeupCondition.wait(slock);
+            mWakeupSignal.wait(key);
         }
-        
-        // At this point, slock is locked, but qlock and wlock are not, so we need to lock them
-        qlock.lock();
-        wlock.lock();
     }
-    // POST-CONDITION: slock and qlock and wlock are locked.
     
-    // Copy the next event, if available, and unlock qlock for others to push to
-    ev = OBNEventQueue.try_pop_with_lock();
-    // qlock.unlock();  // unlocked automatically when returning from this function
+    // Take the next event from the batch, if available
+    if (gc_event_batch.empty()) {
+        ev.reset();
+    } else {
+        ev = std::move(gc_event_batch.front());
+        gc_event_batch.pop_front();
+    }
     
-    // Get system request, note that we have the lock on SysRequest
-    req = _SysRequest;
-    // slock.unlock(); // unlocked automatically when returning from this function
+    // Get system request
+    req = _SysRequest.load();
     
     return !gc_timer_fired;
 }
@@ -421,34 +468,36 @@ bool GCThread::gc_wait_for_ack() {
     OBNEventQueueType::item_type ev;    // To receive the node event
     OBNSysRequestType sysreq;  // To receive the system request
     bool timed_out = false;
+    auto retries = ack_retries;     // Number of retransmissions left
 
     // Loop until the wait-for is done, or until an unexpected termination
     // The loop is broken out by conditions inside the loop
-    std::unique_lock<std::mutex> mlock(gc_waitfor_mutex, std::defer_lock);
-    
     while (true) {
         if (gc_exec_state == GCSTATE_TERMINATING) {
             return false;
         }
         
         // Check the result of wait-for
-        mlock.lock();
-        if (gc_waitfor_status == GC_WAITFOR_RESULT_DONE || gc_waitfor_status == GC_WAITFOR_RESULT_NONE) {
-            mlock.unlock();
+        auto status = gc_waitfor.status();
+        if (status == AckTracker::WAITFOR_DONE || status == AckTracker::WAITFOR_NONE) {
             return true;
-        } else if (gc_waitfor_status == GC_WAITFOR_RESULT_ERROR) {
-            std::fill(gc_waitfor_bits.begin(), gc_waitfor_bits.end(), true);   // Clear the bits: note that true -> cleared, not waiting
-            mlock.unlock();
+        } else if (status == AckTracker::WAITFOR_ERROR) {
+            gc_waitfor.clearPending();  // Clear the bits: we are not waiting for any node anymore
             return false;
         }
-        mlock.unlock();
         
         // Process timeout
-        // For now, we will terminate the simulation immediately.
-        // In the future, we may have different options here, e.g. termination vs. raising a warning but continuing.
+        // If the messages have sequence numbers, they are retransmitted (at most ack_retries times); otherwise the simulation is terminated immediately.
         if (timed_out) {
-            report_error(0, "Timeout while waiting for ACKs at simulation time " + std::to_string(current_sim_time));
-            return false;
+            if (retries == 0 || gc_seq.load() == 0) {
+                report_error(0, "Timeout while waiting for ACKs at simulation time " + std::to_string(current_sim_time));
+                return false;
+            }
+            --retries;
+            gc_retransmit();
+            gc_timer_start(ack_timeout);
+            timed_out = false;
+            continue;
         }
         
         // Processing other events
@@ -488,279 +537,1243 @@ bool GCThread::gc_wait_for_ack() {
 }
 
 
-
-/** This method implements the default processing algorithm for node events, e.g. to respond to irregular update requests.
- It is usually the last function used to process any node event.
- \param pEv Non-nil pointer to the node event object to be processed.
- \return false if the simulation must stop unexpectedly (e.g. error); true otherwise.
+/**
+ Send the SIM_INIT message to all nodes and start the wait-for of their ACKs, which checks for initialization errors.
+ \return false if there is a critical error.
  */
-bool GCThread::gc_process_node_events(OBNsmn::SMNNodeEvent* pEv) {
-    
-    switch (pEv->type) {
-        case OBNSimMsg::N2SMN_MSGTYPE_SIM_EVENT:
-            gc_process_msg_sim_event(pEv);
-            break;
-            
-        case OBNSimMsg::N2SMN_MSGTYPE_SYS_REQUEST_STOP:
-            return gc_process_msg_sys_request_stop(pEv);
-    
-        default:
-            report_warning(0, "Unrecognized and unprocessed message of type " + std::to_string(pEv->type) +
-                           " from node " + std::to_string(pEv->nodeID) + " (" + _nodes[pEv->nodeID]->name + ")");
-            break;
+bool GCThread::gc_send_init() {
+    OBNSimMsg::MSGDATA *pMsgData = new OBNSimMsg::MSGDATA();
+    pMsgData->set_t(initial_wallclock); // initial wallclock time
+    if (!sim_parameters.empty()) {
+        pMsgData->set_b(sim_parameters);    // parameters of the simulation
     }
     
-    return true;
+    int64_t time_unit = sim_time_unit;  // simulation time unit, in microseconds
+    
+    return gc_send_to_all(0, OBNSimMsg::SMN2N_MSGTYPE_SIM_INIT, OBNSimMsg::N2SMN_MSGTYPE_SIM_INIT_ACK, &time_unit, pMsgData,
+                          [this](const OBNSimMsg::N2SMN& msg) {
+                              if (!msg.has_id()) {
+                                  return false;
+                              }
+                              if (msg.has_data() && msg.data().has_i() && msg.data().i() != 0) {
+                                  report_error(0, "Node \"" + _nodes[msg.id() - m_first_node_id]->name + "\" had initialization error #" + std::to_string(msg.data().i()));
+                                  return false;
+                              }
+                              return true;
+                          });
 }
 
 
-/** Process system request, mostly to switch between modes.
- If it is RUNNING, it can switch to PAUSED or TERMINATING.
- If it is PAUSED, it can switch to RUNNING (by RESUME) or TERMINATING (by STOP).
- If it is TERMINATING, it can switch to RUNNING (by RESUME) or PAUSED (by PAUSE) before it reaches TERMINATED, which is unrecoverable.
- \param req The system request.
+/**
+ Save the checkpoint of the simulation at the current time, between two iterations: the nodes send their states in their ACKs of SIM_SAVE, then the GC writes them with its own state to the checkpoint file.
+ \return false if the checkpoint could not be saved; the simulation is then stopped.
  */
-void GCThread::gc_process_sysreq(OBNSysRequestType req) {
-    switch (gc_exec_state) {
-        case GCSTATE_RUNNING:
-            if (req == SYSREQ_STOP) {
-                gc_exec_state = GCSTATE_TERMINATING;
-            } else if (req == SYSREQ_PAUSE) {
-                gc_exec_state = GCSTATE_PAUSED;
-            }
-            break;
-        case GCSTATE_PAUSED:
-            if (req == SYSREQ_RESUME) {
-                gc_exec_state = GCSTATE_RUNNING;
-            } else if (req == SYSREQ_STOP) {
-                gc_exec_state = GCSTATE_TERMINATING;
-            }
-            break;
-        case GCSTATE_TERMINATING:
-            if (req == SYSREQ_RESUME) {
-                gc_exec_state = GCSTATE_RUNNING;
-            } else if (req == SYSREQ_PAUSE) {
-                gc_exec_state = GCSTATE_PAUSED;
+bool GCThread::gc_save_checkpoint() {
+    gc_checkpoint_saved = true;
+    
+    if (!m_subs.empty() || lookahead) {
+        report_error(0, "Checkpoints are not supported with sub-coordinators or lookahead windows.");
+        return false;
+    }
+    
+    // The states of the nodes are stored by their IDs as their ACKs arrive
+    gc_checkpoint_states.assign(_nodes.size(), std::string());
+    bool success = gc_send_to_all(current_sim_time, OBNSimMsg::SMN2N_MSGTYPE_SIM_SAVE, OBNSimMsg::N2SMN_MSGTYPE_SIM_SAVE_ACK, nullptr, nullptr,
+                                  [this](const OBNSimMsg::N2SMN& msg) {
+                                      int id = msg.has_id()?(msg.id() - m_first_node_id):-1;
+                                      if (id < 0 || id > maxID) {
+                                          return false;
+                                      }
+                                      if (msg.has_data() && msg.data().i() != 0) {
+                                          report_error(0, "Node \"" + _nodes[id]->name + "\" could not save its state (error #" + std::to_string(msg.data().i()) + ").");
+                                          return false;
+                                      }
+                                      if (msg.has_data()) {
+                                          gc_checkpoint_states[id] = msg.data().b();
+                                      }
+                                      return true;
+                                  }) && gc_wait_for_ack();
+    
+    // The records are written one node at a time
+    if (success) {
+        CheckpointWriter writer;
+        CheckpointNode record;
+        success = writer.open(checkpoint_file, sim_time_unit, current_sim_time, _nodes.size());
+        for (int k = 0; success && k <= maxID; ++k) {
+            const auto& node = *_nodes[k];
+            record.name = node.name;
+            record.update_types.clear();
+            for (const auto& u: node.update_types) {
+                record.update_types.push_back({u.period, u.mask, u.next_update});
             }
-            break;
-        case GCSTATE_STOPPED:
-            // Do nothing
-            break;
+            record.next_regupdate_time = node.next_regupdate_time;
+            record.next_regupdate_mask = node.next_regupdate_mask;
+            record.irreg_updates = node.irreg_updates;
+            record.state.swap(gc_checkpoint_states[k]);
+            success = writer.write(record);
+        }
+        success = writer.close() && success;
+        if (!success) {
+            report_error(0, "Error while writing the checkpoint file \"" + checkpoint_file + "\".");
+        }
+    }
+    gc_checkpoint_states.clear();
+    
+    if (!success) {
+        report_error(0, "The checkpoint at simulation time " + std::to_string(current_sim_time) + " could not be saved.");
+        return false;
     }
+    report_info(0, "Checkpoint at simulation time " + std::to_string(current_sim_time) + " saved to \"" + checkpoint_file + "\".");
+    return true;
 }
 
 
 /**
- This method extracts the list of nodes that are next to be updated, sends (regular) UPDATE_Y messages to them.
- Only if messages are sent to nodes, it will start wait-for for them and may start a new timer event if timeout is used for UPDATE_Y.
- It also starts a new timer event if timeout is used for UPDATE_Y.
- 
- \return true if successful; false if not (error)
-*/
-bool GCThread::gc_send_update_y() {
-    assert(rtNodeGraph);  // rt_node_graph must be non-empty
-
-    {
-        std::lock_guard<std::mutex> lock(gc_waitfor_mutex);
-        if (gc_waitfor_status == GC_WAITFOR_RESULT_ACTIVE) {
-            // It's an error that wait-for is still active
-            report_error(0, "Internal error: wait-for event is active before sending regular Y updates.");
-            return false;
-        }
+ Resume the simulation from the checkpoint in resume_file, after SIM_INIT: restore the simulation time and the update schedules of the nodes, and send each node its saved state (SIM_LOAD), then wait for their ACKs.
+ The state of each node is sent as soon as its record is read, so the nodes restore their states while the next records are read.
+ \return false if the simulation can't be resumed.
+ */
+bool GCThread::gc_resume() {
+    CheckpointReader reader;
+    if (!reader.open(resume_file)) {
+        report_error(0, "Could not read the checkpoint file \"" + resume_file + "\".");
+        return false;
+    }
+    if (!m_subs.empty()) {
+        report_error(0, "Resuming from a checkpoint is not supported with sub-coordinators.");
+        return false;
+    }
+    if (reader.timeUnit() != sim_time_unit || reader.numNodes() != _nodes.size()) {
+        report_error(0, "The checkpoint file \"" + resume_file + "\" does not match the system: it has " + std::to_string(reader.numNodes()) +
+                     " nodes and time unit " + std::to_string(reader.timeUnit()) + ".");
+        return false;
     }
+    current_sim_time = reader.simTime();
     
-    const auto & updateList = rtNodeGraph->getAndRemoveIndependentNodes();  // Get the list of updating nodes
-    if (updateList.empty()) {
-        // If no nodes are removed but the graph is non-empty, there is a cyclic condition (algebraic loop), which is an error
-        if (rtNodeGraph->empty()) {
-            return true;
-        }
-
-        std::string err_message("An algebraic loop (dependency cycle) occurs at time " + std::to_string(current_sim_time) + " with nodes:\n");
-        
-        // Get the remaining nodes
-        auto node_list(rtNodeGraph->getCurrentNodes());
-        assert(!node_list.empty());
-        
-        // Build the list of remaining nodes
-        for (const auto & node_id : node_list) {
-            err_message += "  " + _nodes[node_id.first]->name + " (" + std::to_string(node_id.second) + ")\n";
+    if (!gc_waitfor_start_all(OBNSimMsg::N2SMN_MSGTYPE_SIM_LOAD_ACK, [this](const OBNSimMsg::N2SMN& msg) {
+        if (msg.has_data() && msg.data().i() != 0) {
+            report_error(0, "Node #" + std::to_string(msg.id() - m_first_node_id) + " could not restore its state (error #" + std::to_string(msg.data().i()) + ").");
+            return false;
         }
-        err_message += "}";
-        
-        report_error(0, err_message);
+        return true;
+    })) {
         return false;
     }
     
-    // Send the UPDATE_Y messages to the nodes
     OBNSimMsg::SMN2N msg;
-    msg.set_msgtype(OBNSimMsg::SMN2N_MSGTYPE_SIM_Y);
+    msg.set_msgtype(OBNSimMsg::SMN2N_MSGTYPE_SIM_LOAD);
     msg.set_time(current_sim_time);
-    
-    // Set up wait-for now because otherwise, for large number of nodes, ACK messages may start coming in soon and not registered.
-    if (!gc_waitfor_start(updateList, OBNSimMsg::N2SMN::SIM_Y_ACK)) {
-        return false;
+    if (gc_seq > 0) {
+        msg.set_seq(gc_seq);
     }
     
-    for (const auto & node: updateList) {
-        // Each node is a pair (node-ID, updatemask)
-        int thisNodeID = node.first;
+    CheckpointNode record;
+    for (int k = 0; k <= maxID; ++k) {
+        auto& node = *_nodes[k];
+        if (!reader.next(record)) {
+            report_error(0, "The checkpoint file \"" + resume_file + "\" is corrupted.");
+            return false;
+        }
         
-        // We don't set ID here because it's dependent on the comm protocol (see node.sendMessage())
-        // msg.set_id(node);
-        msg.set_i(node.second); // Set the update mask specified in the update list
-
-        _nodes[thisNodeID]->sendMessage(thisNodeID, msg);
+        // The node must have the same update types, whose schedule is restored
+        bool same = record.name == node.name && record.update_types.size() == node.update_types.size();
+        for (std::size_t u = 0; same && u < record.update_types.size(); ++u) {
+            same = record.update_types[u].period == node.update_types[u].period && record.update_types[u].mask == node.update_types[u].mask;
+            node.update_types[u].next_update = record.update_types[u].next_update;
+        }
+        if (!same) {
+            report_error(0, "Node #" + std::to_string(k) + " (" + node.name + ") does not match node \"" + record.name + "\" of the checkpoint.");
+            return false;
+        }
+        node.next_regupdate_time = record.next_regupdate_time;
+        node.next_regupdate_mask = record.next_regupdate_mask;
+        node.irreg_updates.swap(record.irreg_updates);
+        gc_scheduler.set(k, node.getNextUpdate());
+        
+        msg.set_id(m_first_node_id + k);
+        msg.mutable_data()->mutable_b()->swap(record.state);
+        if (!gc_send_message(k, msg)) {
+            report_error(0, "Error while sending the saved state to node #" + std::to_string(k) + " (" + node.name + ").");
+            return false;
+        }
     }
     
-    // Set up timeout if necessary
+    gc_timer_reset();
     if (ack_timeout > 0) {
         gc_timer_start(ack_timeout);
     }
-    else {
-        gc_timer_reset();
+    if (!gc_wait_for_ack()) {
+        return false;
     }
     
+    report_info(0, "Resumed from the checkpoint at simulation time " + std::to_string(current_sim_time) + ".");
     return true;
 }
 
 
-/* This method sends irregular UPDATE_Y to nodes in the updating list.
- Only if messages are sent to nodes, it will start wait-for for them and may start a new timer event if timeout is used for UPDATE_Y.
- Here we will directly start the wait-for event without using the method gc_waitfor_start().
-
- \sa gc_update_list
- \return true if successful; false if not (error)
+/**
+ Send the UPDATE_Y messages of the current iteration (started by startNextUpdate()) to the nodes in the correct order, and wait for their ACKs.
+ \param itbegin Iterator to the beginning of the updates, usually gc_update_list; a sub-coordinator may run the updates of an iteration in several parts.
+ \param n Number of updates.
+ \return false if the simulation must stop (e.g. error).
  */
-/*
-bool GCThread::gc_send_update_y_irregular() {
-    if (gc_waitfor_active) {
-        // It's an error that wait-for is still active
-        report_error(0, "Internal error: wait-for event is active before sending irregular Y updates.");
-        return false;
+bool GCThread::gc_run_update_y(GCUpdateListIterator itbegin, size_t n) {
+    if (n == 0) {
+        return true;
     }
     
-    gc_waitfor_num = 0;
-    
-    // Send the irregular UPDATE_Y messages to the irregular update nodes in gc_update_list
-    OBNSimMsg::SMN2N msg;
-    msg.set_msgtype(OBNSimMsg::SMN2N_MSGTYPE_SIM_YI);
-    msg.set_time(current_sim_time);
+    // Create the run-time node graph, for regular updates
+    rtNodeGraph = _nodeGraph->getRTNodeDepGraph(itbegin, n);
     
-    for (IrregUpdateListIterator it(this); !it.atEnd(); ++it) {
-        auto ID = it.getID();
-        
-        // We don't set ID here because it's dependent on the comm protocol (see node.sendMessage())
-        // msg.set_id(ID);
-        
-        OBNSimMsg::MSGDATA *msgdata = new OBNSimMsg::MSGDATA();
-        msgdata->set_i(it.getMask());
-        msg.set_allocated_data(msgdata);
-
-        _nodes[ID]->sendMessage(ID, msg);
-        
-        // Because the irregular update of this node is used, we remove/pop it from the list
-        _nodes[ID]->popIrregularUpdate();
-        
-        // Mark the corresponding bit for wait-for event
-        gc_waitfor_bits[ID] = false;
-        ++gc_waitfor_num;  // One more node to wait for ACK
+    // Send regular UPDATE_Y messages to nodes in the run-time graph, in correct order
+    if (dataflow_dispatch && rtNodeGraph->supportsDataflow()) {
+        // Dataflow dispatch: new UPDATE_Y messages are sent as ACKs arrive, so we only wait once
+        return gc_send_update_y_dataflow() && gc_wait_for_ack();
     }
     
-    // If no messages were sent then no need for wait-for event nor time-out
-    if (gc_waitfor_num > 0) {
-        // Set up wait-for
-        gc_waitfor_active = true;
-        gc_waitfor_type = OBNSimMsg::N2SMN::SIM_YI_ACK;
-        
-        // Set up timeout if necessary
-        if (ack_timeout > 0) {
-            gc_timer_start(ack_timeout);
-        }
-        else {
-            gc_timer_reset();
+    while (!rtNodeGraph->empty()) {
+        // Wait for ACKs while processing all events: returns false if there is an error (e.g. timeout)
+        if (!gc_send_update_y() || !gc_wait_for_ack()) {
+            return false;
         }
     }
-    
     return true;
-}*/
+}
 
 
-/** This method sends UPDATE_X to nodes in the updating list and start wait-for for them.
- Here we will directly start the wait-for event without using the method gc_waitfor_start().
- It also starts a new timer event if timeout is used for UPDATE_X.
- \sa gc_update_list
- \return true if successful; false if not (error)
+/**
+ Send the UPDATE_X messages of the current iteration, wait for their ACKs, then finish the nodes' updates and re-schedule them.
+ \return false if the simulation must stop (e.g. timeout).
+ */
+bool GCThread::gc_run_update_x() {
+    if (!gc_send_update_x() || !gc_wait_for_ack()) {
+        return false;
+    }
+
+    gc_timer_reset();   // Turn off the timer, just in case
+    
+    // Update nodes in the update list to their next regular updates.
+    // Then re-schedule them.
+    for (size_t i = 0; i < gc_update_size; ++i) {
+        auto nodeID = gc_update_list[i].nodeID;
+        if (gc_lookahead_end[nodeID] < current_sim_time) {
+            // Otherwise its update was finished when its lookahead window was computed
+            _nodes[nodeID]->finishCurrentUpdate();
+        }
+        gc_scheduler.set(nodeID, _nodes[nodeID]->getNextUpdate());
+    }
+    return true;
+}
+
+
+/**
+ The main algorithm of a sub-coordinator (see setParent()): run the iterations commanded by the parent until SIM_TERM.
+ As a node, the sub-coordinator acknowledges each command once it has run it, and requests its next update time from the parent before the ACK.
+ If an iteration fails, it requests the parent to stop the simulation, then ignores the commands until SIM_TERM.
+ */
+void GCThread::gc_subordinate_main() {
+    OBNSimMsg::SMN2N cmd;
+    bool failed = false;
+    
+    while (gc_wait_for_parent(cmd)) {
+        int64_t seq = 0;
+        if (cmd.has_seq()) {
+            // A command retransmitted by the parent is not run again, but its ACK is re-sent
+            if (cmd.seq() == gc_parent_seq) {
+                if (gc_parent_ack.has_seq() && gc_parent_ack.seq() == gc_parent_seq) {
+                    gc_send_to_parent(gc_parent_ack);
+                }
+                continue;
+            }
+            seq = gc_parent_seq = cmd.seq();
+        }
+        
+        auto type = cmd.msgtype();
+        if (type == OBNSimMsg::SMN2N_MSGTYPE_SIM_TERM) {
+            break;
+        }
+        
+        if (type == OBNSimMsg::SMN2N_MSGTYPE_SYS_REQUEST_STOP_ACK) {
+            // Pass the parent's answer to the node which requested to stop
+            if (gc_parent_stop_requester >= 0) {
+                _nodes[gc_parent_stop_requester]->sendMessage(m_first_node_id + gc_parent_stop_requester, cmd);
+            } else if (m_send_msg_to_sys_port) {
+                cmd.clear_id();
+                m_send_msg_to_sys_port(cmd);
+            }
+            continue;
+        }
+        
+        if (failed) {
+            continue;
+        }
+        
+        bool success = true;
+        switch (type) {
+            case OBNSimMsg::SMN2N_MSGTYPE_SIM_INIT:
+                gc_parent_id = cmd.id();
+                if (cmd.has_i() && cmd.i() > 0) {
+                    sim_time_unit = cmd.i();
+                }
+                if (cmd.has_data() && cmd.data().has_t()) {
+                    initial_wallclock = cmd.data().t();
+                }
+                if (cmd.has_data()) {
+                    sim_parameters = cmd.data().b();
+                }
+                if (gc_send_init() && gc_wait_for_ack()) {
+                    gc_parent_request_next();
+                    gc_parent_send_ack(OBNSimMsg::N2SMN_MSGTYPE_SIM_INIT_ACK, seq);
+                } else {
+                    // The parent stops the simulation
+                    gc_parent_send_ack(OBNSimMsg::N2SMN_MSGTYPE_SIM_INIT_ACK, seq, 1);
+                    failed = true;
+                }
+                continue;
+                
+            case OBNSimMsg::SMN2N_MSGTYPE_SIM_Y:
+            case OBNSimMsg::SMN2N_MSGTYPE_SIM_YX: {
+                simtime_t t = cmd.time();
+                if (gc_parent_in_step && t == current_sim_time) {
+                    // The parent opens more gates of the current iteration; SIM_YX is the last command and opens all of them
+                    success = gc_parent_run_update_y((type == OBNSimMsg::SMN2N_MSGTYPE_SIM_YX)?~updatemask_t(0):cmd.i());
+                    if (success && type == OBNSimMsg::SMN2N_MSGTYPE_SIM_YX) {
+                        gc_parent_update_x = false;
+                        gc_parent_in_step = false;
+                        success = gc_run_update_x();
+                    }
+                    if (success) {
+                        gc_parent_request_next();
+                        gc_parent_send_ack(OBNSimMsg::N2SMN_MSGTYPE_SIM_Y_ACK, seq);
+                    }
+                    break;
+                }
+                
+                // The gates not requested at this time are open: their nodes are not updating
+                auto requested = gc_parent_requested.find(t);
+                gc_parent_open = (requested != gc_parent_requested.end())?~requested->second:~updatemask_t(0);
+                gc_parent_requested.erase(gc_parent_requested.begin(), gc_parent_requested.upper_bound(t));
+                
+                // Updates that the parent has not run (e.g. because their requests were denied) are skipped
+                while (!gc_scheduler.empty() && gc_scheduler.nextTime() < t) {
+                    report_warning(0, "The updates of a partition at time " + std::to_string(gc_scheduler.nextTime()) + " were not run by the parent GC; they are skipped.");
+                    gc_scheduler.nextNodes(gc_next_nodes);
+                    for (auto nodeID: gc_next_nodes) {
+                        _nodes[nodeID]->getNextUpdate();
+                        _nodes[nodeID]->finishCurrentUpdate();
+                        gc_scheduler.set(nodeID, _nodes[nodeID]->getNextUpdate());
+                    }
+                }
+                
+                if (gc_scheduler.nextTime() != t) {
+                    // Nothing to update at this time, e.g. a request made obsolete by an earlier one
+                    current_sim_time = std::max(current_sim_time, t);
+                    gc_parent_request_next();
+                    gc_parent_send_ack(OBNSimMsg::N2SMN_MSGTYPE_SIM_Y_ACK, seq, OBNsim::YACK_NO_UPDATE_X);
+                    continue;
+                }
+                
+                success = startNextUpdate();
+                if (success) {
+                    gc_parent_left.resize(_nodes.size());
+                    for (size_t k = 0; k < gc_update_size; ++k) {
+                        gc_parent_left[gc_update_list[k].nodeID] = gc_update_list[k].updateMask;
+                    }
+                    success = gc_parent_run_update_y((type == OBNSimMsg::SMN2N_MSGTYPE_SIM_YX)?~updatemask_t(0):cmd.i());
+                }
+                if (success && type == OBNSimMsg::SMN2N_MSGTYPE_SIM_YX) {
+                    success = gc_run_update_x();
+                } else {
+                    gc_parent_update_x = success;
+                    gc_parent_in_step = success;
+                }
+                if (success) {
+                    gc_parent_request_next();
+                    gc_parent_send_ack(OBNSimMsg::N2SMN_MSGTYPE_SIM_Y_ACK, seq);
+                }
+                break;
+            }
+                
+            case OBNSimMsg::SMN2N_MSGTYPE_SIM_X:
+                if (gc_parent_update_x) {
+                    // The updates still waiting, if any, are run first
+                    gc_parent_update_x = false;
+                    gc_parent_in_step = false;
+                    success = gc_parent_run_update_y(~updatemask_t(0)) && gc_run_update_x();
+                }
+                if (success) {
+                    gc_parent_request_next();
+                    gc_parent_send_ack(OBNSimMsg::N2SMN_MSGTYPE_SIM_X_ACK, seq);
+                }
+                break;
+                
+            default:
+                report_warning(0, "Unrecognized and unprocessed message of type " + std::to_string(type) + " from the parent GC.");
+                break;
+        }
+        
+        if (!success) {
+            // The iteration is not acknowledged: the parent stops the simulation
+            report_error(0, "A partition failed at simulation time " + std::to_string(cmd.time()) + "; request the parent GC to stop.");
+            OBNSimMsg::N2SMN msg;
+            msg.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SYS_REQUEST_STOP);
+            gc_send_to_parent(msg);
+            failed = true;
+        }
+    }
+}
+
+
+/**
+ The updates of the current iteration whose update types no longer wait for a closed gate, and have not been run yet, are run in the order of the partition's graph.
+ They include the updates of the nodes which they depend on, because these wait for fewer gates.
+ \param gates The gates opened by the parent.
+ \return false if the simulation must stop (e.g. error).
+ */
+bool GCThread::gc_parent_run_update_y(updatemask_t gates) {
+    gc_parent_open |= gates;
+    gc_parent_batch.clear();
+    for (size_t k = 0; k < gc_update_size; ++k) {
+        auto nodeID = gc_update_list[k].nodeID;
+        auto mask = gc_parent_gates.released(nodeID, gc_parent_left[nodeID], gc_parent_open);
+        if (mask) {
+            gc_parent_batch.push_back(NodeUpdateInfo{nodeID, mask});
+            gc_parent_left[nodeID] &= ~mask;
+        }
+    }
+    return gc_run_update_y(gc_parent_batch.begin(), gc_parent_batch.size());
+}
+
+
+/**
+ Wait for the next message of the parent, while processing the events of the nodes (e.g. their requests of irregular updates, which may change the next update time of the sub-coordinator).
+ The parent's ACKs of the requests of next update times (SIM_EVENT_ACK) are processed here.
+ \param cmd Receives the message.
+ \param untilEventAcks If true, only wait until all requests have been acknowledged, or until another message arrives (which is left to the next call).
+ \return true if a message is returned in cmd; false if the GC must terminate, or if untilEventAcks is true.
+ */
+bool GCThread::gc_wait_for_parent(OBNSimMsg::SMN2N& cmd, bool untilEventAcks) {
+    OBNEventQueueType::item_type ev;    // To receive the node event
+    OBNSysRequestType sysreq;  // To receive the system request
+
+    // The last wait-for has been processed: it must not wake up the GC while it waits for the parent
+    gc_waitfor.reset();
+
+    while (true) {
+        if (gc_parent_pending.load()) {
+            std::lock_guard<std::mutex> lock(m_parent_mutex);
+            auto & front = m_parent_commands.front();
+            bool isEventAck = front.msgtype() == OBNSimMsg::SMN2N_MSGTYPE_SIM_EVENT_ACK;
+            if (isEventAck) {
+                if (front.has_data() && front.data().i() != 0) {
+                    report_warning(0, "The parent GC denied the request of a partition for an update at time " + std::to_string(front.data().t()) + ".");
+                    gc_parent_requested.erase(front.data().t());
+                }
+                if (gc_parent_event_acks > 0) {
+                    --gc_parent_event_acks;
+                }
+            } else if (untilEventAcks) {
+                return false;
+            } else {
+                cmd.Swap(&front);
+            }
+            m_parent_commands.pop_front();
+            gc_parent_pending = !m_parent_commands.empty();
+            if (!isEventAck) {
+                return true;
+            }
+            continue;
+        }
+        
+        if (untilEventAcks && gc_parent_event_acks == 0) {
+            return false;
+        }
+        
+        gc_waiting_parent = true;
+        gc_wait_for_next_event(ev, sysreq);
+        gc_waiting_parent = false;
+        
+        if (sysreq == SYSREQ_TERMINATE) {
+            gc_exec_state = GCSTATE_TERMINATING;
+            return false;
+        }
+        if (sysreq != SYSREQ_NONE) {
+            // The other requests are ignored: the parent controls the simulation
+            resetSysRequest();
+        }
+        
+        if (ev) {
+            if (!gc_process_node_events(ev.get())) {
+                gc_exec_state = GCSTATE_TERMINATING;
+                return false;
+            }
+            if (!untilEventAcks && gc_parent_id >= 0) {
+                // A node may have requested an update while the partition was idle
+                gc_parent_request_next();
+            }
+        }
+    }
+}
+
+
+/**
+ Request the next update time of the sub-coordinator from the parent, as an irregular update of its proxy node, if it is in the future and has not been requested yet with the same gates.
+ The update type 1 of the proxy node is always requested, with the gates of the nodes updating at that time; a new request replaces the previous one at the same time.
+ */
+void GCThread::gc_parent_request_next() {
+    simtime_t t = gc_scheduler.nextTime();
+    if (t <= current_sim_time) {
+        return;
+    }
+    updatemask_t mask = 1;
+    if (!gc_parent_gates.empty()) {
+        gc_scheduler.nextNodes(gc_next_nodes);
+        for (auto nodeID: gc_next_nodes) {
+            mask |= gc_parent_gates.gatesOf(nodeID, _nodes[nodeID]->getNextUpdateMask());
+        }
+    }
+    auto it = gc_parent_requested.find(t);
+    if (it != gc_parent_requested.end() && it->second == mask) {
+        return;
+    }
+    gc_parent_requested[t] = mask;
+    
+    OBNSimMsg::N2SMN msg;
+    msg.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SIM_EVENT);
+    auto *data = new OBNSimMsg::MSGDATA;
+    data->set_t(t);
+    data->set_i(mask);  // The update types of the proxy node
+    msg.set_allocated_data(data);
+    gc_send_to_parent(msg);
+    ++gc_parent_event_acks;
+}
+
+
+/**
+ Send an ACK to the parent.
+ As a node, the sub-coordinator waits for its requests of next update times to be accepted first, so that the parent has scheduled them when it moves on.
+ \param type The type of the ACK.
+ \param seq The sequence number of the acknowledged command, or 0.
+ \param I The I field of the ACK's data, not set if 0.
+ */
+void GCThread::gc_parent_send_ack(OBNSimMsg::N2SMN::MSGTYPE type, int64_t seq, int64_t I) {
+    if (gc_parent_event_acks > 0) {
+        OBNSimMsg::SMN2N cmd;
+        gc_wait_for_parent(cmd, true);
+    }
+    
+    gc_parent_ack.Clear();
+    gc_parent_ack.set_msgtype(type);
+    if (I != 0) {
+        auto *data = new OBNSimMsg::MSGDATA;
+        data->set_i(I);
+        gc_parent_ack.set_allocated_data(data);
+    }
+    if (seq > 0) {
+        gc_parent_ack.set_seq(seq);
+    }
+    gc_send_to_parent(gc_parent_ack);
+}
+
+
+/** Send a message to the parent, setting the ID of this sub-coordinator. */
+void GCThread::gc_send_to_parent(OBNSimMsg::N2SMN& msg) {
+    msg.set_id(gc_parent_id);
+    m_send_msg_to_parent(msg);
+}
+
+
+/** The message is queued, and the sub-coordinator woken up if it is waiting for its parent. */
+void GCThread::postParentCommand(const OBNSimMsg::SMN2N& msg) {
+    {
+        std::lock_guard<std::mutex> lock(m_parent_mutex);
+        m_parent_commands.push_back(msg);
+        ++m_parent_messages;
+        gc_parent_pending = true;
+    }
+    mWakeupSignal.notify();
+}
+
+
+std::pair<bool, std::size_t> GCThread::addSubCoordinator(GCThread* sub, const std::string& name) {
+    if (_gcthread || !sub || sub == this || !m_components.empty() ||
+        (!m_subs.empty() && sub->m_first_node_id <= m_subs.back()->m_first_node_id)) {
+        return std::make_pair(false, 0);
+    }
+    
+    // The sub-coordinator's messages are processed as those of its proxy node
+    if (!sub->setParent([this](const OBNSimMsg::N2SMN& msg) { pushNodeEvent(msg, 0); })) {
+        return std::make_pair(false, 0);
+    }
+    
+    auto result = insertNode(new OBNNodePartition(name, sub));
+    m_subs.emplace_back(sub);
+    return result;
+}
+
+
+bool GCThread::addComponent(GCThread* comp) {
+    if (_gcthread || !comp || comp == this || !_nodes.empty() ||
+        (!m_components.empty() && comp->m_first_node_id <= m_components.back()->m_first_node_id)) {
+        return false;
+    }
+    
+    // The components answer the anonymous requests to stop on the same port
+    comp->m_send_msg_to_sys_port = m_send_msg_to_sys_port;
+    m_components.emplace_back(comp);
+    return true;
+}
+
+
+/**
+ The thread of a GC with parallel components (see addComponent()) only waits for them, because its system requests are forwarded to them directly.
+ The components stop independently, e.g. at different simulation times if some of their nodes request to stop.
+ */
+void GCThread::gc_run_components() {
+    gc_exec_state = GCSTATE_RUNNING;
+    
+    auto start = std::chrono::steady_clock::now();
+    simtime_t minTime = std::numeric_limits<simtime_t>::max(), maxTime = 0;
+    std::size_t numNodes = 0;
+    for (auto& comp: m_components) {
+        comp->joinThread();
+        minTime = std::min(minTime, comp->current_sim_time);
+        maxTime = std::max(maxTime, comp->current_sim_time);
+        numNodes += comp->_nodes.size();
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    current_sim_time = maxTime;
+    
+    report_info(0, "Parallel components: " + std::to_string(m_components.size()) + " GCs ran " + std::to_string(numNodes) +
+                " nodes in " + std::to_string(elapsed) + " s; they stopped at simulation times from " + std::to_string(minTime) +
+                " to " + std::to_string(maxTime) + ".");
+    
+    // Signal simple threads, which are associated with this GC, to terminate, unless the nodes are kept for a restart
+    if (!nodesKeptRunning()) {
+        simple_thread_terminate = true;
+    }
+    
+    gc_exec_state = GCSTATE_STOPPED;
+}
+
+
+/**
+ Retransmit the messages of the current wait-for (those with its sequence number) to the nodes whose ACKs are still expected, when the ACK timeout fires.
+ A message that was sent to a node group is retransmitted to the node only. A node that had received the message will only re-send its ACK.
+ */
+void GCThread::gc_retransmit() {
+    // In dataflow dispatch, the communication threads may be sending messages and writing the records
+    std::unique_lock<std::mutex> lock(gc_waitfor_mutex, std::defer_lock);
+    if (gc_waitfor_dataflow) {
+        lock.lock();
+    }
+    
+    auto seq = gc_seq.load();
+    std::size_t count = 0;
+    for (int id = 0; id <= maxID; ++id) {
+        const auto & rec = gc_resend[id];
+        if (rec.seq != seq || !gc_waitfor.isExpected(id)) {
+            continue;
+        }
+        _nodes[id]->sendFrame(m_first_node_id + id, (rec.group >= 0)?gc_group_state[rec.group].frame:rec.frame);
+        ++count;
+    }
+    gc_retransmissions += count;
+    
+    report_warning(0, "Timeout while waiting for ACKs at simulation time " + std::to_string(current_sim_time) +
+                   "; " + std::to_string(count) + " messages retransmitted.");
+}
+
+
+
+/** This method implements the default processing algorithm for node events, e.g. to respond to irregular update requests.
+ It is usually the last function used to process any node event.
+ \param pEv Non-nil pointer to the node event object to be processed.
+ \return false if the simulation must stop unexpectedly (e.g. error); true otherwise.
+ */
+bool GCThread::gc_process_node_events(OBNsmn::SMNNodeEvent* pEv) {
+    
+    switch (pEv->type) {
+        case OBNSimMsg::N2SMN_MSGTYPE_SIM_EVENT:
+            gc_process_msg_sim_event(pEv);
+            break;
+            
+        case OBNSimMsg::N2SMN_MSGTYPE_SYS_REQUEST_STOP:
+            if (m_send_msg_to_parent) {
+                // The parent of a sub-coordinator decides, and its ACK is passed to the node
+                OBNSimMsg::N2SMN msg;
+                msg.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SYS_REQUEST_STOP);
+                gc_parent_stop_requester = pEv->has_id?pEv->nodeID:-1;
+                gc_send_to_parent(msg);
+                return true;
+            }
+            return gc_process_msg_sys_request_stop(pEv);
+    
+        default:
+            report_warning(0, "Unrecognized and unprocessed message of type " + std::to_string(pEv->type) +
+                           " from node " + std::to_string(pEv->nodeID) + " (" + _nodes[pEv->nodeID]->name + ")");
+            break;
+    }
+    
+    return true;
+}
+
+
+/** Process system request, mostly to switch between modes.
+ If it is RUNNING, it can switch to PAUSED or TERMINATING.
+ If it is PAUSED, it can switch to RUNNING (by RESUME) or TERMINATING (by STOP).
+ If it is TERMINATING, it can switch to RUNNING (by RESUME) or PAUSED (by PAUSE) before it reaches TERMINATED, which is unrecoverable.
+ \param req The system request.
+ */
+void GCThread::gc_process_sysreq(OBNSysRequestType req) {
+    switch (gc_exec_state) {
+        case GCSTATE_RUNNING:
+            if (req == SYSREQ_STOP) {
+                gc_exec_state = GCSTATE_TERMINATING;
+            } else if (req == SYSREQ_PAUSE) {
+                gc_exec_state = GCSTATE_PAUSED;
+            }
+            break;
+        case GCSTATE_PAUSED:
+            if (req == SYSREQ_RESUME) {
+                gc_exec_state = GCSTATE_RUNNING;
+            } else if (req == SYSREQ_STOP) {
+                gc_exec_state = GCSTATE_TERMINATING;
+            }
+            break;
+        case GCSTATE_TERMINATING:
+            if (req == SYSREQ_RESUME) {
+                gc_exec_state = GCSTATE_RUNNING;
+            } else if (req == SYSREQ_PAUSE) {
+                gc_exec_state = GCSTATE_PAUSED;
+            }
+            break;
+        case GCSTATE_STOPPED:
+            // Do nothing
+            break;
+    }
+}
+
+
+/**
+ This method extracts the list of nodes that are next to be updated, sends (regular) UPDATE_Y messages to them.
+ Only if messages are sent to nodes, it will start wait-for for them and may start a new timer event if timeout is used for UPDATE_Y.
+ It also starts a new timer event if timeout is used for UPDATE_Y.
+ 
+ \return true if successful; false if not (error)
+*/
+bool GCThread::gc_send_update_y() {
+    assert(rtNodeGraph);  // rt_node_graph must be non-empty
+
+    if (gc_waitfor.active()) {
+        // It's an error that wait-for is still active
+        report_error(0, "Internal error: wait-for event is active before sending regular Y updates.");
+        return false;
+    }
+    
+    const auto & updateList = rtNodeGraph->getAndRemoveIndependentNodes();  // Get the list of updating nodes
+    if (updateList.empty()) {
+        // If no nodes are removed but the graph is non-empty, there is a cyclic condition (algebraic loop), which is an error
+        if (rtNodeGraph->empty()) {
+            return true;
+        }
+
+        gc_report_algebraic_loop();
+        return false;
+    }
+    
+    // Set up wait-for now because otherwise, for large number of nodes, ACK messages may start coming in soon and not registered.
+    if (!gc_waitfor_start(updateList, OBNSimMsg::N2SMN::SIM_Y_ACK)) {
+        return false;
+    }
+    
+    // Send the UPDATE_Y messages to the nodes
+    gc_send_update_y_nodes(updateList);
+    
+    // Set up timeout if necessary
+    if (ack_timeout > 0) {
+        gc_timer_start(ack_timeout);
+    }
+    else {
+        gc_timer_reset();
+    }
+    
+    return true;
+}
+
+
+/**
+ Report the remaining nodes of the run-time graph as an algebraic loop (dependency cycle).
+ */
+void GCThread::gc_report_algebraic_loop() {
+    std::string err_message("An algebraic loop (dependency cycle) occurs at time " + std::to_string(current_sim_time) + " with nodes:\n");
+    
+    // Get the remaining nodes
+    auto node_list(rtNodeGraph->getCurrentNodes());
+    assert(!node_list.empty());
+    
+    // Build the list of remaining nodes
+    for (const auto & node_id : node_list) {
+        err_message += "  " + _nodes[node_id.first]->name + " (" + std::to_string(node_id.second) + ")\n";
+    }
+    err_message += "}";
+    
+    report_error(0, err_message);
+}
+
+
+/**
+ This method starts the dataflow dispatch of UPDATE_Y messages for the current run-time graph.
+ The initially independent nodes are sent UPDATE_Y messages, then a single wait-for is started which lasts until the run-time graph is empty.
+ Each SIM_Y_ACK received in the meantime (see gc_waitfor_process_ACK()) finishes the node's updates in the graph, and the nodes which become independent are sent their UPDATE_Y messages immediately.
+ 
+ \return true if successful; false if not (error)
+ */
+bool GCThread::gc_send_update_y_dataflow() {
+    assert(rtNodeGraph);  // rt_node_graph must be non-empty
+    
+    // The lock is held while the messages are sent so that early ACKs can't access the graph before we are done
+    std::lock_guard<std::mutex> lock(gc_waitfor_mutex);
+    if (gc_waitfor.active()) {
+        // It's an error that wait-for is still active
+        report_error(0, "Internal error: wait-for event is active before sending regular Y updates.");
+        return false;
+    }
+    
+    const auto & updateList = rtNodeGraph->startDataflow();
+    if (updateList.empty()) {
+        if (rtNodeGraph->empty()) {
+            gc_waitfor.reset();
+            return true;
+        }
+        gc_report_algebraic_loop();
+        return false;
+    }
+    
+    // Set up the wait-for, whose number of nodes will grow as more UPDATE_Y messages are sent
+    gc_waitfor_predicate = GC_WaitFor_Predicate();
+    gc_waitfor_dataflow = true;
+    gc_next_seq();
+    gc_waitfor.begin(OBNSimMsg::N2SMN::SIM_Y_ACK);
+    
+    gc_dataflow_send(updateList, true);
+    
+    // Set up timeout if necessary
+    if (ack_timeout > 0) {
+        gc_timer_start(ack_timeout);
+    }
+    else {
+        gc_timer_reset();
+    }
+    
+    return true;
+}
+
+
+/**
+ Send UPDATE_Y messages to the given nodes and register them in the current (dataflow) wait-for.
+ This method may be called from a communication thread (when an ACK is processed), always with gc_waitfor_mutex locked.
+ \param nodes The nodes and their update masks.
+ \param fromGC Whether it is called from the GC thread.
+ */
+void GCThread::gc_dataflow_send(const std::vector< std::pair<int, updatemask_t> >& nodes, bool fromGC) {
+    for (const auto & node: nodes) {
+        gc_waitfor.expect(node.first);
+    }
+    
+    if (fromGC) {
+        gc_send_update_y_nodes(nodes);
+        return;
+    }
+    
+    // gc_frame and the node groups are only used by the GC thread, so each node is sent its own message
+    auto seq = gc_seq.load();
+    OBNSimMsg::SMN2N msg;
+    msg.set_time(current_sim_time);
+    
+    SMN2NFrame frame;
+    OBNSimMsg::SMN2N ymsg;
+    ymsg.set_msgtype(OBNSimMsg::SMN2N_MSGTYPE_SIM_Y);
+    ymsg.set_time(current_sim_time);
+    if (seq > 0) {
+        msg.set_seq(seq);
+        ymsg.set_seq(seq);
+    }
+    frame.setMessage(ymsg);
+    
+    gc_begin_bundle(nodes);
+    for (const auto & node: nodes) {
+        if (gc_set_update_y_msg(msg, node.first, node.second, false)) {
+            gc_send_message(node.first, msg);
+        } else {
+            int64_t I = node.second;
+            frame.setNode(m_first_node_id + node.first, &I);
+            gc_send_frame(node.first, frame);
+        }
+    }
+    gc_end_bundle(nodes);
+}
+
+
+/**
+ Send UPDATE_Y messages to the given nodes, which have just been returned by the run-time graph; must be called from the GC thread.
+ Plain SIM_Y messages are serialized once and sent by gc_send_grouped(); so are the SIM_YX messages, once for each UPDATE_X mask.
+ The SIM_YW messages, whose windows are specific to each node, are sent to each node.
+ \param nodes The nodes and their update masks.
+ */
+void GCThread::gc_send_update_y_nodes(const std::vector< std::pair<int, updatemask_t> >& nodes) {
+    OBNSimMsg::SMN2N msg;
+    msg.set_msgtype(OBNSimMsg::SMN2N_MSGTYPE_SIM_Y);
+    msg.set_time(current_sim_time);
+    if (gc_seq.load() > 0) {
+        msg.set_seq(gc_seq);
+    }
+    gc_frame.setMessage(msg);
+    
+    // The messages to the nodes sharing a connection are sent together
+    gc_begin_bundle(nodes);
+    gc_grouped_nodes.clear();
+    gc_fused_nodes.clear();
+    for (const auto & node: nodes) {
+        if (gc_set_update_y_msg(msg, node.first, node.second, true)) {
+            if (msg.msgtype() == OBNSimMsg::SMN2N_MSGTYPE_SIM_YX) {
+                gc_fused_nodes.push_back(FusedUpdate{msg.data().i(), node.first, int64_t(node.second)});
+            } else {
+                gc_send_message(node.first, msg);
+            }
+        } else {
+            gc_grouped_nodes.emplace_back(node.first, node.second);
+        }
+    }
+    gc_send_grouped();
+    
+    if (!gc_fused_nodes.empty()) {
+        // The SIM_YX messages with the same UPDATE_X mask (in their data) share the frame
+        std::stable_sort(gc_fused_nodes.begin(), gc_fused_nodes.end(), [](const FusedUpdate& a, const FusedUpdate& b) { return a.X < b.X; });
+        msg.set_msgtype(OBNSimMsg::SMN2N_MSGTYPE_SIM_YX);
+        msg.clear_id();
+        msg.clear_i();
+        auto it = gc_fused_nodes.begin();
+        while (it != gc_fused_nodes.end()) {
+            auto X = it->X;
+            msg.mutable_data()->Clear();
+            msg.mutable_data()->set_i(X);
+            gc_frame.setMessage(msg);
+            gc_grouped_nodes.clear();
+            for (; it != gc_fused_nodes.end() && it->X == X; ++it) {
+                gc_grouped_nodes.emplace_back(it->id, it->I);
+            }
+            gc_send_grouped();
+        }
+    }
+    gc_end_bundle(nodes);
+}
+
+
+/**
+ Send gc_frame to the nodes in gc_grouped_nodes, each with its own I field; must be called from the GC thread.
+ If all members of a node group are in the list with the same I field, the frame is sent once to the group (without ID); otherwise it is sent to each node.
  */
-bool GCThread::gc_send_update_x() {
-    assert(gc_update_size > 0);
+void GCThread::gc_send_grouped() {
+    if (m_node_groups.empty()) {
+        for (const auto & node: gc_grouped_nodes) {
+            gc_frame.setNode(m_first_node_id + node.first, &node.second);
+            gc_send_frame(node.first, gc_frame);
+        }
+        return;
+    }
     
-    {
-        std::lock_guard<std::mutex> lock(gc_waitfor_mutex);
-        if (gc_waitfor_status == GC_WAITFOR_RESULT_ACTIVE) {
-            // It's an error that wait-for is still active
-            report_error(0, "Internal error: wait-for event is active before sending regular X updates.");
-            return false;
+    // Count the members of each group in the list
+    for (const auto & node: gc_grouped_nodes) {
+        auto g = m_node_group_of[node.first];
+        if (g >= 0) {
+            auto & state = gc_group_state[g];
+            if (state.count++ == 0) {
+                state.I = node.second;
+                state.same = true;
+            } else if (state.I != node.second) {
+                state.same = false;
+            }
         }
     }
     
-    int numUpdateX = 0;    // Number of nodes receiving UPDATE_X
+    for (const auto & node: gc_grouped_nodes) {
+        auto g = m_node_group_of[node.first];
+        if (g >= 0 && gc_group_state[g].same && gc_group_state[g].count == gc_group_state[g].size) {
+            // The whole group receives the same message
+            auto & state = gc_group_state[g];
+            if (!state.sent) {
+                gc_frame.setNode(-1, &node.second);
+                m_node_groups[g]->sendFrame(gc_frame);
+                state.sent = true;
+                ++gc_group_sends;
+                if (gc_frame.hasSeq()) {
+                    state.frame = gc_frame;
+                }
+            }
+            if (gc_frame.hasSeq()) {
+                gc_resend[node.first].seq = gc_seq;
+                gc_resend[node.first].group = g;
+            }
+        } else {
+            gc_frame.setNode(m_first_node_id + node.first, &node.second);
+            gc_send_frame(node.first, gc_frame);
+        }
+    }
     
-    // Set up wait-for now because otherwise, for large number of nodes, ACK messages may start coming in soon and are thus not registered.
-    {
-        std::lock_guard<std::mutex> lock(gc_waitfor_mutex);
-        
-        if (gc_waitfor_status == GC_WAITFOR_RESULT_ACTIVE) {
-            // It's an error that wait-for is still active
-            report_error(0, "Internal error: wait-for event is active before sending UPDATE_X messages.");
-            return false;
-        } else if (gc_waitfor_status == GC_WAITFOR_RESULT_ERROR) {
-            // It's an error that wait-for is in error state
-            report_error(0, "Internal error: wait-for event is in error state before sending UPDATE_X messages.");
+    // Reset the groups' states
+    for (const auto & node: gc_grouped_nodes) {
+        auto g = m_node_group_of[node.first];
+        if (g >= 0) {
+            gc_group_state[g].count = 0;
+            gc_group_state[g].sent = false;
+        }
+    }
+}
+
+
+/**
+ Add a group of nodes which receive the same message with a single send (see OBNNodeGroup).
+ A node can be a member of at most one group. The group can only be added when the GC is not running, and after the member nodes have been inserted.
+ \param group The group object; the GC takes its ownership if successful.
+ \param members IDs of the member nodes.
+ \return true if successful.
+ */
+bool GCThread::addNodeGroup(OBNNodeGroup* group, const std::vector<int>& members) {
+    if (_gcthread || !group || members.empty()) {
+        return false;
+    }
+    m_node_group_of.resize(_nodes.size(), -1);
+    for (auto id: members) {
+        if (id < 0 || id >= static_cast<int>(_nodes.size()) || m_node_group_of[id] >= 0) {
             return false;
         }
+    }
+    int g = m_node_groups.size();
+    for (auto id: members) {
+        m_node_group_of[id] = g;
+    }
+    m_node_groups.emplace_back(group);
+    
+    NodeGroupState state;
+    state.size = members.size();
+    gc_group_state.push_back(state);
+    return true;
+}
+
+
+/**
+ Set up the UPDATE_Y message to a node, which has just been returned by the run-time graph (so that RTNodeDepGraph::isSink() can be used).
+ If lookahead is enabled for the node and a window of several updates can be granted, a SIM_YW message is used, with the encoded list of updates in its data.
+ Otherwise, if fused updates are enabled and the node is a sink that needs UPDATE_X, a SIM_YX message is used, with the UPDATE_X mask in its data.
+ In both cases, the node is marked so that it won't receive UPDATE_X later.
+ \param msg The message, whose time is already set.
+ \param id ID of the node.
+ \param mask The mask of the UPDATE_Y.
+ \param fromGC Whether it is called from the GC thread; lookahead windows change the node's schedule so they can only be computed by the GC thread.
+ \return true if the message is set up; false if a plain SIM_Y should be sent (then the message is not changed).
+ */
+bool GCThread::gc_set_update_y_msg(OBNSimMsg::SMN2N& msg, int id, updatemask_t mask, bool fromGC) {
+    if (fromGC && lookahead && m_lookahead_consumers[id] && rtNodeGraph->isSink(id) && gc_lookahead_window(id, mask)) {
+        msg.set_msgtype(OBNSimMsg::SMN2N_MSGTYPE_SIM_YW);
+        msg.set_i(mask);
+        OBNsim::Utils::encodeUpdateList(gc_lookahead_updates, gc_lookahead_bytes);
+        auto *data = msg.mutable_data();
+        data->Clear();
+        data->set_b(gc_lookahead_bytes);
+        gc_skip_update_x[id] = 1;
+    } else if (fuse_update_x && _nodes[id]->needUPDATEX && rtNodeGraph->isSink(id) && (gc_parent_left.empty() || gc_parent_left[id] == 0)) {
+        msg.set_msgtype(OBNSimMsg::SMN2N_MSGTYPE_SIM_YX);
+        msg.set_i(mask);
+        msg.mutable_data()->Clear();
+        msg.mutable_data()->set_i(gc_update_mask_of(id));
+        gc_skip_update_x[id] = 1;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ Compute the lookahead window of a node, i.e. its updates from the current one up to (excluding) a safe horizon, in gc_lookahead_updates.
+ The horizon is the earliest next update time of the node's consumers (or the final simulation time): until then, no consumer can read the node's outputs.
+ The node's consumers that are updating in the current iteration are scheduled at the current time, so no window is granted then.
+ The node's schedule is advanced past the window: its current update is finished here (see gc_lookahead_end), and so are the updates in the window.
+ \param id ID of the node, which must be enabled for lookahead.
+ \param mask The update mask returned by the run-time graph for the node; it must be the node's full mask of the current iteration.
+ \return true if a window of at least two updates is granted.
+ */
+bool GCThread::gc_lookahead_window(int id, updatemask_t mask) {
+    if (mask != gc_update_mask_of(id)) {
+        return false;
+    }
+    
+    // Compute the horizon
+    simtime_t horizon = final_sim_time + 1;
+    for (auto consumer: *m_lookahead_consumers[id]) {
+        auto t = gc_scheduler.timeOf(consumer);
+        if (t >= 0 && t < horizon) {
+            horizon = t;
+        }
+    }
+    if (horizon <= current_sim_time) {
+        return false;
+    }
+    
+    // Collect the node's updates until the horizon
+    auto *pNode = _nodes[id].get();
+    gc_lookahead_updates.clear();
+    gc_lookahead_updates.emplace_back(current_sim_time, mask);
+    while (true) {
+        pNode->finishCurrentUpdate();
+        auto t = pNode->getNextUpdate();
+        if (t < 0 || t >= horizon) {
+            break;
+        }
+        gc_lookahead_updates.emplace_back(t, pNode->getNextUpdateMask());
+    }
+    gc_lookahead_end[id] = gc_lookahead_updates.back().first;
+    
+    if (gc_lookahead_updates.size() < 2) {
+        return false;
+    }
+    ++gc_lookahead_windows;
+    gc_lookahead_count += gc_lookahead_updates.size();
+    return true;
+}
+
+
+/** The update list is ordered by node IDs, so a binary search is used. */
+updatemask_t GCThread::gc_update_mask_of(int id) const {
+    auto itbegin = gc_update_list.begin(), itend = itbegin + gc_update_size;
+    auto it = std::lower_bound(itbegin, itend, id, [](const NodeUpdateInfo& info, int nodeID) { return info.nodeID < nodeID; });
+    return (it != itend && it->nodeID == id)?it->updateMask:0;
+}
+
+
+/* This method sends irregular UPDATE_Y to nodes in the updating list.
+ Only if messages are sent to nodes, it will start wait-for for them and may start a new timer event if timeout is used for UPDATE_Y.
+ Here we will directly start the wait-for event without using the method gc_waitfor_start().
+
+ \sa gc_update_list
+ \return true if successful; false if not (error)
+ */
+/*
+bool GCThread::gc_send_update_y_irregular() {
+    if (gc_waitfor_active) {
+        // It's an error that wait-for is still active
+        report_error(0, "Internal error: wait-for event is active before sending irregular Y updates.");
+        return false;
+    }
+    
+    gc_waitfor_num = 0;
+    
+    // Send the irregular UPDATE_Y messages to the irregular update nodes in gc_update_list
+    OBNSimMsg::SMN2N msg;
+    msg.set_msgtype(OBNSimMsg::SMN2N_MSGTYPE_SIM_YI);
+    msg.set_time(current_sim_time);
+    
+    for (IrregUpdateListIterator it(this); !it.atEnd(); ++it) {
+        auto ID = it.getID();
         
-        for (size_t k = 0; k < gc_update_size; ++k) {
-            auto ID = gc_update_list[k].nodeID;
-            
-            if (_nodes[ID]->needUPDATEX) {
-                // Mark the corresponding bit for wait-for event
-                gc_waitfor_bits[ID] = false;
-                ++numUpdateX;
-            }
+        // We don't set ID here because it's dependent on the comm protocol (see node.sendMessage())
+        // msg.set_id(ID);
+        
+        OBNSimMsg::MSGDATA *msgdata = new OBNSimMsg::MSGDATA();
+        msgdata->set_i(it.getMask());
+        msg.set_allocated_data(msgdata);
+
+        _nodes[ID]->sendMessage(m_first_node_id + ID, msg);
+        
+        // Because the irregular update of this node is used, we remove/pop it from the list
+        _nodes[ID]->popIrregularUpdate();
+        
+        // Mark the corresponding bit for wait-for event
+        gc_waitfor_bits[ID] = false;
+        ++gc_waitfor_num;  // One more node to wait for ACK
+    }
+    
+    // If no messages were sent then no need for wait-for event nor time-out
+    if (gc_waitfor_num > 0) {
+        // Set up wait-for
+        gc_waitfor_active = true;
+        gc_waitfor_type = OBNSimMsg::N2SMN::SIM_YI_ACK;
+        
+        // Set up timeout if necessary
+        if (ack_timeout > 0) {
+            gc_timer_start(ack_timeout);
         }
+        else {
+            gc_timer_reset();
+        }
+    }
+    
+    return true;
+}*/
+
+
+/** This method sends UPDATE_X to nodes in the updating list and start wait-for for them.
+ Here we will directly start the wait-for event without using the method gc_waitfor_start().
+ It also starts a new timer event if timeout is used for UPDATE_X.
+ \sa gc_update_list
+ \return true if successful; false if not (error)
+ */
+bool GCThread::gc_send_update_x() {
+    assert(gc_update_size > 0);
+    
+    auto status = gc_waitfor.status();
+    if (status == AckTracker::WAITFOR_ACTIVE) {
+        // It's an error that wait-for is still active
+        report_error(0, "Internal error: wait-for event is active before sending UPDATE_X messages.");
+        return false;
+    } else if (status == AckTracker::WAITFOR_ERROR) {
+        // It's an error that wait-for is in error state
+        report_error(0, "Internal error: wait-for event is in error state before sending UPDATE_X messages.");
+        return false;
+    }
+    
+    // Set up wait-for now because otherwise, for large number of nodes, ACK messages may start coming in soon and are thus not registered.
+    gc_waitfor_predicate = nullptr;
+    gc_waitfor_dataflow = false;
+    gc_next_seq();
+    gc_waitfor.begin(OBNSimMsg::N2SMN::SIM_X_ACK);
+    for (size_t k = 0; k < gc_update_size; ++k) {
+        auto ID = gc_update_list[k].nodeID;
         
-        if (numUpdateX > 0) {
-            gc_waitfor_type = OBNSimMsg::N2SMN::SIM_X_ACK;
-            gc_waitfor_num = numUpdateX;
-            gc_waitfor_status = GC_WAITFOR_RESULT_ACTIVE;
-            gc_waitfor_predicate = nullptr;
-        } else {
-            // No nodes need UPDATE_X -> disable wait-for and return
-            gc_waitfor_status = GC_WAITFOR_RESULT_NONE;
+        if (_nodes[ID]->needUPDATEX && !gc_skip_update_x[ID]) {
+            // Mark the corresponding bit for wait-for event
+            gc_waitfor.expect(ID);
         }
     }
     
-    if (numUpdateX == 0) {
+    if (gc_waitfor.remaining() == 0) {
+        // No nodes need UPDATE_X -> disable wait-for and return
+        gc_waitfor.reset();
         return true;
     }
     
-    // Send the UPDATE_X messages to all nodes in gc_update_list
+    // Send the UPDATE_X messages to all nodes in gc_update_list, serialized once
     OBNSimMsg::SMN2N msg;
     msg.set_msgtype(OBNSimMsg::SMN2N_MSGTYPE_SIM_X);
     msg.set_time(current_sim_time);
+    if (gc_seq.load() > 0) {
+        msg.set_seq(gc_seq);
+    }
+    gc_frame.setMessage(msg);
 
+    gc_grouped_nodes.clear();
     for (size_t k = 0; k < gc_update_size; ++k) {
         auto ID = gc_update_list[k].nodeID;
         
-        if (_nodes[ID]->needUPDATEX) {
-            // We don't set ID here because it's dependent on the comm protocol (see node.sendMessage())
-            // msg.set_id(ID);
-
-            msg.set_i(gc_update_list[k].updateMask);    // Set the update mask specified in the update list
-            _nodes[ID]->sendMessage(ID, msg);
+        if (_nodes[ID]->needUPDATEX && !gc_skip_update_x[ID]) {
+            // Set the update mask specified in the update list
+            gc_grouped_nodes.emplace_back(ID, gc_update_list[k].updateMask);
         }
     }
+    gc_begin_bundle(gc_grouped_nodes);
+    gc_send_grouped();
+    gc_end_bundle(gc_grouped_nodes);
     
     // Set up timeout if necessary
     if (ack_timeout > 0) {
@@ -780,9 +1793,10 @@ bool GCThread::gc_send_update_x() {
  \param msgtype The type of the message sent to nodes.
  \param pI Pointer to an optional int64 integer field for SMN2N.I field; if null, the field is not set.
  \param pData Pointer to an optional message data block; null pointer (default) if no data. The function will take ownership of this data, therefore the data block should be created dynamically and not released by the caller.
+ \param seq Sequence number of the message, if positive; the message is then recorded for retransmission (see ack_retries).
  \return true if successful; false if not (error)
  */
-bool GCThread::gc_send_to_all(simtime_t t, OBNSimMsg::SMN2N::MSGTYPE msgtype, int64_t *pI, OBNSimMsg::MSGDATA *pData) {
+bool GCThread::gc_send_to_all(simtime_t t, OBNSimMsg::SMN2N::MSGTYPE msgtype, int64_t *pI, OBNSimMsg::MSGDATA *pData, int64_t seq) {
     // Send the message to all nodes
     OBNSimMsg::SMN2N msg;
     msg.set_msgtype(msgtype);
@@ -794,20 +1808,53 @@ bool GCThread::gc_send_to_all(simtime_t t, OBNSimMsg::SMN2N::MSGTYPE msgtype, in
     
     // Set message data (none = clear if NULL)
     msg.set_allocated_data(pData);
+    
+    if (seq > 0) {
+        msg.set_seq(seq);
+    }
+    
+    // The message is serialized once, then only the node's ID is changed
+    if (!gc_frame.setMessage(msg)) {
+        report_error(0, "Error while serializing message (" + std::to_string(msgtype) + ").");
+        return false;
+    }
+    
+    // SIM_INIT is always sent to each node because it tells the node its ID; so are messages recorded for retransmission
+    if (m_broadcast_group && msgtype != OBNSimMsg::SMN2N_MSGTYPE_SIM_INIT && seq <= 0) {
+        gc_frame.setNode(-1);
+        if (!m_broadcast_group->sendFrame(gc_frame)) {
+            report_error(0, "Error while broadcasting message (" + std::to_string(msgtype) + ") to all nodes.");
+            return false;
+        }
+        return true;
+    }
 
+    if (bundle_messages) {
+        for (auto & node: _nodes) {
+            node->beginBundle();
+        }
+    }
+    
+    bool success = true;
     int k = 0;
     for (auto it = _nodes.begin(); it != _nodes.end(); ++it, ++k) {
-        // We don't set ID here because it's dependent on the comm protocol (see node.sendMessage())
-        // msg.set_id(k);
-        if (!(*it)->sendMessage(k, msg)) {
+        gc_frame.setNode(m_first_node_id + k);
+        if (!gc_send_frame(k, gc_frame)) {
             report_error(0, "Error while sending message (" + std::to_string(msgtype) +
                          ") to node #" + std::to_string(k) +
                          " (" + (*it)->name + ").");
-            return false;
+            success = false;
+            break;
         }
     }
     
-    return true;
+    // The bundles are always ended, even after an error
+    if (bundle_messages) {
+        for (auto & node: _nodes) {
+            success = node->endBundle() && success;
+        }
+    }
+    return success;
 }
 
 
@@ -823,13 +1870,10 @@ bool GCThread::gc_send_to_all(simtime_t t, OBNSimMsg::SMN2N::MSGTYPE msgtype, in
  \return true if successful; false if not (error)
  */
 bool GCThread::gc_send_to_all(simtime_t t, OBNSimMsg::SMN2N::MSGTYPE msgtype, OBNSimMsg::N2SMN::MSGTYPE acktype, int64_t *pI, OBNSimMsg::MSGDATA *pData, GC_WaitFor_Predicate pred) {
-    {
-        std::lock_guard<std::mutex> mlock(gc_waitfor_mutex);
-        if (gc_waitfor_status == GC_WAITFOR_RESULT_ACTIVE) {
-            // It's an error that wait-for is still active
-            report_error(0, "Internal error: wait-for event is active before sending messages of type " + std::to_string(msgtype) + " to all nodes.");
-            return false;
-        }
+    if (gc_waitfor.active()) {
+        // It's an error that wait-for is still active
+        report_error(0, "Internal error: wait-for event is active before sending messages of type " + std::to_string(msgtype) + " to all nodes.");
+        return false;
     }
     
     // Set up the wait-for event now because otherwise, for large number of nodes, ACK messages may start coming in very soon and are not registered.
@@ -838,7 +1882,7 @@ bool GCThread::gc_send_to_all(simtime_t t, OBNSimMsg::SMN2N::MSGTYPE msgtype, OB
     }
     
     // Send the message to all nodes
-    if (!gc_send_to_all(t, msgtype, pI, pData)) {
+    if (!gc_send_to_all(t, msgtype, pI, pData, gc_seq)) {
         return false;
     }
     
@@ -877,7 +1921,153 @@ std::pair<int, std::string> GCThread::request_port_connect(std::size_t idx, cons
     pData->set_b(target + source);
     msg.set_allocated_data(pData);
     
-    if (!_nodes[idx]->sendMessage(idx, msg)) {
+    return gc_request_sys(idx, msg, OBNSimMsg::N2SMN_MSGTYPE_SYS_PORT_CONNECT_ACK, timeout);
+}
+
+
+/* Connect many ports at once, with one request per node. */
+std::vector< std::pair<int, std::string> > GCThread::request_port_connect_batch(const std::vector<PortConnectRequest>& requests, unsigned int timeout) {
+    // Until its ACK is received, a connection has timed out
+    std::vector< std::pair<int, std::string> > results(requests.size(), std::make_pair(-12, std::string()));
+    
+    // Only run when the simulation is not running
+    if (gc_exec_state != GCSTATE_STOPPED) {
+        std::fill(results.begin(), results.end(), std::make_pair(-15, std::string("Port connections can only be requested when the simulation is not running.")));
+        return results;
+    }
+    
+    // Group the connections by node, with their positions in the results
+    std::map<std::size_t, std::vector<std::size_t> > nodeRequests;
+    for (std::size_t k = 0; k < requests.size(); ++k) {
+        assert(!requests[k].target.empty() && !requests[k].source.empty());
+        if (requests[k].idx >= _nodes.size()) {
+            results[k].first = -10;
+        } else {
+            nodeRequests[requests[k].idx].push_back(k);
+        }
+    }
+    
+    // Send the requests to all nodes before waiting for any ACK
+    std::map<int64_t, std::pair<std::size_t, const std::vector<std::size_t>*> > pending;     // Request ID -> node index, positions of its connections
+    OBNSimMsg::SMN2N msg;
+    msg.set_time(current_sim_time);
+    msg.set_msgtype(OBNSimMsg::SMN2N_MSGTYPE_SYS_PORT_CONNECT_BATCH);
+    OBNsim::IntStringList connections;
+    for (const auto& node: nodeRequests) {
+        connections.clear();
+        for (auto k: node.second) {
+            connections.emplace_back(requests[k].target.size(), requests[k].target + requests[k].source);
+        }
+        msg.set_i(++gc_sys_request_id);
+        OBNsim::Utils::encodeIntStringList(connections, *msg.mutable_data()->mutable_b());
+        
+        if (_nodes[node.first]->sendMessage(m_first_node_id + node.first, msg)) {
+            pending.emplace(gc_sys_request_id, std::make_pair(node.first, &node.second));
+        } else {
+            // Communication error
+            for (auto k: node.second) {
+                results[k].first = -11;
+            }
+        }
+    }
+    
+    // Wait for the ACKs, which may come in any order; other messages (e.g. late ACKs of previous requests) are ignored
+    gc_waitfor.reset();     // A finished wait-for must not wake up the GC
+    gc_timer_start(timeout);
+    const auto deadline = gc_timer_endtime;     // The timer alone does not fire while other events or requests keep coming
+    
+    OBNEventQueueType::item_type ev;    // To receive the node event
+    OBNSysRequestType sysreq = SYSREQ_NONE;  // To receive the system request
+    OBNsim::IntStringList acks;
+    
+    // The remaining connections time out at the deadline
+    while (!pending.empty() && std::chrono::steady_clock::now() < deadline) {
+        gc_wait_for_next_event(ev, sysreq);
+        
+        // Process some urgent system request
+        if (sysreq == SYSREQ_TERMINATE || sysreq == SYSREQ_STOP) {
+            // stop immediately
+            for (const auto& p: pending) {
+                for (auto k: *p.second.second) {
+                    results[k] = std::make_pair(-15, std::string("User requested to stop."));
+                }
+            }
+            break;
+        }
+        if (sysreq != SYSREQ_NONE) {
+            // The other requests are ignored because the simulation is not running; left pending, they would wake up the GC at once, without an event
+            resetSysRequest();
+        }
+        
+        if (ev) {
+            if (ev->category != SMNNodeEvent::EVT_SYS || ev->type != OBNSimMsg::N2SMN_MSGTYPE_SYS_PORT_CONNECT_BATCH_ACK || !ev->has_id || !ev->has_t) {
+                continue;
+            }
+            auto p = pending.find(ev->t);
+            if (p == pending.end() || static_cast<int>(p->second.first) != ev->nodeID) {
+                continue;
+            }
+            
+            const auto& positions = *p->second.second;
+            if (ev->has_i && ev->i < 0) {
+                // The whole request is invalid
+                for (auto k: positions) {
+                    results[k] = std::make_pair(static_cast<int>(ev->i), ev->has_b?ev->b:std::string());
+                }
+            } else if (!ev->has_b || !OBNsim::Utils::decodeIntStringList(ev->b, acks) || acks.size() != positions.size()) {
+                // Not the ACK we need
+                for (auto k: positions) {
+                    results[k].first = -13;
+                }
+            } else {
+                for (std::size_t j = 0; j < positions.size(); ++j) {
+                    results[positions[j]] = std::make_pair(static_cast<int>(acks[j].first), std::move(acks[j].second));
+                }
+            }
+            pending.erase(p);
+        }
+    }
+    
+    gc_timer_reset();
+    return results;
+}
+
+
+/* Request a node to receive the messages of a node group. */
+std::pair<int, std::string> GCThread::request_subscribe(std::size_t idx, const std::string& channel, unsigned int timeout) {
+    assert(!channel.empty());
+    
+    // Only run when the simulation is not running
+    if (gc_exec_state != GCSTATE_STOPPED) {
+        return std::make_pair(-15, "Subscriptions can only be requested when the simulation is not running.");
+    }
+    
+    if (idx >= _nodes.size()) {
+        return std::make_pair(-10, std::string());
+    }
+    
+    // Prepare the request message
+    OBNSimMsg::SMN2N msg;
+    msg.set_time(current_sim_time);
+    msg.set_msgtype(OBNSimMsg::SMN2N_MSGTYPE_SYS_SUBSCRIBE);
+    
+    OBNSimMsg::MSGDATA* pData = new OBNSimMsg::MSGDATA();
+    pData->set_b(channel);
+    msg.set_allocated_data(pData);
+    
+    return gc_request_sys(idx, msg, OBNSimMsg::N2SMN_MSGTYPE_SYS_SUBSCRIBE_ACK, timeout);
+}
+
+
+/** Send a system request message to a node, then wait for the next incoming message, which must be its ACK.
+ \param idx The index of the node (must be valid).
+ \param msg The request message.
+ \param acktype The type of the ACK.
+ \param timeout The timeout value in milliseconds.
+ \return A pair of the result in the ACK (or an error code, see request_port_connect()) and an error message (if available).
+ */
+std::pair<int, std::string> GCThread::gc_request_sys(std::size_t idx, OBNSimMsg::SMN2N& msg, OBNSimMsg::N2SMN::MSGTYPE acktype, unsigned int timeout) {
+    if (!_nodes[idx]->sendMessage(m_first_node_id + idx, msg)) {
         // Communication error
         return std::make_pair(-11, std::string());
     }
@@ -902,7 +2092,7 @@ std::pair<int, std::string> GCThread::request_port_connect(std::size_t idx, cons
     // Process the event
     if (ev) {
         if (ev->category == SMNNodeEvent::EVT_SYS &&
-            ev->type == OBNSimMsg::N2SMN_MSGTYPE_SYS_PORT_CONNECT_ACK &&
+            ev->type == acktype &&
             ev->has_id && ev->nodeID == idx)
         {
             // Get the result
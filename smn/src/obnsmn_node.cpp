@@ -125,4 +125,32 @@ bool OBNsmn::OBNNode::initialize() {
     irreg_updates.clear();
     
     return true;
-}
\ No newline at end of file
+}
+
+
+/** The buffer is reused between messages, so serializing a message usually doesn't allocate memory. */
+bool OBNsmn::SMN2NFrame::setMessage(const OBNSimMsg::SMN2N& msg) {
+    m_common_size = msg.ByteSizeLong();
+    m_has_seq = msg.has_seq();
+    m_buffer.resize(m_common_size);
+    if (m_common_size > 0 && !msg.SerializeToArray(&m_buffer[0], m_common_size)) {
+        m_common_size = 0;
+        m_buffer.clear();
+        return false;
+    }
+    return true;
+}
+
+
+/** The ID (field 3, int32) and I (field 4, int64) are appended in varint encoding, after the common fields. */
+void OBNsmn::SMN2NFrame::setNode(int nodeID, const int64_t* pI) {
+    m_buffer.resize(m_common_size);
+    if (nodeID >= 0) {
+        m_buffer.push_back(static_cast<char>((3 << 3) | 0));
+        appendVarint(static_cast<uint64_t>(nodeID));
+    }
+    if (pI) {
+        m_buffer.push_back(static_cast<char>((4 << 3) | 0));
+        appendVarint(static_cast<uint64_t>(*pI));
+    }
+}
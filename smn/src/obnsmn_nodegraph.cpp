@@ -10,6 +10,12 @@
 
 #include <unordered_set>
 #include <unordered_map>
+#include <map>
+#include <set>
+#include <deque>
+#include <limits>
+#include <algorithm>
+#include <boost/functional/hash.hpp>
 #include <obnsmn_nodegraph.h>
 #include <obnsmn_gc.h>
 
@@ -207,7 +213,7 @@ std::vector< std::pair<int,updatemask_t> > NodeDepGraph_BGL::getCurrentNodes() c
  This method tries to combine two links (link1 and link2). If they can be combined, the combined link will be placed in link1, and link2 can be removed.
 \return true if they were combined; false otherwise.
 */
-bool NodeDepGraph_BGL::combineLinks(NodeDepGraph_BGL::LinkLabel& link1, const NodeDepGraph_BGL::LinkLabel& link2) {
+bool NodeDepGraph::combineLinks(NodeDepGraph::LinkLabel& link1, const NodeDepGraph::LinkLabel& link2) {
     // Check if link2 is a special case of link1 (i.e. if both its masks are contained in the masks of the other link) or vice versa
     if (((link1.first & link2.first) == link2.first) && ((link1.second & link2.second) == link2.second)) {
         // link2 is a member of link1
@@ -227,6 +233,40 @@ bool NodeDepGraph_BGL::combineLinks(NodeDepGraph_BGL::LinkLabel& link1, const No
     return false;
 }
 
+/**
+ This method adds a new link to a list of parallel links (from the same source node to the same target node).
+ The new link is combined with the current links if possible, so that the resulted list of links is minimal.
+ */
+void NodeDepGraph::addLinkToList(std::vector<NodeDepGraph::LinkLabel>& links, const NodeDepGraph::LinkLabel& newlink) {
+    // Check if the new link can be combined with any current links
+    auto it = links.begin(), itend = links.end();
+    bool combined = false;
+    for (; !combined && it != itend; ++it) {
+        combined = combineLinks(*it, newlink);
+    }
+    
+    if (combined) {
+        // If combined then we need to run a reduction round on the set of links until a minimal set of links (i.e. no further reduction is possible).
+        while (combined) {
+            combined = false;
+            for (it = links.begin(), itend = links.end(); !combined && it != itend; ++it) {
+                for (auto itnext = it+1; !combined && itnext != itend; ++itnext) {
+                    combined = combineLinks(*it, *itnext);
+                    if (combined) {
+                        // Remove the second link
+                        links.erase(itnext);
+                    }
+                }
+            }
+            // at this point, if combined = true then we need to continue the reduction, otherwise we are done
+        }
+    }
+    else {
+        // If not combined then we simply add the new link
+        links.push_back(newlink);
+    }
+}
+
 /* Add dependency of a node on another node.
  
  Add that some outputs of node t depend on the values of the output groups specified in w of node s.
@@ -248,34 +288,7 @@ void NodeDepGraph_BGL::addDependency(int s, int t, updatemask_t smask, updatemas
     tie(theEdge, edgeExists) = edge(sdesc, tdesc, _graph);
     
     if (edgeExists) {
-        // Check if the new link can be combined with any current links
-        auto it = _graph[theEdge].links.begin(), itend = _graph[theEdge].links.end();
-        bool combined = false;
-        NodeDepGraph_BGL::LinkLabel newlink = make_pair(smask, tmask);
-        for (; !combined && it != itend; ++it) {
-            combined = combineLinks(*it, newlink);
-        }
-        
-        if (combined) {
-            // If combined then we need to run a reduction round on the set of links until a minimal set of links (i.e. no further reduction is possible).
-            while (combined) {
-                combined = false;
-                for (it = _graph[theEdge].links.begin(), itend = _graph[theEdge].links.end(); !combined && it != itend; ++it) {
-                    for (auto itnext = it+1; !combined && itnext != itend; ++itnext) {
-                        combined = combineLinks(*it, *itnext);
-                        if (combined) {
-                            // Remove the second link
-                            _graph[theEdge].links.erase(itnext);
-                        }
-                    }
-                }
-                // at this point, if combined = true then we need to continue the reduction, otherwise we are done
-            }
-        }
-        else {
-            // If not combined then we simply add the new link
-            _graph[theEdge].links.push_back(newlink);
-        }
+        addLinkToList(_graph[theEdge].links, make_pair(smask, tmask));
     }
     else {
         // Create a new edge between s and t with the new link
@@ -311,7 +324,7 @@ RTNodeDepGraph* NodeDepGraph_BGL::getRTNodeDepGraph(GCUpdateListIterator itnode,
     for (; nNodes > 0; --nNodes) {
         auto updateInfo = *(itnode++);
         assert(updateInfo.updateMask != 0); // only if the update mask is non-zero
-        _graph[static_cast<GraphT::vertex_descriptor>(updateInfo.nodeID)] = VertexLabel{true, updateInfo.updateMask, 0};  // fields: active, updateMask, inputMask
+        _graph[static_cast<GraphT::vertex_descriptor>(updateInfo.nodeID)] = VertexLabel{true, updateInfo.updateMask, 0, false};  // fields: active, updateMask, inputMask, hasDependents
     }
     
     // Loop through all edges and determine if each of them is active or inactive
@@ -345,10 +358,565 @@ RTNodeDepGraph* NodeDepGraph_BGL::getRTNodeDepGraph(GCUpdateListIterator itnode,
                     // This edge is active, so we will set its status and update the inputMask of its target node
                     _graph[*eit].active = true;
                     _graph[destNode].inputMask |= inputMask;
+                    _graph[sourceNode].hasDependents = true;
                 }
             }
         }
     }
     
     return this;
-}
\ No newline at end of file
+}
+
+// =============================================
+// Implementation using compressed sparse rows (CSR)
+// =============================================
+
+/* Add dependency of a node on another node.
+ Refer to NodeDepGraph_BGL::addDependency() for details; the links are combined in the same way.
+ */
+void NodeDepGraph_CSR::addDependency(int s, int t, updatemask_t smask, updatemask_t tmask) {
+    assert(0 <= s && s < m_numNodes && 0 <= t && t < m_numNodes);
+    
+    auto& links = m_edges[std::make_pair(s, t)];
+    if (links.empty()) {
+        links.emplace_back(smask, tmask);
+    }
+    else {
+        addLinkToList(links, std::make_pair(smask, tmask));
+    }
+    m_frozen = false;
+}
+
+/** Build the CSR arrays of out-edges and in-edges from the collected edges. */
+void NodeDepGraph_CSR::freeze() {
+    m_outOffsets.assign(m_numNodes + 1, 0);
+    m_inOffsets.assign(m_numNodes + 1, 0);
+    
+    // Count the degrees
+    std::size_t nLinks = 0;
+    for (const auto& e: m_edges) {
+        ++m_outOffsets[e.first.first + 1];
+        ++m_inOffsets[e.first.second + 1];
+        nLinks += e.second.size();
+    }
+    for (int i = 0; i < m_numNodes; ++i) {
+        m_outOffsets[i+1] += m_outOffsets[i];
+        m_inOffsets[i+1] += m_inOffsets[i];
+    }
+    
+    // Fill the out-edges; m_edges is sorted by source so the targets of each source are contiguous
+    m_outTargets.clear();
+    m_outTargets.reserve(m_edges.size());
+    for (const auto& e: m_edges) {
+        m_outTargets.push_back(e.first.second);
+    }
+    
+    // Fill the in-edges, then the links in the order of the in-edges
+    m_inSources.assign(m_edges.size(), 0);
+    std::vector<const std::vector<LinkLabel>*> inLinks(m_edges.size(), nullptr);
+    std::vector<std::size_t> pos(m_inOffsets.begin(), m_inOffsets.end() - 1);
+    for (const auto& e: m_edges) {
+        auto j = pos[e.first.second]++;
+        m_inSources[j] = e.first.first;
+        inLinks[j] = &e.second;
+    }
+    
+    m_inLinkOffsets.assign(1, 0);
+    m_inLinkOffsets.reserve(m_edges.size() + 1);
+    m_links.clear();
+    m_links.reserve(nLinks);
+    for (auto p: inLinks) {
+        m_links.insert(m_links.end(), p->begin(), p->end());
+        m_inLinkOffsets.push_back(m_links.size());
+    }
+    
+    m_frozen = true;
+}
+
+/** Re-calculate the input mask of an active node t from its in-edges whose sources are active.
+ An in-edge is active iff at least one of its links intersects with the update masks of both its source and target nodes; the input mask is the combination of the target masks of the links (of active edges) intersecting with the target's update mask.
+ The sources of active in-edges are marked as having dependents (edges only become inactive over time, so they are all marked when the run-time graph is constructed).
+ */
+void NodeDepGraph_CSR::updateInputMask(int t) {
+    updatemask_t inputMask = 0;
+    auto targetUpdateMask = m_nodes[t].updateMask;
+    
+    for (auto j = m_inOffsets[t], jend = m_inOffsets[t+1]; j < jend; ++j) {
+        auto& sourceNode = m_nodes[m_inSources[j]];
+        if (!sourceNode.active) {
+            continue;
+        }
+        
+        bool active_edge = false;
+        updatemask_t edgeMask = 0;
+        for (auto k = m_inLinkOffsets[j], kend = m_inLinkOffsets[j+1]; k < kend; ++k) {
+            const auto& alink = m_links[k];
+            if (alink.second & targetUpdateMask) {
+                edgeMask |= alink.second;
+                active_edge = active_edge || ((alink.first & sourceNode.updateMask) != 0);
+            }
+        }
+        if (active_edge) {
+            inputMask |= edgeMask;
+            sourceNode.hasDependents = true;
+        }
+    }
+    
+    m_nodes[t].inputMask = inputMask;
+}
+
+/** Prepare the run-time dependency graph for specified updating nodes.
+ Only the updating nodes (and the nodes of the previous run-time graph, to reset them) are visited.
+ \param itbegin Iterator to beginning of the list of updating nodes.
+ \param n Exact number of elements (nodes to be updated)
+ \return Pointer to a RTNodeDepGraph object
+ */
+RTNodeDepGraph* NodeDepGraph_CSR::getRTNodeDepGraph(GCUpdateListIterator itnode, size_t nNodes) {
+    if (!m_frozen) {
+        freeze();
+    }
+    
+    // Reset the nodes of the previous run-time graph
+    for (auto id: m_rtNodes) {
+        m_nodes[id].active = false;
+    }
+    m_rtNodes.clear();
+    m_ready.clear();
+    
+    // Mark updating nodes and set their updating masks
+    rtNodesLeft = nNodes;
+    for (; nNodes > 0; --nNodes) {
+        const auto& updateInfo = *(itnode++);
+        assert(updateInfo.updateMask != 0); // only if the update mask is non-zero
+        auto& thisNode = m_nodes[updateInfo.nodeID];
+        thisNode = NodeState();
+        thisNode.active = true;
+        thisNode.updateMask = updateInfo.updateMask;
+        m_rtNodes.push_back(updateInfo.nodeID);
+    }
+    
+    // Calculate the input masks and find the first wave
+    for (auto id: m_rtNodes) {
+        updateInputMask(id);
+        if (m_nodes[id].updateMask & (~m_nodes[id].inputMask)) {
+            m_ready.push_back(id);
+        }
+    }
+    
+    return this;
+}
+
+/** Return a list of IDs of independent nodes in the graph, then remove them as well as all adjacent edges.
+ The result is ordered by node ID, as in NodeDepGraph_BGL.
+ \return Vector of (ID, update-mask) of the independent nodes.
+ */
+std::vector< std::pair<int, updatemask_t> > const& NodeDepGraph_CSR::getAndRemoveIndependentNodes() {
+    rtResult.clear();
+    
+    if (empty()) {
+        return rtResult;
+    }
+    
+    // Release the independent updates of the ready nodes
+    std::sort(m_ready.begin(), m_ready.end());
+    for (auto id: m_ready) {
+        auto& thisNode = m_nodes[id];
+        updatemask_t independentUpdates = thisNode.updateMask & (~thisNode.inputMask);
+        rtResult.emplace_back(id, independentUpdates);
+        
+        thisNode.updateMask &= (~independentUpdates);   // Remove these updates from the flag
+        if (thisNode.updateMask == 0) {
+            // This node becomes inactive because there are no more updates
+            thisNode.active = false;
+            rtNodesLeft--;
+        }
+    }
+    
+    // Only the released nodes and the targets of their out-edges may change
+    if (++m_stamp == 0) {
+        // Wrap around: reset all stamps
+        std::fill(m_stamps.begin(), m_stamps.end(), 0);
+        m_stamp = 1;
+    }
+    m_dirty.clear();
+    for (auto id: m_ready) {
+        if (m_nodes[id].active && m_stamps[id] != m_stamp) {
+            m_stamps[id] = m_stamp;
+            m_dirty.push_back(id);
+        }
+        for (auto j = m_outOffsets[id], jend = m_outOffsets[id+1]; j < jend; ++j) {
+            auto t = m_outTargets[j];
+            if (m_nodes[t].active && m_stamps[t] != m_stamp) {
+                m_stamps[t] = m_stamp;
+                m_dirty.push_back(t);
+            }
+        }
+    }
+    
+    // Re-evaluate them to find the next wave
+    m_ready.clear();
+    for (auto id: m_dirty) {
+        updateInputMask(id);
+        if (m_nodes[id].updateMask & (~m_nodes[id].inputMask)) {
+            m_ready.push_back(id);
+        }
+    }
+    
+    return rtResult;
+}
+
+/** Return the remaining nodes in the run-time graph, ordered by node ID.
+ \return Vector of (ID, update-mask) of the remaining nodes.
+ */
+std::vector< std::pair<int,updatemask_t> > NodeDepGraph_CSR::getCurrentNodes() const {
+    std::vector< std::pair<int,updatemask_t> > result;
+    if (rtNodesLeft <= 0) {
+        return result;
+    }
+    
+    result.reserve(rtNodesLeft);
+    for (auto id: m_rtNodes) {
+        if (m_nodes[id].active) {
+            result.emplace_back(id, m_nodes[id].updateMask);
+        }
+    }
+    std::sort(result.begin(), result.end());
+    
+    return result;
+}
+
+/** Start dataflow dispatch: the nodes found independent by getRTNodeDepGraph() are dispatched, i.e. their independent updates are marked in progress, but they are not removed yet.
+ \return Vector of (ID, update-mask) of the nodes to be updated, ordered by node ID.
+ */
+std::vector< std::pair<int, updatemask_t> > const& NodeDepGraph_CSR::startDataflow() {
+    rtResult.clear();
+    
+    std::sort(m_ready.begin(), m_ready.end());
+    for (auto id: m_ready) {
+        auto& thisNode = m_nodes[id];
+        thisNode.inProgress = thisNode.updateMask & (~thisNode.inputMask);
+        rtResult.emplace_back(id, thisNode.inProgress);
+    }
+    m_ready.clear();
+    
+    return rtResult;
+}
+
+void NodeDepGraph_CSR::dispatchIfIndependent(int t) {
+    auto& thisNode = m_nodes[t];
+    if (!thisNode.active || thisNode.inProgress) {
+        return;
+    }
+    updateInputMask(t);
+    updatemask_t independentUpdates = thisNode.updateMask & (~thisNode.inputMask);
+    if (independentUpdates) {
+        thisNode.inProgress = independentUpdates;
+        rtResult.emplace_back(t, independentUpdates);
+    }
+}
+
+/** Finish the in-progress updates of node id, then re-evaluate the node itself and the targets of its out-edges, which are the only nodes that may become independent.
+ \param id ID of the node whose updates have finished.
+ \return Vector of (ID, update-mask) of the nodes to be updated next; empty if there are none (or if the node had no updates in progress).
+ */
+std::vector< std::pair<int, updatemask_t> > const& NodeDepGraph_CSR::finishNodeUpdate(int id) {
+    rtResult.clear();
+    
+    assert(0 <= id && id < m_numNodes);
+    auto& thisNode = m_nodes[id];
+    if (!thisNode.active || !thisNode.inProgress) {
+        return rtResult;
+    }
+    
+    thisNode.updateMask &= (~thisNode.inProgress);
+    thisNode.inProgress = 0;
+    if (thisNode.updateMask == 0) {
+        // This node becomes inactive because there are no more updates
+        thisNode.active = false;
+        rtNodesLeft--;
+    }
+    
+    dispatchIfIndependent(id);
+    for (auto j = m_outOffsets[id], jend = m_outOffsets[id+1]; j < jend; ++j) {
+        dispatchIfIndependent(m_outTargets[j]);
+    }
+    
+    return rtResult;
+}
+
+
+// =============================================
+// Cache of wave plans
+// =============================================
+
+/** Compute the hash key of a list of updating nodes, from the IDs and update masks of its elements. */
+std::size_t NodeDepGraph_WaveCache::hashUpdateList(GCUpdateListIterator itnode, size_t nNodes) {
+    std::size_t seed = nNodes;
+    for (; nNodes > 0; --nNodes, ++itnode) {
+        boost::hash_combine(seed, itnode->nodeID);
+        boost::hash_combine(seed, itnode->updateMask);
+    }
+    return seed;
+}
+
+/** Check if the plan was computed for exactly the given list of updating nodes. */
+bool NodeDepGraph_WaveCache::WavePlan::matches(GCUpdateListIterator itnode, size_t nNodes) const {
+    if (updates.size() != nNodes) {
+        return false;
+    }
+    for (const auto& u: updates) {
+        if (u.nodeID != itnode->nodeID || u.updateMask != itnode->updateMask) {
+            return false;
+        }
+        ++itnode;
+    }
+    return true;
+}
+
+void NodeDepGraph_WaveCache::addDependency(int s, int t, updatemask_t smask, updatemask_t tmask) {
+    // The graph changes, so all plans are now invalid
+    m_current = nullptr;
+    m_plans.clear();
+    m_graph->addDependency(s, t, smask, tmask);
+}
+
+/** Look up the plan for the given list of updating nodes; if it doesn't exist, compute it with the underlying graph and cache it.
+ \param itbegin Iterator to beginning of the list of updating nodes.
+ \param n Exact number of elements (nodes to be updated)
+ \return Pointer to this object, which replays the plan.
+ */
+RTNodeDepGraph* NodeDepGraph_WaveCache::getRTNodeDepGraph(GCUpdateListIterator itnode, size_t nNodes) {
+    auto key = hashUpdateList(itnode, nNodes);
+    m_nextWave = 0;
+    
+    // Look for the plan in the cache
+    auto range = m_plans.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.matches(itnode, nNodes)) {
+            ++m_hits;
+            m_current = &(it->second);
+            return this;
+        }
+    }
+    
+    // Not found: compute the plan by running the underlying run-time graph until it's empty (or stuck)
+    ++m_misses;
+    if (m_plans.size() >= m_capacity) {
+        m_plans.clear();
+    }
+    
+    WavePlan plan;
+    plan.updates.assign(itnode, itnode + nNodes);
+    
+    RTNodeDepGraph* rtgraph = m_graph->getRTNodeDepGraph(itnode, nNodes);
+    while (!rtgraph->empty()) {
+        const auto & wave = rtgraph->getAndRemoveIndependentNodes();
+        if (wave.empty()) {
+            // Algebraic loop: remember the remaining nodes so that the error can be reported when the plan is replayed
+            plan.remaining = rtgraph->getCurrentNodes();
+            break;
+        }
+        plan.waves.push_back(wave);
+        
+        // Record the sinks of this wave, which must be queried right after the wave is returned
+        plan.sinks.emplace_back();
+        for (const auto & node: wave) {
+            if (rtgraph->isSink(node.first)) {
+                plan.sinks.back().push_back(node.first);   // Sorted because the wave is sorted by ID
+            }
+        }
+    }
+    
+    // References to elements of an unordered container remain valid after insertion
+    m_current = &(m_plans.emplace(key, std::move(plan))->second);
+    return this;
+}
+
+std::vector< std::pair<int, updatemask_t> > const& NodeDepGraph_WaveCache::getAndRemoveIndependentNodes() {
+    if (m_current && m_nextWave < m_current->waves.size()) {
+        return m_current->waves[m_nextWave++];
+    }
+    return m_emptyWave;
+}
+
+/** Return the remaining nodes of the current plan, i.e. those in the waves not yet replayed and those stuck in an algebraic loop, with their remaining update masks. */
+std::vector< std::pair<int,updatemask_t> > NodeDepGraph_WaveCache::getCurrentNodes() const {
+    if (empty()) {
+        return std::vector< std::pair<int,updatemask_t> >();
+    }
+    
+    std::map<int, updatemask_t> nodes;
+    for (auto i = m_nextWave; i < m_current->waves.size(); ++i) {
+        for (const auto & node: m_current->waves[i]) {
+            nodes[node.first] |= node.second;
+        }
+    }
+    for (const auto & node: m_current->remaining) {
+        nodes[node.first] |= node.second;
+    }
+    
+    return std::vector< std::pair<int,updatemask_t> >(nodes.begin(), nodes.end());
+}
+
+bool NodeDepGraph_WaveCache::isSink(int id) const {
+    if (!m_current || m_nextWave == 0) {
+        return false;
+    }
+    const auto & sinks = m_current->sinks[m_nextWave - 1];
+    return std::binary_search(sinks.begin(), sinks.end(), id);
+}
+
+std::string NodeDepGraph_WaveCache::statistics() const {
+    return "Wave-plan cache: " + std::to_string(m_hits) + " hits, " + std::to_string(m_misses) + " misses, " +
+        std::to_string(m_plans.size()) + " plans cached.";
+}
+
+
+
+// ============================================
+// Implementation of NodeDepGraph_Partitioned
+// ============================================
+
+NodeDepGraph_Partitioned::NodeDepGraph_Partitioned(const std::vector<int>& partitions, const GraphFactory& factory): m_partitions(partitions), m_local_ids(partitions.size()) {
+    int numPartitions = partitions.empty()?0:(*std::max_element(partitions.begin(), partitions.end()) + 1);
+    m_sizes.assign(numPartitions, 0);
+    
+    // The root-level nodes follow the proxy nodes of the partitions in the root GC
+    std::size_t numRoot = numPartitions;
+    for (std::size_t k = 0; k < partitions.size(); ++k) {
+        m_local_ids[k] = (partitions[k] >= 0)?(m_sizes[partitions[k]]++):(numRoot++);
+    }
+    
+    for (auto size: m_sizes) {
+        m_graphs.emplace_back(factory(size));
+    }
+    m_graphs.emplace_back(factory(numRoot));
+    m_local_deps.resize(numPartitions);
+    m_gates.resize(numPartitions);
+}
+
+void NodeDepGraph_Partitioned::addDependency(int s, int t, updatemask_t smask, updatemask_t tmask) {
+    int ps = m_partitions[s], pt = m_partitions[t];
+    if (ps >= 0 && ps == pt) {
+        m_graphs[ps]->addDependency(m_local_ids[s], m_local_ids[t], smask, tmask);
+        m_local_deps[ps].push_back(Dependency{m_local_ids[s], m_local_ids[t], smask, tmask});
+        return;
+    }
+    
+    // The dependencies of the root graph are added when the gates are known
+    m_root_deps.push_back(Dependency{s, t, smask, tmask});
+}
+
+/** The root graph is completed with the dependencies between the partitions and the root-level nodes, between the gates of the partitions. */
+NodeDepGraph* NodeDepGraph_Partitioned::releaseRootGraph() {
+    computeGates();
+    
+    auto& root = m_graphs.back();
+    for (const auto& dep: m_root_deps) {
+        int ps = m_partitions[dep.s], pt = m_partitions[dep.t];
+        int s = m_local_ids[dep.s], t = m_local_ids[dep.t];
+        updatemask_t smask = (ps >= 0)?(1 | m_gates[ps].waitsOf(s, dep.smask)):dep.smask;
+        updatemask_t tmask = (pt >= 0)?m_gates[pt].gatesOf(t, dep.tmask):dep.tmask;
+        root->addDependency((ps >= 0)?ps:s, (pt >= 0)?pt:t, smask, tmask);
+    }
+    m_root_deps.clear();
+    return root.release();
+}
+
+/**
+ The gates of a partition are the update types of its nodes which are targets of dependencies from outside the partition.
+ They are numbered by their nodes and update types; the n-th gate has the update type (bit) n of the proxy, and the gates beyond the 63rd share the last bit.
+ The gates for which each update type waits are then propagated along the dependencies of the partition until they don't change.
+ */
+void NodeDepGraph_Partitioned::computeGates() {
+    if (m_gates_computed) {
+        return;
+    }
+    m_gates_computed = true;
+    
+    const int numBits = std::numeric_limits<updatemask_t>::digits;
+    std::vector< std::set< std::pair<int, int> > > gates(m_sizes.size());    // The gates (local ID, update type) of each partition
+    for (const auto& dep: m_root_deps) {
+        int pt = m_partitions[dep.t];
+        for (int k = 0; pt >= 0 && k < numBits; ++k) {
+            if (dep.tmask & (updatemask_t(1) << k)) {
+                gates[pt].emplace(m_local_ids[dep.t], k);
+            }
+        }
+    }
+    
+    for (std::size_t p = 0; p < m_sizes.size(); ++p) {
+        auto& result = m_gates[p];
+        if (gates[p].empty()) {
+            continue;
+        }
+        result.m_gates.resize(m_sizes[p]);
+        result.m_waits.resize(m_sizes[p]);
+        
+        // The gates for which each update type of each node waits, if any
+        std::vector< std::vector<updatemask_t> > waits(m_sizes[p]);
+        std::deque<int> queue;
+        std::vector<bool> queued(m_sizes[p], false);
+        int n = 1;
+        for (const auto& gate: gates[p]) {
+            updatemask_t bit = updatemask_t(1) << std::min(n++, numBits - 1);
+            result.m_gates[gate.first].emplace_back(updatemask_t(1) << gate.second, bit);
+            waits[gate.first].resize(numBits, 0);
+            waits[gate.first][gate.second] |= bit;
+            if (!queued[gate.first]) {
+                queued[gate.first] = true;
+                queue.push_back(gate.first);
+            }
+        }
+        
+        std::vector< std::vector<const Dependency*> > outputs(m_sizes[p]);
+        for (const auto& dep: m_local_deps[p]) {
+            outputs[dep.s].push_back(&dep);
+        }
+        while (!queue.empty()) {
+            int s = queue.front();
+            queue.pop_front();
+            queued[s] = false;
+            for (auto dep: outputs[s]) {
+                updatemask_t inputs = 0;
+                for (int k = 0; k < numBits; ++k) {
+                    if (dep->smask & (updatemask_t(1) << k)) {
+                        inputs |= waits[s][k];
+                    }
+                }
+                if (inputs == 0) {
+                    continue;
+                }
+                auto& target = waits[dep->t];
+                target.resize(numBits, 0);
+                bool changed = false;
+                for (int k = 0; k < numBits; ++k) {
+                    if ((dep->tmask & (updatemask_t(1) << k)) && (target[k] | inputs) != target[k]) {
+                        target[k] |= inputs;
+                        changed = true;
+                    }
+                }
+                if (changed && !queued[dep->t]) {
+                    queued[dep->t] = true;
+                    queue.push_back(dep->t);
+                }
+            }
+        }
+        
+        // The update types of a node with the same gates are listed together
+        for (std::size_t id = 0; id < waits.size(); ++id) {
+            for (int k = 0; k < int(waits[id].size()); ++k) {
+                if (waits[id][k] == 0) {
+                    continue;
+                }
+                auto& list = result.m_waits[id];
+                auto it = std::find_if(list.begin(), list.end(), [&](const std::pair<updatemask_t, updatemask_t>& w) { return w.second == waits[id][k]; });
+                if (it == list.end()) {
+                    list.emplace_back(updatemask_t(1) << k, waits[id][k]);
+                } else {
+                    it->first |= updatemask_t(1) << k;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,107 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Implement the scheduler of the next updates of nodes.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <algorithm>
+#include <obnsmn_scheduler.h>
+
+using namespace OBNsmn;
+
+const std::size_t NodeUpdateScheduler::NOT_IN_HEAP;
+
+void NodeUpdateScheduler::siftUp(std::size_t i) {
+    while (i > 0) {
+        auto parent = (i - 1) / 2;
+        if (!(m_heap[i] < m_heap[parent])) {
+            break;
+        }
+        swapEntries(i, parent);
+        i = parent;
+    }
+}
+
+void NodeUpdateScheduler::siftDown(std::size_t i) {
+    auto n = m_heap.size();
+    while (true) {
+        auto smallest = i;
+        auto left = 2*i + 1, right = left + 1;
+        if (left < n && m_heap[left] < m_heap[smallest]) {
+            smallest = left;
+        }
+        if (right < n && m_heap[right] < m_heap[smallest]) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            break;
+        }
+        swapEntries(i, smallest);
+        i = smallest;
+    }
+}
+
+void NodeUpdateScheduler::set(int id, simtime_t t) {
+    assert(0 <= id && id < m_pos.size());
+    auto i = m_pos[id];
+    
+    if (t < 0) {
+        // Remove the node, if it's in the heap, by moving the last entry to its position
+        if (i != NOT_IN_HEAP) {
+            auto last = m_heap.size() - 1;
+            if (i != last) {
+                swapEntries(i, last);
+            }
+            m_heap.pop_back();
+            m_pos[id] = NOT_IN_HEAP;
+            if (i < m_heap.size()) {
+                siftDown(i);
+                siftUp(i);
+            }
+        }
+        return;
+    }
+    
+    if (i == NOT_IN_HEAP) {
+        // Insert the node
+        m_heap.emplace_back(t, id);
+        m_pos[id] = m_heap.size() - 1;
+        siftUp(m_heap.size() - 1);
+    }
+    else if (t < m_heap[i].first) {
+        m_heap[i].first = t;
+        siftUp(i);
+    }
+    else if (t > m_heap[i].first) {
+        m_heap[i].first = t;
+        siftDown(i);
+    }
+}
+
+/** The entries with the earliest time form a subtree at the root of the heap, so they are collected by a depth-first traversal which stops at entries with later times. */
+simtime_t NodeUpdateScheduler::nextNodes(std::vector<int>& ids) {
+    ids.clear();
+    if (m_heap.empty()) {
+        return -1;
+    }
+    
+    auto t = m_heap.front().first;
+    m_stack.clear();
+    m_stack.push_back(0);
+    while (!m_stack.empty()) {
+        auto i = m_stack.back();
+        m_stack.pop_back();
+        if (i < m_heap.size() && m_heap[i].first == t) {
+            ids.push_back(m_heap[i].second);
+            m_stack.push_back(2*i + 1);
+            m_stack.push_back(2*i + 2);
+        }
+    }
+    
+    std::sort(ids.begin(), ids.end());
+    return t;
+}
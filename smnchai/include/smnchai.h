@@ -14,6 +14,7 @@
 #ifndef smnchai_smnchai_h
 #define smnchai_smnchai_h
 
+#include <functional>
 #include <chaiscript/chaiscript.hpp>
 
 #include <obnsmn_report.h>
@@ -22,10 +23,12 @@
 /** The following macros are defined by CMake to indicate which libraries this SMN build supports:
  - OBNSIM_COMM_YARP: if YARP is supported for communication.
  - OBNSIM_COMM_MQTT: if MQTT is supported for communication.
+ - OBNSIM_COMM_SOCKET: if sockets are supported for communication.
+ - OBNSIM_COMM_SHM: if shared memory is supported for communication.
  */
 
 // At least one communication framework must be supported
-#if !defined(OBNSIM_COMM_YARP) && !defined(OBNSIM_COMM_MQTT)
+#if !defined(OBNSIM_COMM_YARP) && !defined(OBNSIM_COMM_MQTT) && !defined(OBNSIM_COMM_SOCKET) && !defined(OBNSIM_COMM_SHM)
 #error "At least one communication framework must be supported."
 #endif
 
@@ -37,15 +40,20 @@
 #include <obnsmn_comm_mqtt.h>
 #endif
 
+#ifdef OBNSIM_COMM_SOCKET
+#include <obnsmn_comm_socket.h>
+#endif
+
+#ifdef OBNSIM_COMM_SHM
+#include <obnsmn_comm_shm.h>
+#endif
+
 // The usage of this program
 void show_usage();
 
 // Function to shut down the SMN, should be called before exiting
 void shutdown_SMN();
 
-// Function to shut down communication threads
-void shutdown_communication_threads(OBNsmn::GCThread& gc);
-
 namespace SMNChai {
     /** A structure that contains the supported communication objects. */
     struct SMNChaiComm {
@@ -54,6 +62,17 @@ namespace SMNChai {
 #endif
 #ifdef OBNSIM_COMM_MQTT
         OBNsmn::MQTT::MQTTClient* mqttClient = nullptr;
+        
+        /** If set, the MQTT client is shared with other simulations in this SMN (see RunManager) and is obtained from this function,
+         and the workspace's GC topic is routed to its GC (see MQTTClient::addWorkspace()) instead of the client being created. */
+        std::function<OBNsmn::MQTT::MQTTClient* ()> sharedMqttClient;
+        std::string mqttTopic;  ///< The GC topic routed on the shared MQTT client
+#endif
+#ifdef OBNSIM_COMM_SOCKET
+        OBNsmn::SOCKET::SocketServer* socketServer = nullptr;
+#endif
+#ifdef OBNSIM_COMM_SHM
+        OBNsmn::SHM::ShmServer* shmServer = nullptr;
 #endif
         // Check whether all communication threads have finished their execution
         bool allFinished() const {
@@ -63,7 +82,17 @@ namespace SMNChai {
             }
 #endif
 #ifdef OBNSIM_COMM_MQTT
-            if (mqttClient && mqttClient->isRunning()) {
+            if (mqttClient && !sharedMqttClient && mqttClient->isRunning()) {
+                return false;
+            }
+#endif
+#ifdef OBNSIM_COMM_SOCKET
+            if (socketServer && socketServer->isRunning()) {
+                return false;
+            }
+#endif
+#ifdef OBNSIM_COMM_SHM
+            if (shmServer && shmServer->isRunning()) {
                 return false;
             }
 #endif
@@ -78,6 +107,47 @@ namespace SMNChai {
             }
 #endif
 #ifdef OBNSIM_COMM_MQTT
+#endif
+        }
+        
+#ifdef OBNSIM_COMM_MQTT
+        // Stop and delete the MQTT client, or only stop routing the GC topic if the client is shared
+        void releaseMqttClient() {
+            if (mqttClient) {
+                if (sharedMqttClient) {
+                    mqttClient->removeWorkspace(mqttTopic);
+                    mqttTopic.clear();
+                } else {
+                    mqttClient->stop();
+                    delete mqttClient;
+                }
+                mqttClient = nullptr;
+            }
+        }
+#endif
+        
+        // Delete the communication objects (after their threads have been shut down)
+        void deleteObjects() {
+#ifdef OBNSIM_COMM_YARP
+            if (yarpThread) {
+                delete yarpThread;
+                yarpThread = nullptr;
+            }
+#endif
+#ifdef OBNSIM_COMM_MQTT
+            releaseMqttClient();
+#endif
+#ifdef OBNSIM_COMM_SOCKET
+            if (socketServer) {
+                delete socketServer;
+                socketServer = nullptr;
+            }
+#endif
+#ifdef OBNSIM_COMM_SHM
+            if (shmServer) {
+                delete shmServer;
+                shmServer = nullptr;
+            }
 #endif
         }
     };
@@ -87,6 +157,7 @@ namespace SMNChai {
         bool dockerlist{false};     ///< Whether to generate node list for Docker
         std::string dockerlistfile; ///< File name to write the node list for Docker
         bool dryrun{false};         ///< Whether the user specifies dry-run option in the command-line
+        std::string cachefile;      ///< The cache file of the workspace (see WorkSpace::save_cache()); empty if the workspace is not cached
     };
     
     /** The function to load the Chaiscript simulation file.
@@ -100,4 +171,8 @@ namespace SMNChai {
                                             SMNChaiComm& comm,
                                             const SystemSettings& sys_settings);
 }
+
+// Function to shut down the communication threads of a simulation
+void shutdown_communication_threads(OBNsmn::GCThread& gc, SMNChai::SMNChaiComm& comm);
+
 #endif
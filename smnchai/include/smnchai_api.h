@@ -14,6 +14,7 @@
 #include <exception>
 #include <string>
 #include <map>
+#include <vector>
 #include <forward_list>
 #include <unordered_set>
 #include <list>
@@ -23,6 +24,7 @@
 
 #include <obnsim_basic.h>
 #include <obnsmn_gc.h>   // The GC thread
+#include <obnsmn_arrivals.h>
 
 #ifdef OBNSIM_COMM_YARP
 #include <obnsmn_comm_yarp.h>
@@ -32,6 +34,14 @@
 #include <obnsmn_comm_mqtt.h>
 #endif
 
+#ifdef OBNSIM_COMM_SOCKET
+#include <obnsmn_comm_socket.h>
+#endif
+
+#ifdef OBNSIM_COMM_SHM
+#include <obnsmn_comm_shm.h>
+#endif
+
 #include <smnchai.h>
 
 namespace chaiscript {
@@ -63,12 +73,14 @@ namespace SMNChai {
     enum CommProtocol {
         COMM_DEFAULT = 0,   // For nodes: default option set by the system; for ports: any comm. protocol
         COMM_YARP = 1,
-        COMM_MQTT = 2
+        COMM_MQTT = 2,
+        COMM_SOCKET = 3,    // For nodes only: the SMN's messages go over sockets, the data ports use MQTT
+        COMM_SHM = 4        // For nodes on the same host as the SMN: the SMN's messages and the data of shared-memory ports go through shared memory
     };
     
     /** Returns the Communication protocol value from a string.
      \param t_comm A string specifying the comm. protocol.
-     Currently supported: "DEFAULT" or "ANY", "YARP" and "MQTT".
+     Currently supported: "DEFAULT" or "ANY", "YARP", "MQTT", "SOCKET" and "SHM".
      \exception smnchai_exception if the specified protocol is not supported (built into SMNChai).
      */
     CommProtocol comm_protocol_from_string(const std::string& t_comm);
@@ -81,7 +93,11 @@ namespace SMNChai {
         const CommProtocol comm;        
     };
     
+    /** A table of text cells, row by row, e.g. read from a CSV file; used by the bulk functions of WorkSpace. */
+    typedef std::vector< std::vector<std::string> > TextTable;
+    
     class WorkSpace;
+    class NodeLauncher;
     
     /** \brief Class that represents a node, to be created in Chaiscript
      */
@@ -89,8 +105,9 @@ namespace SMNChai {
     public:
         /** Prefix to node name created by the global new_node.
          Typically this prefix is empty, however it can be set to the name of a subsystem so that new nodes are automatically placed inside it.
+         It is per thread because the scripts of several simulations can run concurrently (see RunManager).
          */
-        static std::string m_global_prefix;
+        static thread_local std::string m_global_prefix;
 
     public:
         // DATA MEMBERS
@@ -126,6 +143,9 @@ namespace SMNChai {
         /** The communication protocol used for this node's GC port. */
         CommProtocol m_comm_protocol = COMM_DEFAULT;
         
+        /** The partition of the node, run by a sub-coordinator of the GC; negative if the node is run by the GC directly. */
+        int m_partition = -1;
+        
     public:
         /** Constructor of a node object given its name. The node is not yet added to the network.
          \exception smnchai_exception an error happens, e.g. invalid name.
@@ -155,6 +175,14 @@ namespace SMNChai {
         /** Returns the current comm protocol of the node as a string. */
         std::string get_comm_protocol();
         
+        /** Set the partition of the node (a non-negative number), or run it by the GC directly (a negative number, by default).
+         The nodes of each partition are run by a sub-coordinator, which resolves the dependencies between them; the GC only exchanges one message per partition in each wave.
+         */
+        void set_partition(int p) { m_partition = (p < 0)?-1:p; }
+        
+        /** Returns the partition of the node, or -1 if it is run by the GC directly. */
+        int get_partition() const { return m_partition; }
+        
         /** \brief Add a new physical input port to the node.
          \param t_name The name of the port.
          \exception smnchai_exception an error happens, e.g. invalid name, port already exists...
@@ -234,6 +262,24 @@ namespace SMNChai {
         OBNsmn::MQTT::OBNNodeMQTT* create_mqtt_node(OBNsmn::MQTT::MQTTClient* client, const WorkSpace &ws) const;
 #endif
         
+#ifdef OBNSIM_COMM_SOCKET
+        /** \brief Create a socket node object for this node.
+         \param server Pointer to the SocketServer object to which this node connects (for sending messages)
+         \param ws The WorkSpace object to whom this node belongs (to access system settings).
+         \return Pointer to the new node object; nullptr if there is any error.
+         */
+        OBNsmn::SOCKET::OBNNodeSocket* create_socket_node(OBNsmn::SOCKET::SocketServer* server, const WorkSpace &ws) const;
+#endif
+        
+#ifdef OBNSIM_COMM_SHM
+        /** \brief Create a shared-memory node object for this node.
+         \param server Pointer to the ShmServer object (for sending messages)
+         \param ws The WorkSpace object to whom this node belongs (to access system settings).
+         \return Pointer to the new node object; nullptr if there is any error.
+         */
+        OBNsmn::SHM::OBNNodeShm* create_shm_node(OBNsmn::SHM::ShmServer* server, const WorkSpace &ws) const;
+#endif
+        
         /** Returns the update mask of a given input port, exception if port does not exist. */
         OBNsim::updatemask_t input_updatemask(const std::string &port_name) const {
             auto it = m_inputs.find(port_name);
@@ -365,7 +411,9 @@ namespace SMNChai {
         /** Mapping nodes' names to Node objects, their IDs (to be used later on), and pointers to the Node object. */
         struct NodeInfo {
             Node node;
-            std::size_t index;
+            std::size_t index;      // The index of the node in its GC
+            int partition = -1;     // The index of the sub-coordinator running the node, or -1 for the GC itself
+            std::size_t id = 0;     // The ID of the node in the dependency graph of the whole system
             //OBNsmn::OBNNode* pnodeobj = nullptr;  // Pointer to the actual node object
             NodeInfo(const Node& n): node(n), index(0) { }
         };
@@ -374,6 +422,20 @@ namespace SMNChai {
         /** List of all connections between ports in this workspace. */
         std::forward_list< std::pair<PortInfo, PortInfo> > m_connections;
         
+        /** Keys of the connections in m_connections (see connection_key()), to check in constant time whether a connection exists. */
+        std::unordered_set<std::string> m_connection_keys;
+        
+        /** The key of a connection in m_connection_keys. */
+        static std::string connection_key(const PortInfo &t_from, const PortInfo &t_to) {
+            return t_from.node_name + '/' + t_from.port_name + '\n' + t_to.node_name + '/' + t_to.port_name;
+        }
+        
+        /** Check that two ports can be connected. \exception smnchai_exception They can't be connected. */
+        static void check_connection(const PortInfo &t_from, const PortInfo &t_to);
+        
+        /** Add a connection which has been checked, unless it already exists. \return true if it's added. */
+        bool add_connection(const PortInfo &t_from, const PortInfo &t_to);
+        
         SMNChai::SMNChaiComm& m_comm;   // reference to the comm structure of the main SMN
         OBNsmn::GCThread& m_gcthread;   // the GC thread object
         
@@ -381,6 +443,9 @@ namespace SMNChai {
 #ifdef OBNSIM_COMM_MQTT
         bool m_tracking_mqtt_online_nodes = false;  // am I tracking online nodes in MQTT using m_comm->mqttclient;
 #endif
+        NodeLauncher* m_launcher = nullptr;     // the launcher of the script's local nodes, whose readiness is used to wait for the nodes that must be polled
+        bool m_cacheable = true;        // whether the workspace can be cached (see save_cache()): false once the script has done what the cache can't replay, e.g. started nodes or run simulations
+        double m_cache_wait = -1.0;     // the timeout of the script's waits for the nodes, replayed when loading from the cache: negative if it did not wait, 0 to wait forever
         
         /** Class that contains the settings of a workspace/simulation. */
         struct Settings {
@@ -395,6 +460,20 @@ namespace SMNChai {
             std::time_t m_wallclock = 0;      ///< The initial wall clock time, in Epoch/UNIX time
             CommProtocol m_comm = COMM_MQTT;
             std::string m_mqtt_server{"tcp://localhost:1883"};  ///< The MQTT server address
+            std::string m_socket_address;       ///< The address of the SMN's socket; empty for the default address of the workspace
+            unsigned int m_wave_cache = 1024;   ///< Maximum number of wave plans cached by the GC; 0 to disable the cache
+            std::string m_dep_graph{"bgl"};     ///< Implementation of the node dependency graph: "bgl" or "csr"
+            bool m_dataflow = false;            ///< Whether UPDATE_Y messages are dispatched in dataflow mode instead of in waves
+            bool m_fuse_update_x = false;       ///< Whether UPDATE_X is fused with UPDATE_Y for sink nodes
+            bool m_lookahead = false;           ///< Whether nodes without inputs are granted lookahead windows
+            bool m_mqtt_group_topics = false;   ///< Whether MQTT nodes subscribe to group topics for the SMN's broadcasts
+            bool m_bundle_messages = true;      ///< Whether the messages of a wave to nodes sharing a connection are sent together
+            std::string m_reliability{"reliable"};  ///< Reliability profile of the simulation messages: "reliable", "fast" or "best_effort"
+            unsigned int m_ack_retries = 3;     ///< Number of retransmissions on ACK timeouts, for the unreliable profiles
+            bool m_parallel_components = true;  ///< Whether the connected components of the system are run by parallel GCs
+            double m_checkpoint_time = -1.0;    ///< The time of the checkpoint of the simulation, in microseconds; negative if none
+            std::string m_checkpoint_file;      ///< The checkpoint file to be written
+            std::string m_resume_file;          ///< The checkpoint file from which the simulation resumes; empty to start from t=0
             
             /* Set the default communication protocol. */
             void default_comm(const std::string& t_comm);
@@ -444,6 +523,131 @@ namespace SMNChai {
                 return m_mqtt_server;
             }
             
+            /* Address of the SMN's socket, e.g. "unix:/tmp/smn.sock" or "tcp:*:6000" (empty for the default). */
+            void socket_address(const std::string& addr) {
+                m_socket_address = addr;
+            }
+            
+            std::string socket_address() const {
+                return m_socket_address;
+            }
+            
+            /* Size of the wave-plan cache of the GC (0 to disable). */
+            void wave_cache(unsigned int n) {
+                m_wave_cache = n;
+            }
+            
+            unsigned int wave_cache() const {
+                return m_wave_cache;
+            }
+            
+            /* Implementation of the node dependency graph: "bgl" (Boost graph library) or "csr" (compressed sparse rows). */
+            void dependency_graph(const std::string& t_impl) {
+                if (t_impl != "bgl" && t_impl != "csr") { throw smnchai_exception("Unknown dependency graph implementation '" + t_impl + "'; must be either 'bgl' or 'csr'."); }
+                m_dep_graph = t_impl;
+            }
+            
+            std::string dependency_graph() const {
+                return m_dep_graph;
+            }
+            
+            /* Dataflow dispatch of UPDATE_Y; it always uses the "csr" dependency graph without wave-plan cache. */
+            void dataflow_dispatch(bool b) {
+                m_dataflow = b;
+            }
+            
+            bool dataflow_dispatch() const {
+                return m_dataflow;
+            }
+            
+            /* Fuse UPDATE_X with UPDATE_Y (one SIM_YX message) for nodes whose outputs are not needed by other nodes in the same iteration; all nodes must support SIM_YX. */
+            void fuse_update_x(bool b) {
+                m_fuse_update_x = b;
+            }
+            
+            bool fuse_update_x() const {
+                return m_fuse_update_x;
+            }
+            
+            /* Grant lookahead windows to nodes without inputs (no incoming connections, no dependencies between their updates), which then perform several updates per message; these nodes must support SIM_YW. */
+            void lookahead(bool b) {
+                m_lookahead = b;
+            }
+            
+            bool lookahead() const {
+                return m_lookahead;
+            }
+            
+            /* Publish the SMN's messages to all nodes, or to nodes with the same update types, once on group topics to which the MQTT nodes subscribe; these nodes must support SYS_SUBSCRIBE. */
+            void mqtt_group_topics(bool b) {
+                m_mqtt_group_topics = b;
+            }
+            
+            bool mqtt_group_topics() const {
+                return m_mqtt_group_topics;
+            }
+            
+            /* Send the messages of a wave to nodes sharing a connection (e.g. the nodes of a node host over sockets) together, in one transport message. */
+            void bundle_messages(bool b) {
+                m_bundle_messages = b;
+            }
+            
+            bool bundle_messages() const {
+                return m_bundle_messages;
+            }
+            
+            /* Reliability profile of the simulation messages (SIM_INIT, UPDATE_Y, UPDATE_X) and their ACKs: "reliable" uses MQTT QOS 2; "fast" (QOS 1) and "best_effort" (QOS 0) rely on sequence numbers and retransmissions on ACK timeouts, so they require a positive ACK timeout and nodes supporting sequence numbers. */
+            void reliability(const std::string& t_profile) {
+                if (t_profile != "reliable" && t_profile != "fast" && t_profile != "best_effort") { throw smnchai_exception("Unknown reliability profile '" + t_profile + "'; must be 'reliable', 'fast' or 'best_effort'."); }
+                m_reliability = t_profile;
+            }
+            
+            std::string reliability() const {
+                return m_reliability;
+            }
+            
+            /* Number of retransmissions of the simulation messages on ACK timeouts, for the "fast" and "best_effort" reliability profiles. */
+            void ack_retries(unsigned int n) {
+                m_ack_retries = n;
+            }
+            
+            unsigned int ack_retries() const {
+                return m_ack_retries;
+            }
+            
+            /* Run the connected components of the system (the groups of nodes connected by their ports, directly or not), if there are several, by parallel GCs, each with its own clock; not used with node partitions or MQTT group topics. */
+            void parallel_components(bool b) {
+                m_parallel_components = b;
+            }
+            
+            bool parallel_components() const {
+                return m_parallel_components;
+            }
+            
+            /* Save a checkpoint of the simulation at a given time (in microseconds) to a file, from which a later simulation can resume; all nodes must support checkpoints (SIM_SAVE, SIM_LOAD). A negative time disables the checkpoint. */
+            void checkpoint(double t, const std::string& file) {
+                if (t >= 0.0 && file.empty()) { throw smnchai_exception("The checkpoint file must be non-empty."); }
+                m_checkpoint_time = t;
+                m_checkpoint_file = file;
+            }
+            
+            double checkpoint_time() const {
+                return m_checkpoint_time;
+            }
+            
+            std::string checkpoint_file() const {
+                return m_checkpoint_file;
+            }
+            
+            /* Resume the simulation from a checkpoint file saved by a simulation of the same system (empty to start from t=0). */
+            void resume_from(const std::string& file) {
+                m_resume_file = file;
+            }
+            
+            std::string resume_from() const {
+                return m_resume_file;
+            }
+            
             /* Check if the simulation will run. */
             bool will_run_simulation() const {
                 return m_sys_run_simulation && m_run_simulation;
@@ -467,6 +671,21 @@ namespace SMNChai {
         // Configure the MQTT node for the given mynode in the given GC. Used by generate_obn_system().
         void generate_obn_system_mqtt(decltype(SMNChai::WorkSpace::m_nodes)::iterator &mynode,
                                       OBNsmn::GCThread &gc, OBNsmn::MQTT::MQTTClient *mqttclient);
+        
+        // Create the groups of MQTT nodes, subscribed to group topics, in the given GC. Used by generate_obn_system().
+        void generate_obn_groups_mqtt(OBNsmn::GCThread &gc, OBNsmn::MQTT::MQTTClient *mqttclient);
+#endif
+        
+#ifdef OBNSIM_COMM_SOCKET
+        // Configure the socket node for the given mynode in the given GC. Used by generate_obn_system().
+        void generate_obn_system_socket(decltype(SMNChai::WorkSpace::m_nodes)::iterator &mynode,
+                                        OBNsmn::GCThread &gc, OBNsmn::SOCKET::SocketServer *server);
+#endif
+        
+#ifdef OBNSIM_COMM_SHM
+        // Configure the shared-memory node for the given mynode in the given GC. Used by generate_obn_system().
+        void generate_obn_system_shm(decltype(SMNChai::WorkSpace::m_nodes)::iterator &mynode,
+                                     OBNsmn::GCThread &gc, OBNsmn::SHM::ShmServer *server);
 #endif
         
     public:
@@ -488,6 +707,11 @@ namespace SMNChai {
             return m_name;
         }
         
+        /** Number of nodes in the workspace. */
+        std::size_t number_of_nodes() const {
+            return m_nodes.size();
+        }
+        
         /** \brief Returns the full path to an object.
          \param t_obj1 Name of the first object.
          \param t_obj2 Optional name of the second object.
@@ -523,6 +747,37 @@ namespace SMNChai {
          */
         void connect(const std::string &from_node, const std::string &from_port, const std::string &to_node, const std::string &to_port);
         
+        /** \brief Add many nodes from a table, in one call.
+         
+         Each row describes a node: its name, then optionally its communication protocol (empty for the default), its partition (empty for none)
+         and its blocks, as a space-separated list of "ID:period" with the sampling periods in microseconds (e.g. "0:1000000 1:0").
+         Like new_node(), the names are prefixed by the current subsystem.
+         The whole table is checked before any node is added: if a row is invalid, no node is added.
+         \return The number of nodes added.
+         \exception smnchai_exception A row is invalid, e.g. a node already exists; the message gives the row's number (from 1).
+         */
+        std::size_t add_nodes_from_table(const TextTable &t_table);
+        
+        /** \brief Add many ports to the nodes of the workspace from a table, in one call.
+         
+         Each row describes a port: the name of its node, its name, its kind ("input", "output" or "data"),
+         then optionally its communication protocol (empty for any) and its blocks, as a space-separated list of block IDs:
+         an input has direct feedthrough to these blocks (see Node::input_to_update()), an output is computed by them (see Node::output_from_update()).
+         The whole table is checked before any port is added: if a row is invalid, no port is added.
+         \return The number of ports added.
+         \exception smnchai_exception A row is invalid, e.g. the node does not exist; the message gives the row's number (from 1).
+         */
+        std::size_t add_ports_from_table(const TextTable &t_table);
+        
+        /** \brief Connect many pairs of ports from a table, in one call.
+         
+         Each row describes a connection: the source node and port, then the target node and port.
+         The existing connections are skipped. The whole table is checked before any connection is added: if a row is invalid, no connection is added.
+         \return The number of connections added.
+         \exception smnchai_exception A row is invalid, e.g. a port does not exist; the message gives the row's number (from 1).
+         */
+        std::size_t connect_many(const TextTable &t_table);
+        
         /** Utility function to print workspace's details to std::cout. */
         void print() const;
         
@@ -612,6 +867,65 @@ namespace SMNChai {
         bool start_mqtt_client();
 #endif
         
+#ifdef OBNSIM_COMM_SOCKET
+        /** \brief Start the SocketServer in the comm structure of the SMN.
+         
+         The server should not be created outside this function.
+         It listens on the socket address in the Settings of this workspace.
+         \return true if successful.
+         */
+        bool start_socket_server();
+#endif
+        
+#ifdef OBNSIM_COMM_SHM
+        /** \brief Start the ShmServer in the comm structure of the SMN.
+         
+         The server should not be created outside this function.
+         It creates the SMN's segment in shared memory, named after the SMN's GC port of this workspace.
+         \return true if successful.
+         */
+        bool start_shm_server();
+#endif
+        
+        /** \brief Get the registry notified of the arrival of a node by its communication thread (MQTT and socket nodes), starting the communication if necessary.
+         
+         The nodes of the other protocols (YARP, shared memory) must be polled with is_node_online().
+         \param t_node The node.
+         \param key Receives the name of the node in the registry.
+         \return The registry, or nullptr if the node must be polled.
+         */
+        OBNsmn::ArrivalRegistry* arrival_registry(const Node &t_node, std::string &key);
+        
+#ifdef OBNSIM_COMM_MQTT
+        /** \brief Start tracking the announcements of the MQTT nodes, if not yet.
+         \return true if the tracking has just started.
+         \exception smnchai_exception The MQTT client or the tracking could not be started.
+         */
+        bool start_mqtt_tracking();
+#endif
+        
+    public:
+        /** \brief Save the workspace to a cache file, which load_cache() reads instead of evaluating the script again.
+         
+         The cache contains the workspace's name and settings, its nodes (ports, updates and their dependencies), its connections, the Docker node list,
+         and the timeout of the script's waits for the nodes (m_cache_wait).
+         It is a compact binary file: a header (magic string and key), then the data; all integers are 64-bit little-endian, and strings and lists are preceded by their lengths.
+         The file is written to a temporary file first, then renamed, so that concurrent simulations never read a partial cache.
+         \param t_file The cache file.
+         \param t_key The key of the cache, identifying the script and its arguments.
+         \return true if successful.
+         */
+        bool save_cache(const std::string &t_file, uint64_t t_key) const;
+        
+        /** \brief Load the workspace from a cache file written by save_cache(), replacing its nodes, connections and settings.
+         
+         The file is mapped in memory and the nodes are built in place in the workspace.
+         \param t_file The cache file.
+         \param t_key The expected key of the cache.
+         \return false if the file does not exist, has another key, or is invalid; the workspace is then unchanged.
+         */
+        bool load_cache(const std::string &t_file, uint64_t t_key);
+        
     public:
         // Methods for exporting the network description to DOT, etc.
         
@@ -0,0 +1,174 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Launch many local node processes concurrently.
+ *
+ * A script can launch the nodes of a large workspace on the local host from a table, instead of starting them one at a time.
+ * The processes are started by a pool of bounded size: a process holds its place in the pool until it signals that its node is ready,
+ * so that the host is not flooded with starting processes. Each process signals its readiness directly to the SMN through a pipe.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#ifndef SMNCHAI_SMNCHAI_LAUNCHER_H
+#define SMNCHAI_SMNCHAI_LAUNCHER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <sys/types.h>
+
+#include <obnsmn_arrivals.h>
+#include <smnchai.h>
+#include <smnchai_api.h>
+
+namespace SMNChai {
+    /** A node process to be launched by NodeLauncher. */
+    struct LaunchRequest {
+        std::string node;       ///< Full name of the node, e.g. "workspace/node"
+        std::string command;    ///< The command line, run by /bin/sh
+        std::string workdir;    ///< The working directory of the process; empty for the SMN's
+        std::string log;        ///< The file receiving the stdout and stderr of the process; empty to share the SMN's
+    };
+    
+    /** \brief Launches node processes on the local host, with a bounded number of processes starting at the same time.
+     
+     The processes are started by a thread in the background, so that the script can wait for the nodes (e.g. waitfor_all_nodes) while they are being launched.
+     Each process is given the write end of a pipe as file descriptor 3, named by the environment variable OBN_READY_FD;
+     a node of the C++ framework writes its full name to the pipe as soon as its SMN port is open (see OBNnode::NodeBase::run()).
+     A process is starting until it signals that it's ready, it exits, or the ready timeout expires; a process that times out is sent SIGTERM.
+     The nodes which signaled their readiness are registered in ready(), the registry used to wait for the nodes that can't notify their arrivals otherwise.
+     Before a process is started, its log file is rotated: the previous logs are kept as log.1, log.2, etc.
+     The launching thread keeps running after the processes have started, to reap them when they exit, so that they don't remain as zombies.
+     The destructor waits until every process has left the starting state and reaps the processes which have exited; the nodes that are still running keep running after that.
+     */
+    class NodeLauncher {
+    public:
+        /** The state of a launched process. */
+        enum Status {
+            PENDING,    ///< Not yet started
+            STARTING,   ///< Started, its node has not yet signaled that it's ready
+            READY,      ///< Its node has signaled that it's ready
+            EXITED,     ///< The process exited, or closed the pipe, without signaling
+            TIMEOUT,    ///< The node has not signaled within the ready timeout, and the process was sent SIGTERM
+            FAILED      ///< The process could not be started
+        };
+        
+        NodeLauncher() = default;
+        ~NodeLauncher();
+        
+        /** \brief Queue processes to be launched, in order, and start launching them in the background. */
+        void launch(const std::vector<LaunchRequest>& t_requests);
+        
+        /** \brief Wait until no process is pending or starting.
+         \return The number of processes whose nodes are not ready.
+         */
+        std::size_t await();
+        
+        /** \brief Whether a process has been launched for a node, by the node's full name. */
+        bool launched(const std::string& t_node) const;
+        
+        /** \brief The state of the process of a node, by the node's full name.
+         \exception smnchai_exception No process has been launched for the node.
+         */
+        Status status(const std::string& t_node) const;
+        
+        /** The name of a state, e.g. "ready". */
+        static std::string status_name(Status t_status);
+        
+        /** The registry of the nodes which have signaled that they are ready. */
+        OBNsmn::ArrivalRegistry& ready() {
+            return m_ready;
+        }
+        
+        /** Set the maximum number of processes starting at the same time; 0 for the number of hardware threads (default). */
+        void max_concurrent(unsigned int t_max) {
+            m_max_concurrent = t_max;
+        }
+        
+        unsigned int max_concurrent() const {
+            return m_max_concurrent;
+        }
+        
+        /** Set the time in seconds a process may take to signal that its node is ready, before its place in the pool is freed; non-positive for no limit. */
+        void ready_timeout(double t_timeout) {
+            m_ready_timeout = t_timeout;
+        }
+        
+        double ready_timeout() const {
+            return m_ready_timeout;
+        }
+        
+        /** Set the number of previous log files kept for each node (default: 3). */
+        void log_keep(unsigned int t_keep) {
+            m_log_keep = t_keep;
+        }
+        
+        unsigned int log_keep() const {
+            return m_log_keep;
+        }
+        
+    private:
+        struct Process {
+            LaunchRequest request;
+            Status status = PENDING;
+            pid_t pid = -1;
+            bool reaped = false;        ///< Whether the exited process has been reaped
+            int ready_fd = -1;          ///< Read end of the readiness pipe, only accessed by the launching thread
+            std::string ready_line;     ///< What has been read from the pipe
+            std::chrono::steady_clock::time_point start_time;
+        };
+        
+        /** The function of the launching thread. */
+        void thread_main();
+        
+        /** Start a process. \return false if it could not be started. */
+        bool start_process(Process& t_process);
+        
+        /** Move the log file to log.1, log.1 to log.2, etc., keeping m_log_keep previous logs. */
+        void rotate_log(const std::string& t_file) const;
+        
+        /** Set the final state of a starting process, and free its place in the pool. */
+        void finish_process(Process& t_process, Status t_status);
+        
+        /** Reap the launched processes which have exited. \return The number of launched processes not yet reaped. */
+        std::size_t reap_processes();
+        
+        /** Whether no process is pending or starting; the mutex must be locked. */
+        bool idle() const {
+            return m_starting == 0 && m_next >= m_processes.size();
+        }
+        
+        std::vector< std::unique_ptr<Process> > m_processes;
+        std::unordered_map<std::string, Process*> m_by_node;
+        std::size_t m_next = 0;             ///< The next process to be started
+        unsigned int m_starting = 0;        ///< Number of processes starting
+        bool m_running = false;             ///< Whether the launching thread is running
+        bool m_stop = false;                ///< Tells the launching thread to stop reaping and return
+        
+        // The settings may be changed by the script while the launching thread reads them
+        std::atomic<unsigned int> m_max_concurrent{0};
+        std::atomic<double> m_ready_timeout{60.0};
+        std::atomic<unsigned int> m_log_keep{3};
+        
+        mutable std::mutex m_mutex;         ///< Protects the processes' states and the counters
+        std::condition_variable m_idle;     ///< Notified when no process is pending or starting
+        std::condition_variable m_wakeup;   ///< Wakes up the launching thread while it's only reaping, for new requests or to stop
+        std::thread m_thread;
+        
+        OBNsmn::ArrivalRegistry m_ready;
+    };
+    
+    /** \brief Register the functions to launch local nodes with a Chaiscript object. */
+    void registerLaunchAPI(chaiscript::ChaiScript &chai, WorkSpace &ws, NodeLauncher &launcher);
+}
+
+#endif // SMNCHAI_SMNCHAI_LAUNCHER_H
@@ -0,0 +1,127 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Run several simulations concurrently in one SMNChai process.
+ *
+ * A script can launch other simulation scripts, e.g. for parameter sweeps or Monte Carlo ensembles.
+ * Each launched simulation has its own workspace, GC thread and communication servers, and runs in its own thread;
+ * the simulations share the MQTT connection of the launching script, which routes the GC topic of each workspace to its GC.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#ifndef SMNCHAI_SMNCHAI_RUNS_H
+#define SMNCHAI_SMNCHAI_RUNS_H
+
+#include <string>
+#include <map>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <smnchai.h>
+#include <smnchai_api.h>
+
+namespace SMNChai {
+    /** Result of a simulation launched by a script. */
+    struct RunResult {
+        bool finished = false;      ///< Whether the simulation has finished
+        int code = 0;               ///< Exit code of the simulation, as the exit code of SMNChai (0 if successful)
+        std::string workspace;      ///< Default workspace name of the simulation
+        double sim_time = 0.0;      ///< Simulation time at which the simulation stopped, in microseconds
+        double wall_time = 0.0;     ///< Duration of the simulation (loading the script and running it), in seconds
+    };
+    
+    /** \brief Manages the simulations launched by a script.
+     
+     Each simulation loads its script with smnchai_loadscript() in its own thread, with its own GC and communication objects,
+     then runs its GC until it stops. Its default workspace name is the name of its script followed by "_run" and its number,
+     so that the simulations do not share topics, sockets or shared-memory segments unless a script sets the same workspace name.
+     MQTT simulations share the MQTT client of the launching script (see SMNChaiComm::sharedMqttClient).
+     The destructor waits for all simulations to finish.
+     */
+    class RunManager {
+    public:
+        /** \param t_ws,t_comm The workspace and communication objects of the launching script.
+         \param t_sys The system settings of the launching script, which are passed on to the simulations (except for the Docker node list).
+         */
+        RunManager(WorkSpace& t_ws, SMNChaiComm& t_comm, const SystemSettings& t_sys);
+        
+        ~RunManager();
+        
+        /** \brief Launch a simulation.
+         If the maximum number of concurrent simulations is reached, wait until one finishes.
+         \param t_script The script file of the simulation.
+         \param t_args The named arguments to the script.
+         \return The number of the simulation, starting from 0.
+         */
+        int launch(const std::string& t_script, const std::map<std::string, chaiscript::Boxed_Value>& t_args);
+        
+        /** \brief Wait until a simulation finishes.
+         \return Its exit code.
+         \exception smnchai_exception The simulation does not exist.
+         */
+        int await(int t_run);
+        
+        /** Wait until all simulations finish. */
+        void await_all();
+        
+        /** \brief The result of a simulation (which may not have finished yet, see RunResult::finished).
+         \exception smnchai_exception The simulation does not exist.
+         */
+        RunResult result(int t_run);
+        
+        /** Number of simulations launched. */
+        std::size_t size() const {
+            return m_runs.size();
+        }
+        
+        /** Set the maximum number of simulations which run concurrently; 0 for no limit (default). */
+        void max_concurrent(unsigned int t_max) {
+            m_max_concurrent = t_max;
+        }
+        
+        unsigned int max_concurrent() const {
+            return m_max_concurrent;
+        }
+        
+        /** Request the GCs of all running simulations, of all managers, to terminate, e.g. when the SMN is interrupted. */
+        static void terminate_all();
+        
+    private:
+        struct Run {
+            std::string script;
+            std::map<std::string, chaiscript::Boxed_Value> args;
+            RunResult result;
+            std::thread thread;
+        };
+        
+        /** The thread function of a simulation. */
+        void run_main(Run& t_run);
+        
+#ifdef OBNSIM_COMM_MQTT
+        /** The MQTT client of the launching script, started if necessary, to be shared with the simulations. */
+        OBNsmn::MQTT::MQTTClient* shared_mqtt_client();
+#endif
+        
+        WorkSpace& m_ws;
+        SMNChaiComm& m_comm;
+        SystemSettings m_sys;
+        
+        std::vector< std::unique_ptr<Run> > m_runs;
+        unsigned int m_max_concurrent = 0;
+        unsigned int m_active = 0;          ///< Number of simulations running
+        std::mutex m_mutex;                 ///< Protects the results and m_active
+        std::condition_variable m_finished; ///< Notified when a simulation finishes
+        std::mutex m_mqtt_mutex;            ///< Serializes starting the shared MQTT client
+    };
+    
+    /** \brief Register the functions to launch, await and collect simulations with a Chaiscript object. */
+    void registerRunAPI(chaiscript::ChaiScript &chai, RunManager &runs);
+}
+
+#endif  // SMNCHAI_SMNCHAI_RUNS_H
@@ -12,6 +12,7 @@
 #define smnchai_smnchai_utils_h
 
 #include <vector>
+#include <string>
 
 #include <chaiscript/chaiscript.hpp>
 
@@ -32,6 +33,21 @@ namespace SMNChai {
                                        const std::string& t_delimiter, bool t_header);
         
         
+        /** \brief Load a CSV file as a table of text cells (see SMNChai::TextTable), without creating Chaiscript objects.
+         
+         \param t_file Name of the CSV file.
+         \param t_delimiter The delimiter characters (e.g. ",")
+         \param t_header true if there is a header line at the beginning, which is skipped.
+         \return The rows of the file; empty rows are skipped. If the file can't be read, an exception will be thrown.
+         */
+        std::vector< std::vector<std::string> > load_csv_table(const std::string& t_file, const std::string& t_delimiter, bool t_header);
+        
+        /** \brief Convert a Chaiscript Vector of rows, each a Vector of strings or numbers, to a table of text cells (see SMNChai::TextTable).
+         \exception smnchai_exception A row is not a Vector, or a cell is neither a string nor a number.
+         */
+        std::vector< std::vector<std::string> > table_from_chai(const TChaiVector& t_rows);
+        
+        
         /** Create a Chaiscript module of utility API for IO. */
         chaiscript::ModulePtr smnchai_api_utils_io(chaiscript::ModulePtr m = std::make_shared<chaiscript::Module>());
         
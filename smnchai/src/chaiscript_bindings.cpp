@@ -1,4 +1,6 @@
 #include "smnchai_api.h"
+#include "smnchai_runs.h"
+#include "smnchai_launcher.h"
 #include "smnchai_utils.h"
 #include <chaiscript/dispatchkit/bootstrap.hpp>
 
@@ -40,6 +42,8 @@ void SMNChai::registerSMNAPI(ChaiScript &chai, SMNChai::WorkSpace &ws) {
     chai.add(fun(&Node::set_need_updateX), "need_updateX");
     chai.add(fun(&Node::set_comm_protocol), "set_comm");   // a string of the name of the communication protocol: default, mqtt, yarp
     chai.add(fun(&Node::get_comm_protocol), "get_comm");   // returns a string of the name of the communication protocol: default, mqtt, yarp
+    chai.add(fun(&Node::set_partition), "set_partition");   // the partition of the node, run by a sub-coordinator; negative for the GC itself
+    chai.add(fun(&Node::get_partition), "get_partition");
     
     chai.add(fun(&Node::input_to_update), "input_to_block");
     chai.add(fun(&Node::output_from_update), "output_from_block");
@@ -89,6 +93,25 @@ void SMNChai::registerSMNAPI(ChaiScript &chai, SMNChai::WorkSpace &ws) {
     chai.add(fun([&ws](PortInfo s, PortInfo t) { ws.connect(std::move(s), std::move(t)); }), "connect");
     chai.add(fun<void (WorkSpace::*)(const std::string &, const std::string &, const std::string &, const std::string &)>(&WorkSpace::connect, &ws), "connect");
     
+    /* Bulk functions to add nodes, ports and connections from tables, in one call each (see WorkSpace::add_nodes_from_table(), etc.).
+     A table is either a Vector of rows, each a Vector of strings or numbers, or a CSV file given with its delimiter and whether it has a header line.
+     They return the number of nodes, ports or connections added. */
+    chai.add(fun([&ws](const APIUtils::TChaiVector &rows) { return int(ws.add_nodes_from_table(APIUtils::table_from_chai(rows))); }), "add_nodes_from_table");
+    chai.add(fun([&ws](const std::string &file, const std::string &delimiter, bool header) {
+        ws.m_cacheable = false;     // The file is not part of the cache key
+        return int(ws.add_nodes_from_table(APIUtils::load_csv_table(file, delimiter, header)));
+    }), "add_nodes_from_table");
+    chai.add(fun([&ws](const APIUtils::TChaiVector &rows) { return int(ws.add_ports_from_table(APIUtils::table_from_chai(rows))); }), "add_ports_from_table");
+    chai.add(fun([&ws](const std::string &file, const std::string &delimiter, bool header) {
+        ws.m_cacheable = false;     // The file is not part of the cache key
+        return int(ws.add_ports_from_table(APIUtils::load_csv_table(file, delimiter, header)));
+    }), "add_ports_from_table");
+    chai.add(fun([&ws](const APIUtils::TChaiVector &rows) { return int(ws.connect_many(APIUtils::table_from_chai(rows))); }), "connect_many");
+    chai.add(fun([&ws](const std::string &file, const std::string &delimiter, bool header) {
+        ws.m_cacheable = false;     // The file is not part of the cache key
+        return int(ws.connect_many(APIUtils::load_csv_table(file, delimiter, header)));
+    }), "connect_many");
+    
     // Function to change the name of the workspace: workspace(new_name)
     chai.add(fun(&WorkSpace::set_name, &ws), "workspace");
     
@@ -120,7 +143,10 @@ void SMNChai::registerSMNAPI(ChaiScript &chai, SMNChai::WorkSpace &ws) {
         ws.start_remote_node(n, c, p, a);
     }), "start_remote_node");
     
-    chai.add(fun(&run_remote_command), "run_remote_command");
+    chai.add(fun([&ws](const std::string &c, const std::string &t, const std::string &p, const std::string &a, const std::string &w) {
+        ws.m_cacheable = false;     // The command is not run again when the workspace is loaded from its cache
+        run_remote_command(c, t, p, a, w);
+    }), "run_remote_command");
     
     chai.add(fun<void (WorkSpace::*)(const Node &, double)>(&WorkSpace::waitfor_node_online, &ws), "waitfor_node");
     //chai.add(fun<void (WorkSpace::*)(const std::string &, double) const>(&WorkSpace::waitfor_node_online, &ws), "waitfor_node");
@@ -203,6 +229,120 @@ void SMNChai::registerSMNAPI(ChaiScript &chai, SMNChai::WorkSpace &ws) {
     chai.add(util_module);
 }
 
+/** This function registers the functions to launch other simulations from a script, wait for them and collect their results.
+ \param chai The ChaiScript object to which the functions are registered.
+ \param runs The manager of the simulations launched by the script.
+ */
+void SMNChai::registerRunAPI(ChaiScript &chai, SMNChai::RunManager &runs) {
+    /* Launch a simulation script, optionally with named arguments (a Map, typically of strings as on the command line); returns the number of the simulation. */
+    chai.add(fun([&runs](const std::string &script, const std::map<std::string, Boxed_Value> &args) { return runs.launch(script, args); }), "launch_run");
+    chai.add(fun([&runs](const std::string &script) { return runs.launch(script, std::map<std::string, Boxed_Value>()); }), "launch_run");
+    
+    /* Wait for a simulation to finish and return its exit code (0 if successful). */
+    chai.add(fun([&runs](int run) { return runs.await(run); }), "await_run");
+    
+    /* Wait for all simulations to finish. */
+    chai.add(fun([&runs]() { runs.await_all(); }), "await_runs");
+    
+    /* The result of a simulation, as a Map with keys "finished", "code", "workspace", "sim_time" (in microseconds) and "wall_time" (in seconds). */
+    chai.add(fun([&runs](int run) {
+        auto result = runs.result(run);
+        std::map<std::string, Boxed_Value> m;
+        m["finished"] = Boxed_Value(result.finished);
+        m["code"] = Boxed_Value(result.code);
+        m["workspace"] = Boxed_Value(result.workspace);
+        m["sim_time"] = Boxed_Value(result.sim_time);
+        m["wall_time"] = Boxed_Value(result.wall_time);
+        return m;
+    }), "run_result");
+    
+    /* Number of simulations launched. */
+    chai.add(fun([&runs]() { return int(runs.size()); }), "number_of_runs");
+    
+    /* Set/get the maximum number of simulations running concurrently; 0 for no limit. */
+    chai.add(fun([&runs](int n) {
+        if (n < 0) { throw smnchai_exception("The maximum number of concurrent simulations must be non-negative."); }
+        runs.max_concurrent(n);
+    }), "max_concurrent_runs");
+    chai.add(fun([&runs]() { return int(runs.max_concurrent()); }), "max_concurrent_runs");
+}
+
+/** This function registers the functions to launch the nodes of the workspace as local processes, concurrently.
+ \param chai The ChaiScript object to which the functions are registered.
+ \param ws The workspace of the nodes.
+ \param launcher The launcher of the script's local nodes.
+ */
+void SMNChai::registerLaunchAPI(ChaiScript &chai, SMNChai::WorkSpace &ws, SMNChai::NodeLauncher &launcher) {
+    /* Launch local nodes from a table: a Vector of Maps with keys "node" (a Node or a node name), "command",
+     and optionally "workdir" and "log" (the file receiving the node's output).
+     Like start_remote_node, a node is not launched if it's already online or if the simulation will not run.
+     Returns the number of nodes launched; the script does not wait for them to be ready (see await_launches and waitfor_all_nodes). */
+    chai.add(fun([&ws, &launcher](const std::vector<Boxed_Value> &table) {
+        ws.m_cacheable = false;     // The nodes are not launched again when the workspace is loaded from its cache
+        if (!ws.m_settings.will_run_simulation()) {
+            return 0;
+        }
+        std::vector<SMNChai::LaunchRequest> requests;
+        for (const auto &row_value: table) {
+            const auto &row = boxed_cast<const std::map<std::string, Boxed_Value>&>(row_value);
+            auto get_string = [&row](const std::string &key, bool required) {
+                auto it = row.find(key);
+                if (it == row.end()) {
+                    if (required) {
+                        throw smnchai_exception("Each row of the launch table must have the key '" + key + "'.");
+                    }
+                    return std::string();
+                }
+                return boxed_cast<std::string>(it->second);
+            };
+            
+            auto node_it = row.find("node");
+            if (node_it == row.end()) {
+                throw smnchai_exception("Each row of the launch table must have the key 'node'.");
+            }
+            SMNChai::Node node = node_it->second.is_type(user_type<SMNChai::Node>()) ?
+                boxed_cast<const SMNChai::Node&>(node_it->second) : SMNChai::Node(boxed_cast<std::string>(node_it->second));
+            if (ws.is_node_online(node)) {
+                continue;
+            }
+            
+            SMNChai::LaunchRequest request;
+            request.node = ws.get_full_path(node.get_name());
+            request.command = get_string("command", true);
+            request.workdir = get_string("workdir", false);
+            request.log = get_string("log", false);
+            requests.push_back(request);
+        }
+        launcher.launch(requests);
+        return int(requests.size());
+    }), "launch_nodes");
+    
+    /* Wait until every launched node is ready, has exited or has timed out; returns the number of nodes which are not ready. */
+    chai.add(fun([&launcher]() { return int(launcher.await()); }), "await_launches");
+    
+    /* The state of the process of a launched node: "pending", "starting", "ready", "exited", "timeout" or "failed". */
+    chai.add(fun([&ws, &launcher](const std::string &node) { return SMNChai::NodeLauncher::status_name(launcher.status(ws.get_full_path(node))); }), "launch_status");
+    chai.add(fun([&ws, &launcher](const SMNChai::Node &node) { return SMNChai::NodeLauncher::status_name(launcher.status(ws.get_full_path(node.get_name()))); }), "launch_status");
+    
+    /* Set/get the maximum number of nodes starting at the same time; 0 for the number of hardware threads. */
+    chai.add(fun([&launcher](int n) {
+        if (n < 0) { throw smnchai_exception("The maximum number of nodes starting concurrently must be non-negative."); }
+        launcher.max_concurrent(n);
+    }), "launcher_max_concurrent");
+    chai.add(fun([&launcher]() { return int(launcher.max_concurrent()); }), "launcher_max_concurrent");
+    
+    /* Set/get the time in seconds a node may take to signal that it's ready, after which its process is terminated; non-positive for no limit. */
+    chai.add(fun([&launcher](double t) { launcher.ready_timeout(t); }), "launcher_ready_timeout");
+    chai.add(fun([&launcher]() { return launcher.ready_timeout(); }), "launcher_ready_timeout");
+    
+    /* Set/get the number of previous log files kept for each node. */
+    chai.add(fun([&launcher](int n) {
+        if (n < 0) { throw smnchai_exception("The number of kept log files must be non-negative."); }
+        launcher.log_keep(n);
+    }), "launcher_log_keep");
+    chai.add(fun([&launcher]() { return int(launcher.log_keep()); }), "launcher_log_keep");
+}
+
 void SMNChai::WorkSpace::register_settings_with_Chaiscript(ChaiScript &chai) {
     // Register the Settings class and the settings object
     chai.add(user_type<SMNChai::WorkSpace::Settings>(), "WorkspaceSettings");
@@ -238,4 +378,43 @@ void SMNChai::WorkSpace::register_settings_with_Chaiscript(ChaiScript &chai) {
     /* Set/get MQTT server. */
     chai.add(fun(static_cast<void (SMNChai::WorkSpace::Settings::*)(const std::string&)>(&SMNChai::WorkSpace::Settings::MQTT_server)), "MQTT_server");
     chai.add(fun(static_cast<std::string (SMNChai::WorkSpace::Settings::*)() const>(&SMNChai::WorkSpace::Settings::MQTT_server)), "MQTT_server");
+    
+    /* Set/get the address of the SMN's socket, for the nodes using the socket communication. */
+    chai.add(fun(static_cast<void (SMNChai::WorkSpace::Settings::*)(const std::string&)>(&SMNChai::WorkSpace::Settings::socket_address)), "socket_address");
+    chai.add(fun(static_cast<std::string (SMNChai::WorkSpace::Settings::*)() const>(&SMNChai::WorkSpace::Settings::socket_address)), "socket_address");
+    
+    /* Set/get the size of the wave-plan cache of the GC (0 to disable). */
+    chai.add(fun(static_cast<void (SMNChai::WorkSpace::Settings::*)(unsigned int)>(&SMNChai::WorkSpace::Settings::wave_cache)), "wave_cache");
+    chai.add(fun(static_cast<unsigned int (SMNChai::WorkSpace::Settings::*)() const>(&SMNChai::WorkSpace::Settings::wave_cache)), "wave_cache");
+    
+    /* Set/get the implementation of the node dependency graph: "bgl" or "csr". */
+    chai.add(fun(static_cast<void (SMNChai::WorkSpace::Settings::*)(const std::string&)>(&SMNChai::WorkSpace::Settings::dependency_graph)), "dependency_graph");
+    chai.add(fun(static_cast<std::string (SMNChai::WorkSpace::Settings::*)() const>(&SMNChai::WorkSpace::Settings::dependency_graph)), "dependency_graph");
+    
+    /* Set/get dataflow dispatch of UPDATE_Y messages. */
+    chai.add(fun(static_cast<void (SMNChai::WorkSpace::Settings::*)(bool)>(&SMNChai::WorkSpace::Settings::dataflow_dispatch)), "dataflow_dispatch");
+    chai.add(fun(static_cast<bool (SMNChai::WorkSpace::Settings::*)() const>(&SMNChai::WorkSpace::Settings::dataflow_dispatch)), "dataflow_dispatch");
+    chai.add(fun(static_cast<void (SMNChai::WorkSpace::Settings::*)(bool)>(&SMNChai::WorkSpace::Settings::fuse_update_x)), "fuse_update_x");
+    chai.add(fun(static_cast<bool (SMNChai::WorkSpace::Settings::*)() const>(&SMNChai::WorkSpace::Settings::fuse_update_x)), "fuse_update_x");
+    chai.add(fun(static_cast<void (SMNChai::WorkSpace::Settings::*)(bool)>(&SMNChai::WorkSpace::Settings::lookahead)), "lookahead");
+    chai.add(fun(static_cast<bool (SMNChai::WorkSpace::Settings::*)() const>(&SMNChai::WorkSpace::Settings::lookahead)), "lookahead");
+    chai.add(fun(static_cast<void (SMNChai::WorkSpace::Settings::*)(bool)>(&SMNChai::WorkSpace::Settings::mqtt_group_topics)), "mqtt_group_topics");
+    chai.add(fun(static_cast<bool (SMNChai::WorkSpace::Settings::*)() const>(&SMNChai::WorkSpace::Settings::mqtt_group_topics)), "mqtt_group_topics");
+    chai.add(fun(static_cast<void (SMNChai::WorkSpace::Settings::*)(bool)>(&SMNChai::WorkSpace::Settings::bundle_messages)), "bundle_messages");
+    chai.add(fun(static_cast<bool (SMNChai::WorkSpace::Settings::*)() const>(&SMNChai::WorkSpace::Settings::bundle_messages)), "bundle_messages");
+    
+    /* Set/get the reliability profile ("reliable", "fast", "best_effort") and the number of retransmissions on ACK timeouts. */
+    chai.add(fun(static_cast<void (SMNChai::WorkSpace::Settings::*)(const std::string&)>(&SMNChai::WorkSpace::Settings::reliability)), "reliability");
+    chai.add(fun(static_cast<std::string (SMNChai::WorkSpace::Settings::*)() const>(&SMNChai::WorkSpace::Settings::reliability)), "reliability");
+    chai.add(fun(static_cast<void (SMNChai::WorkSpace::Settings::*)(unsigned int)>(&SMNChai::WorkSpace::Settings::ack_retries)), "ack_retries");
+    chai.add(fun(static_cast<unsigned int (SMNChai::WorkSpace::Settings::*)() const>(&SMNChai::WorkSpace::Settings::ack_retries)), "ack_retries");
+    chai.add(fun(static_cast<void (SMNChai::WorkSpace::Settings::*)(bool)>(&SMNChai::WorkSpace::Settings::parallel_components)), "parallel_components");
+    chai.add(fun(static_cast<bool (SMNChai::WorkSpace::Settings::*)() const>(&SMNChai::WorkSpace::Settings::parallel_components)), "parallel_components");
+    
+    /* Set/get the checkpoint (time in microseconds, file) and the checkpoint file to resume from. */
+    chai.add(fun(&SMNChai::WorkSpace::Settings::checkpoint), "checkpoint");
+    chai.add(fun(&SMNChai::WorkSpace::Settings::checkpoint_time), "checkpoint_time");
+    chai.add(fun(&SMNChai::WorkSpace::Settings::checkpoint_file), "checkpoint_file");
+    chai.add(fun(static_cast<void (SMNChai::WorkSpace::Settings::*)(const std::string&)>(&SMNChai::WorkSpace::Settings::resume_from)), "resume_from");
+    chai.add(fun(static_cast<std::string (SMNChai::WorkSpace::Settings::*)() const>(&SMNChai::WorkSpace::Settings::resume_from)), "resume_from");
 }
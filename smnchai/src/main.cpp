@@ -23,10 +23,11 @@
 
 #include <chaiscript/chaiscript.hpp>
 #include <smnchai.h>
+#include <smnchai_runs.h>
 
 // At least one of the communication protocols must be supported
-#if !defined(OBNSIM_COMM_YARP) && !defined(OBNSIM_COMM_MQTT)
-#error At least one communication protocol must be supported (YARP, MQTT)
+#if !defined(OBNSIM_COMM_YARP) && !defined(OBNSIM_COMM_MQTT) && !defined(OBNSIM_COMM_SOCKET) && !defined(OBNSIM_COMM_SHM)
+#error At least one communication protocol must be supported (YARP, MQTT, SOCKET, SHM)
 #endif
 
 // Implement reporting functions for the SMN
@@ -75,18 +76,7 @@ void shutdown_SMN() {
     //std::this_thread::sleep_for(std::chrono::seconds(2));
     
     // Delete the communication objects (which are created dynamically in loadscript())
-#ifdef OBNSIM_COMM_YARP
-    if (comm_objects.yarpThread) {
-        delete comm_objects.yarpThread;
-        comm_objects.yarpThread = nullptr;
-    }
-#endif
-#ifdef OBNSIM_COMM_MQTT
-    if (comm_objects.mqttClient) {
-        delete comm_objects.mqttClient;
-        comm_objects.mqttClient = nullptr;
-    }
-#endif
+    comm_objects.deleteObjects();
     
     // Shutdown ProtoBuf
     google::protobuf::ShutdownProtobufLibrary();
@@ -96,24 +86,39 @@ void shutdown_SMN() {
 // Only use this pointer in special occasions, e.g. in the handler when the program exits unexpectedly
 OBNsmn::GCThread *main_gcthread = nullptr;
 
-void shutdown_communication_threads(OBNsmn::GCThread& gc) {
+void shutdown_communication_threads(OBNsmn::GCThread& gc, SMNChai::SMNChaiComm& comm) {
     gc.simple_thread_terminate = true;
     
 #ifdef OBNSIM_COMM_MQTT
-    if (comm_objects.mqttClient) {
+    if (comm.mqttClient && !comm.sharedMqttClient) {
         // Loop until MQTT finishes or a max timeout
         int niters = 0;
-        while (niters++ <= 9 && comm_objects.mqttClient->outMsgCount() > 0) {
+        while (niters++ <= 9 && comm.mqttClient->outMsgCount() > 0) {
             // Messages are still pending -> wait
             std::this_thread::sleep_for(std::chrono::milliseconds(500));
         }
         
-        comm_objects.mqttClient->stop();    // Force stop MQTT
+        comm.mqttClient->stop();    // Force stop MQTT
+    }
+    // A shared client is stopped by the simulation which owns it
+#endif
+    
+#ifdef OBNSIM_COMM_SOCKET
+    if (comm.socketServer) {
+        // The messages are written synchronously, so nothing is pending
+        comm.socketServer->stop();
+    }
+#endif
+    
+#ifdef OBNSIM_COMM_SHM
+    if (comm.shmServer) {
+        // The messages are written synchronously to the nodes' rings, so nothing is pending
+        comm.shmServer->stop();
     }
 #endif
     
 #ifdef OBNSIM_COMM_YARP
-    if (comm_objects.yarpThread && !comm_objects.yarpThread->done_execution) {
+    if (comm.yarpThread && !comm.yarpThread->done_execution) {
         // Wait a fixed amount of time for Yarp
         std::this_thread::sleep_for(std::chrono::seconds(1));
     }
@@ -128,9 +133,10 @@ static void interrupt_signal_handler(int signal_value) {
     if (main_gcthread) {
         std:: cout << "Try to terminate the simulation system cleanly..." << std::endl;
         main_gcthread->setSysRequest(OBNsmn::GCThread::SYSREQ_TERMINATE);
+        SMNChai::RunManager::terminate_all();   // And the simulations launched by the script
         std::this_thread::sleep_for(std::chrono::seconds(2));   // Wait a bit to let GC handle the request
         
-        shutdown_communication_threads(*main_gcthread);
+        shutdown_communication_threads(*main_gcthread, comm_objects);
     }
     
     // We won't delete the objects, etc., just let the program exit abnormally
@@ -191,6 +197,7 @@ int main(int argc, char* argv[]) {
     ("help,h", "Show help")
     ("dry-run", "Force dry-run (no simulation)")
     ("dockerlist", po::value<std::string>(), "Generate node list for Docker without running simulation")
+    ("cache", po::value<std::string>(), "Load the workspace from a cache file instead of evaluating the script, if the cache is valid; otherwise save it to the file")
     ;
     
     // Hidden options, will not be shown to the user
@@ -250,6 +257,9 @@ int main(int argc, char* argv[]) {
     SMNChai::SystemSettings sys_settings;
     sys_settings.dockerlist = args_map.count("dockerlist") != 0;     // Whether we want to generate the list of nodes for Docker
     sys_settings.dryrun = args_map.count("dry-run") != 0;
+    if (args_map.count("cache")) {
+        sys_settings.cachefile = args_map["cache"].as<std::string>();
+    }
 
     if (sys_settings.dockerlist) {
         // Check output file
@@ -295,7 +305,7 @@ int main(int argc, char* argv[]) {
             std::cerr << "ERROR: could not start GC thread. Shutting down..." << std::endl;
             
             // As the communication thread(s) already started, we try to signal them to stop
-            shutdown_communication_threads(gc);
+            shutdown_communication_threads(gc, comm_objects);
             
             if (comm_objects.allFinished()) {
                 // Good
@@ -314,7 +324,7 @@ int main(int argc, char* argv[]) {
         gc.joinThread();
         
         // Shutdown communications
-        shutdown_communication_threads(gc);
+        shutdown_communication_threads(gc, comm_objects);
         
         comm_objects.joinThreads();
         
@@ -11,6 +11,7 @@
  */
 
 #include <cassert>
+#include <cstdlib>
 #include <algorithm>
 #include <cmath>
 #include <chrono>
@@ -22,6 +23,7 @@
 
 #include <obnsmn_report.h>
 #include <smnchai_api.h>
+#include <smnchai_launcher.h>
 
 #ifdef OBNSIM_COMM_YARP
 #include <yarp/os/Run.h>        // YarpRun support
@@ -29,10 +31,10 @@
 
 using namespace SMNChai;
 
-std::string Node::m_global_prefix = "";
+thread_local std::string Node::m_global_prefix = "";
 
 const char* CommProtocolNames[] = {
-    "default", "yarp", "mqtt"
+    "default", "yarp", "mqtt", "socket", "shm"
 };
 
 
@@ -66,6 +68,8 @@ void SMNChai::run_remote_command(const std::string &t_node, const std::string &t
 
 
 void SMNChai::WorkSpace::start_remote_node(const std::string &t_node, const std::string &t_computer, const std::string &t_prog, const std::string &t_args, const std::string &t_tag, const std::string &t_workdir) {
+    m_cacheable = false;
+    
     // Only start if node is not online
     if (m_settings.will_run_simulation() && !is_node_online(t_node)) {
         if (t_tag.empty()) {
@@ -96,38 +100,109 @@ bool SMNChai::WorkSpace::is_node_online(const SMNChai::Node &t_node) {
 #ifdef OBNSIM_COMM_MQTT
         // We should check the list of online nodes, then ping the node's GC port;
         // for now we only check the list and assume it's still online.
-        if (!m_tracking_mqtt_online_nodes) {
-            // std::cout << "Start tracking MQTT nodes\n";
-            // Start tracking
-            if (start_mqtt_client()) {
-                if (m_comm.mqttClient->startListeningForArrivals(m_name.empty()?"":(m_name+'/'))) {
-                    m_tracking_mqtt_online_nodes = true;
-                    
-                    // Delay a bit for receiving nodes' announcements
-                    std::this_thread::sleep_for (std::chrono::seconds(1));
-                } else {
-                    // Error
-                    throw smnchai_exception("Error: Could not start tracking nodes' availability in MQTT.");
-                }
-            } else {
-                // Error
-                throw smnchai_exception("Error: MQTT communication could not be started.");
-            }
+        auto name = get_full_path(t_node.get_name());
+        if (start_mqtt_tracking()) {
+            // Give the broker some time to deliver the nodes' retained announcements, but not more than needed for this node
+            m_comm.mqttClient->arrivals().waitForAll(std::vector<std::string>{name}, 1.0);
         }
         
         // At this point, we should be able to track the nodes
-        return m_comm.mqttClient->checkNodeOnline(t_node.get_name());
+        return m_comm.mqttClient->checkNodeOnline(name);
 #else
         throw smnchai_exception("Error: MQTT communication is not supported in this SMN.");
 #endif
     }
+    else if (t_node.m_comm_protocol == SMNChai::COMM_SOCKET ||
+             (t_node.m_comm_protocol == SMNChai::COMM_DEFAULT && m_settings.m_comm == SMNChai::COMM_SOCKET)) {
+#ifdef OBNSIM_COMM_SOCKET
+        // A node is online when it is connected to the SMN's socket, so the server must be listening
+        if (!start_socket_server()) {
+            throw smnchai_exception("Error: Socket communication could not be started.");
+        }
+        return m_comm.socketServer->checkNodeOnline(get_full_path(t_node.get_name(), OBNsim::NODE_GC_PORT_NAME));
+#else
+        throw smnchai_exception("Error: Socket communication is not supported in this SMN.");
+#endif
+    }
+    else if (t_node.m_comm_protocol == SMNChai::COMM_SHM ||
+             (t_node.m_comm_protocol == SMNChai::COMM_DEFAULT && m_settings.m_comm == SMNChai::COMM_SHM)) {
+#ifdef OBNSIM_COMM_SHM
+        // A node waits for the SMN's segment before it goes online, so the server must be started
+        if (!start_shm_server()) {
+            throw smnchai_exception("Error: Shared-memory communication could not be started.");
+        }
+        return m_comm.shmServer->checkNodeOnline(get_full_path(t_node.get_name(), OBNsim::NODE_GC_PORT_NAME));
+#else
+        throw smnchai_exception("Error: Shared-memory communication is not supported in this SMN.");
+#endif
+    }
     
     return false;
 }
 
 
+OBNsmn::ArrivalRegistry* SMNChai::WorkSpace::arrival_registry(const SMNChai::Node &t_node, std::string &key) {
+    if (t_node.m_comm_protocol == SMNChai::COMM_MQTT ||
+        (t_node.m_comm_protocol == SMNChai::COMM_DEFAULT && m_settings.m_comm == SMNChai::COMM_MQTT)) {
 #ifdef OBNSIM_COMM_MQTT
+        start_mqtt_tracking();
+        key = get_full_path(t_node.get_name());
+        return &m_comm.mqttClient->arrivals();
+#else
+        throw smnchai_exception("Error: MQTT communication is not supported in this SMN.");
+#endif
+    }
+    else if (t_node.m_comm_protocol == SMNChai::COMM_SOCKET ||
+             (t_node.m_comm_protocol == SMNChai::COMM_DEFAULT && m_settings.m_comm == SMNChai::COMM_SOCKET)) {
+#ifdef OBNSIM_COMM_SOCKET
+        if (!start_socket_server()) {
+            throw smnchai_exception("Error: Socket communication could not be started.");
+        }
+        key = get_full_path(t_node.get_name(), OBNsim::NODE_GC_PORT_NAME);
+        return &m_comm.socketServer->arrivals();
+#else
+        throw smnchai_exception("Error: Socket communication is not supported in this SMN.");
+#endif
+    }
+    
+    return nullptr;
+}
+
+
+#ifdef OBNSIM_COMM_MQTT
+bool SMNChai::WorkSpace::start_mqtt_tracking() {
+    if (m_tracking_mqtt_online_nodes) {
+        return false;
+    }
+    if (!start_mqtt_client()) {
+        throw smnchai_exception("Error: MQTT communication could not be started.");
+    }
+    if (!m_comm.mqttClient->startListeningForArrivals(m_name.empty()?"":(m_name+'/'))) {
+        throw smnchai_exception("Error: Could not start tracking nodes' availability in MQTT.");
+    }
+    m_tracking_mqtt_online_nodes = true;
+    return true;
+}
+
 bool SMNChai::WorkSpace::start_mqtt_client() {
+    if (m_comm.sharedMqttClient) {
+        // The client is shared with other simulations: only route our GC topic to our GC
+        if (!m_comm.mqttTopic.empty()) {
+            return true;
+        }
+        m_comm.mqttClient = m_comm.sharedMqttClient();
+        if (!m_comm.mqttClient) {
+            return false;
+        }
+        auto topic = get_full_path("_smn_", OBNsim::NODE_GC_PORT_NAME);
+        if (!m_comm.mqttClient->addWorkspace(topic, &m_gcthread)) {
+            m_comm.mqttClient = nullptr;
+            return false;
+        }
+        m_comm.mqttTopic = topic;
+        return true;
+    }
+    
     bool create_mqtt = (m_comm.mqttClient == nullptr);
     if (create_mqtt) {
         m_comm.mqttClient = new OBNsmn::MQTT::MQTTClient(&m_gcthread);
@@ -154,6 +229,55 @@ bool SMNChai::WorkSpace::start_mqtt_client() {
 }
 #endif
 
+#ifdef OBNSIM_COMM_SOCKET
+bool SMNChai::WorkSpace::start_socket_server() {
+    bool create_server = (m_comm.socketServer == nullptr);
+    if (create_server) {
+        m_comm.socketServer = new OBNsmn::SOCKET::SocketServer(&m_gcthread);
+    } else if (m_comm.socketServer->isRunning()) {
+        // already running
+        return true;
+    }
+    
+    m_comm.socketServer->setAddress(m_settings.m_socket_address.empty()?
+                                    OBNsim::Socket::defaultAddress(m_name.empty()?"":(m_name+'/')):m_settings.m_socket_address);
+    
+    // Start listening
+    bool success = m_comm.socketServer->start();
+    if (!success && create_server) {
+        // Delete the socket server
+        delete m_comm.socketServer;
+        m_comm.socketServer = nullptr;
+    }
+    
+    return success;
+}
+#endif
+
+#ifdef OBNSIM_COMM_SHM
+bool SMNChai::WorkSpace::start_shm_server() {
+    bool create_server = (m_comm.shmServer == nullptr);
+    if (create_server) {
+        m_comm.shmServer = new OBNsmn::SHM::ShmServer(&m_gcthread);
+    } else if (m_comm.shmServer->isRunning()) {
+        // already running
+        return true;
+    }
+    
+    m_comm.shmServer->setPortName(get_full_path("_smn_", OBNsim::NODE_GC_PORT_NAME));
+    
+    // Create the SMN's segment
+    bool success = m_comm.shmServer->start();
+    if (!success && create_server) {
+        // Delete the shared-memory server
+        delete m_comm.shmServer;
+        m_comm.shmServer = nullptr;
+    }
+    
+    return success;
+}
+#endif
+
 //bool SMNChai::WorkSpace::is_node_online(const std::string &t_node) const {
 //    // YARP requires / at the beginning
 //    return yarp::os::Network::exists('/' + get_full_path(t_node, OBNsim::NODE_GC_PORT_NAME));
@@ -187,10 +311,23 @@ bool SMNChai::WorkSpace::start_mqtt_client() {
 //}
 
 void SMNChai::WorkSpace::waitfor_node_online(const SMNChai::Node &t_node, double timeout) {
+    // Remember the wait, to be replayed when the workspace is loaded from its cache
+    m_cache_wait = (timeout <= 0.0 || m_cache_wait == 0.0)?0.0:std::max(m_cache_wait, timeout);
+    
     if (!m_settings.will_run_simulation()) {
         // If not going to run simulation then we should not wait
         return;
     }
+    
+    // The arrival of the node may be notified, otherwise it's polled
+    std::string key;
+    if (auto *registry = arrival_registry(t_node, key)) {
+        if (!registry->waitForAll(std::vector<std::string>{key}, timeout).empty()) {
+            throw smnchai_exception("Waiting for node '" + t_node.get_name() + "' to go online but timeout occurred.");
+        }
+        return;
+    }
+    
     if (timeout <= 0.0) {
         while (!is_node_online(t_node)) {
             std::this_thread::sleep_for (std::chrono::milliseconds(100));
@@ -214,39 +351,84 @@ void SMNChai::WorkSpace::waitfor_node_online(const SMNChai::Node &t_node, double
 }
 
 void SMNChai::WorkSpace::waitfor_all_nodes_online(double timeout) {
+    // Remember the wait, to be replayed when the workspace is loaded from its cache
+    m_cache_wait = (timeout <= 0.0 || m_cache_wait == 0.0)?0.0:std::max(m_cache_wait, timeout);
+    
     if (!m_settings.will_run_simulation()) {
         // If not going to run simulation then we should not wait
         return;
     }
-
-    if (timeout <= 0.0) {
-        while (!are_all_nodes_online()) {
-            std::this_thread::sleep_for (std::chrono::milliseconds(500));
+    
+    auto start = std::chrono::steady_clock::now();
+    
+    // The arrivals of the MQTT and socket nodes are notified by their communication threads, the other nodes are polled
+    std::map<OBNsmn::ArrivalRegistry*, std::vector<std::string> > notified;
+    std::vector<const SMNChai::Node*> polled;
+    std::string key;
+    for (const auto& mynode: m_nodes) {
+        if (auto *registry = arrival_registry(mynode.second.node, key)) {
+            notified[registry].push_back(key);
+        } else {
+            polled.push_back(&mynode.second.node);
         }
-    } else {
-        std::chrono::time_point<std::chrono::steady_clock> start;
-        std::chrono::duration<double> dur;
-        
-        start = std::chrono::steady_clock::now();
-        
-        while (!are_all_nodes_online()) {
-            std::this_thread::sleep_for (std::chrono::milliseconds(500));
-            
-            dur = std::chrono::steady_clock::now() - start;
-            if (dur.count() > timeout) {
-                // Timeout occurs
-                
-                // DEBUG: print nodes that are not online yet
-                std::cout << "Unavailable nodes:\n";
-                for (auto it = m_nodes.begin(); it != m_nodes.end(); ++it) {
-                    if (!is_node_online(it->second.node)) {
-                        std::cout << it->first << " ";
-                    }
-                }
-                
-                throw smnchai_exception("Waiting for all nodes to go online but timeout occurred.");
+    }
+    
+    // Wait for the notified nodes, each wait returns as soon as its last node has arrived
+    bool timed_out = false;
+    for (const auto& names: notified) {
+        double remaining = 0.0;     // Wait forever if there is no timeout
+        if (timeout > 0.0) {
+            remaining = timeout - std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            remaining = std::max(remaining, 1e-3);
+        }
+        if (!names.first->waitForAll(names.second, remaining).empty()) {
+            timed_out = true;
+            break;
+        }
+    }
+    
+    // The polled nodes launched by the script signal when they are ready, which is waited for before polling them
+    if (!timed_out && m_launcher && !polled.empty()) {
+        std::vector<std::string> launched;
+        for (const auto* t_node: polled) {
+            auto name = get_full_path(t_node->get_name());
+            if (m_launcher->launched(name)) {
+                launched.push_back(name);
             }
         }
+        if (!launched.empty()) {
+            double remaining = 0.0;
+            if (timeout > 0.0) {
+                remaining = timeout - std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                remaining = std::max(remaining, 1e-3);
+            }
+            m_launcher->ready().waitForAll(launched, remaining);
+        }
+    }
+    
+    // Poll the other nodes in batches: a node that has gone online is not checked again
+    while (!timed_out && !polled.empty()) {
+        polled.erase(std::remove_if(polled.begin(), polled.end(), [this](const SMNChai::Node* t_node) { return is_node_online(*t_node); }), polled.end());
+        if (polled.empty()) {
+            break;
+        }
+        if (timeout > 0.0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > timeout) {
+            timed_out = true;
+            break;
+        }
+        std::this_thread::sleep_for (std::chrono::milliseconds(50));
+    }
+    
+    if (timed_out) {
+        // DEBUG: print nodes that are not online yet
+        std::cout << "Unavailable nodes:\n";
+        for (auto it = m_nodes.begin(); it != m_nodes.end(); ++it) {
+            if (!is_node_online(it->second.node)) {
+                std::cout << it->first << " ";
+            }
+        }
+        
+        throw smnchai_exception("Waiting for all nodes to go online but timeout occurred.");
     }
 }
 
@@ -297,6 +479,38 @@ OBNsmn::MQTT::OBNNodeMQTT* SMNChai::Node::create_mqtt_node(OBNsmn::MQTT::MQTTCli
 }
 #endif
 
+#ifdef OBNSIM_COMM_SOCKET
+OBNsmn::SOCKET::OBNNodeSocket* SMNChai::Node::create_socket_node(OBNsmn::SOCKET::SocketServer* t_server, const WorkSpace &ws) const {
+    auto *p_node = new OBNsmn::SOCKET::OBNNodeSocket(m_name, m_updates.size(), ws.get_full_path(m_name, OBNsim::NODE_GC_PORT_NAME), t_server);
+    
+    p_node->needUPDATEX = m_updateX;
+    
+    // Configure all update types in this node
+    // Note that time values are stored as real numbers of microseconds, which must be converted to integer values in time unit
+    for (auto myupdate = m_updates.begin(); myupdate != m_updates.end(); ++myupdate) {
+        p_node->setUpdateType(myupdate->first, ws.get_time_value(myupdate->second.sampling_time));
+    }
+    
+    return p_node;
+}
+#endif
+
+#ifdef OBNSIM_COMM_SHM
+OBNsmn::SHM::OBNNodeShm* SMNChai::Node::create_shm_node(OBNsmn::SHM::ShmServer* t_server, const WorkSpace &ws) const {
+    auto *p_node = new OBNsmn::SHM::OBNNodeShm(m_name, m_updates.size(), ws.get_full_path(m_name, OBNsim::NODE_GC_PORT_NAME), t_server);
+    
+    p_node->needUPDATEX = m_updateX;
+    
+    // Configure all update types in this node
+    // Note that time values are stored as real numbers of microseconds, which must be converted to integer values in time unit
+    for (auto myupdate = m_updates.begin(); myupdate != m_updates.end(); ++myupdate) {
+        p_node->setUpdateType(myupdate->first, ws.get_time_value(myupdate->second.sampling_time));
+    }
+    
+    return p_node;
+}
+#endif
+
 SMNChai::CommProtocol SMNChai::comm_protocol_from_string(const std::string& t_comm) {
     std::string comm = OBNsim::Utils::toLower(t_comm);
     if (comm == "yarp") {
@@ -310,6 +524,18 @@ SMNChai::CommProtocol SMNChai::comm_protocol_from_string(const std::string& t_co
         return SMNChai::COMM_MQTT;
 #else
         throw smnchai_exception("MQTT is not supported by this SMNChai program.");
+#endif
+    } else if (comm == "socket") {
+#ifdef OBNSIM_COMM_SOCKET
+        return SMNChai::COMM_SOCKET;
+#else
+        throw smnchai_exception("Sockets are not supported by this SMNChai program.");
+#endif
+    } else if (comm == "shm") {
+#ifdef OBNSIM_COMM_SHM
+        return SMNChai::COMM_SHM;
+#else
+        throw smnchai_exception("Shared memory is not supported by this SMNChai program.");
 #endif
     } else if (comm == "default" || comm == "any") {
         return SMNChai::COMM_DEFAULT;
@@ -516,7 +742,7 @@ void SMNChai::WorkSpace::add_node(const SMNChai::Node &p_node) {
     m_nodes.emplace(nodeName, SMNChai::WorkSpace::NodeInfo(p_node));
 }
 
-void SMNChai::WorkSpace::connect(const SMNChai::PortInfo &t_from, const SMNChai::PortInfo &t_to) {
+void SMNChai::WorkSpace::check_connection(const SMNChai::PortInfo &t_from, const SMNChai::PortInfo &t_to) {
     // Check that these ports can be connected
     if (t_from.port_type == SMNChai::PortInfo::INPUT) {
         throw smnchai_exception("Port " + t_from.node_name + '/' + t_from.port_name + " is an input and can't be the source of a connection.");
@@ -530,16 +756,20 @@ void SMNChai::WorkSpace::connect(const SMNChai::PortInfo &t_from, const SMNChai:
     if (t_from.comm != SMNChai::COMM_DEFAULT && t_to.comm != SMNChai::COMM_DEFAULT && t_from.comm != t_to.comm) {
         throw smnchai_exception("Ports " + t_from.node_name + '/' + t_from.port_name + " and " + t_to.node_name + '/' + t_to.port_name + " must use the same communication protocol to be connected.");
     }
-    
+}
+
+bool SMNChai::WorkSpace::add_connection(const SMNChai::PortInfo &t_from, const SMNChai::PortInfo &t_to) {
     // Check if this connection has already existed
-    bool bNotExist = std::none_of(m_connections.begin(), m_connections.end(),
-                                  [t_from,t_to](const std::pair<PortInfo, PortInfo>& p) {
-                                      return (p.first.node_name == t_from.node_name) && (p.first.port_name == t_from.port_name) &&
-                                      (p.second.node_name == t_to.node_name) && (p.second.port_name == t_to.port_name);
-                                  });
-    if (bNotExist) {
-        m_connections.emplace_front(t_from, t_to);
+    if (!m_connection_keys.insert(connection_key(t_from, t_to)).second) {
+        return false;
     }
+    m_connections.emplace_front(t_from, t_to);
+    return true;
+}
+
+void SMNChai::WorkSpace::connect(const SMNChai::PortInfo &t_from, const SMNChai::PortInfo &t_to) {
+    check_connection(t_from, t_to);
+    add_connection(t_from, t_to);
 }
 
 void SMNChai::WorkSpace::connect(const std::string &from_node, const std::string &from_port, const std::string &to_node, const std::string &to_port) {
@@ -558,6 +788,182 @@ void SMNChai::WorkSpace::connect(const std::string &from_node, const std::string
     connect(itsrc->second.node.port(from_port), ittgt->second.node.port(to_port));
 }
 
+// Throw the exception of an invalid row of a table, adding the row's number to the message
+static void throw_row_error(std::size_t t_row, const std::string &t_msg) {
+    throw SMNChai::smnchai_exception("Row " + std::to_string(t_row + 1) + " of the table: " + t_msg);
+}
+
+// Parse a space-separated list of block IDs, e.g. "0 2"
+static std::vector<unsigned int> parse_block_ids(const std::string &t_list) {
+    std::vector<unsigned int> ids;
+    std::istringstream ss(t_list);
+    std::string item;
+    while (ss >> item) {
+        char *end;
+        auto id = std::strtoul(item.c_str(), &end, 10);
+        if (*end != '\0' || id > OBNsim::MAX_UPDATE_INDEX) {
+            throw SMNChai::smnchai_exception("Block ID '" + item + "' is invalid.");
+        }
+        ids.push_back(id);
+    }
+    return ids;
+}
+
+std::size_t SMNChai::WorkSpace::add_nodes_from_table(const SMNChai::TextTable &t_table) {
+    // The nodes are built and checked first, then added all at once
+    std::vector<SMNChai::Node> nodes;
+    nodes.reserve(t_table.size());
+    std::unordered_set<std::string> names;
+    names.reserve(t_table.size());
+    
+    for (std::size_t row = 0; row < t_table.size(); ++row) {
+        const auto &cells = t_table[row];
+        try {
+            if (cells.empty() || cells.size() > 4) {
+                throw smnchai_exception("A node is described by its name, then optionally its communication protocol, partition and blocks.");
+            }
+            
+            SMNChai::Node node(cells[0]);
+            if (m_nodes.count(node.m_name) != 0 || !names.insert(node.m_name).second) {
+                throw smnchai_exception("Node '" + node.m_name + "' already exists in workspace '" + m_name + "'.");
+            }
+            
+            if (cells.size() > 1 && !cells[1].empty()) {
+                node.set_comm_protocol(cells[1]);
+            }
+            
+            if (cells.size() > 2 && !cells[2].empty()) {
+                char *end;
+                auto partition = std::strtol(cells[2].c_str(), &end, 10);
+                if (*end != '\0') {
+                    throw smnchai_exception("The partition '" + cells[2] + "' of node '" + node.m_name + "' is not an integer.");
+                }
+                node.set_partition(partition);
+            }
+            
+            if (cells.size() > 3) {
+                std::istringstream ss(cells[3]);
+                std::string block;
+                while (ss >> block) {
+                    auto colon = block.find(':');
+                    char *end = nullptr;
+                    double period = (colon == std::string::npos)?0.0:std::strtod(block.c_str() + colon + 1, &end);
+                    if (colon == std::string::npos || *end != '\0' || period < 0.0) {
+                        throw smnchai_exception("The block '" + block + "' of node '" + node.m_name + "' must have the form ID:period.");
+                    }
+                    auto ids = parse_block_ids(block.substr(0, colon));
+                    if (ids.size() != 1) {
+                        throw smnchai_exception("The block '" + block + "' of node '" + node.m_name + "' must have the form ID:period.");
+                    }
+                    node.add_update(ids[0], period);
+                }
+            }
+            
+            nodes.push_back(std::move(node));
+        } catch (const smnchai_exception &e) {
+            throw_row_error(row, e.what());
+        }
+    }
+    
+    for (auto &node: nodes) {
+        auto name = node.m_name;
+        m_nodes.emplace(std::move(name), SMNChai::WorkSpace::NodeInfo(node));
+    }
+    return nodes.size();
+}
+
+std::size_t SMNChai::WorkSpace::add_ports_from_table(const SMNChai::TextTable &t_table) {
+    // The ports are added to copies of the nodes, which replace the nodes once the whole table is checked
+    std::map<std::string, SMNChai::Node> changed;
+    
+    for (std::size_t row = 0; row < t_table.size(); ++row) {
+        const auto &cells = t_table[row];
+        try {
+            if (cells.size() < 3 || cells.size() > 5) {
+                throw smnchai_exception("A port is described by its node, its name and its kind, then optionally its communication protocol and blocks.");
+            }
+            
+            auto it = changed.find(cells[0]);
+            if (it == changed.end()) {
+                auto itnode = m_nodes.find(cells[0]);
+                if (itnode == m_nodes.end()) {
+                    throw smnchai_exception("Node '" + cells[0] + "' does not exist.");
+                }
+                it = changed.emplace(cells[0], itnode->second.node).first;
+            }
+            auto &node = it->second;
+            
+            const auto &port = cells[1];
+            std::string comm = (cells.size() > 3 && !cells[3].empty())?cells[3]:"any";
+            auto blocks = (cells.size() > 4)?parse_block_ids(cells[4]):std::vector<unsigned int>();
+            
+            if (cells[2] == "input") {
+                node.add_input(port, comm);
+                for (auto id: blocks) {
+                    node.input_to_update(id, port, true);
+                }
+            } else if (cells[2] == "output") {
+                node.add_output(port, comm);
+                for (auto id: blocks) {
+                    node.output_from_update(id, port);
+                }
+            } else if (cells[2] == "data") {
+                if (!blocks.empty()) {
+                    throw smnchai_exception("Data port '" + port + "' of node '" + node.m_name + "' can't be associated with blocks.");
+                }
+                node.add_dataport(port, comm);
+            } else {
+                throw smnchai_exception("The kind of port '" + port + "' must be 'input', 'output' or 'data', but '" + cells[2] + "' is given.");
+            }
+        } catch (const smnchai_exception &e) {
+            throw_row_error(row, e.what());
+        }
+    }
+    
+    for (auto &node: changed) {
+        m_nodes.at(node.first).node = std::move(node.second);
+    }
+    return t_table.size();
+}
+
+std::size_t SMNChai::WorkSpace::connect_many(const SMNChai::TextTable &t_table) {
+    // The connections are checked first, then added all at once
+    std::vector< std::pair<PortInfo, PortInfo> > connections;
+    connections.reserve(t_table.size());
+    
+    for (std::size_t row = 0; row < t_table.size(); ++row) {
+        const auto &cells = t_table[row];
+        try {
+            if (cells.size() != 4) {
+                throw smnchai_exception("A connection is described by its source node and port, then its target node and port.");
+            }
+            
+            auto itsrc = m_nodes.find(cells[0]);
+            if (itsrc == m_nodes.end()) {
+                throw smnchai_exception("Source node '" + cells[0] + "' of a connection does not exist.");
+            }
+            auto ittgt = m_nodes.find(cells[2]);
+            if (ittgt == m_nodes.end()) {
+                throw smnchai_exception("Target node '" + cells[2] + "' of a connection does not exist.");
+            }
+            
+            connections.emplace_back(itsrc->second.node.port(cells[1]), ittgt->second.node.port(cells[3]));
+            check_connection(connections.back().first, connections.back().second);
+        } catch (const smnchai_exception &e) {
+            throw_row_error(row, e.what());
+        }
+    }
+    
+    m_connection_keys.reserve(m_connection_keys.size() + connections.size());
+    std::size_t added = 0;
+    for (const auto &conn: connections) {
+        if (add_connection(conn.first, conn.second)) {
+            ++added;
+        }
+    }
+    return added;
+}
+
 
 void SMNChai::WorkSpace::print() const {
     print_settings();
@@ -570,6 +976,9 @@ void SMNChai::WorkSpace::print() const {
         if (n.second.node.m_comm_protocol != COMM_DEFAULT) {
             std::cout << "(" << CommProtocolNames[int(n.second.node.m_comm_protocol)] << ")";
         }
+        if (n.second.node.m_partition >= 0) {
+            std::cout << "[partition " << n.second.node.m_partition << "]";
+        }
         std::cout << ' ';
     }
     std::cout << "\n\nList of connections:" << std::endl;
@@ -586,7 +995,19 @@ void SMNChai::WorkSpace::print_settings() const {
     "+ ACK timeout (in ms): " << m_settings.m_ack_timeout << std::endl <<
     "+ Begin wallclock: " << std::ctime(&m_settings.m_wallclock) <<
     "+ Default communication: " << CommProtocolNames[int(m_settings.m_comm)] << std::endl <<
-    "+ MQTT server: " << m_settings.m_mqtt_server << std::endl;
+    "+ MQTT server: " << m_settings.m_mqtt_server << std::endl <<
+    "+ Socket address: " << (m_settings.m_socket_address.empty()?"(default)":m_settings.m_socket_address) << std::endl <<
+    "+ Dependency graph: " << m_settings.m_dep_graph << std::endl <<
+    "+ Dataflow dispatch: " << (m_settings.m_dataflow?"on":"off") << std::endl <<
+    "+ Fused UPDATE_X: " << (m_settings.m_fuse_update_x?"on":"off") << std::endl <<
+    "+ Lookahead windows: " << (m_settings.m_lookahead?"on":"off") << std::endl <<
+    "+ MQTT group topics: " << (m_settings.m_mqtt_group_topics?"on":"off") << std::endl <<
+    "+ Message bundles: " << (m_settings.m_bundle_messages?"on":"off") << std::endl <<
+    "+ Reliability: " << m_settings.m_reliability << " (" << m_settings.m_ack_retries << " retries)" << std::endl <<
+    "+ Parallel components: " << (m_settings.m_parallel_components?"on":"off") << std::endl <<
+    "+ Checkpoint: " << ((m_settings.m_checkpoint_time >= 0.0)?(std::to_string(m_settings.m_checkpoint_time) + " us to '" + m_settings.m_checkpoint_file + "'"):"none") << std::endl <<
+    "+ Resume from: " << (m_settings.m_resume_file.empty()?"(start)":("'" + m_settings.m_resume_file + "'")) << std::endl <<
+    "+ Wave-plan cache size: " << m_settings.m_wave_cache << std::endl;
 }
 
 std::string SMNChai::WorkSpace::get_full_path(const std::string &t_obj1, const std::string &t_obj2) const {
@@ -683,6 +1104,102 @@ void SMNChai::WorkSpace::generate_obn_system_mqtt(decltype(SMNChai::WorkSpace::m
     // to which the node should subscribe.
     // So there is no need to "connect" the ports here.
 }
+
+void SMNChai::WorkSpace::generate_obn_groups_mqtt(OBNsmn::GCThread &gc, OBNsmn::MQTT::MQTTClient *mqttclient) {
+    // All nodes subscribe to the workspace's broadcast topic (e.g. workspace/_smn_/_all_).
+    // MQTT nodes with the same update types (and the same need for UPDATE_X) are always scheduled at the same times with the same masks,
+    // so they are grouped and subscribe to the group's topic (e.g. workspace/_smn_/_group_/0).
+    const std::string allTopic = get_full_path("_smn_", "_all_");
+    bool allSubscribed = true;
+    std::map< std::pair< bool, std::vector< std::pair<unsigned int, double> > >, std::vector<int> > groups;
+    
+    for (const auto& mynode: m_nodes) {
+        if (!(mynode.second.node.m_comm_protocol == SMNChai::COMM_MQTT ||
+              (mynode.second.node.m_comm_protocol == SMNChai::COMM_DEFAULT && m_settings.m_comm == SMNChai::COMM_MQTT))) {
+            allSubscribed = false;
+            continue;
+        }
+        
+        auto result = gc.request_subscribe(mynode.second.index, allTopic);
+        if (result.first < 0) {
+            OBNsmn::report_warning(0, "Node '" + mynode.first + "' could not subscribe to the group topics (error " + std::to_string(result.first) +
+                                   (result.second.empty()?")":("; " + result.second + ")")) + "; it will receive the SMN's messages on its own topic.");
+            allSubscribed = false;
+            continue;
+        }
+        
+        std::vector< std::pair<unsigned int, double> > updates;
+        for (const auto& myupdate: mynode.second.node.m_updates) {
+            updates.emplace_back(myupdate.first, myupdate.second.sampling_time);
+        }
+        groups[std::make_pair(mynode.second.node.m_updateX, updates)].push_back(mynode.second.index);
+    }
+    
+    if (allSubscribed) {
+        gc.setBroadcastGroup(new OBNsmn::MQTT::OBNNodeGroupMQTT(allTopic, mqttclient));
+    }
+    
+    int k = 0;
+    for (const auto& group: groups) {
+        if (group.second.size() < 2) {
+            continue;
+        }
+        const std::string topic = get_full_path("_smn_", "_group_/" + std::to_string(k++));
+        std::vector<int> members;
+        for (auto id: group.second) {
+            if (gc.request_subscribe(id, topic).first >= 0) {
+                members.push_back(id);
+            }
+        }
+        if (members.size() >= 2) {
+            gc.addNodeGroup(new OBNsmn::MQTT::OBNNodeGroupMQTT(topic, mqttclient), members);
+        }
+    }
+}
+#endif
+
+#ifdef OBNSIM_COMM_SOCKET
+void SMNChai::WorkSpace::generate_obn_system_socket(decltype(SMNChai::WorkSpace::m_nodes)::iterator &mynode, OBNsmn::GCThread &gc, OBNsmn::SOCKET::SocketServer *server) {
+    // Create the node
+    auto *p_node = mynode->second.node.create_socket_node(server, *this);
+    auto result = gc.insertNode(p_node);
+    if (result.first) {
+        // Record the ID of this node in GC
+        mynode->second.index = result.second;
+    } else {
+        // Delete the node object
+        delete p_node;
+        throw smnchai_exception("Could not insert node '" + mynode->first + "' into the system.");
+    }
+    
+    // The node must already be connected to the SMN's socket, on which it has sent the name of its GC port
+    if (!server->checkNodeOnline(get_full_path(mynode->first, OBNsim::NODE_GC_PORT_NAME))) {
+        // Failed -> error; note that the GC is now managing all node objects, so do not delete node objects
+        throw smnchai_exception("Node " + mynode->first + " is not connected to the SMN's socket " + server->address() + ".");
+    }
+}
+#endif
+
+#ifdef OBNSIM_COMM_SHM
+void SMNChai::WorkSpace::generate_obn_system_shm(decltype(SMNChai::WorkSpace::m_nodes)::iterator &mynode, OBNsmn::GCThread &gc, OBNsmn::SHM::ShmServer *server) {
+    // Create the node
+    auto *p_node = mynode->second.node.create_shm_node(server, *this);
+    auto result = gc.insertNode(p_node);
+    if (result.first) {
+        // Record the ID of this node in GC
+        mynode->second.index = result.second;
+    } else {
+        // Delete the node object
+        delete p_node;
+        throw smnchai_exception("Could not insert node '" + mynode->first + "' into the system.");
+    }
+    
+    // The node must already have created its segment, which the SMN writes to
+    if (!server->checkNodeOnline(get_full_path(mynode->first, OBNsim::NODE_GC_PORT_NAME))) {
+        // Failed -> error; note that the GC is now managing all node objects, so do not delete node objects
+        throw smnchai_exception("Node " + mynode->first + " is not online in shared memory.");
+    }
+}
 #endif
 
 bool SMNChai::WorkSpace::is_comm_protocol_used(SMNChai::CommProtocol comm) const {
@@ -710,15 +1227,137 @@ void SMNChai::WorkSpace::generate_obn_system(OBNsmn::GCThread &gc, SMNChai::SMNC
         throw smnchai_exception("There is no node in workspace '" + m_name + "' to generate its OBN system.");
     }
     
+    // The partitions of the nodes (see Node::set_partition()), numbered in increasing order, each run by a sub-coordinator of the GC
+    std::map<int, int> partitionIndex;
+    for (const auto& mynode: m_nodes) {
+        if (mynode.second.node.m_partition >= 0) {
+            partitionIndex.emplace(mynode.second.node.m_partition, 0);
+        }
+    }
+    int numPartitions = 0;
+    for (auto& p: partitionIndex) {
+        p.second = numPartitions++;
+    }
+    
+    std::vector<int> partitions;    // The partition of each node, by its ID
+    std::vector<std::size_t> partitionSizes(numPartitions, 0);
+    std::size_t numRootNodes = 0;
+    for (auto& mynode: m_nodes) {
+        mynode.second.id = partitions.size();
+        mynode.second.partition = (mynode.second.node.m_partition >= 0)?partitionIndex[mynode.second.node.m_partition]:-1;
+        partitions.push_back(mynode.second.partition);
+        if (mynode.second.partition >= 0) {
+            ++partitionSizes[mynode.second.partition];
+        } else {
+            ++numRootNodes;
+        }
+    }
+    
+    // A checkpoint covers the whole system, so it is run by a single GC
+    bool useCheckpoints = m_settings.m_checkpoint_time >= 0.0 || !m_settings.m_resume_file.empty();
+    if (numPartitions > 0 && useCheckpoints) {
+        throw smnchai_exception("Checkpoints can't be used with node partitions.");
+    }
+    
+    // Without partitions, the connected components of the system (by the connections of their ports) are run by parallel GCs, if there are several.
+    // They are numbered in the order of their first nodes, and replace the partitions below.
+    bool useComponents = false;
+    if (numPartitions == 0 && m_settings.m_parallel_components && !m_settings.m_mqtt_group_topics && !useCheckpoints) {
+        std::vector<std::size_t> parent(m_nodes.size());
+        for (std::size_t k = 0; k < parent.size(); ++k) {
+            parent[k] = k;
+        }
+        auto findRoot = [&parent](std::size_t k) {
+            while (parent[k] != k) {
+                k = parent[k] = parent[parent[k]];
+            }
+            return k;
+        };
+        for (const auto& myconn: m_connections) {
+            auto a = findRoot(m_nodes.at(myconn.first.node_name).id), b = findRoot(m_nodes.at(myconn.second.node_name).id);
+            if (a != b) {
+                parent[std::max(a, b)] = std::min(a, b);
+            }
+        }
+        
+        std::vector<int> componentOf(m_nodes.size(), -1);
+        int numComponents = 0;
+        for (std::size_t k = 0; k < parent.size(); ++k) {
+            auto r = findRoot(k);
+            if (componentOf[r] < 0) {
+                componentOf[r] = numComponents++;
+            }
+            partitions[k] = componentOf[r];
+        }
+        
+        if (numComponents > 1) {
+            useComponents = true;
+            numPartitions = numComponents;
+            partitionSizes.assign(numComponents, 0);
+            numRootNodes = 0;
+            for (auto& mynode: m_nodes) {
+                mynode.second.partition = partitions[mynode.second.id];
+                ++partitionSizes[mynode.second.partition];
+            }
+        } else {
+            partitions.assign(m_nodes.size(), -1);
+        }
+    }
+    
+    // The GCs of the partitions (sub-coordinators) or of the components
+    std::vector<OBNsmn::GCThread*> subs;
+    if (useComponents) {
+        // The GC has no nodes: the nodes of each component follow those of the previous one
+        int firstID = 0;
+        for (int c = 0; c < numPartitions; ++c) {
+            auto *comp = new OBNsmn::GCThread();
+            comp->setFirstNodeID(firstID);
+            firstID += partitionSizes[c];
+            if (!gc.addComponent(comp)) {
+                delete comp;
+                throw smnchai_exception("Could not create the GC of component " + std::to_string(c) + ".");
+            }
+            subs.push_back(comp);
+        }
+        OBNsmn::report_info(0, "The system has " + std::to_string(numPartitions) + " independent components, run by parallel GCs.");
+    }
+    else if (numPartitions > 0) {
+        // The sub-coordinators must be added before the nodes of the GC: their proxy nodes come first, then the nodes of the GC, then the nodes of each partition
+        if (m_settings.m_lookahead) {
+            throw smnchai_exception("Lookahead windows can't be used with node partitions.");
+        }
+        if (m_settings.m_mqtt_group_topics) {
+            throw smnchai_exception("MQTT group topics can't be used with node partitions.");
+        }
+        
+        int firstID = numPartitions + numRootNodes;
+        for (const auto& p: partitionIndex) {
+            auto *sub = new OBNsmn::GCThread();
+            sub->setFirstNodeID(firstID);
+            firstID += partitionSizes[p.second];
+            if (!gc.addSubCoordinator(sub, get_full_path("_smn_", "_partition_" + std::to_string(p.first))).first) {
+                delete sub;
+                throw smnchai_exception("Could not create the sub-coordinator of partition " + std::to_string(p.first) + ".");
+            }
+            subs.push_back(sub);
+        }
+    }
+    
+    // The GC running a node
+    auto gcOf = [&gc, &subs](const NodeInfo& info) -> OBNsmn::GCThread& {
+        return (info.partition < 0)?gc:*subs[info.partition];
+    };
+    
     // Create GC ports and node objects, add them to the GC object and save their IDs
     for (auto mynode = m_nodes.begin(); mynode != m_nodes.end(); ++mynode) {
+        auto& nodegc = gcOf(mynode->second);
         if (mynode->second.node.m_comm_protocol == SMNChai::COMM_YARP ||
             (mynode->second.node.m_comm_protocol == SMNChai::COMM_DEFAULT && m_settings.m_comm == SMNChai::COMM_YARP)) {
 #ifdef OBNSIM_COMM_YARP
             if (comm.yarpThread == nullptr) {
                 throw smnchai_exception("Error: The YARP communication thread has not yet been created.");
             }
-            generate_obn_system_yarp(mynode, gc);
+            generate_obn_system_yarp(mynode, nodegc);
 #else
             throw smnchai_exception("Error: YARP communication is not supported in this SMN.");
 #endif
@@ -729,32 +1368,70 @@ void SMNChai::WorkSpace::generate_obn_system(OBNsmn::GCThread &gc, SMNChai::SMNC
             if (comm.mqttClient == nullptr) {
                 throw smnchai_exception("Error: The MQTT communication client has not yet been created.");
             }
-            generate_obn_system_mqtt(mynode, gc, comm.mqttClient);
+            generate_obn_system_mqtt(mynode, nodegc, comm.mqttClient);
 #else
             throw smnchai_exception("Error: MQTT communication is not supported in this SMN.");
+#endif
+        }
+        else if (mynode->second.node.m_comm_protocol == SMNChai::COMM_SOCKET ||
+                 (mynode->second.node.m_comm_protocol == SMNChai::COMM_DEFAULT && m_settings.m_comm == SMNChai::COMM_SOCKET)) {
+#ifdef OBNSIM_COMM_SOCKET
+            if (comm.socketServer == nullptr) {
+                throw smnchai_exception("Error: The socket communication server has not yet been created.");
+            }
+            generate_obn_system_socket(mynode, nodegc, comm.socketServer);
+#else
+            throw smnchai_exception("Error: Socket communication is not supported in this SMN.");
+#endif
+        }
+        else if (mynode->second.node.m_comm_protocol == SMNChai::COMM_SHM ||
+                 (mynode->second.node.m_comm_protocol == SMNChai::COMM_DEFAULT && m_settings.m_comm == SMNChai::COMM_SHM)) {
+#ifdef OBNSIM_COMM_SHM
+            if (comm.shmServer == nullptr) {
+                throw smnchai_exception("Error: The shared-memory communication server has not yet been created.");
+            }
+            generate_obn_system_shm(mynode, nodegc, comm.shmServer);
+#else
+            throw smnchai_exception("Error: Shared-memory communication is not supported in this SMN.");
 #endif
         }
     }
     
     // Now connect the ports and create the dependency graph.
     // ASSUME that all ports have already been created, i.e. nodes are already started.
-    OBNsmn::NodeDepGraph* nodeGraph = new OBNsmn::NodeDepGraph_BGL(m_nodes.size());
+    // The dependencies inside a partition are resolved by its sub-coordinator, the others by the GC; a component has all its dependencies.
+    OBNsmn::NodeDepGraph_Partitioned nodeGraphs(partitions, [this](std::size_t n) -> OBNsmn::NodeDepGraph* {
+        if (m_settings.m_dataflow || m_settings.m_dep_graph == "csr") {
+            return new OBNsmn::NodeDepGraph_CSR(n);
+        } else {
+            return new OBNsmn::NodeDepGraph_BGL(n);
+        }
+    });
     
-    for (auto myconn = m_connections.begin(); myconn != m_connections.end(); ++myconn) {        
-        auto& target = m_nodes.at(myconn->second.node_name);    // The target node must exist
-        auto result = gc.request_port_connect(target.index, myconn->second.port_name, get_full_path(myconn->first));
-        // If result.first >= 0 then it's successful (even though the connection may have already existed)
-        if (result.first < 0) {
-            // Error
-            throw smnchai_exception("Could not connect " + get_full_path(myconn->first) + " to " + get_full_path(myconn->second) +
-                                    " with Error code " + std::to_string(result.first) +
-                                    (result.second.empty()?".":(" (" + result.second + ").")));
-        }
-        //else {
-        //    std::cout << "Successfully connected " + get_full_path(myconn->first) + " to " + get_full_path(myconn->second) << std::endl;
-        //}
-        
-        
+    // The connections are requested in batches, one per GC, so that all nodes connect their ports concurrently
+    std::map<OBNsmn::GCThread*, std::vector<OBNsmn::GCThread::PortConnectRequest> > connRequests;
+    std::map<OBNsmn::GCThread*, std::vector<const std::pair<PortInfo, PortInfo>*> > connOfRequests;
+    for (const auto& myconn: m_connections) {
+        auto& target = m_nodes.at(myconn.second.node_name);    // The target node must exist
+        auto* targetgc = &gcOf(target);
+        connRequests[targetgc].push_back(OBNsmn::GCThread::PortConnectRequest{target.index, myconn.second.port_name, get_full_path(myconn.first)});
+        connOfRequests[targetgc].push_back(&myconn);
+    }
+    for (auto& requests: connRequests) {
+        auto results = requests.first->request_port_connect_batch(requests.second);
+        const auto& conns = connOfRequests[requests.first];
+        for (std::size_t k = 0; k < results.size(); ++k) {
+            // If result.first >= 0 then it's successful (even though the connection may have already existed)
+            if (results[k].first < 0) {
+                // Error
+                throw smnchai_exception("Could not connect " + get_full_path(conns[k]->first) + " to " + get_full_path(conns[k]->second) +
+                                        " with Error code " + std::to_string(results[k].first) +
+                                        (results[k].second.empty()?".":(" (" + results[k].second + ").")));
+            }
+        }
+    }
+    
+    for (auto myconn = m_connections.begin(); myconn != m_connections.end(); ++myconn) {
         // Add a dependency link for this connection iff:
         // (a) source is an output port and target is an input port; and
         // (b) the update masks for both of them are non-zero
@@ -766,13 +1443,13 @@ void SMNChai::WorkSpace::generate_obn_system(OBNsmn::GCThread &gc, SMNChai::SMNC
             src_mask != 0 && tgt_mask != 0)
         {
             //std::cout << "Dependency from " << src_node.second << " with mask " << src_mask << " to " << tgt_node.second << " with mask " << tgt_mask << std::endl;
-            nodeGraph->addDependency(src_node.index, tgt_node.index, src_mask, tgt_mask);
+            nodeGraphs.addDependency(src_node.id, tgt_node.id, src_mask, tgt_mask);
         }
     }
     
     // Set internal dependencies between blocks / updates of the same node
     for (auto& mynode: m_nodes) {
-        auto mynodeid = mynode.second.index;
+        auto mynodeid = mynode.second.id;
         for (auto& myupdate: mynode.second.node.m_updates) {
             if (!myupdate.second.dependencies.empty()) {
                 // Compute the source mask (all blocks that this block depend on)
@@ -781,27 +1458,121 @@ void SMNChai::WorkSpace::generate_obn_system(OBNsmn::GCThread &gc, SMNChai::SMNC
                     src_mask |= (1 << src);
                 }
                 // Create the dependency link
-                nodeGraph->addDependency(mynodeid, mynodeid, src_mask, 1 << myupdate.first);
+                nodeGraphs.addDependency(mynodeid, mynodeid, src_mask, 1 << myupdate.first);
+            }
+        }
+    }
+
+    // Group the MQTT nodes on common topics, if enabled
+    if (m_settings.m_mqtt_group_topics) {
+#ifdef OBNSIM_COMM_MQTT
+        if (comm.mqttClient == nullptr) {
+            throw smnchai_exception("Error: The MQTT communication client has not yet been created.");
+        }
+        generate_obn_groups_mqtt(gc, comm.mqttClient);
+#else
+        throw smnchai_exception("Error: MQTT communication is not supported in this SMN.");
+#endif
+    }
+    
+    // Enable lookahead windows for the nodes without inputs, whose consumers are the targets of their connections
+    if (m_settings.m_lookahead) {
+        std::vector<bool> hasInputs(m_nodes.size(), false);
+        std::vector< std::vector<int> > consumers(m_nodes.size());
+        // The consumers of a node are run by its GC (the nodes of a component are connected), so they are given by their indexes in that GC
+        for (const auto& myconn: m_connections) {
+            const auto& src = m_nodes.at(myconn.first.node_name);
+            const auto& tgt = m_nodes.at(myconn.second.node_name);
+            hasInputs[tgt.id] = true;
+            if (src.id != tgt.id && std::find(consumers[src.id].begin(), consumers[src.id].end(), int(tgt.index)) == consumers[src.id].end()) {
+                consumers[src.id].push_back(tgt.index);
+            }
+        }
+        for (const auto& mynode: m_nodes) {
+            auto mynodeid = mynode.second.id;
+            bool independent = !hasInputs[mynodeid];
+            for (const auto& myupdate: mynode.second.node.m_updates) {
+                independent = independent && myupdate.second.dependencies.empty();
+            }
+            if (independent) {
+                gcOf(mynode.second).enableLookahead(mynode.second.index, consumers[mynodeid]);
             }
         }
     }
 
-    gc.setDependencyGraph(nodeGraph);   // Set the dependency graph for the GC
+    // Cache the wave plans of recurring update patterns, if enabled
+    // (Wave plans are not used in dataflow dispatch.)
+    auto cacheWaves = [this](OBNsmn::NodeDepGraph* nodeGraph) -> OBNsmn::NodeDepGraph* {
+        if (m_settings.m_wave_cache > 0 && !m_settings.m_dataflow) {
+            return new OBNsmn::NodeDepGraph_WaveCache(nodeGraph, m_settings.m_wave_cache);
+        }
+        return nodeGraph;
+    };
     
-    // Copy the settings to GC
-    gc.ack_timeout = m_settings.m_ack_timeout;
+    // Set the dependency graph for the GC, unless it only runs components
+    if (!useComponents) {
+        gc.setDependencyGraph(cacheWaves(nodeGraphs.releaseRootGraph()));
+    }
+    for (std::size_t p = 0; p < subs.size(); ++p) {
+        subs[p]->setDependencyGraph(cacheWaves(nodeGraphs.releasePartitionGraph(p)));
+        if (!useComponents) {
+            subs[p]->setPartitionGates(nodeGraphs.partitionGates(p));
+        }
+    }
     
-    if (!gc.setSimulationTimeUnit(m_settings.m_time_unit)) {
-        throw smnchai_exception("Error while setting simulation time unit.");
+    // With the unreliable profiles, the simulation messages are sent at a lower QOS and retransmitted on ACK timeouts
+    int seq_qos = 2;
+    unsigned int ack_retries = 0;
+    if (m_settings.m_reliability != "reliable") {
+        if (m_settings.m_ack_timeout <= 0) {
+            throw smnchai_exception("The reliability profile '" + m_settings.m_reliability + "' requires a positive ACK timeout.");
+        }
+        ack_retries = m_settings.m_ack_retries;
+        seq_qos = (m_settings.m_reliability == "fast")?1:0;
     }
     
-    if (!gc.setInitialWallclock(m_settings.m_wallclock)) {
-        throw smnchai_exception("Error while setting the initial wallclock time.");
+#ifdef OBNSIM_COMM_MQTT
+    if (comm.mqttClient) {
+        comm.mqttClient->setSeqQoS(seq_qos);
     }
+#endif
     
-    // Note that time values are mostly real numbers in microseconds, so we need to convert them to integer numbers in the time unit.
-    if (!gc.setFinalSimulationTime(get_time_value(m_settings.m_final_time))) {
-        throw smnchai_exception("Error while setting final simulation time.");
+    // Copy the settings to GC and its sub-coordinators or components; the sub-coordinators receive the time settings from the GC
+    subs.push_back(&gc);
+    for (auto *pgc: subs) {
+        pgc->ack_timeout = m_settings.m_ack_timeout;
+        pgc->dataflow_dispatch = m_settings.m_dataflow;
+        pgc->fuse_update_x = m_settings.m_fuse_update_x;
+        pgc->lookahead = m_settings.m_lookahead;
+        pgc->bundle_messages = m_settings.m_bundle_messages;
+        pgc->ack_retries = ack_retries;
+        
+        if (pgc != &gc && !useComponents) {
+            continue;
+        }
+        
+        if (!pgc->setSimulationTimeUnit(m_settings.m_time_unit)) {
+            throw smnchai_exception("Error while setting simulation time unit.");
+        }
+        
+        if (!pgc->setInitialWallclock(m_settings.m_wallclock)) {
+            throw smnchai_exception("Error while setting the initial wallclock time.");
+        }
+        
+        // Note that time values are mostly real numbers in microseconds, so we need to convert them to integer numbers in the time unit.
+        if (!pgc->setFinalSimulationTime(get_time_value(m_settings.m_final_time))) {
+            throw smnchai_exception("Error while setting final simulation time.");
+        }
+    }
+    
+    if (useCheckpoints) {
+        if (m_settings.m_lookahead && m_settings.m_checkpoint_time >= 0.0) {
+            throw smnchai_exception("Checkpoints can't be used with lookahead windows.");
+        }
+        if (!gc.setCheckpoint((m_settings.m_checkpoint_time >= 0.0)?get_time_value(m_settings.m_checkpoint_time):-1, m_settings.m_checkpoint_file) ||
+            !gc.setResumeFile(m_settings.m_resume_file)) {
+            throw smnchai_exception("Error while setting the checkpoint of the simulation.");
+        }
     }
 }
 
@@ -0,0 +1,463 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Cache of a workspace built by a script, to skip the evaluation of the script on repeated runs.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <obnsmn_report.h>
+#include <smnchai_api.h>
+
+using namespace SMNChai;
+
+namespace {
+    /** The magic string of a cache file, which changes with the layout of the data. */
+    const char CACHE_MAGIC[8] = {'O', 'B', 'N', 'W', 'S', 'C', '0', '1'};
+
+    /** Accumulates the content of a cache file in memory. */
+    class CacheWriter {
+    public:
+        std::string data;
+
+        void writeInt(int64_t v) {
+            uint64_t x = static_cast<uint64_t>(v);
+            for (int k = 0; k < 8; ++k, x >>= 8) {
+                data.push_back(static_cast<char>(x & 0xFF));
+            }
+        }
+
+        void writeDouble(double v) {
+            int64_t x;
+            std::memcpy(&x, &v, sizeof(x));
+            writeInt(x);
+        }
+
+        void writeString(const std::string& s) {
+            writeInt(s.size());
+            data.append(s);
+        }
+
+        void writePort(const PortInfo& p) {
+            writeString(p.node_name);
+            writeString(p.port_name);
+            writeInt(p.port_type);
+            writeInt(p.comm);
+        }
+    };
+
+    /** Reads the content of a cache file mapped in memory; any read beyond its end fails. */
+    class CacheReader {
+        const char* m_pos;
+        const char* m_end;
+
+    public:
+        CacheReader(const char* data, std::size_t size): m_pos(data), m_end(data + size) { }
+
+        bool atEnd() const {
+            return m_pos == m_end;
+        }
+
+        bool readBytes(const char*& p, std::size_t n) {
+            if (std::size_t(m_end - m_pos) < n) {
+                return false;
+            }
+            p = m_pos;
+            m_pos += n;
+            return true;
+        }
+
+        bool readInt(int64_t& v) {
+            const char* p;
+            if (!readBytes(p, 8)) {
+                return false;
+            }
+            uint64_t x = 0;
+            for (int k = 0; k < 8; ++k) {
+                x |= static_cast<uint64_t>(static_cast<unsigned char>(p[k])) << (8*k);
+            }
+            v = static_cast<int64_t>(x);
+            return true;
+        }
+
+        /** Read a count of items, each taking at least itemSize bytes, so that a corrupted count fails without a huge allocation. */
+        bool readCount(std::size_t& n, std::size_t itemSize) {
+            int64_t v;
+            if (!readInt(v) || v < 0 || uint64_t(v) > std::size_t(m_end - m_pos) / itemSize) {
+                return false;
+            }
+            n = v;
+            return true;
+        }
+
+        template <typename T>
+        bool readValue(T& v) {
+            int64_t x;
+            if (!readInt(x)) {
+                return false;
+            }
+            v = static_cast<T>(x);
+            return true;
+        }
+
+        bool readDouble(double& v) {
+            int64_t x;
+            if (!readInt(x)) {
+                return false;
+            }
+            std::memcpy(&v, &x, sizeof(v));
+            return true;
+        }
+
+        bool readString(std::string& s) {
+            std::size_t n;
+            const char* p;
+            if (!readCount(n, 1) || !readBytes(p, n)) {
+                return false;
+            }
+            s.assign(p, n);
+            return true;
+        }
+
+        bool readComm(CommProtocol& c) {
+            int64_t x;
+            if (!readInt(x) || x < COMM_DEFAULT || x > COMM_SHM) {
+                return false;
+            }
+            c = static_cast<CommProtocol>(x);
+            return true;
+        }
+
+        /** Read a port; PortInfo can't be assigned, so it's constructed by the caller from the read fields. */
+        bool readPort(std::string& node, std::string& port, PortInfo::PortType& type, CommProtocol& comm) {
+            int64_t t;
+            if (!readString(node) || !readString(port) || !readInt(t) || t < PortInfo::INPUT || t > PortInfo::DATA || !readComm(comm)) {
+                return false;
+            }
+            type = static_cast<PortInfo::PortType>(t);
+            return true;
+        }
+    };
+
+    /** A read-only memory map of a whole file, unmapped when destroyed. */
+    class MappedFile {
+        void* m_data = MAP_FAILED;
+        std::size_t m_size = 0;
+
+    public:
+        explicit MappedFile(const std::string& file) {
+            int fd = ::open(file.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return;
+            }
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+                m_size = st.st_size;
+                m_data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            }
+            ::close(fd);    // The mapping stays valid after closing the file
+        }
+
+        ~MappedFile() {
+            if (m_data != MAP_FAILED) {
+                ::munmap(m_data, m_size);
+            }
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool valid() const {
+            return m_data != MAP_FAILED;
+        }
+
+        const char* data() const {
+            return static_cast<const char*>(m_data);
+        }
+
+        std::size_t size() const {
+            return m_size;
+        }
+    };
+}
+
+
+bool WorkSpace::save_cache(const std::string &t_file, uint64_t t_key) const {
+    CacheWriter w;
+    w.data.append(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    w.writeInt(t_key);
+    w.writeString(m_name);
+
+    // The settings, except the system ones
+    w.writeInt(m_settings.m_ack_timeout);
+    w.writeDouble(m_settings.m_final_time);
+    w.writeInt(m_settings.m_time_unit);
+    w.writeInt(m_settings.m_run_simulation);
+    w.writeInt(m_settings.m_wallclock);
+    w.writeInt(m_settings.m_comm);
+    w.writeString(m_settings.m_mqtt_server);
+    w.writeString(m_settings.m_socket_address);
+    w.writeInt(m_settings.m_wave_cache);
+    w.writeString(m_settings.m_dep_graph);
+    w.writeInt(m_settings.m_dataflow);
+    w.writeInt(m_settings.m_fuse_update_x);
+    w.writeInt(m_settings.m_lookahead);
+    w.writeInt(m_settings.m_mqtt_group_topics);
+    w.writeInt(m_settings.m_bundle_messages);
+    w.writeString(m_settings.m_reliability);
+    w.writeInt(m_settings.m_ack_retries);
+    w.writeInt(m_settings.m_parallel_components);
+    w.writeDouble(m_settings.m_checkpoint_time);
+    w.writeString(m_settings.m_checkpoint_file);
+    w.writeString(m_settings.m_resume_file);
+    w.writeDouble(m_cache_wait);
+
+    // The nodes
+    w.writeInt(m_nodes.size());
+    for (const auto& mynode: m_nodes) {
+        const auto& node = mynode.second.node;
+        w.writeString(node.m_name);
+        w.writeInt(node.m_updateX);
+        w.writeInt(node.m_comm_protocol);
+        w.writeInt(node.m_partition);
+
+        w.writeInt(node.m_inputs.size());
+        for (const auto& port: node.m_inputs) {
+            w.writeString(port.first);
+            w.writeInt(port.second.m_mask);
+            w.writeInt(port.second.m_comm);
+        }
+        w.writeInt(node.m_outputs.size());
+        for (const auto& port: node.m_outputs) {
+            w.writeString(port.first);
+            w.writeInt(port.second.m_mask);
+            w.writeInt(port.second.m_comm);
+        }
+        w.writeInt(node.m_dataports.size());
+        for (const auto& port: node.m_dataports) {
+            w.writeString(port.first);
+            w.writeInt(port.second);
+        }
+
+        w.writeInt(node.m_updates.size());
+        for (const auto& update: node.m_updates) {
+            w.writeInt(update.first);
+            w.writeDouble(update.second.sampling_time);
+            w.writeInt(update.second.dependencies.size());
+            for (auto dep: update.second.dependencies) {
+                w.writeInt(dep);
+            }
+        }
+    }
+
+    // The connections, in their order in the list
+    w.writeInt(std::distance(m_connections.begin(), m_connections.end()));
+    for (const auto& myconn: m_connections) {
+        w.writePort(myconn.first);
+        w.writePort(myconn.second);
+    }
+
+    // The Docker node list
+    w.writeInt(m_docker_nodelist.size());
+    for (const auto& docker: m_docker_nodelist) {
+        w.writeString(docker.name);
+        w.writeString(docker.machine);
+        w.writeString(docker.image);
+        w.writeString(docker.cmd);
+        w.writeString(docker.src);
+        w.writeString(docker.extra);
+    }
+
+    // Write to a temporary file, then replace the cache file at once
+    std::string tmpfile = t_file + ".tmp" + std::to_string(::getpid());
+    {
+        std::ofstream f(tmpfile, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!f || !f.write(w.data.data(), w.data.size())) {
+            std::remove(tmpfile.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmpfile.c_str(), t_file.c_str()) != 0) {
+        std::remove(tmpfile.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+bool WorkSpace::load_cache(const std::string &t_file, uint64_t t_key) {
+    MappedFile file(t_file);
+    if (!file.valid()) {
+        return false;
+    }
+    CacheReader r(file.data(), file.size());
+
+    const char* magic;
+    int64_t key;
+    if (!r.readBytes(magic, sizeof(CACHE_MAGIC)) || std::memcmp(magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        !r.readInt(key) || static_cast<uint64_t>(key) != t_key) {
+        return false;
+    }
+
+    // Everything is read into a separate workspace content, which replaces the current one only if the whole file is valid
+    std::string name;
+    Settings settings = m_settings;
+    double cache_wait;
+    if (!r.readString(name) || (!name.empty() && !OBNsim::Utils::isValidIdentifier(name)) ||
+        !r.readValue(settings.m_ack_timeout) ||
+        !r.readDouble(settings.m_final_time) ||
+        !r.readValue(settings.m_time_unit) ||
+        !r.readValue(settings.m_run_simulation) ||
+        !r.readValue(settings.m_wallclock) ||
+        !r.readComm(settings.m_comm) ||
+        !r.readString(settings.m_mqtt_server) ||
+        !r.readString(settings.m_socket_address) ||
+        !r.readValue(settings.m_wave_cache) ||
+        !r.readString(settings.m_dep_graph) ||
+        !r.readValue(settings.m_dataflow) ||
+        !r.readValue(settings.m_fuse_update_x) ||
+        !r.readValue(settings.m_lookahead) ||
+        !r.readValue(settings.m_mqtt_group_topics) ||
+        !r.readValue(settings.m_bundle_messages) ||
+        !r.readString(settings.m_reliability) ||
+        !r.readValue(settings.m_ack_retries) ||
+        !r.readValue(settings.m_parallel_components) ||
+        !r.readDouble(settings.m_checkpoint_time) ||
+        !r.readString(settings.m_checkpoint_file) ||
+        !r.readString(settings.m_resume_file) ||
+        !r.readDouble(cache_wait)) {
+        return false;
+    }
+
+    // The nodes are built in place in the map, without copying them
+    decltype(m_nodes) nodes;
+    std::size_t nnodes;
+    if (!r.readCount(nnodes, 8)) {
+        return false;
+    }
+    std::string node_name;
+    for (std::size_t i = 0; i < nnodes; ++i) {
+        if (!r.readString(node_name) || !OBNsim::Utils::isValidNodeName(node_name)) {
+            return false;
+        }
+        auto inserted = nodes.emplace(node_name, NodeInfo(Node(node_name)));
+        if (!inserted.second) {
+            return false;
+        }
+        Node& node = inserted.first->second.node;
+        node.m_name = node_name;        // Without the prefix of the current subsystem, added by the constructor
+
+        std::size_t n;
+        std::string port_name;
+        Node::PhysicalPortProperties props;
+        if (!r.readValue(node.m_updateX) || !r.readComm(node.m_comm_protocol) || !r.readValue(node.m_partition) || !r.readCount(n, 24)) {
+            return false;
+        }
+        for (std::size_t k = 0; k < n; ++k) {
+            if (!r.readString(port_name) || !r.readValue(props.m_mask) || !r.readComm(props.m_comm)) {
+                return false;
+            }
+            node.m_inputs.emplace_hint(node.m_inputs.end(), port_name, props);
+        }
+        if (!r.readCount(n, 24)) {
+            return false;
+        }
+        for (std::size_t k = 0; k < n; ++k) {
+            if (!r.readString(port_name) || !r.readValue(props.m_mask) || !r.readComm(props.m_comm)) {
+                return false;
+            }
+            node.m_outputs.emplace_hint(node.m_outputs.end(), port_name, props);
+        }
+        if (!r.readCount(n, 16)) {
+            return false;
+        }
+        for (std::size_t k = 0; k < n; ++k) {
+            if (!r.readString(port_name) || !r.readComm(props.m_comm)) {
+                return false;
+            }
+            node.m_dataports.emplace_hint(node.m_dataports.end(), port_name, props.m_comm);
+        }
+
+        if (!r.readCount(n, 24)) {
+            return false;
+        }
+        for (std::size_t k = 0; k < n; ++k) {
+            unsigned int id;
+            double sampling_time;
+            std::size_t ndeps;
+            if (!r.readValue(id) || id > OBNsim::MAX_UPDATE_INDEX || !r.readDouble(sampling_time) || !r.readCount(ndeps, 8)) {
+                return false;
+            }
+            auto& block = node.m_updates.emplace_hint(node.m_updates.end(), id, Node::BlockDef(sampling_time))->second;
+            for (std::size_t d = 0; d < ndeps; ++d) {
+                unsigned int dep;
+                if (!r.readValue(dep)) {
+                    return false;
+                }
+                block.dependencies.insert(dep);
+            }
+        }
+    }
+
+    // The connections, appended in order
+    decltype(m_connections) connections;
+    std::size_t nconns;
+    if (!r.readCount(nconns, 64)) {
+        return false;
+    }
+    decltype(m_connection_keys) connection_keys;
+    connection_keys.reserve(nconns);
+    auto last = connections.before_begin();
+    std::string src_node, src_port, tgt_node, tgt_port;
+    PortInfo::PortType src_type, tgt_type;
+    CommProtocol src_comm, tgt_comm;
+    for (std::size_t k = 0; k < nconns; ++k) {
+        if (!r.readPort(src_node, src_port, src_type, src_comm) || !r.readPort(tgt_node, tgt_port, tgt_type, tgt_comm)) {
+            return false;
+        }
+        last = connections.emplace_after(last, PortInfo{src_node, src_port, src_type, src_comm}, PortInfo{tgt_node, tgt_port, tgt_type, tgt_comm});
+        connection_keys.insert(connection_key(last->first, last->second));
+    }
+
+    // The Docker node list
+    decltype(m_docker_nodelist) docker_nodelist;
+    std::size_t ndocker;
+    if (!r.readCount(ndocker, 48)) {
+        return false;
+    }
+    for (std::size_t k = 0; k < ndocker; ++k) {
+        DockerNodeInfo docker;
+        if (!r.readString(docker.name) || !r.readString(docker.machine) || !r.readString(docker.image) ||
+            !r.readString(docker.cmd) || !r.readString(docker.src) || !r.readString(docker.extra)) {
+            return false;
+        }
+        docker_nodelist.push_back(std::move(docker));
+    }
+
+    if (!r.atEnd()) {
+        return false;
+    }
+
+    // The system settings are those of this run, not of the cached one
+    settings.m_sys_run_simulation = m_settings.m_sys_run_simulation;
+    settings.m_dockerlist = m_settings.m_dockerlist;
+
+    set_name(name);
+    m_settings = settings;
+    m_cache_wait = cache_wait;
+    m_nodes.swap(nodes);
+    m_connections.swap(connections);
+    m_connection_keys.swap(connection_keys);
+    m_docker_nodelist.swap(docker_nodelist);
+    return true;
+}
@@ -0,0 +1,327 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Launch many local node processes concurrently.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "smnchai_launcher.h"
+
+extern char **environ;
+
+using namespace SMNChai;
+
+namespace {
+    /** The file descriptor of the readiness pipe in a launched process. */
+    const int READY_FD = 3;
+    
+    /** The period in milliseconds to check for exited processes, once all processes have started. */
+    const int REAP_PERIOD = 250;
+}
+
+
+NodeLauncher::~NodeLauncher() {
+    await();
+    
+    {
+        std::lock_guard<std::mutex> mylock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeup.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    
+    // Reap the processes which have exited meanwhile; the others keep running
+    reap_processes();
+}
+
+
+void NodeLauncher::launch(const std::vector<LaunchRequest>& t_requests) {
+    std::lock_guard<std::mutex> mylock(m_mutex);
+    for (const auto& request: t_requests) {
+        if (request.command.empty()) {
+            throw smnchai_exception("The command to launch node " + request.node + " is empty.");
+        }
+        std::unique_ptr<Process> process(new Process);
+        process->request = request;
+        m_by_node[request.node] = process.get();
+        m_processes.push_back(std::move(process));
+    }
+    
+    if (m_next < m_processes.size()) {
+        if (m_running) {
+            m_wakeup.notify_all();      // The thread may be only reaping
+        } else {
+            if (m_thread.joinable()) {
+                m_thread.join();
+            }
+            m_running = true;
+            m_thread = std::thread(&NodeLauncher::thread_main, this);
+        }
+    }
+}
+
+
+std::size_t NodeLauncher::await() {
+    std::unique_lock<std::mutex> mylock(m_mutex);
+    m_idle.wait(mylock, [this]() { return !m_running || idle(); });
+    return std::count_if(m_processes.begin(), m_processes.end(), [](const std::unique_ptr<Process>& p) { return p->status != READY; });
+}
+
+
+bool NodeLauncher::launched(const std::string& t_node) const {
+    std::lock_guard<std::mutex> mylock(m_mutex);
+    return m_by_node.count(t_node) > 0;
+}
+
+
+NodeLauncher::Status NodeLauncher::status(const std::string& t_node) const {
+    std::lock_guard<std::mutex> mylock(m_mutex);
+    auto it = m_by_node.find(t_node);
+    if (it == m_by_node.end()) {
+        throw smnchai_exception("No process has been launched for node " + t_node + ".");
+    }
+    return it->second->status;
+}
+
+
+std::string NodeLauncher::status_name(Status t_status) {
+    switch (t_status) {
+        case PENDING: return "pending";
+        case STARTING: return "starting";
+        case READY: return "ready";
+        case EXITED: return "exited";
+        case TIMEOUT: return "timeout";
+        default: return "failed";
+    }
+}
+
+
+void NodeLauncher::thread_main() {
+    std::vector<Process*> starting;     // The processes whose readiness pipes are watched
+    std::vector<struct pollfd> fds;
+    
+    while (true) {
+        // Start the pending processes while there is room in the pool
+        while (true) {
+            Process* process = nullptr;
+            {
+                std::lock_guard<std::mutex> mylock(m_mutex);
+                unsigned int max = m_max_concurrent;
+                if (max == 0) {
+                    max = std::max(1u, std::thread::hardware_concurrency());
+                }
+                if (m_starting < max && m_next < m_processes.size()) {
+                    process = m_processes[m_next++].get();
+                    ++m_starting;
+                }
+            }
+            if (!process) {
+                break;
+            }
+            if (start_process(*process)) {
+                std::lock_guard<std::mutex> mylock(m_mutex);
+                process->status = STARTING;
+                starting.push_back(process);
+            } else {
+                finish_process(*process, FAILED);
+            }
+        }
+        
+        std::size_t alive = reap_processes();
+        
+        if (starting.empty()) {
+            std::unique_lock<std::mutex> mylock(m_mutex);
+            if (idle()) {
+                m_idle.notify_all();
+                // Only reaping the processes now, until they have all exited or the launcher is destroyed
+                if (m_stop || alive == 0) {
+                    m_running = false;
+                    return;
+                }
+                m_wakeup.wait_for(mylock, std::chrono::milliseconds(REAP_PERIOD), [this]() { return m_stop || !idle(); });
+            }
+            continue;
+        }
+        
+        // Wait for the processes to signal, or for a short while to check the timeouts and the new requests
+        fds.resize(starting.size());
+        for (std::size_t k = 0; k < starting.size(); ++k) {
+            fds[k].fd = starting[k]->ready_fd;
+            fds[k].events = POLLIN;
+            fds[k].revents = 0;
+        }
+        ::poll(fds.data(), fds.size(), 50);
+        
+        auto now = std::chrono::steady_clock::now();
+        double ready_timeout = m_ready_timeout;
+        for (std::size_t k = 0; k < starting.size(); ++k) {
+            auto& process = *starting[k];
+            Status result = STARTING;
+            
+            if (fds[k].revents != 0) {
+                char buffer[256];
+                auto n = ::read(process.ready_fd, buffer, sizeof(buffer));
+                if (n > 0) {
+                    process.ready_line.append(buffer, n);
+                    auto pos = process.ready_line.find('\n');
+                    if (pos != std::string::npos) {
+                        m_ready.arrive(process.ready_line.substr(0, pos));
+                        result = READY;
+                    }
+                } else if (n == 0 || (errno != EINTR && errno != EAGAIN)) {
+                    // The pipe was closed without signaling: the process has exited, or its node does not signal
+                    result = EXITED;
+                }
+            }
+            if (result == STARTING && ready_timeout > 0.0 &&
+                std::chrono::duration<double>(now - process.start_time).count() > ready_timeout) {
+                // The node is considered failed; it's terminated rather than left running unnoticed, possibly joining the simulation later
+                if (!process.reaped) {
+                    ::kill(process.pid, SIGTERM);
+                }
+                result = TIMEOUT;
+            }
+            
+            if (result != STARTING) {
+                ::close(process.ready_fd);
+                process.ready_fd = -1;
+                finish_process(process, result);
+                starting[k] = nullptr;
+            }
+        }
+        starting.erase(std::remove(starting.begin(), starting.end(), nullptr), starting.end());
+    }
+}
+
+
+void NodeLauncher::finish_process(Process& t_process, Status t_status) {
+    std::lock_guard<std::mutex> mylock(m_mutex);
+    t_process.status = t_status;
+    --m_starting;
+    if (t_status != READY) {
+        OBNsmn::report_warning(0, "The process of node " + t_process.request.node + " is " + status_name(t_status) + ".");
+    }
+}
+
+
+std::size_t NodeLauncher::reap_processes() {
+    // Check without reaping whether any child has exited, to avoid a system call per process in the usual case
+    siginfo_t info;
+    info.si_pid = 0;
+    bool exited = ::waitid(P_ALL, 0, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid != 0;
+    
+    // Only the launched processes are reaped, not any child (waitpid(-1)), which would steal the children waited for by other parts of the SMN
+    std::lock_guard<std::mutex> mylock(m_mutex);
+    std::size_t alive = 0;
+    for (auto& p: m_processes) {
+        if (p->pid > 0 && !p->reaped) {
+            pid_t result = exited ? ::waitpid(p->pid, nullptr, WNOHANG) : 0;
+            if (result == p->pid || (result < 0 && errno == ECHILD)) {
+                p->reaped = true;   // Reaped, or not a child anymore
+            } else {
+                ++alive;
+            }
+        }
+    }
+    return alive;
+}
+
+
+void NodeLauncher::rotate_log(const std::string& t_file) const {
+    unsigned int keep = m_log_keep;
+    if (keep > 0) {
+        for (auto k = keep - 1; k > 0; --k) {
+            std::rename((t_file + '.' + std::to_string(k)).c_str(), (t_file + '.' + std::to_string(k+1)).c_str());
+        }
+        std::rename(t_file.c_str(), (t_file + ".1").c_str());
+    }
+}
+
+
+bool NodeLauncher::start_process(Process& t_process) {
+    const auto& request = t_process.request;
+    
+    // Everything the child needs is prepared before forking, because the child may only call async-signal-safe functions
+    const char* argv[] = {"/bin/sh", "-c", request.command.c_str(), nullptr};
+    
+    std::vector<std::string> env;
+    for (char **e = environ; *e; ++e) {
+        if (std::strncmp(*e, "OBN_READY_FD=", 13) != 0) {
+            env.emplace_back(*e);
+        }
+    }
+    env.push_back("OBN_READY_FD=" + std::to_string(READY_FD));
+    std::vector<const char*> envp;
+    for (const auto& e: env) {
+        envp.push_back(e.c_str());
+    }
+    envp.push_back(nullptr);
+    
+    int log_fd = -1;
+    if (!request.log.empty()) {
+        rotate_log(request.log);
+        log_fd = ::open(request.log.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (log_fd < 0) {
+            OBNsmn::report_error(0, "Could not open the log file " + request.log + " of node " + request.node + ": " + std::strerror(errno));
+            return false;
+        }
+    }
+    
+    int pipe_fds[2];
+    if (::pipe(pipe_fds) != 0) {
+        OBNsmn::report_error(0, "Could not create the readiness pipe of node " + request.node + ": " + std::strerror(errno));
+        if (log_fd >= 0) { ::close(log_fd); }
+        return false;
+    }
+    ::fcntl(pipe_fds[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(pipe_fds[1], F_SETFD, FD_CLOEXEC);
+    
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        // Child process
+        if (!request.workdir.empty() && ::chdir(request.workdir.c_str()) != 0) {
+            ::_exit(127);
+        }
+        if (log_fd >= 0) {
+            ::dup2(log_fd, STDOUT_FILENO);
+            ::dup2(log_fd, STDERR_FILENO);
+        }
+        if (pipe_fds[1] == READY_FD) {
+            ::fcntl(READY_FD, F_SETFD, 0);
+        } else {
+            ::dup2(pipe_fds[1], READY_FD);     // The duplicate is not closed on exec
+        }
+        ::execve(argv[0], const_cast<char* const*>(argv), const_cast<char* const*>(envp.data()));
+        ::_exit(127);
+    }
+    
+    ::close(pipe_fds[1]);
+    if (log_fd >= 0) {
+        ::close(log_fd);
+    }
+    if (pid < 0) {
+        OBNsmn::report_error(0, "Could not start the process of node " + request.node + ": " + std::strerror(errno));
+        ::close(pipe_fds[0]);
+        return false;
+    }
+    
+    t_process.pid = pid;
+    t_process.ready_fd = pipe_fds[0];
+    t_process.start_time = std::chrono::steady_clock::now();
+    return true;
+}
@@ -11,10 +11,13 @@
  */
 
 #include <fstream>
+#include <iterator>
 #include <boost/filesystem.hpp>     // manipulate paths
 
 #include "smnchai.h"        // Common defs
 #include "smnchai_api.h"    // Chaiscript API for SMN
+#include "smnchai_runs.h"   // Simulations launched by the script
+#include "smnchai_launcher.h"   // Local nodes launched by the script
 
 #include <chaiscript/chaiscript.hpp>
 
@@ -27,6 +30,286 @@
 const char *SMNCHAI_ENV_VAR = "SMNCHAI_DIR";    // environment variable that contains the path to the main SMNChai directory
 const char *SMNCHAI_STDLIB_NAME = "stdlib.chai";    // name of the standard library file
 
+// Construct the simulation network of a workspace: start the communication threads and generate the system into the GC.
+// Return true if the simulation can be run, false if the program should exit with the return code given in the second value
+static std::pair<bool, int> construct_network(SMNChai::WorkSpace& ws, OBNsmn::GCThread& gc, SMNChai::SMNChaiComm& comm)
+{
+    std::cout << "Done loading the script file. Now constructing the simulation network...\n";
+    
+    // Need to create and start the communication threads here to get certain messages from the nodes
+#ifdef OBNSIM_COMM_YARP
+    bool create_yarp = (comm.yarpThread == nullptr);
+#endif
+    
+    if (ws.is_comm_protocol_used(SMNChai::COMM_YARP)) {
+        // Create and Open Yarp port
+#ifdef OBNSIM_COMM_YARP
+        if (create_yarp) {
+            comm.yarpThread = new OBNsmn::YARP::YARPPollingThread(&gc, "");
+        }
+        
+        // Set the GC port name on this SMN
+        comm.yarpThread->setPortName('/' + ws.get_full_path("_smn_", OBNsim::NODE_GC_PORT_NAME));  // YARP requires / at the beginning
+        
+        bool yarpSuccess = true;
+        
+        // Must open the GC port on this SMN because other nodes will be connected to it in generate_obn_system()
+        if (!comm.yarpThread->openPort()) {
+            std::cerr << "ERROR: Could not open the main GC port on the SMN." << std::endl;
+            if (create_yarp) {
+                // Delete the YARP thread here because we created it
+                delete comm.yarpThread;
+                comm.yarpThread = nullptr;
+            }
+            yarpSuccess = false;
+        }
+        
+        // Start Yarp communication
+        if (!comm.yarpThread->startThread()) {
+            std::cerr << "ERROR: could not start Yarp communication thread." << std::endl;
+            if (create_yarp) {
+                // Delete the YARP thread here because we created it
+                delete comm.yarpThread;
+                comm.yarpThread = nullptr;
+            }
+            yarpSuccess = false;
+        }
+        
+        if (!yarpSuccess) {
+            // Delete the MQTT thread if it's already started
+#ifdef OBNSIM_COMM_MQTT
+            comm.releaseMqttClient();
+#endif
+            return std::make_pair(false, 5);
+        }
+#else
+        std::cerr << "ERROR: YARP communication is not supported in this SMN." << std::endl;
+        return std::make_pair(false, 5);
+#endif
+    }
+    
+    if (ws.is_comm_protocol_used(SMNChai::COMM_MQTT)) {
+        // Create and Open MQTT port
+        // If fail, remember to also shut down Yarp if necessary (shutdown_communication_threads)
+#ifdef OBNSIM_COMM_MQTT
+        // Start MQTT communication
+        if (!ws.start_mqtt_client()) {
+            std::cerr << "ERROR: could not start MQTT communication thread." << std::endl;
+#ifdef OBNSIM_COMM_YARP
+            // Shut down Yarp
+            if (comm.yarpThread) {
+                shutdown_communication_threads(gc, comm);
+                if (create_yarp) {
+                    delete comm.yarpThread;
+                    comm.yarpThread = nullptr;
+                }
+            }
+#endif
+            // Delete the MQTT client
+            comm.releaseMqttClient();
+            return std::make_pair(false, 5);
+        }
+#else
+        std::cerr << "Error: MQTT communication is not supported in this SMN." << std::endl;
+#ifdef OBNSIM_COMM_YARP
+        if (comm.yarpThread) {
+            shutdown_communication_threads(gc, comm);
+            if (create_yarp) {
+                delete comm.yarpThread;
+                comm.yarpThread = nullptr;
+            }
+        }
+#endif
+        return std::make_pair(false, 5);
+#endif
+    }
+#ifdef OBNSIM_COMM_MQTT
+    else if (comm.mqttClient) {
+        comm.releaseMqttClient();
+    }
+#endif
+    
+    if (ws.is_comm_protocol_used(SMNChai::COMM_SOCKET)) {
+        // Start listening for the nodes' connections (if the script has not already started it to wait for the nodes)
+        // If fail, remember to also shut down Yarp and MQTT if necessary (shutdown_communication_threads)
+#ifdef OBNSIM_COMM_SOCKET
+        if (!ws.start_socket_server()) {
+            std::cerr << "ERROR: could not start socket communication server." << std::endl;
+#else
+        {
+            std::cerr << "Error: Socket communication is not supported in this SMN." << std::endl;
+#endif
+            shutdown_communication_threads(gc, comm);
+#ifdef OBNSIM_COMM_YARP
+            if (comm.yarpThread && create_yarp) {
+                delete comm.yarpThread;
+                comm.yarpThread = nullptr;
+            }
+#endif
+#ifdef OBNSIM_COMM_MQTT
+            comm.releaseMqttClient();
+#endif
+            return std::make_pair(false, 5);
+        }
+    }
+#ifdef OBNSIM_COMM_SOCKET
+    else if (comm.socketServer) {
+        comm.socketServer->stop();
+        delete comm.socketServer;
+        comm.socketServer = nullptr;
+    }
+#endif
+    
+    if (ws.is_comm_protocol_used(SMNChai::COMM_SHM)) {
+        // Create the SMN's segment (if the script has not already created it to wait for the nodes)
+        // If fail, remember to also shut down the other communication threads (shutdown_communication_threads)
+#ifdef OBNSIM_COMM_SHM
+        if (!ws.start_shm_server()) {
+            std::cerr << "ERROR: could not start shared-memory communication server." << std::endl;
+#else
+        {
+            std::cerr << "Error: Shared-memory communication is not supported in this SMN." << std::endl;
+#endif
+            shutdown_communication_threads(gc, comm);
+#ifdef OBNSIM_COMM_YARP
+            if (comm.yarpThread && create_yarp) {
+                delete comm.yarpThread;
+                comm.yarpThread = nullptr;
+            }
+#endif
+#ifdef OBNSIM_COMM_MQTT
+            comm.releaseMqttClient();
+#endif
+#ifdef OBNSIM_COMM_SOCKET
+            if (comm.socketServer != nullptr) {
+                delete comm.socketServer;
+                comm.socketServer = nullptr;
+            }
+#endif
+            return std::make_pair(false, 5);
+        }
+    }
+#ifdef OBNSIM_COMM_SHM
+    else if (comm.shmServer) {
+        comm.shmServer->stop();
+        delete comm.shmServer;
+        comm.shmServer = nullptr;
+    }
+#endif
+
+#ifdef OBNSIM_COMM_MQTT
+    if (comm.mqttClient && ws.m_tracking_mqtt_online_nodes) {
+        // The MQTT client is running and may be tracking nodes' availability -> stop tracking
+        comm.mqttClient->stopListeningForArrivals(ws.get_name().empty()?"":(ws.get_name()+'/'));
+        ws.m_tracking_mqtt_online_nodes = false;
+    }
+#endif
+    
+    try {
+        ws.generate_obn_system(gc, comm);
+    } catch (SMNChai::smnchai_exception const &e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        
+        // As the communication thread(s) already started, we try to signal them to stop
+        shutdown_communication_threads(gc, comm);
+        
+        // Delete them if we created them before
+#ifdef OBNSIM_COMM_YARP
+        if (comm.yarpThread && create_yarp) {
+            delete comm.yarpThread;
+            comm.yarpThread = nullptr;
+        }
+#endif
+#ifdef OBNSIM_COMM_MQTT
+        comm.releaseMqttClient();
+#endif
+#ifdef OBNSIM_COMM_SOCKET
+        if (comm.socketServer) {
+            delete comm.socketServer;
+            comm.socketServer = nullptr;
+        }
+#endif
+#ifdef OBNSIM_COMM_SHM
+        if (comm.shmServer) {
+            delete comm.shmServer;
+            comm.shmServer = nullptr;
+        }
+#endif
+        
+        return std::make_pair(false, 6);
+    }
+    
+    return std::make_pair(true, 0);
+}
+
+// Check whether the simulation of a loaded workspace is to be run; if not, tell why, and generate the node list for Docker if it's asked for
+static bool simulation_to_run(const SMNChai::WorkSpace& ws, const SMNChai::SystemSettings& sys_settings)
+{
+    // If it's set not to run the simulation, we can exit now
+    if (sys_settings.dryrun || !ws.m_settings.m_run_simulation) {
+        std::cout << "\nTHE SIMULATION IS SET NOT TO BE RUN AUTOMATICALLY (DRY-RUN).\n";
+        return false;
+    }
+    
+    if (sys_settings.dockerlist) {
+        std::cout << "\nGENERATE NODE LIST FOR DOCKER WITHOUT RUNNING THE SIMULATION.\n";
+        try {
+            std::ofstream dockerlistfile(sys_settings.dockerlistfile);
+            ws.obndocker_dump(dockerlistfile);
+            dockerlistfile.close();
+        } catch (std::ofstream::failure e) {
+            std::cerr << "Error while writing to Docker node list file.\n";
+        }
+        
+        return false;
+    }
+    
+    return true;
+}
+
+// Transfer the system settings to the settings of a workspace
+static void apply_system_settings(SMNChai::WorkSpace& ws, const SMNChai::SystemSettings& sys_settings)
+{
+    if (sys_settings.dryrun || sys_settings.dockerlist) {
+        ws.m_settings.m_sys_run_simulation = false;     // Force no-simulation
+        ws.m_settings.m_dockerlist = sys_settings.dockerlist;
+    }
+}
+
+// Compute the key of the workspace cache of a script (see WorkSpace::save_cache()): a hash of the content of the script, its arguments and its default workspace name.
+// Return false if the key can't be computed: the script can't be read, or an argument is not a string (e.g. given by launch_run()).
+// The files used by the script are not part of the key: the cache must be deleted when they change.
+static bool workspace_cache_key(const std::string& script_file,
+                                const std::map<std::string, chaiscript::Boxed_Value>& arguments_map,
+                                const std::string& default_workspace,
+                                uint64_t& key)
+{
+    std::ifstream f(script_file, std::ios::in | std::ios::binary);
+    if (!f) {
+        return false;
+    }
+    std::string content((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    
+    // FNV-1a hash of the strings, each followed by a null character to separate them
+    key = 14695981039346656037ULL;
+    auto hash = [&key](const std::string& s) {
+        for (char c: s) {
+            key = (key ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+        }
+        key = key * 1099511628211ULL;
+    };
+    hash(content);
+    hash(default_workspace);
+    for (const auto& arg: arguments_map) {      // The map is sorted by the names
+        if (!arg.second.is_type(chaiscript::user_type<std::string>())) {
+            return false;
+        }
+        hash(arg.first);
+        hash(chaiscript::boxed_cast<const std::string&>(arg.second));
+    }
+    return true;
+}
+
 // Return true if simulation should continue, false if should exit with given return code in the second value
 std::pair<bool, int> SMNChai::smnchai_loadscript(const std::string& script_file,
                                                  const std::map<std::string, chaiscript::Boxed_Value>& arguments_map,
@@ -131,6 +414,33 @@ std::pair<bool, int> SMNChai::smnchai_loadscript(const std::string& script_file,
     }
 
     
+    // A valid cache of the workspace built by this script with the same arguments replaces the evaluation of the script
+    uint64_t cache_key = 0;
+    bool cache_enabled = !sys_settings.cachefile.empty() && workspace_cache_key(script_file, arguments_map, default_workspace, cache_key);
+    if (cache_enabled) {
+        SMNChai::WorkSpace ws(default_workspace, comm, gc);
+        apply_system_settings(ws, sys_settings);
+        
+        if (ws.load_cache(sys_settings.cachefile, cache_key)) {
+            std::cout << "Loaded the workspace from the cache file: " << sys_settings.cachefile << std::endl;
+            
+            // The script's waits for the nodes are replayed, as a wait for all nodes
+            if (ws.m_cache_wait >= 0.0) {
+                try {
+                    ws.waitfor_all_nodes_online(ws.m_cache_wait);
+                } catch (const SMNChai::smnchai_exception &e) {
+                    std::cerr << "SMNChai error:\n" << e.what() << std::endl;
+                    return std::make_pair(false, 3);
+                }
+            }
+            
+            if (!simulation_to_run(ws, sys_settings)) {
+                return std::make_pair(false, 0);
+            }
+            return construct_network(ws, gc, comm);
+        }
+    }
+    
 #ifndef SMNCHAI_CHAISCRIPT_STATIC
     chaiscript::ChaiScript chai(modulepaths, chai_usepath);  // Dynamic standard library + search path
 #else
@@ -140,13 +450,68 @@ std::pair<bool, int> SMNChai::smnchai_loadscript(const std::string& script_file,
     SMNChai::WorkSpace ws(default_workspace, comm, gc);  // default workspace name is the name of the script file
     
     // Transfer the system settings to WorkSpace settings
-    if (sys_settings.dryrun || sys_settings.dockerlist) {
-        ws.m_settings.m_sys_run_simulation = false;     // Force no-simulation
-        ws.m_settings.m_dockerlist = sys_settings.dockerlist;
-    }
+    apply_system_settings(ws, sys_settings);
     
     SMNChai::registerSMNAPI(chai, ws);
     
+    // The script can run the simulation itself, several times with warm restarts: the nodes and their connections are kept between the runs
+    bool network_constructed = false;
+    int warm_runs = 0;
+    auto simulate = [&](const std::string& params) -> double {
+        if (!ws.m_settings.will_run_simulation() || ws.m_settings.m_dockerlist) {
+            // Dry run
+            return 0.0;
+        }
+        
+        if (!network_constructed) {
+            if (!construct_network(ws, gc, comm).first) {
+                throw SMNChai::smnchai_exception("The simulation network could not be constructed.");
+            }
+            network_constructed = true;
+        } else {
+            if (!gc.nodesKeptRunning()) {
+                throw SMNChai::smnchai_exception("The simulation can't be restarted because the nodes were terminated: the last simulation did not reach its final time, or the system is partitioned.");
+            }
+            
+            // The time settings may have changed since the last run
+            if (!gc.setInitialWallclock(ws.m_settings.m_wallclock) ||
+                !gc.setFinalSimulationTime(ws.get_time_value(ws.m_settings.m_final_time))) {
+                throw SMNChai::smnchai_exception("Error while setting the time settings of the restarted simulation.");
+            }
+        }
+        
+        gc.keep_nodes_running = true;
+        gc.setSimulationParameters(params);
+        
+        std::cout << ((warm_runs == 0)?"Start simulation...\n":"Restart simulation...\n");
+        if (!gc.startThread()) {
+            throw SMNChai::smnchai_exception("Could not start the GC thread.");
+        }
+        gc.joinThread();
+        ++warm_runs;
+        
+        // The simulation time at which it stopped, in microseconds
+        return double(gc.currentSimulationTime()) * double(gc.simulationTimeUnit());
+    };
+    chai.add(chaiscript::fun(simulate), "simulate");
+    chai.add(chaiscript::fun([&simulate]() { return simulate(""); }), "simulate");
+    
+    // Whatever happens, the nodes kept running by the script's simulations are terminated when leaving
+    struct KeptNodesGuard {
+        OBNsmn::GCThread& gc;
+        const bool& constructed;
+        ~KeptNodesGuard() { if (constructed) { gc.terminateNodes(); } }
+    } kept_nodes_guard{gc, network_constructed};
+    
+    // The simulations launched by the script, which are awaited before this one is run
+    SMNChai::RunManager runs(ws, comm, sys_settings);
+    SMNChai::registerRunAPI(chai, runs);
+    
+    // The nodes launched locally by the script; the launcher is destroyed before the workspace
+    SMNChai::NodeLauncher launcher;
+    ws.m_launcher = &launcher;
+    SMNChai::registerLaunchAPI(chai, ws, launcher);
+    
     // Add the named arguments to the chai engine as a const map variable
     chai.add(chaiscript::const_var(&arguments_map), "args");
     
@@ -170,162 +535,38 @@ std::pair<bool, int> SMNChai::smnchai_loadscript(const std::string& script_file,
         throw;
     }
     
-    
-    // If it's set not to run the simulation, we can exit now
-    if (sys_settings.dryrun || !ws.m_settings.m_run_simulation) {
-        std::cout << "\nTHE SIMULATION IS SET NOT TO BE RUN AUTOMATICALLY (DRY-RUN).\n";
-        return std::make_pair(false, 0);
-    }
-    
-    if (sys_settings.dockerlist) {
-        std::cout << "\nGENERATE NODE LIST FOR DOCKER WITHOUT RUNNING THE SIMULATION.\n";
-        try {
-            std::ofstream dockerlistfile(sys_settings.dockerlistfile);
-            ws.obndocker_dump(dockerlistfile);
-            dockerlistfile.close();
-        } catch (std::ofstream::failure e) {
-            std::cerr << "Error while writing to Docker node list file.\n";
+    // Save the workspace for the next runs, unless the script has done what the cache can't replay
+    if (cache_enabled) {
+        if (!ws.m_cacheable || runs.size() > 0 || network_constructed) {
+            std::cout << "The workspace is not cached because the script starts nodes, simulations or remote commands." << std::endl;
+        } else if (ws.save_cache(sys_settings.cachefile, cache_key)) {
+            std::cout << "Saved the workspace to the cache file: " << sys_settings.cachefile << std::endl;
+        } else {
+            std::cerr << "ERROR: could not write the cache file " << sys_settings.cachefile << std::endl;
         }
-        
-        return std::make_pair(false, 0);
     }
     
-    std::cout << "Done loading the script file. Now constructing the simulation network...\n";
-    
-    // Need to create and start the communication threads here to get certain messages from the nodes
-#ifdef OBNSIM_COMM_YARP
-    bool create_yarp = (comm.yarpThread == nullptr);
-#endif
-    
-    if (ws.is_comm_protocol_used(SMNChai::COMM_YARP)) {
-        // Create and Open Yarp port
-#ifdef OBNSIM_COMM_YARP
-        if (create_yarp) {
-            comm.yarpThread = new OBNsmn::YARP::YARPPollingThread(&gc, "");
-        }
-        
-        // Set the GC port name on this SMN
-        comm.yarpThread->setPortName('/' + ws.get_full_path("_smn_", OBNsim::NODE_GC_PORT_NAME));  // YARP requires / at the beginning
-        
-        bool yarpSuccess = true;
-        
-        // Must open the GC port on this SMN because other nodes will be connected to it in generate_obn_system()
-        if (!comm.yarpThread->openPort()) {
-            std::cerr << "ERROR: Could not open the main GC port on the SMN." << std::endl;
-            if (create_yarp) {
-                // Delete the YARP thread here because we created it
-                delete comm.yarpThread;
-                comm.yarpThread = nullptr;
-            }
-            yarpSuccess = false;
+    // Wait for the launched simulations; a script which only launches simulations has nothing more to run
+    if (runs.size() > 0) {
+        runs.await_all();
+        if (ws.number_of_nodes() == 0) {
+            std::cout << "\nALL " << runs.size() << " LAUNCHED SIMULATIONS HAVE FINISHED.\n";
+            return std::make_pair(false, 0);
         }
-        
-        // Start Yarp communication
-        if (!comm.yarpThread->startThread()) {
-            std::cerr << "ERROR: could not start Yarp communication thread." << std::endl;
-            if (create_yarp) {
-                // Delete the YARP thread here because we created it
-                delete comm.yarpThread;
-                comm.yarpThread = nullptr;
-            }
-            yarpSuccess = false;
-        }
-        
-        if (!yarpSuccess) {
-            // Delete the MQTT thread if it's already started
-#ifdef OBNSIM_COMM_MQTT
-            if (comm.mqttClient != nullptr) {
-                comm.mqttClient->stop();
-                delete comm.mqttClient;
-                comm.mqttClient = nullptr;
-            }
-#endif
-            return std::make_pair(false, 5);
-        }
-#else
-        std::cerr << "ERROR: YARP communication is not supported in this SMN." << std::endl;
-        return std::make_pair(false, 5);
-#endif
     }
     
-    if (ws.is_comm_protocol_used(SMNChai::COMM_MQTT)) {
-        // Create and Open MQTT port
-        // If fail, remember to also shut down Yarp if necessary (shutdown_communication_threads)
-#ifdef OBNSIM_COMM_MQTT
-        // Start MQTT communication
-        if (!ws.start_mqtt_client()) {
-            std::cerr << "ERROR: could not start MQTT communication thread." << std::endl;
-#ifdef OBNSIM_COMM_YARP
-            // Shut down Yarp
-            if (comm.yarpThread) {
-                shutdown_communication_threads(gc);
-                if (create_yarp) {
-                    delete comm.yarpThread;
-                    comm.yarpThread = nullptr;
-                }
-            }
-#endif
-            // Delete the MQTT client
-            if (comm.mqttClient != nullptr) {
-                delete comm.mqttClient;
-                comm.mqttClient = nullptr;
-            }
-            return std::make_pair(false, 5);
-        }
-#else
-        std::cerr << "Error: MQTT communication is not supported in this SMN." << std::endl;
-#ifdef OBNSIM_COMM_YARP
-        if (comm.yarpThread) {
-            shutdown_communication_threads(gc);
-            if (create_yarp) {
-                delete comm.yarpThread;
-                comm.yarpThread = nullptr;
-            }
-        }
-#endif
-        return std::make_pair(false, 5);
-#endif
-    }
-#ifdef OBNSIM_COMM_MQTT
-    else if (comm.mqttClient) {
-        comm.mqttClient->stop();
-        delete comm.mqttClient;
-    }
-#endif
-
-#ifdef OBNSIM_COMM_MQTT
-    if (comm.mqttClient && ws.m_tracking_mqtt_online_nodes) {
-        // The MQTT client is running and may be tracking nodes' availability -> stop tracking
-        comm.mqttClient->stopListeningForArrivals();
-        ws.m_tracking_mqtt_online_nodes = false;
+    
+    if (!simulation_to_run(ws, sys_settings)) {
+        return std::make_pair(false, 0);
     }
-#endif
     
-    try {
-        ws.generate_obn_system(gc, comm);
-    } catch (SMNChai::smnchai_exception const &e) {
-        std::cerr << "ERROR: " << e.what() << std::endl;
-        
-        // As the communication thread(s) already started, we try to signal them to stop
-        shutdown_communication_threads(gc);
-        
-        // Delete them if we created them before
-#ifdef OBNSIM_COMM_YARP
-        if (comm.yarpThread && create_yarp) {
-            delete comm.yarpThread;
-            comm.yarpThread = nullptr;
-        }
-#endif
-#ifdef OBNSIM_COMM_MQTT
-        if (comm.mqttClient) {
-            comm.mqttClient->stop();
-            delete comm.mqttClient;
-            comm.mqttClient = nullptr;
-        }
-#endif
-        
-        return std::make_pair(false, 6);
+    // If the script has run the simulation itself, terminate the nodes that it kept running for warm restarts; there is nothing more to run
+    if (network_constructed) {
+        gc.terminateNodes();
+        shutdown_communication_threads(gc, comm);
+        std::cout << "\nTHE SCRIPT HAS RUN THE SIMULATION " << warm_runs << " TIME(S).\n";
+        return std::make_pair(false, 0);
     }
     
-    return std::make_pair(true, 0);
-}
\ No newline at end of file
+    return construct_network(ws, gc, comm);
+}
@@ -0,0 +1,169 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Run several simulations concurrently in one SMNChai process.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <chrono>
+#include <atomic>
+#include <unordered_set>
+#include <boost/filesystem.hpp>     // manipulate paths
+
+#include "smnchai_runs.h"
+
+using namespace SMNChai;
+
+namespace {
+    // Numbers the default workspaces of all simulations in this process, so that they are unique
+    std::atomic<unsigned int> run_counter{0};
+    
+    // The GCs of the running simulations of all managers, for terminate_all()
+    std::mutex running_gcs_mutex;
+    std::unordered_set<OBNsmn::GCThread*> running_gcs;
+}
+
+
+RunManager::RunManager(WorkSpace& t_ws, SMNChaiComm& t_comm, const SystemSettings& t_sys): m_ws(t_ws), m_comm(t_comm), m_sys(t_sys) {
+    // Only the launching script writes the Docker node list and the workspace cache
+    m_sys.dockerlist = false;
+    m_sys.dockerlistfile.clear();
+    m_sys.cachefile.clear();
+}
+
+RunManager::~RunManager() {
+    await_all();
+}
+
+
+int RunManager::launch(const std::string& t_script, const std::map<std::string, chaiscript::Boxed_Value>& t_args) {
+    boost::filesystem::path script_file(t_script);
+    if (!boost::filesystem::exists(script_file) || !boost::filesystem::is_regular_file(script_file)) {
+        throw smnchai_exception("The script file " + t_script + " of the simulation to launch does not exist.");
+    }
+    
+    std::unique_lock<std::mutex> mylock(m_mutex);
+    if (m_max_concurrent > 0) {
+        m_finished.wait(mylock, [this](){ return m_active < m_max_concurrent; });
+    }
+    
+    std::unique_ptr<Run> run(new Run);
+    run->script = t_script;
+    run->args = t_args;
+    run->result.workspace = script_file.stem().string() + "_run" + std::to_string(run_counter++);
+    
+    ++m_active;
+    Run& theRun = *run;
+    m_runs.push_back(std::move(run));
+    theRun.thread = std::thread(&RunManager::run_main, this, std::ref(theRun));
+    
+    return m_runs.size() - 1;
+}
+
+
+int RunManager::await(int t_run) {
+    if (t_run < 0 || std::size_t(t_run) >= m_runs.size()) {
+        throw smnchai_exception("Simulation " + std::to_string(t_run) + " does not exist.");
+    }
+    
+    auto& run = *m_runs[t_run];
+    int code;
+    {
+        std::unique_lock<std::mutex> mylock(m_mutex);
+        m_finished.wait(mylock, [&run](){ return run.result.finished; });
+        code = run.result.code;
+    }
+    
+    if (run.thread.joinable()) {
+        run.thread.join();
+    }
+    return code;
+}
+
+
+void RunManager::await_all() {
+    for (std::size_t k = 0; k < m_runs.size(); ++k) {
+        await(k);
+    }
+}
+
+
+RunResult RunManager::result(int t_run) {
+    if (t_run < 0 || std::size_t(t_run) >= m_runs.size()) {
+        throw smnchai_exception("Simulation " + std::to_string(t_run) + " does not exist.");
+    }
+    
+    std::lock_guard<std::mutex> mylock(m_mutex);
+    return m_runs[t_run]->result;
+}
+
+
+void RunManager::terminate_all() {
+    std::lock_guard<std::mutex> mylock(running_gcs_mutex);
+    for (auto gc: running_gcs) {
+        gc->setSysRequest(OBNsmn::GCThread::SYSREQ_TERMINATE);
+    }
+}
+
+
+#ifdef OBNSIM_COMM_MQTT
+OBNsmn::MQTT::MQTTClient* RunManager::shared_mqtt_client() {
+    std::lock_guard<std::mutex> mylock(m_mqtt_mutex);
+    return m_ws.start_mqtt_client()?m_comm.mqttClient:nullptr;
+}
+#endif
+
+
+void RunManager::run_main(Run& t_run) {
+    auto start = std::chrono::steady_clock::now();
+    
+    OBNsmn::GCThread gc;
+    SMNChaiComm comm;
+#ifdef OBNSIM_COMM_MQTT
+    comm.sharedMqttClient = [this]() { return shared_mqtt_client(); };
+#endif
+    
+    {
+        std::lock_guard<std::mutex> mylock(running_gcs_mutex);
+        running_gcs.insert(&gc);
+    }
+    
+    int code = 0;
+    try {
+        auto load_script_result = smnchai_loadscript(t_run.script, t_run.args, t_run.result.workspace, gc, comm, m_sys);
+        if (!load_script_result.first) {
+            code = load_script_result.second;
+        } else if (gc.startThread()) {
+            OBNsmn::report_info(0, "Simulation " + t_run.result.workspace + " started.");
+            gc.joinThread();
+        } else {
+            OBNsmn::report_error(0, "Could not start the GC thread of simulation " + t_run.result.workspace + ".");
+            code = 1;
+        }
+    } catch (const std::exception &e) {
+        OBNsmn::report_error(0, "Simulation " + t_run.result.workspace + " failed: " + e.what());
+        code = 1;
+    }
+    
+    {
+        std::lock_guard<std::mutex> mylock(running_gcs_mutex);
+        running_gcs.erase(&gc);
+    }
+    
+    shutdown_communication_threads(gc, comm);
+    comm.joinThreads();
+    comm.deleteObjects();
+    
+    std::lock_guard<std::mutex> mylock(m_mutex);
+    t_run.result.finished = true;
+    t_run.result.code = code;
+    if (gc.currentSimulationTime() > 0) {
+        t_run.result.sim_time = double(gc.currentSimulationTime()) * double(gc.simulationTimeUnit());
+    }
+    t_run.result.wall_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    --m_active;
+    m_finished.notify_all();
+}
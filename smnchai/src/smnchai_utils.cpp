@@ -9,6 +9,8 @@
  */
 
 #include <cstdlib>
+#include <sstream>
+#include <cstring>
 #include <smnchai_api.h>
 #include <csvparser/csvparser.h>  // Read CSV files
 #include <smnchai_utils.h>
@@ -98,6 +100,72 @@ SMNChai::APIUtils::TChaiVector SMNChai::APIUtils::load_csv_into_chai(const std::
     return v;
 }
 
+std::vector< std::vector<std::string> > SMNChai::APIUtils::load_csv_table(const std::string& t_file,
+                                                                         const std::string& t_delimiter,
+                                                                         bool t_header)
+{
+    CsvParser *csvparser = CsvParser_new(t_file.c_str(), t_delimiter.empty()?NULL:t_delimiter.c_str(), t_header);
+    
+    if (t_header && CsvParser_getHeader(csvparser) == NULL) {
+        std::string msg(CsvParser_getErrorMessage(csvparser));
+        CsvParser_destroy(csvparser);
+        throw smnchai_exception("Could not read the CSV file " + t_file + ": " + msg);
+    }
+    
+    std::vector< std::vector<std::string> > table;
+    CsvRow *row;
+    while ((row = CsvParser_getRow(csvparser)) ) {
+        char **rowFields = CsvParser_getFields(row);
+        int n = CsvParser_getNumFields(row);
+        if (n > 0) {
+            table.emplace_back(rowFields, rowFields + n);
+        }
+        CsvParser_destroy_row(row);
+    }
+    
+    // A file which can't be read is only reported by the error message of the parser, which is otherwise "Reached EOF"
+    const char *error = CsvParser_getErrorMessage(csvparser);
+    std::string msg = (error && std::strcmp(error, "Reached EOF") != 0)?error:"";
+    CsvParser_destroy(csvparser);
+    if (!msg.empty()) {
+        throw smnchai_exception("Could not read the CSV file " + t_file + ": " + msg);
+    }
+    return table;
+}
+
+std::vector< std::vector<std::string> > SMNChai::APIUtils::table_from_chai(const TChaiVector& t_rows)
+{
+    std::vector< std::vector<std::string> > table;
+    table.reserve(t_rows.size());
+    for (const auto& row_value: t_rows) {
+        if (!row_value.is_type(chaiscript::user_type<TChaiVector>())) {
+            throw smnchai_exception("Each row of a table must be a Vector.");
+        }
+        const auto& row = chaiscript::boxed_cast<const TChaiVector&>(row_value);
+        
+        table.emplace_back();
+        auto& cells = table.back();
+        cells.reserve(row.size());
+        for (const auto& cell: row) {
+            if (cell.is_type(chaiscript::user_type<std::string>())) {
+                cells.push_back(chaiscript::boxed_cast<const std::string&>(cell));
+            } else if (cell.is_type(chaiscript::user_type<int>())) {
+                cells.push_back(std::to_string(chaiscript::boxed_cast<int>(cell)));
+            } else if (cell.is_type(chaiscript::user_type<long>())) {    // Integers loaded by load_csv_into_chai()
+                cells.push_back(std::to_string(chaiscript::boxed_cast<long>(cell)));
+            } else if (cell.is_type(chaiscript::user_type<double>())) {
+                std::ostringstream ss;
+                ss.precision(17);
+                ss << chaiscript::boxed_cast<double>(cell);
+                cells.push_back(ss.str());
+            } else {
+                throw smnchai_exception("Each cell of a table must be a string or a number.");
+            }
+        }
+    }
+    return table;
+}
+
 chaiscript::ModulePtr SMNChai::APIUtils::smnchai_api_utils_math(chaiscript::ModulePtr m)
 {
     using namespace chaiscript::extras::math;
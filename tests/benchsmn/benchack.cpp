@@ -0,0 +1,135 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Stress test and benchmark of the GC's ACK accounting.
+ *
+ * In each simulated step, the GC starts a wait-for for all nodes, and several communication threads send the ACKs of the nodes (each node's ACK is sent twice, to exercise duplicates).
+ * The stress test checks that each step completes exactly once, after all ACKs.
+ * The benchmark compares the lock-free AckTracker with the previous accounting (mutex, std::vector<bool>, counter, std::function predicate).
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include <obnsmn_acktracker.h>
+
+using namespace OBNsmn;
+
+const int ACK_TYPE = 0x0101;
+
+/** The previous ACK accounting of the GC, protected by a mutex. */
+struct MutexAcks {
+    std::mutex mut;
+    std::vector<bool> bits;
+    int num = 0;
+    int type = 0;
+    bool active = false;
+    std::function<bool (int)> predicate;
+
+    void begin(int t, std::size_t n) {
+        std::lock_guard<std::mutex> lock(mut);
+        bits.assign(n, false);
+        num = n;
+        type = t;
+        active = true;
+        predicate = [](int) { return true; };
+    }
+
+    /** \return true if this ACK completes the wait-for. */
+    bool acknowledge(int id, int t) {
+        std::lock_guard<std::mutex> lock(mut);
+        if (!active || t != type) { return false; }
+        if (predicate && !predicate(id)) { return false; }
+        if (!bits[id]) {
+            bits[id] = true;
+            if (--num == 0) {
+                active = false;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/** Run the steps: the GC (this thread) starts a wait-for, the comm threads acknowledge, the GC waits for completion.
+ \return Wall-clock duration in microseconds per step, or a negative value if a step did not complete exactly once.
+ */
+template <typename Begin, typename Ack>
+double runSteps(int threads, int nodes, int steps, Begin begin, Ack ack) {
+    std::atomic<int> step(-1);          // Current step, published by the GC
+    std::atomic<int> completed(0);      // Number of completions of the current step
+    std::atomic<int> finished(0);       // Number of (thread, step) pairs whose ACKs have all been sent
+    std::atomic<bool> bad(false);
+
+    std::vector<std::thread> comm;
+    for (int p = 0; p < threads; ++p) {
+        comm.emplace_back([&, p]() {
+            for (int s = 0; s < steps; ++s) {
+                while (step.load() < s) { std::this_thread::yield(); }
+                // Each thread acknowledges its share of the nodes, twice
+                for (int r = 0; r < 2; ++r) {
+                    for (int id = p; id < nodes; id += threads) {
+                        if (ack(id)) { completed.fetch_add(1); }
+                    }
+                }
+                finished.fetch_add(1);
+            }
+        });
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; ++s) {
+        completed.store(0);
+        begin();
+        step.store(s);
+        while (completed.load() == 0) { std::this_thread::yield(); }
+        // Wait for the remaining (duplicate) ACKs of this step before checking it and starting the next one
+        while (finished.load() < threads * (s + 1)) { std::this_thread::yield(); }
+        if (completed.load() != 1) { bad = true; }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (auto& t: comm) { t.join(); }
+
+    return bad?-1.0:std::chrono::duration<double, std::micro>(t1 - t0).count() / steps;
+}
+
+int main(int argc, char **argv) {
+    const int steps = 200;
+    bool allOK = true;
+
+    std::cout << "ACK accounting benchmark (" << steps << " steps, all nodes acknowledge twice per step)" << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(8) << "nodes" << std::setw(18) << "mutex (us/step)" << std::setw(20) << "lock-free (us/step)" << std::setw(10) << "speedup" << std::endl;
+    for (int threads: {1, 4}) {
+        for (int nodes: {1000, 10000}) {
+            MutexAcks m;
+            double r1 = runSteps(threads, nodes, steps,
+                                 [&]() { m.begin(ACK_TYPE, nodes); },
+                                 [&](int id) { return m.acknowledge(id, ACK_TYPE); });
+
+            AckTracker a;
+            a.resize(nodes);
+            double r2 = runSteps(threads, nodes, steps,
+                                 [&]() { a.begin(ACK_TYPE); a.expectAll(); },
+                                 [&](int id) { return a.acknowledge(id, ACK_TYPE) == AckTracker::COMPLETED; });
+
+            std::cout << std::setw(8) << threads << std::setw(8) << nodes << std::setw(18) << std::fixed << std::setprecision(1) << r1
+            << std::setw(20) << r2 << std::setw(9) << r1 / r2 << 'x';
+            if (r1 < 0 || r2 < 0) {
+                std::cout << "  FAILED";
+                allOK = false;
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    return allOK?0:1;
+}
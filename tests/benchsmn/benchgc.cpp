@@ -0,0 +1,942 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Test of the GC's dispatch options with simulated nodes, counting the messages sent by the GC.
+ *
+ * The GC runs a system of fast source nodes (period 1), each feeding a slow consumer (period 10) with direct feedthrough, and of free-running source nodes (period 3) without consumers.
+ * The nodes are simulated by a "network" thread, which executes the GC's messages in order and ACKs them.
+ * For each combination of dispatch options, the test checks that every node performs all its updates (UPDATE_Y and UPDATE_X) in order,
+ * and that each consumer sees the output of its source at the current time, then reports the number of messages sent by the GC.
+ * The simulated nodes receive the broadcast messages as frames (see SMN2NFrame), which are parsed by the default OBNNode::sendFrame().
+ * Optionally, the nodes with the same periods form node groups (see OBNNodeGroup), and all nodes form the broadcast group; a message to a group is counted once.
+ * Fusing UPDATE_X into UPDATE_Y (SIM_YX) must not send more messages than without, with or without node groups.
+ *
+ * With a lossy network, which drops every n-th message and ACK, the GC retransmits the lost messages on ACK timeouts (see GCThread::ack_retries) and the simulated nodes discard duplicates by their sequence numbers, re-sending their ACKs.
+ *
+ * The same system is also run hierarchically: the source/consumer pairs are split among sub-coordinators (see GCThread::addSubCoordinator()), while the free sources stay at the root GC.
+ * Half of the consumers are in the partition next to their sources', so the partitions depend on each other in both directions through their gates (see PartitionGates).
+ * The nodes must perform the same updates, and receive the same messages, as with a single GC; the root GC must send the same number of messages with twice as many pairs, i.e. it only depends on the number of partitions.
+ *
+ * Finally, the system is split into independent components, each run by its own GC in parallel (see GCThread::addComponent()), with the same checks.
+ *
+ * The system is run several times with the nodes kept running between the runs (warm restart, see GCThread::keep_nodes_running),
+ * and with a checkpoint from which a new GC with new nodes resumes the simulation (see GCThread::setCheckpoint()); the resumed nodes must perform the same updates as after the checkpoint.
+ *
+ * Before a simulation, the ports of the nodes are connected with one request per connection (GCThread::request_port_connect()) and with one batch per node (GCThread::request_port_connect_batch()), over a network with latency;
+ * the results of the connections are checked and the times are compared.
+ *
+ * The test also checks the frames against messages serialized in full, and compares the time to serialize a broadcast message for each node with serializing it once in a frame.
+ *
+ * Each of these features is checked by its own test function, and the result of each test is summarized at the end.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <obnsmn_gc.h>
+#include <obnsmn_report.h>
+
+using namespace OBNsmn;
+
+std::size_t numWarnings = 0;    ///< Number of warnings reported (e.g. retransmissions), not printed
+
+void OBNsmn::report_error(int code, std::string msg) {
+    std::cerr << "ERROR: " << msg << std::endl;
+}
+
+void OBNsmn::report_warning(int code, std::string msg) {
+    ++numWarnings;
+}
+
+void OBNsmn::report_info(int code, std::string msg) {
+}
+
+/** The simulated network: a queue of messages from the GC, executed in order by one thread. */
+class SimNetwork {
+public:
+    std::mutex mut;
+    std::condition_variable cond;
+    std::deque< std::pair<int, OBNSimMsg::SMN2N> > queue;
+    std::deque< std::chrono::steady_clock::time_point > sendTimes;     ///< When the messages in the queue were sent
+    bool done = false;
+
+    std::chrono::microseconds latency{0};           ///< Delay of every message from the GC to a node; messages sent together are delayed together
+
+    std::size_t numMessages = 0;                    ///< Number of messages sent by the GC
+    int numRootNodes = 0;                           ///< The nodes with lower IDs are run by the root GC (see runHierarchical())
+    std::size_t numRootMessages = 0;                ///< Number of messages sent to these nodes
+    std::vector<OBNsim::UpdateList> ylog, xlog;     ///< Updates performed by each node
+    std::vector<int> source;                        ///< The source of each node, or -1
+    bool ok = true;
+
+    unsigned int lossEvery = 0;                     ///< If positive, every lossEvery-th message or ACK is lost
+    std::size_t numDelivered = 0, numLost = 0;
+    std::vector<int64_t> lastSeq;                   ///< Sequence number of the last message received by each node
+    std::vector<OBNSimMsg::N2SMN> lastAck;          ///< The last ACK with a sequence number sent by each node
+    std::vector<std::string> loaded;                ///< The state restored by each node from a checkpoint
+
+    void push(int id, const OBNSimMsg::SMN2N& msg) {
+        std::lock_guard<std::mutex> lock(mut);
+        ++numMessages;
+        numRootMessages += id < numRootNodes;
+        queue.emplace_back(id, msg);
+        sendTimes.push_back(std::chrono::steady_clock::now());
+        cond.notify_one();
+    }
+
+    /** Push a message sent once to several nodes. */
+    void push(const std::vector<int>& ids, const OBNSimMsg::SMN2N& msg) {
+        std::lock_guard<std::mutex> lock(mut);
+        ++numMessages;
+        for (auto id: ids) {
+            queue.emplace_back(id, msg);
+            sendTimes.push_back(std::chrono::steady_clock::now());
+        }
+        cond.notify_one();
+    }
+
+    /** Execute the messages until stopped. */
+    void run(GCThread& gc) {
+        while (true) {
+            std::pair<int, OBNSimMsg::SMN2N> item;
+            std::chrono::steady_clock::time_point sendTime;
+            {
+                std::unique_lock<std::mutex> lock(mut);
+                cond.wait(lock, [this]() { return !queue.empty() || done; });
+                if (queue.empty()) { return; }
+                item = std::move(queue.front());
+                queue.pop_front();
+                sendTime = sendTimes.front();
+                sendTimes.pop_front();
+            }
+            if (latency.count() > 0) {
+                std::this_thread::sleep_until(sendTime + latency);
+            }
+
+            int id = item.first;
+            const auto& msg = item.second;
+            if (lost()) {
+                continue;
+            }
+            // Duplicates are discarded, but the ACK of the last message is re-sent (see NodeBase::postEvent())
+            if (msg.has_seq()) {
+                auto seq = msg.seq();
+                if (seq == lastSeq[id] || (seq < lastSeq[id] && msg.msgtype() != OBNSimMsg::SMN2N_MSGTYPE_SIM_INIT)) {
+                    if (seq == lastSeq[id] && lastAck[id].seq() == seq && !lost()) {
+                        gc.pushNodeEvent(lastAck[id], id);
+                    }
+                    continue;
+                }
+                lastSeq[id] = seq;
+            }
+            // Messages to a group must not have an ID; messages to a node must have its ID
+            if (msg.msgtype() != OBNSimMsg::SMN2N_MSGTYPE_SIM_INIT && msg.has_id() && msg.id() != id) {
+                ok = false;
+            }
+            OBNSimMsg::N2SMN ack;
+            ack.set_id(id);
+            switch (msg.msgtype()) {
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_INIT:
+                    ack.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SIM_INIT_ACK);
+                    break;
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_Y:
+                    updateY(id, msg.time(), msg.i());
+                    ack.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SIM_Y_ACK);
+                    break;
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_YX:
+                    updateY(id, msg.time(), msg.i());
+                    xlog[id].emplace_back(msg.time(), msg.data().i());
+                    ack.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SIM_Y_ACK);
+                    break;
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_YW: {
+                    OBNsim::UpdateList window;
+                    if (!OBNsim::Utils::decodeUpdateList(msg.data().b(), window) || window.empty() || window.front().first != msg.time()) {
+                        ok = false;
+                    }
+                    for (const auto& update: window) {
+                        updateY(id, update.first, update.second);
+                        xlog[id].push_back(update);
+                    }
+                    ack.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SIM_Y_ACK);
+                    break;
+                }
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_X:
+                    xlog[id].emplace_back(msg.time(), msg.i());
+                    ack.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SIM_X_ACK);
+                    break;
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_SAVE:
+                    // The state of a node is the number of updates it has performed
+                    ack.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SIM_SAVE_ACK);
+                    ack.mutable_data()->set_b(std::to_string(ylog[id].size()));
+                    break;
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_LOAD:
+                    loaded[id] = msg.data().b();
+                    ack.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SIM_LOAD_ACK);
+                    break;
+                case OBNSimMsg::SMN2N_MSGTYPE_SYS_PORT_CONNECT: {
+                    // Every node has only the input port "u"
+                    ack.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SYS_PORT_CONNECT_ACK);
+                    auto result = connectPort(msg.data().i(), msg.data().b());
+                    if (result != 0) {
+                        ack.mutable_data()->set_i(result);
+                    }
+                    break;
+                }
+                case OBNSimMsg::SMN2N_MSGTYPE_SYS_PORT_CONNECT_BATCH: {
+                    OBNsim::IntStringList connections;
+                    if (!OBNsim::Utils::decodeIntStringList(msg.data().b(), connections)) {
+                        ok = false;
+                    }
+                    for (auto& conn: connections) {
+                        conn.first = connectPort(conn.first, conn.second);
+                        conn.second.clear();
+                    }
+                    ack.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SYS_PORT_CONNECT_BATCH_ACK);
+                    ack.mutable_data()->set_t(msg.i());
+                    OBNsim::Utils::encodeIntStringList(connections, *ack.mutable_data()->mutable_b());
+                    break;
+                }
+                default:
+                    continue;
+            }
+            if (msg.has_seq()) {
+                ack.set_seq(msg.seq());
+                lastAck[id] = ack;
+            }
+            if (!lost()) {
+                gc.pushNodeEvent(ack, id);
+            }
+        }
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> lock(mut);
+        done = true;
+        cond.notify_one();
+    }
+
+private:
+    /** Whether the next message or ACK is lost. */
+    bool lost() {
+        if (lossEvery > 0 && ++numDelivered % lossEvery == 0) {
+            ++numLost;
+            return true;
+        }
+        return false;
+    }
+
+    /** Connect a port, given as (I, B) of SYS_PORT_CONNECT. \return the result code of SYS_PORT_CONNECT_ACK. */
+    int connectPort(int64_t i, const std::string& names) {
+        if (i <= 0 || names.size() <= static_cast<std::size_t>(i)) {
+            return -3;
+        }
+        return (names.compare(0, i, "u") == 0)?0:-1;
+    }
+
+    void updateY(int id, OBNsim::simtime_t t, OBNsim::updatemask_t m) {
+        ylog[id].emplace_back(t, m);
+        // The source must have been updated at the current time
+        if (source[id] >= 0 && (ylog[source[id]].empty() || ylog[source[id]].back().first != t)) {
+            ok = false;
+        }
+    }
+};
+
+/** A node simulated by the network. */
+class SimNode: public OBNNode {
+    SimNetwork& m_net;
+public:
+    SimNode(const std::string& name, OBNsim::simtime_t period, SimNetwork& net): OBNNode(name, 1), m_net(net) {
+        setUpdateType(0, period);
+    }
+    virtual bool sendMessage(int nodeID, OBNSimMsg::SMN2N &msg) override {
+        m_net.push(nodeID, msg);
+        return true;
+    }
+};
+
+/** A group of nodes simulated by the network. */
+class SimGroup: public OBNNodeGroup {
+    SimNetwork& m_net;
+    std::vector<int> m_members;
+public:
+    SimGroup(const std::vector<int>& members, SimNetwork& net): m_net(net), m_members(members) { }
+    virtual bool sendFrame(const SMN2NFrame &frame) override {
+        OBNSimMsg::SMN2N msg;
+        if (!frame.getMessage(msg) || msg.has_id()) {
+            m_net.ok = false;
+        }
+        m_net.push(m_members, msg);
+        return true;
+    }
+};
+
+/** Build the system of source/consumer pairs and free sources in a GC, with the nodes simulated by a network. \return the periods of the nodes. */
+std::vector<OBNsim::simtime_t> buildSystem(GCThread& gc, SimNetwork& net, int numPairs, int numFree) {
+    std::vector<OBNsim::simtime_t> periods;
+
+    // Nodes 2k and 2k+1 are a fast source and its slow consumer, then come the free-running sources
+    for (int k = 0; k < numPairs; ++k) {
+        periods.push_back(1);
+        periods.push_back(10);
+        net.source.push_back(-1);
+        net.source.push_back(2*k);
+    }
+    for (int k = 0; k < numFree; ++k) {
+        periods.push_back(3);
+        net.source.push_back(-1);
+    }
+    int numNodes = periods.size();
+    for (int k = 0; k < numNodes; ++k) {
+        gc.insertNode(new SimNode("node" + std::to_string(k), periods[k], net));
+    }
+    net.ylog.resize(numNodes);
+    net.xlog.resize(numNodes);
+    net.lastSeq.assign(numNodes, 0);
+    net.lastAck.resize(numNodes);
+    net.loaded.resize(numNodes);
+
+    auto *graph = new NodeDepGraph_CSR(numNodes);
+    for (int k = 0; k < numPairs; ++k) {
+        graph->addDependency(2*k, 2*k+1, 1, 1);
+        gc.enableLookahead(2*k, std::vector<int>{2*k+1});
+    }
+    for (int k = 2*numPairs; k < numNodes; ++k) {
+        gc.enableLookahead(k, std::vector<int>());
+    }
+    gc.setDependencyGraph(graph);
+    return periods;
+}
+
+/** The updates that a node of a given period must perform until the final time. */
+OBNsim::UpdateList expectedUpdates(OBNsim::simtime_t period, OBNsim::simtime_t finalTime) {
+    OBNsim::UpdateList expected;
+    for (OBNsim::simtime_t t = 0; t <= finalTime; t += period) {
+        expected.emplace_back(t, 1);
+    }
+    return expected;
+}
+
+/** Form node groups of the nodes with the same periods (sources, consumers, free sources), and the broadcast group of all nodes. */
+void addNodeGroups(GCThread& gc, SimNetwork& net, int numPairs, int numNodes) {
+    std::vector<int> all(numNodes), sources, consumers, free;
+    for (int k = 0; k < numNodes; ++k) {
+        all[k] = k;
+        (k >= 2*numPairs?free:(k % 2?consumers:sources)).push_back(k);
+    }
+    gc.setBroadcastGroup(new SimGroup(all, net));
+    for (const auto& members: {sources, consumers, free}) {
+        gc.addNodeGroup(new SimGroup(members, net), members);
+    }
+}
+
+/** Set the final time and the dispatch options of a GC. */
+void setDispatchOptions(GCThread& gc, OBNsim::simtime_t finalTime, bool fuse, bool lookahead, bool dataflow) {
+    gc.setSimulationTimeUnit(1);
+    gc.setFinalSimulationTime(finalTime);
+    gc.fuse_update_x = fuse;
+    gc.lookahead = lookahead;
+    gc.dataflow_dispatch = dataflow;
+}
+
+/** Run the GC once with the network, then check that each node has performed all its updates, in order. \return true if the check passes. */
+bool runOnce(GCThread& gc, SimNetwork& net, const std::vector<OBNsim::simtime_t>& periods, OBNsim::simtime_t finalTime) {
+    std::thread netThread([&]() { net.run(gc); });
+    gc.startThread();
+    gc.joinThread();
+    net.stop();
+    netThread.join();
+
+    for (std::size_t k = 0; k < periods.size(); ++k) {
+        auto expected = expectedUpdates(periods[k], finalTime);
+        if (net.ylog[k] != expected || net.xlog[k] != expected) {
+            net.ok = false;
+        }
+    }
+    return net.ok;
+}
+
+/** Run a simulation with given dispatch options, optionally with node groups.
+ \return the number of messages, or 0 if the check fails. */
+std::size_t runSimulation(int numPairs, int numFree, OBNsim::simtime_t finalTime, bool fuse, bool lookahead, bool dataflow, bool groups) {
+    SimNetwork net;
+    GCThread gc;
+    auto periods = buildSystem(gc, net, numPairs, numFree);
+    if (groups) {
+        addNodeGroups(gc, net, numPairs, periods.size());
+    }
+    setDispatchOptions(gc, finalTime, fuse, lookahead, dataflow);
+    return runOnce(gc, net, periods, finalTime)?net.numMessages:0;
+}
+
+/** Run a simulation over a network that loses every lossEvery-th message or ACK, which the GC must retransmit.
+ \param lost Receives the number of lost messages and ACKs.
+ \return the number of messages, or 0 if the check fails. */
+std::size_t runLossy(int numPairs, int numFree, OBNsim::simtime_t finalTime, bool fuse, bool lookahead, bool dataflow, bool groups, unsigned int lossEvery, std::size_t& lost) {
+    SimNetwork net;
+    net.lossEvery = lossEvery;
+    GCThread gc;
+    auto periods = buildSystem(gc, net, numPairs, numFree);
+    if (groups) {
+        addNodeGroups(gc, net, numPairs, periods.size());
+    }
+    setDispatchOptions(gc, finalTime, fuse, lookahead, dataflow);
+    // Short timeouts: a spurious retransmission is harmless
+    gc.ack_timeout = 2;
+    gc.ack_retries = 10;
+
+    bool ok = runOnce(gc, net, periods, finalTime);
+    lost = net.numLost;
+    return ok?net.numMessages:0;
+}
+
+/** Run a simulation several times with the nodes kept running between the runs, then terminate the nodes.
+ \return the number of messages of all runs, or 0 if the check fails. */
+std::size_t runWarmRestart(int numPairs, int numFree, OBNsim::simtime_t finalTime, bool dataflow, int runs) {
+    SimNetwork net;
+    GCThread gc;
+    auto periods = buildSystem(gc, net, numPairs, numFree);
+    int numNodes = periods.size();
+    setDispatchOptions(gc, finalTime, false, false, dataflow);
+    gc.keep_nodes_running = true;
+
+    std::thread netThread([&]() { net.run(gc); });
+    for (int r = 0; r < runs; ++r) {
+        for (int k = 0; k < numNodes; ++k) {
+            net.ylog[k].clear();
+            net.xlog[k].clear();
+        }
+        gc.startThread();
+        gc.joinThread();
+        if (!gc.nodesKeptRunning()) {
+            net.ok = false;
+        }
+        for (int k = 0; k < numNodes; ++k) {
+            auto expected = expectedUpdates(periods[k], finalTime);
+            if (net.ylog[k] != expected || net.xlog[k] != expected) {
+                net.ok = false;
+            }
+        }
+    }
+    if (!gc.terminateNodes()) {
+        net.ok = false;
+    }
+    net.stop();
+    netThread.join();
+    return net.ok?net.numMessages:0;
+}
+
+/** Run the system with the source/consumer pairs split among a given number of sub-coordinators.
+ The source of pair k is in partition k % numPartitions; its consumer is in the same partition for even k, and in the next partition (cyclically) for odd k,
+ so that the partitions depend on each other in both directions.
+ Node IDs: the proxies of the partitions, then the free sources (at the root), then the nodes of each partition.
+ \param rootMessages Receives the number of messages sent by the root GC, to its free sources and to the proxies of the partitions.
+ \return the number of messages to the nodes, or 0 if the check fails. */
+std::size_t runHierarchical(int numPairs, int numFree, OBNsim::simtime_t finalTime, int numPartitions, bool dataflow, double& elapsed, std::size_t& rootMessages) {
+    SimNetwork net;
+    GCThread gc;
+
+    // Global IDs (as in the dependency graph): the free sources, then the nodes of each partition, in the order of their pairs
+    std::vector<int> partitions(numFree, -1);
+    std::vector<OBNsim::simtime_t> periods(numFree, 3);
+    std::vector<int> sourceOf(numPairs), consumerOf(numPairs);
+    for (int p = 0; p < numPartitions; ++p) {
+        for (int k = 0; k < numPairs; ++k) {
+            if (k % numPartitions == p) {
+                sourceOf[k] = partitions.size();
+                partitions.push_back(p);
+                periods.push_back(1);
+            }
+            if ((k % numPartitions + k % 2) % numPartitions == p) {
+                consumerOf[k] = partitions.size();
+                partitions.push_back(p);
+                periods.push_back(10);
+            }
+        }
+    }
+    int numNodes = partitions.size();
+    NodeDepGraph_Partitioned graphs(partitions, [](std::size_t n) { return new NodeDepGraph_CSR(n); });
+    std::vector<int> source(numNodes, -1);
+    for (int k = 0; k < numPairs; ++k) {
+        graphs.addDependency(sourceOf[k], consumerOf[k], 1, 1);
+        source[consumerOf[k]] = sourceOf[k];
+    }
+
+    // The ID of a node in the messages is its global ID shifted by the proxies
+    net.source.assign(numPartitions, -1);
+    for (auto s: source) {
+        net.source.push_back((s >= 0)?(s + numPartitions):-1);
+    }
+    net.ylog.resize(numPartitions + numNodes);
+    net.xlog.resize(numPartitions + numNodes);
+    net.lastSeq.assign(numPartitions + numNodes, 0);
+    net.lastAck.resize(numPartitions + numNodes);
+
+    std::vector<GCThread*> subs;
+    for (int p = 0, first = numFree; p < numPartitions; ++p) {
+        auto *sub = new GCThread;
+        sub->setFirstNodeID(numPartitions + first);
+        for (std::size_t k = 0; k < graphs.partitionSize(p); ++k) {
+            sub->insertNode(new SimNode("node" + std::to_string(first + k), periods[first + k], net));
+        }
+        first += graphs.partitionSize(p);
+        sub->setDependencyGraph(graphs.releasePartitionGraph(p));
+        sub->setPartitionGates(graphs.partitionGates(p));
+        sub->dataflow_dispatch = dataflow;
+        gc.addSubCoordinator(sub, "partition" + std::to_string(p));
+        subs.push_back(sub);
+    }
+    for (int k = 0; k < numFree; ++k) {
+        gc.insertNode(new SimNode("node" + std::to_string(k), periods[k], net));
+    }
+    gc.setDependencyGraph(graphs.releaseRootGraph());
+    gc.setSimulationTimeUnit(1);
+    gc.setFinalSimulationTime(finalTime);
+    gc.dataflow_dispatch = dataflow;
+    net.numRootNodes = numPartitions + numFree;
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::thread netThread([&]() { net.run(gc); });
+    gc.startThread();
+    gc.joinThread();
+    net.stop();
+    netThread.join();
+    elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    for (int k = 0; k < numNodes; ++k) {
+        auto expected = expectedUpdates(periods[k], finalTime);
+        if (net.ylog[k + numPartitions] != expected || net.xlog[k + numPartitions] != expected) {
+            net.ok = false;
+        }
+    }
+
+    // The messages to the free sources are counted by the network
+    rootMessages = net.numRootMessages;
+    for (auto sub: subs) {
+        rootMessages += sub->numberOfParentMessages();
+    }
+    return net.ok?net.numMessages:0;
+}
+
+/** Run the system split into a given number of components, each with its share of the source/consumer pairs and of the free sources, run by parallel GCs.
+ Node IDs: the nodes of each component, pairs first.
+ \return the number of messages, or 0 if the check fails. */
+std::size_t runComponents(int numPairs, int numFree, OBNsim::simtime_t finalTime, int numComponents, bool dataflow, double& elapsed) {
+    SimNetwork net;
+    GCThread gc;
+    std::vector<OBNsim::simtime_t> periods;
+    
+    for (int c = 0; c < numComponents; ++c) {
+        auto *comp = new GCThread;
+        int first = periods.size();
+        comp->setFirstNodeID(first);
+        for (int k = c; k < numPairs; k += numComponents) {
+            periods.insert(periods.end(), {1, 10});
+            net.source.insert(net.source.end(), {-1, int(periods.size()) - 2});
+        }
+        for (int k = c; k < numFree; k += numComponents) {
+            periods.push_back(3);
+            net.source.push_back(-1);
+        }
+        int size = periods.size() - first;
+        auto *graph = new NodeDepGraph_CSR(size);
+        for (int k = 0; k < size; ++k) {
+            comp->insertNode(new SimNode("node" + std::to_string(first + k), periods[first + k], net));
+            if (net.source[first + k] >= 0) {
+                graph->addDependency(k-1, k, 1, 1);
+            }
+        }
+        comp->setDependencyGraph(graph);
+        comp->setSimulationTimeUnit(1);
+        comp->setFinalSimulationTime(finalTime);
+        comp->dataflow_dispatch = dataflow;
+        gc.addComponent(comp);
+    }
+    int numNodes = periods.size();
+    net.ylog.resize(numNodes);
+    net.xlog.resize(numNodes);
+    net.lastSeq.assign(numNodes, 0);
+    net.lastAck.resize(numNodes);
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::thread netThread([&]() { net.run(gc); });
+    gc.startThread();
+    gc.joinThread();
+    net.stop();
+    netThread.join();
+    elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    for (int k = 0; k < numNodes; ++k) {
+        auto expected = expectedUpdates(periods[k], finalTime);
+        if (net.ylog[k] != expected || net.xlog[k] != expected) {
+            net.ok = false;
+        }
+    }
+    return net.ok?net.numMessages:0;
+}
+
+/** Run the system with a checkpoint, then resume it from the checkpoint in a new GC with new nodes.
+ The resumed nodes must restore the states saved at the checkpoint, then perform the same updates as after the checkpoint in the first run.
+ \return the number of messages of the resumed run, or 0 if the check fails. */
+std::size_t runCheckpoint(int numPairs, int numFree, OBNsim::simtime_t finalTime, OBNsim::simtime_t checkpointTime, bool dataflow, const std::string& file) {
+    // Run the whole simulation, saving the checkpoint
+    SimNetwork net1;
+    GCThread gc1;
+    auto periods = buildSystem(gc1, net1, numPairs, numFree);
+    int numNodes = periods.size();
+    gc1.setSimulationTimeUnit(1);
+    gc1.setFinalSimulationTime(finalTime);
+    gc1.dataflow_dispatch = dataflow;
+    if (!gc1.setCheckpoint(checkpointTime, file)) {
+        return 0;
+    }
+    std::thread netThread1([&]() { net1.run(gc1); });
+    gc1.startThread();
+    gc1.joinThread();
+    net1.stop();
+    netThread1.join();
+
+    // Resume from the checkpoint
+    SimNetwork net2;
+    GCThread gc2;
+    buildSystem(gc2, net2, numPairs, numFree);
+    gc2.setSimulationTimeUnit(1);
+    gc2.setFinalSimulationTime(finalTime);
+    gc2.dataflow_dispatch = dataflow;
+    if (!gc2.setResumeFile(file)) {
+        return 0;
+    }
+    std::thread netThread2([&]() { net2.run(gc2); });
+    gc2.startThread();
+    gc2.joinThread();
+    net2.stop();
+    netThread2.join();
+    std::remove(file.c_str());
+
+    bool ok = net1.ok && net2.ok;
+    for (int k = 0; k < numNodes; ++k) {
+        auto after = std::find_if(net1.ylog[k].begin(), net1.ylog[k].end(), [checkpointTime](const OBNsim::UpdateList::value_type& u) { return u.first > checkpointTime; });
+        if (net2.loaded[k] != std::to_string(after - net1.ylog[k].begin()) ||
+            !std::equal(after, net1.ylog[k].end(), net2.ylog[k].begin()) || net2.ylog[k].size() != std::size_t(net1.ylog[k].end() - after) ||
+            net2.xlog[k] != net2.ylog[k]) {
+            ok = false;
+        }
+    }
+    return ok?net2.numMessages:0;
+}
+
+/** Connect the ports of the nodes before a simulation, with one request per connection or with one batch per node.
+ Every node has the input port "u", to which numConnections ports are connected, and the port "v", which does not exist; each message to a node is delayed by the latency.
+ \return true if the result of every connection is correct.
+ */
+bool runConnect(int numNodes, int numConnections, std::chrono::microseconds latency, bool batch, double& elapsed) {
+    SimNetwork net;
+    net.latency = latency;
+    GCThread gc;
+    for (int k = 0; k < numNodes; ++k) {
+        gc.insertNode(new SimNode("node" + std::to_string(k), 1, net));
+        net.source.push_back(-1);
+    }
+    net.ylog.resize(numNodes);
+    net.xlog.resize(numNodes);
+    net.lastSeq.assign(numNodes, 0);
+    net.lastAck.resize(numNodes);
+
+    std::vector<GCThread::PortConnectRequest> requests;
+    for (int k = 0; k < numNodes; ++k) {
+        for (int j = 0; j < numConnections; ++j) {
+            requests.push_back(GCThread::PortConnectRequest{std::size_t(k), "u", "node" + std::to_string((k+j+1) % numNodes) + "/y"});
+        }
+        requests.push_back(GCThread::PortConnectRequest{std::size_t(k), "v", "node0/y"});
+    }
+
+    std::thread netThread([&]() { net.run(gc); });
+    auto start = std::chrono::steady_clock::now();
+    std::vector< std::pair<int, std::string> > results;
+    if (batch) {
+        results = gc.request_port_connect_batch(requests);
+    } else {
+        for (const auto& request: requests) {
+            results.push_back(gc.request_port_connect(request.idx, request.target, request.source));
+        }
+    }
+    elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    net.stop();
+    netThread.join();
+
+    bool ok = net.ok && results.size() == requests.size();
+    for (std::size_t k = 0; ok && k < results.size(); ++k) {
+        ok = results[k].first == ((requests[k].target == "u")?0:-1);
+    }
+    return ok;
+}
+
+/** Connect ports of nodes that never ACK, with a system request (e.g. SYSREQ_STEP) pending, which is ignored because the simulation is not running.
+ \return true if every connection times out (-12) in about the timeout. */
+bool runConnectTimeout(GCThread::OBNSysRequestType sysreq, unsigned int timeout) {
+    // The network does not run, so the nodes never receive the requests
+    SimNetwork net;
+    GCThread gc;
+    std::vector<GCThread::PortConnectRequest> requests;
+    for (int k = 0; k < 2; ++k) {
+        gc.insertNode(new SimNode("node" + std::to_string(k), 1, net));
+        requests.push_back(GCThread::PortConnectRequest{std::size_t(k), "u", "node" + std::to_string(1-k) + "/y"});
+    }
+
+    gc.setSysRequest(sysreq);
+    auto start = std::chrono::steady_clock::now();
+    auto results = gc.request_port_connect_batch(requests, timeout);
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    bool ok = elapsed >= timeout && elapsed < 10.0 * timeout;
+    for (const auto& result: results) {
+        ok = ok && result.first == -12;
+    }
+    return ok;
+}
+
+/** Check the frames against full serialization and time both. \return The speedup, or 0 if the check fails. */
+double benchFrames(int numNodes, int rounds) {
+    OBNSimMsg::SMN2N msg;
+    msg.set_msgtype(OBNSimMsg::SMN2N_MSGTYPE_SIM_X);
+    msg.set_time(123456789);
+    SMN2NFrame frame;
+    if (!frame.setMessage(msg)) { return 0; }
+
+    // The frames must parse to the same messages, including negative values
+    for (int64_t I: {int64_t(0), int64_t(1), int64_t(300), int64_t(-1)}) {
+        for (int id: {0, 1, 127, 128, numNodes - 1}) {
+            OBNSimMsg::SMN2N expected(msg), parsed;
+            expected.set_id(id);
+            expected.set_i(I);
+            frame.setNode(id, &I);
+            if (!frame.getMessage(parsed) || parsed.SerializeAsString() != expected.SerializeAsString()) { return 0; }
+        }
+    }
+
+    std::string buffer;
+    std::size_t total1 = 0, total2 = 0;     // Keep the work from being optimized away
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (int id = 0; id < numNodes; ++id) {
+            msg.set_id(id);
+            msg.set_i(id & 0xF);
+            msg.SerializeToString(&buffer);
+            total1 += buffer.size();
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    msg.clear_id();
+    msg.clear_i();
+    for (int r = 0; r < rounds; ++r) {
+        frame.setMessage(msg);
+        for (int id = 0; id < numNodes; ++id) {
+            int64_t I = id & 0xF;
+            frame.setNode(id, &I);
+            total2 += frame.size();
+        }
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    if (total1 != total2) { return 0; }
+
+    double d1 = std::chrono::duration<double, std::micro>(t1 - t0).count() / rounds;
+    double d2 = std::chrono::duration<double, std::micro>(t2 - t1).count() / rounds;
+    std::cout << "Broadcast to " << numNodes << " nodes: " << std::fixed << std::setprecision(1) << d1 << " us serialized per node, " << d2 << " us with a frame" << std::endl;
+    return d1 / d2;
+}
+
+/** Print FAILED at the end of a row of a table if a check fails. \return ok */
+bool endRow(bool ok) {
+    if (!ok) {
+        std::cout << "  FAILED";
+    }
+    std::cout << std::endl;
+    return ok;
+}
+
+/** Each combination of the dispatch options sends the messages expected by the nodes; fusing UPDATE_X never sends more messages than without. */
+bool testDispatch(int numPairs, int numFree, OBNsim::simtime_t finalTime) {
+    bool ok = true;
+    std::cout << "GC dispatch test (" << numPairs << " source/consumer pairs, " << numFree << " free sources, final time " << finalTime << ")" << std::endl;
+    std::cout << std::setw(8) << "fused" << std::setw(12) << "lookahead" << std::setw(10) << "dataflow" << std::setw(8) << "groups" << std::setw(12) << "messages" << std::setw(10) << "ratio" << std::endl;
+    std::size_t baseline = 0;
+    std::vector<std::size_t> counts(16);
+    for (int options = 0; options < 16; ++options) {
+        bool fuse = options & 1, lookahead = options & 2, dataflow = options & 4, groups = options & 8;
+        auto n = runSimulation(numPairs, numFree, finalTime, fuse, lookahead, dataflow, groups);
+        counts[options] = n;
+        if (options == 0) { baseline = n; }
+        std::cout << std::setw(8) << fuse << std::setw(12) << lookahead << std::setw(10) << dataflow << std::setw(8) << groups << std::setw(12) << n;
+        if (n > 0) {
+            std::cout << std::setw(9) << std::fixed << std::setprecision(1) << double(baseline) / n << 'x';
+        }
+        ok = endRow(n > 0) && ok;
+    }
+    // Fusing UPDATE_X must not send more messages, also with node groups
+    for (int options = 0; options < 16; options += 2) {
+        if (counts[options + 1] > counts[options]) {
+            std::cout << "Fused UPDATE_X sends more messages than without (lookahead " << bool(options & 2) << ", dataflow " << bool(options & 4) << ", groups " << bool(options & 8) << "): FAILED" << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+/** The lost messages and ACKs are recovered by retransmissions, for each combination of the dispatch options. */
+bool testLossy(int numPairs, int numFree) {
+    bool ok = true;
+    const unsigned int lossEvery = 50;
+    const OBNsim::simtime_t finalTime = 100;
+    std::cout << "Lossy network (every " << lossEvery << "th message or ACK lost, final time " << finalTime << ")" << std::endl;
+    std::cout << std::setw(8) << "fused" << std::setw(12) << "lookahead" << std::setw(10) << "dataflow" << std::setw(8) << "groups" << std::setw(10) << "lost" << std::setw(12) << "messages" << std::setw(10) << "timeouts" << std::endl;
+    for (int options = 0; options < 16; ++options) {
+        bool fuse = options & 1, lookahead = options & 2, dataflow = options & 4, groups = options & 8;
+        numWarnings = 0;
+        std::size_t lost;
+        auto n = runLossy(numPairs, numFree, finalTime, fuse, lookahead, dataflow, groups, lossEvery, lost);
+        std::cout << std::setw(8) << fuse << std::setw(12) << lookahead << std::setw(10) << dataflow << std::setw(8) << groups << std::setw(10) << lost
+        << std::setw(12) << n << std::setw(10) << numWarnings;
+        ok = endRow(n > 0) && ok;
+    }
+    return ok;
+}
+
+/** The nodes receive the same messages as with a single GC, and the root GC's messages don't depend on the sizes of the partitions. */
+bool testHierarchy(int numPairs, int numFree, OBNsim::simtime_t finalTime) {
+    bool ok = true;
+    std::cout << "Hierarchical GC (pairs split among sub-coordinators, depending on each other, final time " << finalTime << ")" << std::endl;
+    std::cout << std::setw(12) << "partitions" << std::setw(10) << "dataflow" << std::setw(12) << "messages" << std::setw(8) << "root" << std::setw(12) << "2x pairs" << std::setw(10) << "ms" << std::endl;
+    for (int dataflow = 0; dataflow < 2; ++dataflow) {
+        auto flat = runSimulation(numPairs, numFree, finalTime, false, false, dataflow, false);
+        for (int numPartitions: {1, 4, numPairs}) {
+            double elapsed, elapsed2;
+            std::size_t root, root2;
+            auto n = runHierarchical(numPairs, numFree, finalTime, numPartitions, dataflow, elapsed, root);
+            auto n2 = runHierarchical(2*numPairs, numFree, finalTime, numPartitions, dataflow, elapsed2, root2);
+            std::cout << std::setw(12) << numPartitions << std::setw(10) << dataflow << std::setw(12) << n << std::setw(8) << root << std::setw(12) << root2
+            << std::setw(10) << std::fixed << std::setprecision(1) << elapsed;
+            ok = endRow(n > 0 && n == flat && n2 > 0 && root2 == root) && ok;
+        }
+    }
+    return ok;
+}
+
+/** The nodes receive the same messages from parallel GCs, one per component, as with a single GC. */
+bool testComponents(int numPairs, int numFree, OBNsim::simtime_t finalTime) {
+    bool ok = true;
+    std::cout << "Parallel components (one GC per component, final time " << finalTime << ")" << std::endl;
+    std::cout << std::setw(12) << "components" << std::setw(10) << "dataflow" << std::setw(12) << "messages" << std::setw(10) << "ms" << std::endl;
+    for (int dataflow = 0; dataflow < 2; ++dataflow) {
+        auto flat = runSimulation(numPairs, numFree, finalTime, false, false, dataflow, false);
+        for (int numComponents: {1, 4, numPairs}) {
+            double elapsed;
+            auto n = runComponents(numPairs, numFree, finalTime, numComponents, dataflow, elapsed);
+            std::cout << std::setw(12) << numComponents << std::setw(10) << dataflow << std::setw(12) << n << std::setw(10) << std::fixed << std::setprecision(1) << elapsed;
+            ok = endRow(n > 0 && n == flat) && ok;
+        }
+    }
+    return ok;
+}
+
+/** The nodes kept running receive the same messages in each run, except SIM_TERM sent once at the end. */
+bool testWarmRestart(int numPairs, int numFree, OBNsim::simtime_t finalTime) {
+    bool ok = true;
+    const int runs = 3, numNodes = 2*numPairs + numFree;
+    std::cout << "Warm restart (" << runs << " runs without relaunching the nodes, final time " << finalTime << ")" << std::endl;
+    std::cout << std::setw(10) << "dataflow" << std::setw(12) << "messages" << std::setw(12) << "single run" << std::endl;
+    for (int dataflow = 0; dataflow < 2; ++dataflow) {
+        auto single = runSimulation(numPairs, numFree, finalTime, false, false, dataflow, false);
+        auto n = runWarmRestart(numPairs, numFree, finalTime, dataflow, runs);
+        std::cout << std::setw(10) << dataflow << std::setw(12) << n << std::setw(12) << single;
+        ok = endRow(n > 0 && n == runs * (single - numNodes) + numNodes) && ok;
+    }
+    return ok;
+}
+
+/** The simulation resumed from a checkpoint continues from the saved state. */
+bool testCheckpoint(int numPairs, int numFree, OBNsim::simtime_t finalTime) {
+    bool ok = true;
+    const OBNsim::simtime_t checkpointTime = finalTime / 2 + 5;
+    std::cout << "Checkpoint at time " << checkpointTime << ", then resume in a new GC (final time " << finalTime << ")" << std::endl;
+    std::cout << std::setw(10) << "dataflow" << std::setw(12) << "messages" << std::setw(12) << "full run" << std::endl;
+    for (int dataflow = 0; dataflow < 2; ++dataflow) {
+        auto full = runSimulation(numPairs, numFree, finalTime, false, false, dataflow, false);
+        auto n = runCheckpoint(numPairs, numFree, finalTime, checkpointTime, dataflow, "benchgc_checkpoint.bin");
+        std::cout << std::setw(10) << dataflow << std::setw(12) << n << std::setw(12) << full;
+        ok = endRow(n > 0) && ok;
+    }
+    return ok;
+}
+
+/** Port connections before the simulation, with one round trip per connection or one batch per node sent to all nodes at once, give the correct results; a batch times out even with a system request pending. */
+bool testConnect() {
+    bool ok = true;
+    const std::chrono::microseconds latency(200);
+    std::cout << "Port connections (" << latency.count() << " us latency per message)" << std::endl;
+    std::cout << std::setw(8) << "nodes" << std::setw(14) << "connections" << std::setw(14) << "single ms" << std::setw(12) << "batch ms" << std::endl;
+    for (int nodes: {10, 100}) {
+        const int connections = 10;
+        double single = 0.0, batched = 0.0;
+        bool connected = runConnect(nodes, connections, latency, false, single);
+        connected = runConnect(nodes, connections, latency, true, batched) && connected;
+        std::cout << std::setw(8) << nodes << std::setw(14) << nodes * (connections + 1) << std::setw(14) << std::fixed << std::setprecision(1) << single << std::setw(12) << batched;
+        ok = endRow(connected) && ok;
+    }
+    // A pending system request must not keep the batch from timing out
+    const unsigned int timeout = 100;
+    const std::vector< std::pair<GCThread::OBNSysRequestType, std::string> > sysreqs = {
+        {GCThread::SYSREQ_PAUSE, "PAUSE"}, {GCThread::SYSREQ_RESUME, "RESUME"}, {GCThread::SYSREQ_STEP, "STEP"}
+    };
+    for (const auto& sysreq: sysreqs) {
+        std::cout << "Batch timeout of " << timeout << " ms with " << sysreq.second << " pending";
+        ok = endRow(runConnectTimeout(sysreq.first, timeout)) && ok;
+    }
+    return ok;
+}
+
+/** The frames give the same messages as full serialization. */
+bool testFrames() {
+    auto speedup = benchFrames(10000, 100);
+    if (speedup > 0) {
+        std::cout << "Speedup: " << std::setprecision(1) << speedup << 'x' << std::endl;
+    } else {
+        std::cout << "Frame check FAILED" << std::endl;
+    }
+    return speedup > 0;
+}
+
+int main(int argc, char **argv) {
+    const int numPairs = 20, numFree = 20;
+    const OBNsim::simtime_t finalTime = 1000;
+
+    // Each feature is tested separately, so that a failure points at it
+    const std::vector< std::pair<std::string, bool> > results = {
+        {"dispatch", testDispatch(numPairs, numFree, finalTime)},
+        {"lossy network", testLossy(numPairs, numFree)},
+        {"hierarchy", testHierarchy(numPairs, numFree, finalTime)},
+        {"components", testComponents(numPairs, numFree, finalTime)},
+        {"warm restart", testWarmRestart(numPairs, numFree, finalTime)},
+        {"checkpoint", testCheckpoint(numPairs, numFree, finalTime)},
+        {"connect", testConnect()},
+        {"frames", testFrames()}
+    };
+
+    bool allOK = true;
+    std::cout << "Summary" << std::endl;
+    for (const auto& result: results) {
+        std::cout << std::setw(16) << result.first << ": " << (result.second?"OK":"FAILED") << std::endl;
+        allOK = allOK && result.second;
+    }
+    return allOK?0:1;
+}
@@ -0,0 +1,255 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Equivalence test and benchmark of the GC's dependency graphs.
+ *
+ * The test builds random dependency graphs, with links between random update types, in NodeDepGraph_BGL and NodeDepGraph_CSR.
+ * The graphs are acyclic, or have random edges which may form algebraic loops.
+ * For each graph, both run-time algorithms are run on the same random lists of updating nodes, reusing the graph objects between the lists as the GC does;
+ * they must return the same waves, the same sinks in each wave (isSink()), and the same remaining nodes when they get stuck in an algebraic loop.
+ * The same check is run for the wave-plan cache (NodeDepGraph_WaveCache) over the CSR graph against the BGL graph, with recurring lists of updating nodes,
+ * a capacity smaller than the number of distinct lists so that the cache is cleared when full, and new dependencies added during the run.
+ *
+ * The benchmark compares the time per step of both graphs for increasing numbers of nodes.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <obnsmn_nodegraph.h>
+
+using namespace OBNsmn;
+
+typedef std::vector< std::pair<int, updatemask_t> > WaveT;
+
+const int numUpdateTypes = 4;   ///< Update types of the nodes, i.e. the bits of the random masks
+
+/** The result of running a run-time graph to completion. */
+struct RunResult {
+    std::vector<WaveT> waves;
+    std::vector< std::vector<int> > sinks;  ///< The sinks of each wave
+    WaveT remaining;                        ///< The remaining nodes, sorted by ID, if the graph got stuck
+
+    bool operator==(const RunResult& other) const {
+        return waves == other.waves && sinks == other.sinks && remaining == other.remaining;
+    }
+    bool operator!=(const RunResult& other) const {
+        return !(*this == other);
+    }
+};
+
+/** Run the run-time algorithm of a graph for a list of updating nodes until the graph is empty or stuck. */
+RunResult runGraph(NodeDepGraph& graph, NodeUpdateInfoList& updates) {
+    RunResult result;
+    RTNodeDepGraph* rtgraph = graph.getRTNodeDepGraph(updates.begin(), updates.size());
+    while (!rtgraph->empty()) {
+        const auto & wave = rtgraph->getAndRemoveIndependentNodes();
+        if (wave.empty()) {
+            result.remaining = rtgraph->getCurrentNodes();
+            std::sort(result.remaining.begin(), result.remaining.end());
+            break;
+        }
+        result.waves.push_back(wave);
+        result.sinks.emplace_back();
+        for (const auto & node: wave) {
+            if (rtgraph->isSink(node.first)) {
+                result.sinks.back().push_back(node.first);
+            }
+        }
+    }
+    return result;
+}
+
+/** A random non-zero update mask. */
+updatemask_t randomMask(std::mt19937& rng) {
+    std::uniform_int_distribution<updatemask_t> mask(1, (updatemask_t(1) << numUpdateTypes) - 1);
+    return mask(rng);
+}
+
+/** Add the same random dependencies to several graphs.
+ Each node depends on up to maxInputs other nodes. If acyclic, the sources of a node come before it in a random order of the nodes; otherwise they are arbitrary.
+ */
+void addRandomDependencies(const std::vector<NodeDepGraph*>& graphs, int numNodes, int maxInputs, bool acyclic, std::mt19937& rng) {
+    std::vector<int> order(numNodes);
+    for (int k = 0; k < numNodes; ++k) {
+        order[k] = k;
+    }
+    std::shuffle(order.begin(), order.end(), rng);
+
+    std::uniform_int_distribution<int> inputs(0, maxInputs);
+    for (int k = 0; k < numNodes; ++k) {
+        int t = order[k];
+        int n = (acyclic && k == 0)?0:inputs(rng);
+        for (int j = 0; j < n; ++j) {
+            int s = acyclic?order[std::uniform_int_distribution<int>(0, k-1)(rng)]:std::uniform_int_distribution<int>(0, numNodes-1)(rng);
+            if (s == t) {
+                continue;
+            }
+            updatemask_t smask = randomMask(rng), tmask = randomMask(rng);
+            for (auto graph: graphs) {
+                graph->addDependency(s, t, smask, tmask);
+            }
+        }
+    }
+}
+
+/** A random list of updating nodes, sorted by ID as in the GC, each node being updated with a given probability. */
+NodeUpdateInfoList randomUpdates(int numNodes, double probability, std::mt19937& rng) {
+    NodeUpdateInfoList updates;
+    std::bernoulli_distribution updating(probability);
+    for (int k = 0; k < numNodes; ++k) {
+        if (updating(rng)) {
+            updates.push_back(NodeUpdateInfo{k, randomMask(rng)});
+        }
+    }
+    return updates;
+}
+
+/** Compare the waves of NodeDepGraph_CSR with NodeDepGraph_BGL on random graphs and updates.
+ \return true if they are the same for every list of updating nodes.
+ */
+bool checkCSR(int numGraphs, int listsPerGraph, std::size_t& numWaves, std::size_t& numStuck) {
+    std::mt19937 rng(2016);
+    std::uniform_int_distribution<int> size(1, 60);
+    std::uniform_real_distribution<double> probability(0.05, 1.0);
+    numWaves = numStuck = 0;
+
+    for (int g = 0; g < numGraphs; ++g) {
+        int numNodes = size(rng);
+        NodeDepGraph_BGL bgl(numNodes);
+        NodeDepGraph_CSR csr(numNodes);
+        addRandomDependencies({&bgl, &csr}, numNodes, 3, g % 2 == 0, rng);
+
+        for (int l = 0; l < listsPerGraph; ++l) {
+            auto updates = randomUpdates(numNodes, probability(rng), rng);
+            if (updates.empty()) {
+                continue;
+            }
+            auto expected = runGraph(bgl, updates);
+            if (runGraph(csr, updates) != expected) {
+                std::cout << "Graph " << g << " (" << numNodes << " nodes), list " << l << ": the waves differ" << std::endl;
+                return false;
+            }
+            numWaves += expected.waves.size();
+            numStuck += !expected.remaining.empty();
+        }
+    }
+    return true;
+}
+
+/** Compare the waves replayed by NodeDepGraph_WaveCache, over a CSR graph, with NodeDepGraph_BGL on random graphs and recurring updates.
+ Each graph has a pool of lists of updating nodes larger than the capacity of the cache, from which the steps are drawn at random, so that plans are
+ replayed from the cache but the cache also gets full and is cleared. Halfway through the steps, a new dependency is added to both graphs.
+ \return true if the waves are the same for every step.
+ */
+bool checkWaveCache(int numGraphs, int stepsPerGraph, std::size_t capacity, int poolSize, std::size_t& hits, std::size_t& misses) {
+    std::mt19937 rng(2017);
+    std::uniform_int_distribution<int> size(2, 60);
+    std::uniform_real_distribution<double> probability(0.05, 1.0);
+    std::uniform_int_distribution<int> pick(0, poolSize-1);
+    hits = misses = 0;
+
+    for (int g = 0; g < numGraphs; ++g) {
+        int numNodes = size(rng);
+        NodeDepGraph_BGL bgl(numNodes);
+        NodeDepGraph_WaveCache cache(new NodeDepGraph_CSR(numNodes), capacity);
+        addRandomDependencies({&bgl, &cache}, numNodes, 3, g % 2 == 0, rng);
+
+        std::vector<NodeUpdateInfoList> pool;
+        while (pool.size() < std::size_t(poolSize)) {
+            auto updates = randomUpdates(numNodes, probability(rng), rng);
+            if (!updates.empty()) {
+                pool.push_back(updates);
+            }
+        }
+
+        for (int l = 0; l < stepsPerGraph; ++l) {
+            if (l == stepsPerGraph/2) {
+                // The new dependency must invalidate the cached plans
+                updatemask_t smask = randomMask(rng), tmask = randomMask(rng);
+                bgl.addDependency(0, 1, smask, tmask);
+                cache.addDependency(0, 1, smask, tmask);
+            }
+            auto & updates = pool[pick(rng)];
+            if (runGraph(cache, updates) != runGraph(bgl, updates)) {
+                std::cout << "Graph " << g << " (" << numNodes << " nodes), step " << l << ": the waves differ" << std::endl;
+                return false;
+            }
+        }
+        hits += cache.hits();
+        misses += cache.misses();
+    }
+    return true;
+}
+
+/** Time the steps of a graph on the given lists of updating nodes. \return Microseconds per step. */
+double timeSteps(NodeDepGraph& graph, std::vector<NodeUpdateInfoList>& lists, int rounds) {
+    std::size_t total = 0;     // Keep the work from being optimized away
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (auto & updates: lists) {
+            RTNodeDepGraph* rtgraph = graph.getRTNodeDepGraph(updates.begin(), updates.size());
+            while (!rtgraph->empty()) {
+                const auto & wave = rtgraph->getAndRemoveIndependentNodes();
+                if (wave.empty()) {
+                    break;
+                }
+                total += wave.size();
+            }
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    if (total == 0) {
+        return 0.0;
+    }
+    return std::chrono::duration<double, std::micro>(t1 - t0).count() / (rounds * lists.size());
+}
+
+int main(int argc, char **argv) {
+    bool allOK = true;
+
+    const int numGraphs = 400, listsPerGraph = 50;
+    std::size_t numWaves, numStuck;
+    bool ok = checkCSR(numGraphs, listsPerGraph, numWaves, numStuck);
+    std::cout << "CSR graph against BGL graph (" << numGraphs << " random graphs, " << listsPerGraph << " update lists each): "
+    << numWaves << " waves, " << numStuck << " algebraic loops, " << (ok?"OK":"FAILED") << std::endl;
+    allOK = allOK && ok;
+
+    // Without clearing the cache, each graph would have at most 2 misses per list of its pool (one before and one after the new dependency)
+    const int cacheGraphs = 200, cacheSteps = 200, poolSize = 16;
+    const std::size_t capacity = 8;
+    std::size_t hits, misses;
+    ok = checkWaveCache(cacheGraphs, cacheSteps, capacity, poolSize, hits, misses);
+    ok = ok && hits > 0 && misses > std::size_t(2 * cacheGraphs * poolSize);
+    std::cout << "Cached CSR graph against BGL graph (" << cacheGraphs << " random graphs, " << cacheSteps << " steps from " << poolSize
+    << " update lists each, capacity " << capacity << "): " << hits << " hits, " << misses << " misses, " << (ok?"OK":"FAILED") << std::endl;
+    allOK = allOK && ok;
+
+    // Sparse updates on acyclic graphs, as in large networks of periodic nodes
+    std::cout << "Time per step (acyclic graphs, up to 2 inputs per node, 10% of the nodes updating)" << std::endl;
+    std::cout << std::setw(10) << "nodes" << std::setw(14) << "BGL (us)" << std::setw(14) << "CSR (us)" << std::setw(10) << "speedup" << std::endl;
+    for (int numNodes: {100, 1000, 10000}) {
+        std::mt19937 rng(numNodes);
+        NodeDepGraph_BGL bgl(numNodes);
+        NodeDepGraph_CSR csr(numNodes);
+        addRandomDependencies({&bgl, &csr}, numNodes, 2, true, rng);
+        std::vector<NodeUpdateInfoList> lists;
+        for (int l = 0; l < 20; ++l) {
+            lists.push_back(randomUpdates(numNodes, 0.1, rng));
+        }
+        int rounds = std::max(1, 200000 / numNodes);
+        double t1 = timeSteps(bgl, lists, rounds);
+        double t2 = timeSteps(csr, lists, rounds);
+        std::cout << std::setw(10) << numNodes << std::setw(14) << std::fixed << std::setprecision(2) << t1 << std::setw(14) << t2
+        << std::setw(9) << std::setprecision(1) << t1 / t2 << 'x' << std::endl;
+    }
+
+    return allOK?0:1;
+}
@@ -0,0 +1,175 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Stress test and contention benchmark of the GC's event queue.
+ *
+ * The stress test runs several producer threads pushing tagged events into an mpsc_queue, with random pauses so that the consumer often goes to sleep.
+ * The consumer drains the queue in batches, like the GC, and checks that no event is lost, duplicated or reordered (per producer).
+ *
+ * The benchmark measures the throughput of the mutex-based shared_queue (with its condition variable) and of the lock-free mpsc_queue (with an event count),
+ * for increasing numbers of producer threads pushing as fast as possible.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <sharedqueue.h>
+#include <mpscqueue.h>
+
+/** A small event, about the size of an SMN node event, which can be linked in an mpsc_queue. */
+struct BenchEvent: public mpsc_queue_hook {
+    int producer;
+    long seq;
+    char payload[48];
+    BenchEvent(int p, long s): producer(p), seq(s) { }
+};
+
+/** Run the consumer loop of the GC on an mpsc_queue: drain in batches, sleep on the event count when empty.
+ \return true if all events were received in order.
+ */
+bool consumeMPSC(mpsc_queue<BenchEvent>& queue, event_count& signal, int producers, long perProducer) {
+    std::vector<long> expected(producers, 0);
+    std::deque<mpsc_queue<BenchEvent>::item_type> batch;
+    long remaining = producers * perProducer;
+    bool ok = true;
+
+    while (remaining > 0) {
+        if (queue.pop_all(batch) == 0) {
+            unsigned int key = signal.prepare_wait();
+            if (!queue.empty()) {
+                signal.cancel_wait();
+                continue;
+            }
+            // Use a timed wait sometimes to exercise both waiting methods
+            if (remaining % 2) {
+                signal.wait(key);
+            } else {
+                signal.wait_until(key, std::chrono::steady_clock::now() + std::chrono::milliseconds(1));
+            }
+            continue;
+        }
+        for (auto& ev: batch) {
+            if (ev->seq != expected[ev->producer]) {
+                ok = false;
+            }
+            expected[ev->producer] = ev->seq + 1;
+            --remaining;
+        }
+        batch.clear();
+    }
+    return ok && queue.empty();
+}
+
+/** Stress test of mpsc_queue with event_count. */
+bool stressMPSC(int producers, long perProducer) {
+    event_count signal;
+    mpsc_queue<BenchEvent> queue(signal);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue, p, perProducer]() {
+            std::mt19937 rng(p);
+            std::uniform_int_distribution<int> pause(0, 999);
+            for (long s = 0; s < perProducer; ++s) {
+                queue.push(new BenchEvent(p, s));
+                if (pause(rng) == 0) {
+                    // Let the consumer go to sleep
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                }
+            }
+        });
+    }
+
+    bool ok = consumeMPSC(queue, signal, producers, perProducer);
+    for (auto& t: threads) { t.join(); }
+    return ok;
+}
+
+/** Throughput of shared_queue: producers push, the consumer pops one event at a time. \return Events per microsecond. */
+double benchShared(int producers, long perProducer) {
+    std::condition_variable cond;
+    shared_queue<BenchEvent> queue(cond);
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue, p, perProducer]() {
+            for (long s = 0; s < perProducer; ++s) {
+                queue.push(new BenchEvent(p, s));
+            }
+        });
+    }
+    for (long n = producers * perProducer; n > 0; --n) {
+        queue.wait_and_pop();
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (auto& t: threads) { t.join(); }
+
+    return producers * perProducer / std::chrono::duration<double, std::micro>(t1 - t0).count();
+}
+
+/** Throughput of mpsc_queue: producers push, the consumer drains in batches. \return Events per microsecond. */
+double benchMPSC(int producers, long perProducer, bool& ok) {
+    event_count signal;
+    mpsc_queue<BenchEvent> queue(signal);
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue, p, perProducer]() {
+            for (long s = 0; s < perProducer; ++s) {
+                queue.push(new BenchEvent(p, s));
+            }
+        });
+    }
+    ok = consumeMPSC(queue, signal, producers, perProducer);
+    auto t1 = std::chrono::steady_clock::now();
+    for (auto& t: threads) { t.join(); }
+
+    return producers * perProducer / std::chrono::duration<double, std::micro>(t1 - t0).count();
+}
+
+int main(int argc, char **argv) {
+    bool allOK = true;
+
+    std::cout << "Stress test of mpsc_queue:";
+    for (int producers: {1, 2, 4, 8, 16}) {
+        bool ok = stressMPSC(producers, 50000);
+        std::cout << ' ' << producers << (ok?":OK":":FAILED");
+        allOK = allOK && ok;
+    }
+    std::cout << std::endl;
+
+    const long total = 1000000;     // Total number of events in each run
+    std::cout << "Event queue benchmark (" << total << " events per run, best of 5 runs)" << std::endl;
+    std::cout << std::setw(10) << "producers" << std::setw(22) << "shared_queue (ev/us)" << std::setw(20) << "mpsc_queue (ev/us)" << std::setw(10) << "speedup" << std::endl;
+    for (int producers: {1, 2, 4, 8, 16}) {
+        // Best of several runs, as the threads' scheduling makes single runs noisy
+        bool ok = true;
+        double r1 = 0.0, r2 = 0.0;
+        for (int run = 0; run < 5; ++run) {
+            bool runOK;
+            r1 = std::max(r1, benchShared(producers, total / producers));
+            r2 = std::max(r2, benchMPSC(producers, total / producers, runOK));
+            ok = ok && runOK;
+        }
+        std::cout << std::setw(10) << producers << std::setw(22) << std::fixed << std::setprecision(3) << r1
+        << std::setw(20) << r2 << std::setw(9) << std::setprecision(1) << r2 / r1 << 'x';
+        if (!ok) {
+            std::cout << "  FAILED";
+            allOK = false;
+        }
+        std::cout << std::endl;
+    }
+
+    return allOK?0:1;
+}
@@ -0,0 +1,124 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Benchmark of the GC's next-update scheduler against a linear scan of all nodes.
+ *
+ * Each node has one periodic update with a random, long period, so that only a few nodes are updated in each iteration (except the first one).
+ * For each number of nodes, both methods run the same number of GC iterations and must produce the same sequence of updates.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <obnsmn_scheduler.h>
+
+using namespace OBNsmn;
+
+/** A simplified node, which is only updated periodically (allocated separately, like the nodes in the GC). */
+struct BenchNode {
+    simtime_t period;
+    simtime_t next_update = 0;
+    
+    simtime_t getNextUpdate() const { return next_update; }
+    void finishCurrentUpdate() { next_update += period; }
+};
+
+typedef std::vector< std::unique_ptr<BenchNode> > NodeList;
+
+NodeList makeNodes(std::size_t n) {
+    // Sparse update rates: periods between 1000 and 100000 time units, so that only few nodes are updated in each iteration
+    std::mt19937 rng(n);
+    std::uniform_int_distribution<simtime_t> period(1000, 100000);
+    NodeList nodes;
+    for (std::size_t i = 0; i < n; ++i) {
+        nodes.emplace_back(new BenchNode());
+        nodes.back()->period = period(rng);
+    }
+    return nodes;
+}
+
+/** Run the GC iterations with a linear scan over all nodes, as GCThread::startNextUpdate() used to do. */
+uint64_t runScan(NodeList& nodes, int iterations) {
+    uint64_t checksum = 0;
+    std::vector<int> ids;
+    for (int k = 0; k < iterations; ++k) {
+        simtime_t t = -1;
+        ids.clear();
+        int nodeID = 0;
+        for (auto it = nodes.begin(); it != nodes.end(); ++it, ++nodeID) {
+            simtime_t t_node = (*it)->getNextUpdate();
+            if (t_node >= 0) {
+                if (t_node == t) {
+                    ids.push_back(nodeID);
+                }
+                else if ((t_node < t) || (t < 0)) {
+                    t = t_node;
+                    ids.assign(1, nodeID);
+                }
+            }
+        }
+        for (auto id: ids) {
+            checksum = checksum * 31 + id + t;
+            nodes[id]->finishCurrentUpdate();
+        }
+    }
+    return checksum;
+}
+
+/** Run the GC iterations with the scheduler. */
+uint64_t runScheduler(NodeList& nodes, int iterations) {
+    uint64_t checksum = 0;
+    NodeUpdateScheduler scheduler;
+    scheduler.reset(nodes.size());
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        scheduler.set(i, nodes[i]->getNextUpdate());
+    }
+    
+    std::vector<int> ids;
+    for (int k = 0; k < iterations; ++k) {
+        simtime_t t = scheduler.nextNodes(ids);
+        for (auto id: ids) {
+            checksum = checksum * 31 + id + t;
+            nodes[id]->finishCurrentUpdate();
+            scheduler.set(id, nodes[id]->getNextUpdate());
+        }
+    }
+    return checksum;
+}
+
+int main(int argc, char **argv) {
+    const int iterations = 2000;
+    
+    std::cout << "Next-update scheduler benchmark (" << iterations << " GC iterations per run)" << std::endl;
+    std::cout << std::setw(10) << "nodes" << std::setw(16) << "scan (us/it)" << std::setw(18) << "scheduler (us/it)" << std::setw(10) << "speedup" << std::endl;
+    
+    bool allOK = true;
+    for (std::size_t n: {100, 1000, 10000, 100000}) {
+        auto nodes1 = makeNodes(n), nodes2 = makeNodes(n);
+        
+        auto t0 = std::chrono::steady_clock::now();
+        auto c1 = runScan(nodes1, iterations);
+        auto t1 = std::chrono::steady_clock::now();
+        auto c2 = runScheduler(nodes2, iterations);
+        auto t2 = std::chrono::steady_clock::now();
+        
+        double scan_us = std::chrono::duration<double, std::micro>(t1 - t0).count() / iterations;
+        double sched_us = std::chrono::duration<double, std::micro>(t2 - t1).count() / iterations;
+        std::cout << std::setw(10) << n << std::setw(16) << std::fixed << std::setprecision(3) << scan_us
+        << std::setw(18) << sched_us << std::setw(9) << std::setprecision(1) << scan_us / sched_us << 'x';
+        if (c1 != c2) {
+            std::cout << "  MISMATCH";
+            allOK = false;
+        }
+        std::cout << std::endl;
+    }
+    
+    return allOK?0:1;
+}
@@ -0,0 +1,276 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Benchmark of the step rate of the GC with nodes communicating through shared memory.
+ *
+ * The GC runs with its shared-memory server (see obnsmn_comm_shm.h), and each node is simulated by a thread with its own segment, which ACKs the GC's messages.
+ * All nodes have period 1, so each step of the simulation takes two round trips (UPDATE_Y, UPDATE_X) with all nodes.
+ * The step rate is compared with the same simulation over a Unix-domain socket (see benchsocket.cpp).
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <obnsmn_gc.h>
+#include <obnsmn_report.h>
+#include <obnsmn_comm_shm.h>
+#include <obnsmn_comm_socket.h>
+
+using namespace OBNsmn;
+
+void OBNsmn::report_error(int code, std::string msg) {
+    std::cerr << "ERROR: " << msg << std::endl;
+}
+
+void OBNsmn::report_warning(int code, std::string msg) {
+    std::cerr << "WARNING: " << msg << std::endl;
+}
+
+void OBNsmn::report_info(int code, std::string msg) {
+}
+
+
+/** Set the ACK of a message of the GC; returns false if the message needs no ACK. */
+bool makeAck(const OBNSimMsg::SMN2N& msg, OBNSimMsg::N2SMN& ack) {
+    ack.Clear();
+    ack.set_id(msg.id());
+    if (msg.has_seq()) {
+        ack.set_seq(msg.seq());
+    }
+    switch (msg.msgtype()) {
+        case OBNSimMsg::SMN2N_MSGTYPE_SIM_INIT:
+            ack.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SIM_INIT_ACK);
+            return true;
+        case OBNSimMsg::SMN2N_MSGTYPE_SIM_Y:
+        case OBNSimMsg::SMN2N_MSGTYPE_SIM_YX:
+        case OBNSimMsg::SMN2N_MSGTYPE_SIM_YW:
+            ack.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SIM_Y_ACK);
+            return true;
+        case OBNSimMsg::SMN2N_MSGTYPE_SIM_X:
+            ack.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SIM_X_ACK);
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+/** A simulated node in shared memory: creates its segment, then ACKs the GC's messages until SIM_TERM. */
+void runShmNode(const std::string& smnPortName, const std::string& portName, std::atomic<int>& ready, std::atomic<int>& bad) {
+    std::string error;
+    OBNsim::Shm::Segment segment, smn;
+    if (!segment.create(OBNsim::Shm::segmentName(portName), OBNsim::Shm::DEFAULT_CAPACITY, error) ||
+        !smn.open(OBNsim::Shm::segmentName(smnPortName), error)) {
+        std::cerr << "ERROR: " << error << std::endl;
+        ++bad;
+        ++ready;
+        return;
+    }
+    segment.setOnline(true);
+    ++ready;
+
+    OBNSimMsg::SMN2N msg;
+    OBNSimMsg::N2SMN ack;
+    std::string bytes;
+    bool done = false;
+
+    while (!done) {
+        segment.read([&](uint32_t channel, const char* data, std::size_t size) {
+            if (done) {
+                return;
+            }
+            if (!msg.ParseFromArray(data, size)) {
+                ++bad;
+                return;
+            }
+            if (msg.msgtype() == OBNSimMsg::SMN2N_MSGTYPE_SIM_TERM) {
+                done = true;
+            } else if (makeAck(msg, ack)) {
+                ack.SerializeToString(&bytes);
+                if (!smn.write(OBNsim::Shm::CHANNEL_SMN, bytes.data(), bytes.size())) {
+                    ++bad;
+                }
+            }
+        });
+        if (!done) {
+            segment.wait();
+        }
+    }
+
+    segment.close();
+    smn.close();
+}
+
+
+/** A simulated node on a Unix-domain socket: connects to the SMN, sends its GC port name, then ACKs the GC's messages until SIM_TERM. */
+void runSocketNode(const std::string& address, const std::string& portName, std::atomic<int>& bad) {
+    std::string error;
+    int fd = OBNsim::Socket::connectTo(address, error);
+    if (fd < 0) {
+        std::cerr << "ERROR: " << error << std::endl;
+        ++bad;
+        return;
+    }
+
+    OBNsim::Socket::FrameWriter writer;
+    OBNsim::Socket::FrameReader reader;
+    writer.attach(fd);
+    writer.write(portName.data(), portName.size());
+
+    OBNSimMsg::SMN2N msg;
+    OBNSimMsg::N2SMN ack;
+    std::string bytes;
+    const char* data;
+    std::size_t size;
+    bool done = false;
+
+    while (!done && reader.receive(fd) > 0) {
+        while (!done && reader.next(data, size)) {
+            if (!msg.ParseFromArray(data, size)) {
+                ++bad;
+                continue;
+            }
+            if (msg.msgtype() == OBNSimMsg::SMN2N_MSGTYPE_SIM_TERM) {
+                done = true;
+            } else if (makeAck(msg, ack)) {
+                ack.SerializeToString(&bytes);
+                writer.write(bytes.data(), bytes.size());
+            }
+        }
+    }
+
+    writer.detach(fd);
+    OBNsim::Socket::closeSocket(fd);
+}
+
+
+/** Run the GC until the end of the simulation; returns the number of steps per second. */
+double runGC(GCThread& gc, int numNodes, int numSteps) {
+    gc.setDependencyGraph(new NodeDepGraph_CSR(numNodes));
+    gc.setSimulationTimeUnit(1);
+    gc.setFinalSimulationTime(numSteps - 1);
+
+    auto t0 = std::chrono::steady_clock::now();
+    gc.startThread();
+    gc.joinThread();
+    auto t1 = std::chrono::steady_clock::now();
+    return numSteps / std::chrono::duration<double>(t1 - t0).count();
+}
+
+
+/** Run the simulation of a given number of steps with a given number of nodes in shared memory.
+ \return The number of steps per second, or a negative value if an error occurred.
+ */
+double runShm(int numNodes, int numSteps) {
+    const std::string smnPortName = "benchshm/_smn_/_gc_";
+    GCThread gc;
+    SHM::ShmServer server(&gc);
+    server.setPortName(smnPortName);
+    if (!server.start()) {
+        return -1.0;
+    }
+
+    std::atomic<int> ready(0), bad(0);
+    std::vector<std::string> portNames;
+    std::vector<std::thread> nodes;
+    for (int k = 0; k < numNodes; ++k) {
+        portNames.push_back("benchshm/n" + std::to_string(k) + "/_gc_");
+        nodes.emplace_back(runShmNode, smnPortName, portNames.back(), std::ref(ready), std::ref(bad));
+    }
+    while (ready < numNodes) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // The node objects get their segments from the server, so they are created when the nodes are online
+    for (int k = 0; k < numNodes && bad == 0; ++k) {
+        if (!server.checkNodeOnline(portNames[k])) {
+            ++bad;
+            break;
+        }
+        auto* node = new SHM::OBNNodeShm("n" + std::to_string(k), 1, portNames[k], &server);
+        node->setUpdateType(0, 1);
+        gc.insertNode(node);
+    }
+
+    double rate = -1.0;
+    if (bad == 0) {
+        rate = runGC(gc, numNodes, numSteps);
+    }
+
+    for (auto& t: nodes) {
+        t.join();
+    }
+    server.stop();
+
+    return (bad > 0)?-1.0:rate;
+}
+
+
+/** Run the simulation of a given number of steps with a given number of nodes on a Unix-domain socket.
+ \return The number of steps per second, or a negative value if an error occurred.
+ */
+double runSocket(const std::string& address, int numNodes, int numSteps) {
+    GCThread gc;
+    SOCKET::SocketServer server(&gc);
+    server.setAddress(address);
+    if (!server.start()) {
+        return -1.0;
+    }
+
+    std::atomic<int> bad(0);
+    std::vector<std::string> portNames;
+    std::vector<std::thread> nodes;
+    for (int k = 0; k < numNodes; ++k) {
+        portNames.push_back("bench/n" + std::to_string(k) + "/_gc_");
+        auto* node = new SOCKET::OBNNodeSocket("n" + std::to_string(k), 1, portNames.back(), &server);
+        node->setUpdateType(0, 1);
+        gc.insertNode(node);
+        nodes.emplace_back(runSocketNode, address, portNames.back(), std::ref(bad));
+    }
+
+    // Wait for all nodes to connect
+    for (const auto& name: portNames) {
+        while (!server.checkNodeOnline(name) && bad == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    double rate = runGC(gc, numNodes, numSteps);
+
+    for (auto& t: nodes) {
+        t.join();
+    }
+    server.stop();
+
+    return (bad > 0)?-1.0:rate;
+}
+
+
+int main(int argc, char **argv) {
+    const int numSteps = 2000;
+    const std::string unixAddress = OBNsim::Socket::defaultAddress("benchshm/");
+    bool allOK = true;
+
+    std::cout << "GC step rate with shared memory (" << numSteps << " steps, all nodes update in every step)" << std::endl;
+    std::cout << std::setw(8) << "nodes" << std::setw(14) << "shm (st/s)" << std::setw(14) << "unix (st/s)" << std::endl;
+    for (int numNodes: {1, 8, 32}) {
+        double r1 = runShm(numNodes, numSteps);
+        double r2 = runSocket(unixAddress, numNodes, numSteps);
+
+        std::cout << std::setw(8) << numNodes << std::fixed << std::setprecision(0) << std::setw(14) << r1 << std::setw(14) << r2;
+        if (r1 < 0 || r2 < 0) {
+            std::cout << "  FAILED";
+            allOK = false;
+        }
+        std::cout << std::endl;
+    }
+
+    return allOK?0:1;
+}
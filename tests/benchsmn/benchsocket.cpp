@@ -0,0 +1,319 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*- */
+/** \file
+ * \brief Benchmark of the step rate of the GC with nodes connected by sockets.
+ *
+ * The GC runs with its socket server (see obnsmn_comm_socket.h), and each node is simulated by a thread connected to the server, which ACKs the GC's messages.
+ * All nodes have period 1, so each step of the simulation takes two round trips (UPDATE_Y, UPDATE_X) with all nodes.
+ * The benchmark measures the steps per second over a Unix-domain socket, over TCP on the loopback interface,
+ * and over TCP through a relay, which forwards the bytes between each node and the SMN without parsing them.
+ * The relay stands in for an MQTT broker on the same host: the messages take the same extra hop, but the relay does none of the broker's work (routing, QOS handshakes), so it gives an upper bound of the step rate with MQTT.
+ * It also measures the step rate when all nodes share one Unix-domain connection, as the nodes of a NodeHost do, and checks that each message reaches its node;
+ * with bundling (the default), the GC sends the messages of a wave to the connection in one write, and the simulated host sends its ACKs together, otherwise one write per message.
+ *
+ * This file is part of the openBuildNet simulation framework
+ * (OBN-Sim) developed at EPFL.
+ *
+ * \author Truong X. Nghiem (xuan.nghiem@epfl.ch)
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <obnsmn_gc.h>
+#include <obnsmn_report.h>
+#include <obnsmn_comm_socket.h>
+
+using namespace OBNsmn;
+
+void OBNsmn::report_error(int code, std::string msg) {
+    std::cerr << "ERROR: " << msg << std::endl;
+}
+
+void OBNsmn::report_warning(int code, std::string msg) {
+    std::cerr << "WARNING: " << msg << std::endl;
+}
+
+void OBNsmn::report_info(int code, std::string msg) {
+}
+
+
+/** A simulated node: connects to the SMN, sends its GC port name, then ACKs the GC's messages until SIM_TERM. */
+void runNode(const std::string& address, const std::string& portName, std::atomic<int>& bad) {
+    std::string error;
+    int fd = OBNsim::Socket::connectTo(address, error);
+    if (fd < 0) {
+        std::cerr << "ERROR: " << error << std::endl;
+        ++bad;
+        return;
+    }
+
+    OBNsim::Socket::FrameWriter writer;
+    OBNsim::Socket::FrameReader reader;
+    writer.attach(fd);
+    writer.write(portName.data(), portName.size());
+
+    OBNSimMsg::SMN2N msg;
+    OBNSimMsg::N2SMN ack;
+    std::string bytes;
+    const char* data;
+    std::size_t size;
+    bool done = false;
+
+    while (!done && reader.receive(fd) > 0) {
+        while (reader.next(data, size)) {
+            if (!msg.ParseFromArray(data, size)) {
+                ++bad;
+                continue;
+            }
+            ack.Clear();
+            ack.set_id(msg.id());
+            if (msg.has_seq()) {
+                ack.set_seq(msg.seq());
+            }
+            switch (msg.msgtype()) {
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_INIT:
+                    ack.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SIM_INIT_ACK);
+                    break;
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_Y:
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_YX:
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_YW:
+                    ack.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SIM_Y_ACK);
+                    break;
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_X:
+                    ack.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SIM_X_ACK);
+                    break;
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_TERM:
+                    done = true;
+                    continue;
+                default:
+                    continue;
+            }
+            ack.SerializeToString(&bytes);
+            writer.write(bytes.data(), bytes.size());
+        }
+    }
+
+    writer.detach(fd);
+    OBNsim::Socket::closeSocket(fd);
+}
+
+
+/** Simulated nodes sharing a connection, like a NodeHost: registers all nodes' names, then ACKs the GC's messages to each node until all of them have received SIM_TERM.
+ If bundle is set, the ACKs of the messages received together are sent together.
+ */
+void runHost(const std::string& address, const std::vector<std::string>& portNames, bool bundle, std::atomic<int>& bad) {
+    std::string error;
+    int fd = OBNsim::Socket::connectTo(address, error);
+    if (fd < 0) {
+        std::cerr << "ERROR: " << error << std::endl;
+        ++bad;
+        return;
+    }
+
+    OBNsim::Socket::FrameWriter writer;
+    OBNsim::Socket::FrameReader reader;
+    writer.attach(fd);
+    std::string names;
+    for (const auto& name: portNames) {
+        names += name;
+        names += '\0';
+    }
+    writer.write(names.data(), names.size());
+
+    OBNSimMsg::SMN2N msg;
+    OBNSimMsg::N2SMN ack;
+    std::string bytes;
+    const char* data;
+    std::size_t size;
+    std::unordered_map<uint32_t, int32_t> ids;  // The ID of the node of each tag, which must not change
+    std::size_t terminated = 0;
+
+    while (terminated < portNames.size() && reader.receive(fd) > 0) {
+        if (bundle) {
+            writer.beginBundle();
+        }
+        while (reader.next(data, size)) {
+            if (size < OBNsim::Socket::FRAME_TAG_SIZE ||
+                !msg.ParseFromArray(data + OBNsim::Socket::FRAME_TAG_SIZE, size - OBNsim::Socket::FRAME_TAG_SIZE)) {
+                ++bad;
+                continue;
+            }
+            auto tag = OBNsim::Socket::frameTag(data);
+            auto found = ids.emplace(tag, msg.id());
+            if (tag >= portNames.size() || found.first->second != msg.id()) {
+                ++bad;
+                continue;
+            }
+            ack.Clear();
+            ack.set_id(msg.id());
+            if (msg.has_seq()) {
+                ack.set_seq(msg.seq());
+            }
+            switch (msg.msgtype()) {
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_INIT:
+                    ack.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SIM_INIT_ACK);
+                    break;
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_Y:
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_YX:
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_YW:
+                    ack.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SIM_Y_ACK);
+                    break;
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_X:
+                    ack.set_msgtype(OBNSimMsg::N2SMN_MSGTYPE_SIM_X_ACK);
+                    break;
+                case OBNSimMsg::SMN2N_MSGTYPE_SIM_TERM:
+                    ++terminated;
+                    continue;
+                default:
+                    continue;
+            }
+            ack.SerializeToString(&bytes);
+            writer.write(bytes.data(), bytes.size());
+        }
+        if (bundle) {
+            writer.endBundle();
+        }
+    }
+
+    writer.detach(fd);
+    OBNsim::Socket::closeSocket(fd);
+}
+
+
+/** Copy the bytes from one socket to another until the first one is closed. */
+void forward(int from, int to) {
+    char buffer[65536];
+    ssize_t n;
+    while ((n = ::recv(from, buffer, sizeof(buffer), 0)) > 0) {
+        for (ssize_t k = 0; k < n; ) {
+            auto m = ::send(to, buffer + k, n - k, MSG_NOSIGNAL);
+            if (m <= 0) {
+                return;
+            }
+            k += m;
+        }
+    }
+    ::shutdown(to, SHUT_WR);
+}
+
+
+/** The relay: accepts a given number of connections, and connects each one to the SMN. */
+void runRelay(int listen_fd, int numNodes, const std::string& smnAddress, std::vector<std::thread>& threads) {
+    std::string error;
+    for (int k = 0; k < numNodes; ++k) {
+        int client = OBNsim::Socket::acceptFrom(listen_fd);
+        int server = OBNsim::Socket::connectTo(smnAddress, error);
+        if (client < 0 || server < 0) {
+            std::cerr << "ERROR: relay could not connect: " << error << std::endl;
+            return;
+        }
+        threads.emplace_back(forward, client, server);
+        threads.emplace_back(forward, server, client);
+    }
+}
+
+
+/** Run the simulation of a given number of steps with a given number of nodes.
+ \param address The address on which the SMN listens.
+ \param relayAddress If not empty, the nodes connect to the relay at this address instead of to the SMN.
+ \param shared Whether the nodes share one connection (without relay).
+ \param bundle Whether the messages on a shared connection are bundled.
+ \return The number of steps per second, or a negative value if an error occurred.
+ */
+double runSteps(const std::string& address, const std::string& relayAddress, int numNodes, int numSteps, bool shared = false, bool bundle = true) {
+    GCThread gc;
+    SOCKET::SocketServer server(&gc);
+    server.setAddress(address);
+    if (!server.start()) {
+        return -1.0;
+    }
+
+    int relay_fd = -1;
+    std::vector<std::thread> relayThreads;
+    std::thread relay;
+    if (!relayAddress.empty()) {
+        std::string error;
+        relay_fd = OBNsim::Socket::listenOn(relayAddress, error);
+        if (relay_fd < 0) {
+            std::cerr << "ERROR: " << error << std::endl;
+            return -1.0;
+        }
+        relay = std::thread(runRelay, relay_fd, numNodes, address, std::ref(relayThreads));
+    }
+
+    std::atomic<int> bad(0);
+    std::vector<std::string> portNames;
+    std::vector<std::thread> nodes;
+    for (int k = 0; k < numNodes; ++k) {
+        portNames.push_back("bench/n" + std::to_string(k) + "/_gc_");
+        auto* node = new SOCKET::OBNNodeSocket("n" + std::to_string(k), 1, portNames.back(), &server);
+        node->setUpdateType(0, 1);
+        gc.insertNode(node);
+        if (!shared) {
+            nodes.emplace_back(runNode, relayAddress.empty()?address:relayAddress, portNames.back(), std::ref(bad));
+        }
+    }
+    if (shared) {
+        nodes.emplace_back(runHost, address, std::cref(portNames), bundle, std::ref(bad));
+    }
+    if (relay.joinable()) {
+        relay.join();
+    }
+
+    // Wait for all nodes to connect: the server notifies their arrivals
+    while (bad == 0 && !server.arrivals().waitForAll(portNames, 0.1).empty()) { }
+
+    gc.setDependencyGraph(new NodeDepGraph_CSR(numNodes));
+    gc.setSimulationTimeUnit(1);
+    gc.setFinalSimulationTime(numSteps - 1);
+    gc.bundle_messages = bundle;
+
+    auto t0 = std::chrono::steady_clock::now();
+    gc.startThread();
+    gc.joinThread();
+    auto t1 = std::chrono::steady_clock::now();
+
+    for (auto& t: nodes) {
+        t.join();
+    }
+    server.stop();
+    for (auto& t: relayThreads) {
+        t.join();
+    }
+    OBNsim::Socket::closeSocket(relay_fd);
+    OBNsim::Socket::unlinkAddress(relayAddress);
+
+    return (bad > 0)?-1.0:(numSteps / std::chrono::duration<double>(t1 - t0).count());
+}
+
+
+int main(int argc, char **argv) {
+    const int numSteps = 2000;
+    const std::string unixAddress = OBNsim::Socket::defaultAddress("benchsocket/");
+    bool allOK = true;
+
+    std::cout << "GC step rate with socket transports (" << numSteps << " steps, all nodes update in every step)" << std::endl;
+    std::cout << std::setw(8) << "nodes" << std::setw(14) << "unix (st/s)" << std::setw(14) << "tcp (st/s)" << std::setw(20) << "tcp+relay (st/s)" << std::setw(20) << "unix shared (st/s)" << std::setw(24) << "shared unbundled (st/s)" << std::endl;
+    for (int numNodes: {1, 8, 32}) {
+        double r1 = runSteps(unixAddress, "", numNodes, numSteps);
+        double r2 = runSteps("tcp:127.0.0.1:47651", "", numNodes, numSteps);
+        double r3 = runSteps("tcp:127.0.0.1:47652", "tcp:127.0.0.1:47653", numNodes, numSteps);
+        double r4 = runSteps(unixAddress, "", numNodes, numSteps, true);
+        double r5 = runSteps(unixAddress, "", numNodes, numSteps, true, false);
+
+        std::cout << std::setw(8) << numNodes << std::fixed << std::setprecision(0) << std::setw(14) << r1 << std::setw(14) << r2 << std::setw(20) << r3 << std::setw(20) << r4 << std::setw(24) << r5;
+        if (r1 < 0 || r2 < 0 || r3 < 0 || r4 < 0 || r5 < 0) {
+            std::cout << "  FAILED";
+            allOK = false;
+        }
+        std::cout << std::endl;
+    }
+
+    return allOK?0:1;
+}